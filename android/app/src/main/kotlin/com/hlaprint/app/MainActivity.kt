@@ -47,15 +47,17 @@ class MainActivity : FlutterActivity() {
                                 println("Duplex = $duplex")
                                 println("Color = $colorMode")
                                 println("Orientation = $orientation")
-                                printPdfDirectIPP(
-                                    pdfFile = pdfFile,
-                                    printerIp = ip,
-                                    orientation = orientation,
-                                    duplex = duplex,
-                                    colorMode = colorMode,
-                                    pageSize = pageSize,
-                                    copies = copies
-                                )
+                                pdfFile.inputStream().buffered().use { document ->
+                                    printPdfDirectIPP(
+                                        document = document,
+                                        printerIp = ip,
+                                        orientation = orientation,
+                                        duplex = duplex,
+                                        colorMode = colorMode,
+                                        pageSize = pageSize,
+                                        copies = copies
+                                    )
+                                }
                                 result.success("success")
                             } catch (e: Exception) {
                                 e.printStackTrace()
@@ -64,10 +66,12 @@ class MainActivity : FlutterActivity() {
                         }.start()
                     }
                     "printInvoicePdf" -> {
+                        // PDF dari Dart sebagai bytes (tanpa file sementara) atau path file
+                        val fileBytes = call.argument<ByteArray>("fileBytes")
                         val filePath = call.argument<String>("filePath")
                         val printerIp = call.argument<String>("ip")
 
-                        if (filePath == null || printerIp == null) {
+                        if ((fileBytes == null && filePath == null) || printerIp == null) {
                             result.success("error:missing-params")
                             return@setMethodCallHandler
                         }
@@ -78,14 +82,17 @@ class MainActivity : FlutterActivity() {
 
                         Thread {
                             try {
-                                val pdfFile = File(filePath)
-                                printPdfDirectIPP(
-                                    pdfFile = pdfFile,
-                                    printerIp = printerIp,
-                                    orientation = orientation,
-                                    duplex = duplex,
-                                    pageSize = pageSize
-                                )
+                                val document: InputStream = fileBytes?.let { ByteArrayInputStream(it) }
+                                    ?: File(filePath!!).inputStream().buffered()
+                                document.use {
+                                    printPdfDirectIPP(
+                                        document = it,
+                                        printerIp = printerIp,
+                                        orientation = orientation,
+                                        duplex = duplex,
+                                        pageSize = pageSize
+                                    )
+                                }
                                 result.success("success")
                             } catch (e: Exception) {
                                 result.success("error:${e.message}")
@@ -119,7 +126,7 @@ class MainActivity : FlutterActivity() {
 
 
     private fun printPdfDirectIPP(
-        pdfFile: File,
+        document: InputStream,
         printerIp: String,
         orientation: Int,
         duplex: Boolean,
@@ -142,7 +149,7 @@ class MainActivity : FlutterActivity() {
             }
 
             val job = printer.printJob(
-                pdfFile,
+                document,
                 IppAttribute("job-name", IppTag.NameWithoutLanguage, IppString("IPP_Print_PDF")),
                 IppAttribute("document-format", IppTag.MimeMediaType, "application/pdf"),
                 IppAttribute("copies", IppTag.Integer, copies),
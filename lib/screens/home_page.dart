@@ -45,10 +45,21 @@ class _HomePageState extends State<HomePage> {
   final CashApproveService _cashApproveService = CashApproveService();
   final UserService _userService = UserService();
   final Map<int, int> _jobBatchTracker = {};
+  // printPDF Windows berjalan di worker native; hasilnya datang lewat
+  // onSpoolCompleted/onSpoolFailed dengan jobHandle yang dikembalikan printPDF.
+  final Map<int, Completer<String>> _nativeSpoolWaiters = {};
+  final Map<int, Object> _earlySpoolResults = {};
+  // Job hitam-putih dikirim native sebagai bitmap 1 bit. 'ordered' menjaga
+  // arsiran/foto tetap terbaca; 'threshold' paling tajam untuk teks murni,
+  // 'diffusion' terbaik untuk foto tapi paling lambat.
+  static const String _monoDitherMode = 'ordered';
   String _bwPrinterName = '';
   String _colorPrinterName = '';
   bool _isBwPrinterOnline = false;
   bool _isColorPrinterOnline = false;
+  // Printer yang sedang dipantau native (Windows/Linux); status berikutnya
+  // datang sebagai event onPrinterStatus, tidak di-poll lagi.
+  String _watchedPrinters = '';
   bool _isSmartCopiesActive = false;
   bool _isDownloading = false;
   double _downloadProgress = 0.0;
@@ -95,47 +106,86 @@ class _HomePageState extends State<HomePage> {
     }
 
     platform.setMethodCallHandler((call) async {
-      switch (call.method) {
-        case 'onPrintJobCompleted':
-          final args = call.arguments as Map;
-          final int printJobId = args['printJobId'];
-
-          _handleJobCompletion(printJobId);
-          _stopAnimationTimer = Timer(const Duration(seconds: 5), () {
-            if (mounted) setState(() => _isAnimatingPrint = false);
-          });
-          break;
-
-        case 'onPrintJobFailed':
-          final args = call.arguments as Map;
-          final int printJobId = args['printJobId'];
-          final String reason = args['error'] ?? "Unknown";
+      _handlePlatformEvent(call.method, call.arguments);
+    });
 
-          debugPrint("DART: Job #$printJobId FAILED/CANCELLED. Reason: $reason");
+  }
 
-          if (_jobBatchTracker.containsKey(printJobId)) {
-            _jobBatchTracker.remove(printJobId);
-          }
+  // Events arrive from the runner in onPrintEvents batches; each item carries
+  // its legacy method name in 'event'.
+  void _handlePlatformEvent(String method, dynamic arguments) {
+    switch (method) {
+      case 'onPrintEvents':
+        final args = arguments as Map;
+        final int dropped = args['dropped'] ?? 0;
+        if (dropped > 0) debugPrint("DART: $dropped print events dropped by the native queue");
+        for (final event in args['events'] as List) {
+          _handlePlatformEvent(event['event'] as String, event);
+        }
+        break;
+      case 'onPrintJobCompleted':
+        final args = arguments as Map;
+        final int printJobId = args['printJobId'];
+        debugPrint("DART: Job #$printJobId completed, spool ${args['spoolBytes']} bytes");
+
+        _handleJobCompletion(printJobId);
+        _stopAnimationTimer = Timer(const Duration(seconds: 5), () {
           if (mounted) setState(() => _isAnimatingPrint = false);
-          break;
-        case 'onPrinterStatus':
-          String status = call.arguments as String;
-          debugPrint("PRINTER STATUS: $status");
-          break;
-        case 'onPrintProgress':
-          final args = call.arguments as Map;
-          final String statusLog = args['status'] ?? "";
-
-          if (statusLog.contains("[Printing]")) {
-            if (mounted) setState(() => _isAnimatingPrint = true);
-            _stopAnimationTimer?.cancel();
-          }
-          break;
-        default:
-          debugPrint('Unknown method ${call.method}');
-      }
-    });
+        });
+        break;
+
+      case 'onPrintJobFailed':
+        final args = arguments as Map;
+        final int printJobId = args['printJobId'];
+        final String reason = args['error'] ?? "Unknown";
 
+        debugPrint("DART: Job #$printJobId FAILED/CANCELLED. Reason: $reason");
+
+        if (_jobBatchTracker.containsKey(printJobId)) {
+          _jobBatchTracker.remove(printJobId);
+        }
+        if (mounted) setState(() => _isAnimatingPrint = false);
+        break;
+      case 'onPrinterStatus':
+        if (arguments is Map) {
+          _applyPrinterStatus(arguments);
+        } else {
+          debugPrint("PRINTER STATUS: $arguments");
+        }
+        break;
+      case 'onSpoolStarted':
+        final args = arguments as Map;
+        debugPrint("DART: Spool handle #${args['jobHandle']} started (job #${args['printJobId']}, setup ${args['setupMs']?.round()} ms)");
+        break;
+      case 'onSpoolProgress':
+        final args = arguments as Map;
+        debugPrint("DART: Spool handle #${args['jobHandle']} ${args['pagesSpooled']}/${args['totalPages']} pages");
+        break;
+      case 'onSpoolCompleted':
+        final args = arguments as Map;
+        debugPrint("DART: Spool handle #${args['jobHandle']} done, first page after ${args['firstPageMs']?.round()} ms, "
+            "spool ${args['spoolBytes']} bytes (mono ${args['monoMode']}), peak RSS ${args['peakRssBytes']} bytes");
+        _completeNativeSpool(args['jobHandle'] as int, 'Sent To Printer');
+        break;
+      case 'onSpoolFailed':
+        final args = arguments as Map;
+        _completeNativeSpool(
+          args['jobHandle'] as int,
+          PlatformException(code: args['code'] ?? 'PRINT_FAILED', message: args['error']),
+        );
+        break;
+      case 'onPrintProgress':
+        final args = arguments as Map;
+        final String statusLog = args['status'] ?? "";
+
+        if (statusLog.contains("[Printing]")) {
+          if (mounted) setState(() => _isAnimatingPrint = true);
+          _stopAnimationTimer?.cancel();
+        }
+        break;
+      default:
+        debugPrint('Unknown method $method');
+    }
   }
 
   void _startPrinterStatusTimer() {
@@ -285,8 +335,8 @@ class _HomePageState extends State<HomePage> {
       }
       return;
     }
-    // Jika platform bukan windows, logic sederhana
-    if (!Platform.isWindows) {
+    // Jika platform bukan windows/linux, logic sederhana
+    if (!Platform.isWindows && !Platform.isLinux) {
       if (mounted) {
         setState(() {
           _bwPrinterName = newBwName;
@@ -296,46 +346,45 @@ class _HomePageState extends State<HomePage> {
       return;
     }
 
-    bool bwStatus = false;
-    bool colorStatus = false;
-
-    if (newBwName.isNotEmpty) {
-      try {
-        final bool result = await platform.invokeMethod(
-            'getPrinterStatus', {'printerName': newBwName});
-        bwStatus = result;
-        //debugPrint("🔍 [Cek Printer BW] Nama: $newBwName | Status Online: $result");
-      } catch (e) {
-        debugPrint("Error check BW printer: $e"); // Commented to reduce log spam on timer
-      }
-    }
+    final printers = [
+      if (newBwName.isNotEmpty) newBwName,
+      if (newColorName.isNotEmpty &&
+          ['shopowner', 'shopmanager', 'cashier', 'coffeshop'].contains(_userRole))
+        newColorName,
+    ];
+    // Timer hanya membaca preferensi; native baru dipanggil saat daftar printer berubah
+    final watchKey = printers.join('\n');
+    if (watchKey == _watchedPrinters) return;
+    _watchedPrinters = watchKey;
 
-    if (newColorName.isNotEmpty &&
-        ['shopowner', 'shopmanager', 'cashier', 'coffeshop'].contains(_userRole)) {
-      try {
-        final bool result = await platform.invokeMethod(
-            'getPrinterStatus', {'printerName': newColorName});
-        colorStatus = result;
-        //debugPrint("🔍 [Cek Printer Color] Nama: $newColorName | Status Online: $result");
-      } catch (e) {
-        debugPrint("Error check Color printer: $e");
-      }
+    Map statuses = {};
+    try {
+      statuses = await platform.invokeMethod('watchPrinters', {'printers': printers}) ?? {};
+    } catch (e) {
+      debugPrint("Error watch printers: $e");
     }
 
     if (mounted) {
-      // Optimasi: Hanya setState jika ada perubahan value untuk mencegah flicker UI saat Timer berjalan
-      if (_bwPrinterName != newBwName ||
-          _colorPrinterName != newColorName ||
-          _isBwPrinterOnline != bwStatus ||
-          _isColorPrinterOnline != colorStatus) {
+      setState(() {
+        _bwPrinterName = newBwName;
+        _colorPrinterName = newColorName;
+        _isBwPrinterOnline = statuses[newBwName]?['online'] ?? false;
+        _isColorPrinterOnline = statuses[newColorName]?['online'] ?? false;
+      });
+    }
+  }
 
-        setState(() {
-          _bwPrinterName = newBwName;
-          _colorPrinterName = newColorName;
-          _isBwPrinterOnline = bwStatus;
-          _isColorPrinterOnline = colorStatus;
-        });
-      }
+  void _applyPrinterStatus(Map status) {
+    final String printerName = status['printerName'] ?? '';
+    final bool online = status['online'] ?? false;
+    debugPrint("PRINTER STATUS: $printerName online=$online paperOut=${status['paperOut']} "
+        "error=${status['error']} queued=${status['queuedJobs']} ppm=${status['pagesPerMinute']}");
+    if (!mounted || printerName.isEmpty) return;
+    if (printerName == _bwPrinterName && _isBwPrinterOnline != online) {
+      setState(() => _isBwPrinterOnline = online);
+    }
+    if (printerName == _colorPrinterName && _isColorPrinterOnline != online) {
+      setState(() => _isColorPrinterOnline = online);
     }
   }
 
@@ -834,7 +883,29 @@ class _HomePageState extends State<HomePage> {
     }
   }
 
-  Future<bool> _runGhostscriptCommand(String inputPath, String outputPath, int timeoutSeconds, {required int startPage, required int endPage}) async {
+  // Rasterize halaman di native (Poppler/Cairo, multi-thread) tanpa spawn gswin64c.
+  Future<bool> _rasterizePagesNative(String inputPath, String outputPath, {required int startPage, required int endPage, bool color = true}) async {
+    try {
+      final Map<Object?, Object?>? result = await platform.invokeMethod('rasterizePages', {
+        'inputPath': inputPath,
+        'outputPath': outputPath,
+        'startPage': startPage,
+        'endPage': endPage,
+        'dpi': 300,
+        if (!color) 'monoMode': _monoDitherMode,
+      });
+      debugPrint("Native rasterize: ${result?['pages']} pages, ${result?['threads']} threads, ${result?['elapsedMs']} ms, "
+          "${result?['outputBytes']} bytes");
+      return File(outputPath).existsSync();
+    } on PlatformException catch (e) {
+      debugPrint("Native rasterize failed: ${e.message}");
+      return false;
+    } on MissingPluginException {
+      return false;
+    }
+  }
+
+  Future<bool> _runGhostscriptCommand(String inputPath, String outputPath, int timeoutSeconds, {required int startPage, required int endPage, bool color = true}) async {
     final String execDir = p.dirname(Platform.resolvedExecutable);
     final String gstPath = p.join(execDir, 'gswin64c.exe');
 
@@ -842,7 +913,8 @@ class _HomePageState extends State<HomePage> {
       '-dBATCH',
       '-dNOPAUSE',
       '-dSAFER',
-      '-sDEVICE=pdfimage24',
+      // Job hitam-putih cukup grayscale 8 bit, sepertiga data RGB
+      color ? '-sDEVICE=pdfimage24' : '-sDEVICE=pdfimage8',
       '-r300',
       '-dTextAlphaBits=4',
       '-dGraphicsAlphaBits=4',
@@ -924,6 +996,22 @@ class _HomePageState extends State<HomePage> {
       debugPrint("Total Pages: $totalPagesToPrint | Batch Size: $batchSize");
       debugPrint("Requested Copies: $copies | Loop Runs: $outerLoopLimit | Copies Per Command: $copiesForPrintCommand | pageSize: $pageSize");
 
+      // Jalur utama Windows: seluruh rentang halaman + salinan dikirim dalam satu
+      // spool job langsung dari file asli. Loop batch di bawah hanya dipakai sebagai fallback.
+      if (Platform.isWindows && altPrintMode == printDefault && originalFile != null) {
+        _jobBatchTracker[jobId] = 1;
+        bool isDirectSuccess = await _printRangeForWindows(originalFile, printerName, job, pageSize, startPage, endPage);
+        if (isDirectSuccess) {
+          if (job.status != 'Sent To Printer') {
+            await _updatePrintJobStatus(jobId, 'Sent To Printer', currentStatus: 'Processing');
+          }
+          setState(() => _gsProgress = 1.0);
+          return;
+        }
+        debugPrint("Direct range print failed. Falling back to batch mode...");
+        _jobBatchTracker[jobId] = totalOperations;
+      }
+
       for (int c = 0; c < outerLoopLimit; c++) {
         if (mounted) {
           setState(() {
@@ -961,13 +1049,24 @@ class _HomePageState extends State<HomePage> {
             bool success = false;
             if (Platform.isWindows && altPrintMode == printDefault) {
               if (originalFile != null) {
-                success = await _runGhostscriptCommand(
+                success = await _rasterizePagesNative(
                     originalFile.path,
                     newPath,
-                    30,
                     startPage: currentBatchStart,
-                    endPage: currentBatchEnd
+                    endPage: currentBatchEnd,
+                    color: job.color ?? false
                 );
+                if (!success) {
+                  debugPrint("Native rasterizer failed. Falling back to Ghostscript...");
+                  success = await _runGhostscriptCommand(
+                      originalFile.path,
+                      newPath,
+                      30,
+                      startPage: currentBatchStart,
+                      endPage: currentBatchEnd,
+                      color: job.color ?? false
+                  );
+                }
               } else {
                 debugPrint("Error: Original file is missing for Windows print job.");
                 success = false;
@@ -1016,19 +1115,8 @@ class _HomePageState extends State<HomePage> {
             }
           } else if (Platform.isWindows && originalFile != null) {
             debugPrint("Batch ${i + 1}. Fallback to Sumatra per page...");
-            bool isSumatraSuccess = await _printWithSumatra(originalFile.path, printerName, jobToPrint, pageSize, currentBatchStart, currentBatchEnd);
-            if (isSumatraSuccess) {
-              debugPrint("Sumatra sent command. Requesting C++ to monitor spooler...");
-              await Future.delayed(const Duration(milliseconds: 500));
-              try {
-                await platform.invokeMethod('monitorLastJob', {
-                  'printerName': printerName,
-                  'printJobId': jobId,
-                });
-              } catch (e) {
-                debugPrint("Gagal memanggil monitor C++: $e");
-              }
-            } else {
+            bool isSumatraSuccess = await _printWithSumatra(originalFile.path, printerName, jobToPrint, pageSize, currentBatchStart, currentBatchEnd, monitorJobId: jobId);
+            if (!isSumatraSuccess) {
               ScaffoldMessenger.of(context).showSnackBar(
                 SnackBar(
                   content: Text('Failed to print with Type A'),
@@ -1172,72 +1260,29 @@ class _HomePageState extends State<HomePage> {
       return false;
     }
   }
-  // Helper untuk mencari nama kertas yang cocok di driver
+  // Helper untuk mencari nama kertas yang cocok di driver. Pencocokan (nama
+  // persis, F4/Folio, ukuran standar, lalu nama terpendek yang mengandung
+  // target) dilakukan native dari database kapabilitas printer.
   Future<String> _resolvePaperNameForSumatra(String printerName, String targetSize) async {
     try {
-      // 1. Minta daftar kertas dari Driver via Native C++
-      final List<Object?> result = await platform.invokeMethod('getPrinterPaperSizes', {
-        'ip': printerName, // Kirim nama printer
+      final String? paperName = await platform.invokeMethod('resolvePaperName', {
+        'printerName': printerName,
+        'pageSize': targetSize,
       });
+      if (paperName != null) return paperName;
 
-      // Casting ke List<String>
-      List<String> availablePapers = result.map((e) => e.toString()).toList();
-
-      debugPrint("Driver Papers for $printerName: $availablePapers");
-
-      String targetUpper = targetSize.toUpperCase().trim(); // misal "A5"
-
-      // 2. LOGIKA PENCOCOKAN (Fuzzy Matching)
-
-      // Prioritas A: Cari yang sama persis (Case Insensitive)
-      for (var paper in availablePapers) {
-        if (paper.toUpperCase() == targetUpper) return paper;
-      }
-
-      // Prioritas B: Cari yang MENGANDUNG kata tersebut (misal "A5" ada di "ISO A5" atau "A5 148x210")
-      // Kita cari yang stringnya paling pendek tapi mengandung kata kunci (untuk menghindari 'A5' match dengan 'A5 Extra Large')
-      String? bestMatch;
-      int shortestLength = 999;
-
-      for (var paper in availablePapers) {
-        String pUpper = paper.toUpperCase();
-
-        // Khusus F4, cari juga "FOLIO" atau "OFICIO"
-        if (targetUpper == "F4") {
-          if (pUpper.contains("FOLIO") || pUpper.contains("OFICIO") || pUpper.contains("F4")) {
-            return paper; // Ketemu F4/Folio
-          }
-        }
-
-        // Pencocokan standar (Contains)
-        // Tambahkan spasi agar "A5" tidak match dengan "A50" (jika ada)
-        // Cek: "A5", "A5 ", " A5"
-        bool match = pUpper == targetUpper ||
-            pUpper.contains("$targetUpper ") ||
-            pUpper.contains(" $targetUpper") ||
-            pUpper.contains(targetUpper); // Fallback longgar
-
-        if (match) {
-          if (paper.length < shortestLength) {
-            shortestLength = paper.length;
-            bestMatch = paper;
-          }
-        }
-      }
-
-      if (bestMatch != null) return bestMatch;
-
-      // 3. Jika tidak ketemu sama sekali, kembalikan default A4 (atau biarkan Sumatra pakai default printer)
+      // Jika tidak ketemu sama sekali, kembalikan default A4 (atau biarkan Sumatra pakai default printer)
       debugPrint("Paper size $targetSize not found in driver. Defaulting to A4.");
       return "A4";
-
     } catch (e) {
       debugPrint("Failed to resolve paper name: $e");
       return "A4"; // Fallback jika error
     }
   }
 
-  Future<bool> _printWithSumatra(String filePath, String printerName, PrintJob printJob, String pageSize, int customStartPage, int customEndPage) async {
+  /// [monitorJobId]: print job yang dipantau di spooler. Dokumen dicetak dari
+  /// salinan bernama tag dari C++, jadi job-nya dikenali dari nama dokumen.
+  Future<bool> _printWithSumatra(String filePath, String printerName, PrintJob printJob, String pageSize, int customStartPage, int customEndPage, {int? monitorJobId}) async {
     debugPrint("Attempting fallback print with SumatraPDF...");
 
     final startPage = customStartPage;
@@ -1302,7 +1347,22 @@ class _HomePageState extends State<HomePage> {
       args.add('-print-settings');
       args.add(printSettings);
     }
-    args.add(filePath);
+
+    File? taggedCopy;
+    if (monitorJobId != null) {
+      try {
+        final String? tag = await platform.invokeMethod<String>('expectSpoolJob', {
+          'printerName': printerName,
+          'printJobId': monitorJobId,
+        });
+        if (tag != null) {
+          taggedCopy = await File(filePath).copy(p.join(Directory.systemTemp.path, '$tag.pdf'));
+        }
+      } catch (e) {
+        debugPrint("Gagal menyiapkan pemantauan spooler: $e");
+      }
+    }
+    args.add(taggedCopy?.path ?? filePath);
 
     try {
       final String execDir = p.dirname(Platform.resolvedExecutable);
@@ -1323,6 +1383,13 @@ class _HomePageState extends State<HomePage> {
     } catch (e) {
       debugPrint("Exception running SumatraPDF: $e");
       return false;
+    } finally {
+      // SumatraPDF -silent baru keluar setelah dokumen selesai di-spool
+      if (taggedCopy != null) {
+        try {
+          await taggedCopy.delete();
+        } catch (_) {}
+      }
     }
   }
 
@@ -1380,6 +1447,11 @@ class _HomePageState extends State<HomePage> {
         String docPageSize = docPageSizeRaw.toUpperCase().trim();
         if (docPageSize.isEmpty) docPageSize = "A4";
 
+        if ((Platform.isWindows && altPrintMode == printDefault) || Platform.isLinux) {
+          if (await _printTransactionNative(response, userRole, docPageSize)) return;
+          debugPrint("Native transaction unavailable. Falling back to per-file printing...");
+        }
+
         if (response.isUseInvoice) {
           String invoicePrinter = _bwPrinterName;
           if (userRole != null && userRole != 'darkstore' && response.printFiles.first.color == true) {
@@ -1403,43 +1475,16 @@ class _HomePageState extends State<HomePage> {
           try {
             await _updatePrintJobStatus(job.id, 'Processing', currentStatus: job.status);
 
-            if (Platform.isWindows && altPrintMode != printTypeB) {
-              final String filenameToDownload = Uri.parse(job.filename).pathSegments.last;
-              final Directory tempDir = await getTemporaryDirectory();
-              final String savePath = p.join(tempDir.path, filenameToDownload);
-
-              setState(() {
-                _isDownloading = true;
-                _downloadProgress = 0.0;
-              });
-
-              try {
-                await Dio().download(
-                  job.filename,
-                  savePath,
-                  onReceiveProgress: (received, total) {
-                    if (total > 0) {
-                      setState(() {
-                        _downloadProgress = received / total;
-                      });
-                    }
-                  },
-                );
+            // Cetak sambil mengunduh; bila gagal, alur unduh-lalu-cetak di bawah dipakai
+            if (Platform.isWindows && altPrintMode == printDefault &&
+                await _streamPrintForWindows(job, selectedPrinter)) {
+              await _updatePrintJobStatus(job.id, 'Sent To Printer', currentStatus: 'Processing');
+              await _updatePrintCount(job.id);
+              continue;
+            }
 
-                downloadedFile = File(savePath);
-              } catch (e) {
-                debugPrint("Download Error: $e");
-                ScaffoldMessenger.of(context).showSnackBar(
-                  SnackBar(content: Text('Failed to download file: $e')),
-                );
-                rethrow;
-              } finally {
-                if (mounted) {
-                  setState(() {
-                    _isDownloading = false;
-                  });
-                }
-              }
+            if (Platform.isWindows && altPrintMode != printTypeB) {
+              downloadedFile = await _downloadPrintFile(job);
             }
 
             await _processAndPrintStreamed(
@@ -1502,6 +1547,238 @@ class _HomePageState extends State<HomePage> {
     }
   }
 
+  Future<File> _downloadPrintFile(PrintJob job) async {
+    final String filenameToDownload = Uri.parse(job.filename).pathSegments.last;
+    final Directory tempDir = await getTemporaryDirectory();
+    final String savePath = p.join(tempDir.path, filenameToDownload);
+
+    setState(() {
+      _isDownloading = true;
+      _downloadProgress = 0.0;
+    });
+
+    try {
+      await Dio().download(
+        job.filename,
+        savePath,
+        onReceiveProgress: (received, total) {
+          if (total > 0) {
+            setState(() {
+              _downloadProgress = received / total;
+            });
+          }
+        },
+      );
+
+      return File(savePath);
+    } catch (e) {
+      debugPrint("Download Error: $e");
+      ScaffoldMessenger.of(context).showSnackBar(
+        SnackBar(content: Text('Failed to download file: $e')),
+      );
+      rethrow;
+    } finally {
+      if (mounted) {
+        setState(() {
+          _isDownloading = false;
+        });
+      }
+    }
+  }
+
+  // Seluruh transaksi (invoice, file, separator) dikirim sekali ke native dan
+  // dicetak sebagai satu dokumen spooler per printer, tanpa jeda antar job.
+  // Mengembalikan false bila native tidak menerima transaksi, supaya alur
+  // per-file yang lama dipakai; gagal setelah diterima hanya dilaporkan.
+  Future<bool> _printTransactionNative(PrintJobResponse response, String? userRole, String docPageSize) async {
+    // Linux tanpa printer diset: hasil cukup ditulis ke file PDF
+    String target(String printerName) => printerName.isEmpty && Platform.isLinux ? 'file' : printerName;
+    final List<File> tempFiles = [];
+    final List<Map<String, dynamic>> sections = [];
+
+    try {
+      if (response.isUseInvoice && response.userRole != "online") {
+        String invoicePrinter = _bwPrinterName;
+        if (userRole != null && userRole != 'darkstore' && response.printFiles.first.color == true) {
+          invoicePrinter = _colorPrinterName;
+        }
+        Uint8List? invoicePdf;
+        try {
+          invoicePdf = await _renderInvoicePdf(_invoiceUrl(response));
+        } catch (e) {
+          debugPrint("Failed to render invoice: $e");
+        }
+        if (invoicePdf != null) {
+          // Invoice dikirim sebagai bytes, native membacanya langsung dari memori
+          sections.add({
+            'type': 'document',
+            'fileBytes': invoicePdf,
+            'printerName': target(invoicePrinter),
+            'printJobId': -1, // Dummy ID for invoice
+            'color': false,
+            'doubleSided': false,
+            'copies': 1,
+            'pageSize': docPageSize,
+            'pageOrientation': 'auto',
+          });
+        }
+      }
+
+      for (final job in response.printFiles) {
+        final String selectedPrinter =
+            userRole != 'darkstore' && job.color == true ? _colorPrinterName : _bwPrinterName;
+        String pageSize = (job.pageSize ?? "A4").toUpperCase().trim();
+        if (pageSize.isEmpty) pageSize = "A4";
+
+        await _updatePrintJobStatus(job.id, 'Processing', currentStatus: job.status);
+        final File file = await _downloadPrintFile(job);
+        tempFiles.add(file);
+        final Map<String, dynamic> section = {
+          'type': 'document',
+          'filePath': file.path,
+          'printerName': target(selectedPrinter),
+          'printJobId': job.id,
+          'color': job.color ?? false,
+          'doubleSided': job.doubleSided,
+          'copies': job.copies ?? 1,
+          'pageSize': pageSize,
+          'pageOrientation': job.pageOrientation ?? 'auto',
+          'pagesStart': job.pagesStart,
+          'pageEnd': job.pageEnd,
+          'rasterDpi': 300,
+          'pipelineDepth': 4,
+          'monoMode': _monoDitherMode,
+        };
+        if (selectedPrinter == _colorPrinterName) {
+          sections.addAll(await _splitSectionByColour(section, target(_bwPrinterName)));
+        } else {
+          sections.add(section);
+        }
+      }
+
+      if (response.isUseSeparator) {
+        sections.add({
+          'type': 'separator',
+          'printerName': target(_bwPrinterName),
+          'printJobId': -2,
+          'doubleSided': true,
+          'pageSize': docPageSize,
+        });
+      }
+
+      final Map<Object?, Object?> result;
+      try {
+        result = await platform.invokeMethod('printTransaction', {'sections': sections});
+      } on PlatformException catch (e) {
+        debugPrint("printTransaction rejected: ${e.message}");
+        return false;
+      } on MissingPluginException {
+        return false;
+      }
+
+      setState(() => _isAnimatingPrint = true);
+      final stopwatch = Stopwatch()..start();
+      final List<int> jobHandles = List<int>.from(result['jobHandles'] as List);
+      try {
+        await Future.wait(jobHandles.map(_awaitNativeSpool));
+        debugPrint("Transaction spooled: ${sections.length} sections, ${jobHandles.length} documents (${stopwatch.elapsedMilliseconds} ms)");
+        for (final job in response.printFiles) {
+          // Satu dokumen spooler per printer: job yang dipecah warna ke dua
+          // printer baru selesai setelah onPrintJobCompleted dari keduanya
+          final int documents = sections
+              .where((section) => section['printJobId'] == job.id)
+              .map((section) => section['printerName'])
+              .toSet()
+              .length;
+          _jobBatchTracker[job.id] = documents > 0 ? documents : 1;
+          await _updatePrintJobStatus(job.id, 'Sent To Printer', currentStatus: 'Processing');
+          await _updatePrintCount(job.id);
+        }
+      } on PlatformException catch (e, s) {
+        await Sentry.captureException(e, stackTrace: s);
+        ScaffoldMessenger.of(context).showSnackBar(
+          SnackBar(
+            content: Text('Print Error: ${e.message}'),
+            backgroundColor: Colors.red,
+          ),
+        );
+      }
+      return true;
+    } finally {
+      for (final file in tempFiles) {
+        if (await file.exists()) await file.delete();
+      }
+    }
+  }
+
+  // Preflight native: ukuran, orientasi, warna dan halaman kosong per halaman.
+  // Null bila native tidak mendukung atau analisis gagal.
+  Future<List<Map<Object?, Object?>>?> _analyzeDocumentNative(String filePath) async {
+    try {
+      final Map<Object?, Object?>? result = await platform.invokeMethod('analyzeDocument', {'filePath': filePath});
+      if (result == null) return null;
+      debugPrint("Analyze: ${(result['pages'] as List).length} pages, ${result['colorPages']} colour, "
+          "${result['blankPages']} blank, ${result['threads']} threads, ${result['elapsedMs']} ms"
+          "${result['cached'] == true ? ' (cached)' : ''}");
+      return List<Map<Object?, Object?>>.from(result['pages'] as List);
+    } on PlatformException catch (e) {
+      debugPrint("Analyze failed: ${e.message}");
+      return null;
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  // Bagian berwarna dipecah per halaman: halaman abu-abu ke printer hitam-putih,
+  // halaman kosong dilewati. Dokumen bolak-balik tidak dipecah karena pasangan
+  // muka-belakang harus tetap satu lembar.
+  Future<List<Map<String, dynamic>>> _splitSectionByColour(Map<String, dynamic> section, String bwPrinter) async {
+    if (section['doubleSided'] == true || bwPrinter.isEmpty || bwPrinter == section['printerName']) {
+      return [section];
+    }
+    final pages = await _analyzeDocumentNative(section['filePath'] as String);
+    if (pages == null || pages.isEmpty) return [section];
+
+    final int first = (section['pagesStart'] as int?) ?? 0;
+    final int last = (section['pageEnd'] as int?) ?? 0;
+    final List<int> colorPages = [];
+    final List<int> grayPages = [];
+    for (final page in pages) {
+      final int number = page['page'] as int;
+      if ((first > 0 && number < first) || (last > 0 && number > last)) continue;
+      if (page['blank'] == true) continue;
+      (page['color'] == true ? colorPages : grayPages).add(number);
+    }
+    // Semua kosong: cetak apa adanya daripada menghilangkan job
+    if (colorPages.isEmpty && grayPages.isEmpty) return [section];
+
+    return [
+      if (colorPages.isNotEmpty) {...section, 'pages': colorPages},
+      if (grayPages.isNotEmpty) {...section, 'printerName': bwPrinter, 'color': false, 'pages': grayPages},
+    ];
+  }
+
+  String _invoiceUrl(PrintJobResponse jobResponse) {
+    String colorStatus = '';
+    bool? color = jobResponse.printFiles.first.color;
+    if (jobResponse.printFiles.length == 1) {
+      if (color == true) {
+        colorStatus = 'color';
+      } else if (color == false) {
+        colorStatus = 'bw';
+      }
+    }
+
+    if (jobResponse.userRole == 'darkstore') {
+      String path = "PrintInvoicesNanaNew";
+      if (Platform.isAndroid) {
+        path = "PrintInvoicesNanaAndroid";
+      }
+      return '$baseUrl/$path/${jobResponse.transactionId}/${jobResponse.companyId}/$colorStatus';
+    }
+    return '$baseUrl/PrintInvoices/${jobResponse.transactionId}/$colorStatus';
+  }
+
   Future<void> _printInvoiceFromHtml(String printerName, PrintJobResponse jobResponse, String ipPrinter, String pageSize) async {
     if (jobResponse.userRole != "online") {
       String colorStatus = '';
@@ -1514,20 +1791,8 @@ class _HomePageState extends State<HomePage> {
         }
       }
 
-      String invoiceUrl;
-      int pageOrientation = 3;
-      if (jobResponse.userRole == 'darkstore') {
-        String path = "PrintInvoicesNanaNew";
-        if (Platform.isAndroid) {
-          path = "PrintInvoicesNanaAndroid";
-        }
-        invoiceUrl = '$baseUrl/$path/${jobResponse
-            .transactionId}/${jobResponse.companyId}/$colorStatus';
-      } else {
-        pageOrientation = 4;
-        invoiceUrl =
-        '$baseUrl/PrintInvoices/${jobResponse.transactionId}/$colorStatus';
-      }
+      final String invoiceUrl = _invoiceUrl(jobResponse);
+      final int pageOrientation = jobResponse.userRole == 'darkstore' ? 3 : 4;
 
       if (Platform.isWindows) {
         await _printInvoiceForWindows(printerName, invoiceUrl, color, pageSize);
@@ -1663,31 +1928,49 @@ class _HomePageState extends State<HomePage> {
   }
 
 
-  Future<void> _printInvoiceForWindows(String printerName, String invoiceUrl, bool? color, String pageSize) async {
-    try {
-      final htmlContent = await _printJobService.fetchInvoiceHtml(
-          invoiceUrl);
+  // HTML invoice -> PDF lewat wkhtmltopdf (bundel di Windows, PATH di Linux).
+  // HTML masuk lewat stdin dan PDF dibaca dari stdout, tanpa file sementara.
+  Future<Uint8List?> _renderInvoicePdf(String invoiceUrl) async {
+    final htmlContent = await _printJobService.fetchInvoiceHtml(
+        invoiceUrl);
 
-      final tempDir = await Directory.systemTemp.createTemp();
-      final inputHtml = File(p.join(tempDir.path, 'input.html'));
-      await inputHtml.writeAsString(htmlContent);
+    final String execDir = p.dirname(Platform.resolvedExecutable);
+    final exePath = Platform.isWindows ? p.join(execDir, 'wkhtmltopdf.exe') : 'wkhtmltopdf';
 
-      final outputPdf = File(p.join(tempDir.path, 'output.pdf'));
+    final process = await Process.start(
+      exePath,
+      ['--quiet', '-', '-'],
+      workingDirectory: execDir,
+    );
+    final output = BytesBuilder(copy: false);
+    final stdoutDone = process.stdout.forEach(output.add);
+    final stderrDone = process.stderr.drain<void>();
+    process.stdin.add(utf8.encode(htmlContent));
+    await process.stdin.close();
+    final exitCode = await process.exitCode;
+    await Future.wait([stdoutDone, stderrDone]);
+    debugPrint("Invoice url: $invoiceUrl");
+    return exitCode == 0 && output.isNotEmpty ? output.takeBytes() : null;
+  }
 
-      final String execDir = p.dirname(Platform.resolvedExecutable);
-      final exePath = p.join(execDir, 'wkhtmltopdf.exe');
+  // Untuk jalur yang tetap butuh file (SumatraPDF).
+  Future<File> _writeTempPdf(Uint8List bytes, String name) async {
+    final tempDir = await Directory.systemTemp.createTemp();
+    final file = File(p.join(tempDir.path, name));
+    await file.writeAsBytes(bytes, flush: true);
+    return file;
+  }
+
+  Future<void> _printInvoiceForWindows(String printerName, String invoiceUrl, bool? color, String pageSize) async {
+    try {
       final prefs = await SharedPreferences.getInstance();
       final String altPrintMode = prefs.getString(alternativePrintModeKey) ?? printDefault;
 
-      final result = await Process.run(
-        exePath,
-        [inputHtml.path, outputPdf.path],
-        workingDirectory: execDir,
-      );
-      if (result.exitCode == 0) {
-        debugPrint("Invoice url: $invoiceUrl");
+      final Uint8List? outputPdf = await _renderInvoicePdf(invoiceUrl);
+      if (outputPdf != null) {
         if (altPrintMode == printTypeA) {
-          await _printInvoiceWithSumatra(outputPdf.path, printerName, pageSize);
+          final file = await _writeTempPdf(outputPdf, 'output.pdf');
+          await _printInvoiceWithSumatra(file.path, printerName, pageSize);
         } else {
           await _printInvoiceFile(printerName, outputPdf, color, pageSize);
         }
@@ -1909,12 +2192,9 @@ class _HomePageState extends State<HomePage> {
     try {
       final bytes = await fetchInvoicePdf(invoiceUrl);
 
-      final dir = await getTemporaryDirectory();
-      final filePath = "${dir.path}/invoice_print.pdf";
-      final file = File(filePath);
-      await file.writeAsBytes(bytes);
+      // Dikirim langsung sebagai bytes, tanpa file sementara
       final params = {
-        "filePath": filePath,
+        "fileBytes": bytes,
         "orientation": pageOrientation,
         "ip": ipPrinter,
         "duplex": false,
@@ -1938,12 +2218,43 @@ class _HomePageState extends State<HomePage> {
   }
 
 
-  Future<void> _printInvoiceFile(String printerName, File file, bool? color, String pageSize) async {
+  void _completeNativeSpool(int jobHandle, Object outcome) {
+    final waiter = _nativeSpoolWaiters.remove(jobHandle);
+    if (waiter == null) {
+      // Event datang sebelum printPDF selesai mengembalikan handle
+      _earlySpoolResults[jobHandle] = outcome;
+      return;
+    }
+    if (outcome is PlatformException) {
+      waiter.completeError(outcome);
+    } else {
+      waiter.complete(outcome as String);
+    }
+  }
+
+  // Kirim printPDF (atau printSeparator) ke job executor native dan tunggu
+  // sampai semua halaman sudah masuk spooler. Gagal dilempar sebagai
+  // PlatformException seperti sebelumnya, jadi fallback SumatraPDF tetap berjalan.
+  Future<String> _invokeNativePrint(Map<String, dynamic> args, {String method = 'printPDF'}) async {
+    final response = await platform.invokeMethod(method, args);
+    return _awaitNativeSpool((response as Map)['jobHandle'] as int);
+  }
+
+  Future<String> _awaitNativeSpool(int jobHandle) {
+    final early = _earlySpoolResults.remove(jobHandle);
+    if (early is PlatformException) return Future.error(early);
+    if (early is String) return Future.value(early);
+
+    final waiter = Completer<String>();
+    _nativeSpoolWaiters[jobHandle] = waiter;
+    return waiter.future;
+  }
+
+  Future<void> _printInvoiceFile(String printerName, Uint8List bytes, bool? color, String pageSize) async {
     try {
-      final result = await platform.invokeMethod(
-        'printPDF',
+      final result = await _invokeNativePrint(
         {
-          'filePath': file.path,
+          'fileBytes': bytes,
           'printerName': printerName,
           'printJobId': -1, // Dummy ID for invoice
           'color': false,
@@ -1962,6 +2273,7 @@ class _HomePageState extends State<HomePage> {
     } on PlatformException catch (e, s) {
       debugPrint("Platform channel invoice print failed: $e. Attempting fallback to SumatraPDF...");
 
+      final file = await _writeTempPdf(bytes, 'output.pdf');
       bool isFallbackSuccess = await _printInvoiceWithSumatra(file.path, printerName, pageSize);
       if (isFallbackSuccess) {
         debugPrint("Fallback to SumatraPDF (Invoice) successful.");
@@ -1983,6 +2295,28 @@ class _HomePageState extends State<HomePage> {
   Future<void> _printSeparatorFromAsset(String printerName, String ipPrinter, String pageSize) async {
     File? tempFile;
     try {
+      if (Platform.isWindows) {
+        final prefs = await SharedPreferences.getInstance();
+        final String altPrintMode = prefs.getString(alternativePrintModeKey) ?? printDefault;
+        if (altPrintMode != printTypeA) {
+          // Separator sudah di-cache di native, tanpa file sementara
+          try {
+            await _invokeNativePrint(
+              {
+                'printerName': printerName,
+                'printJobId': -2,
+                'doubleSided': true,
+                'pageSize': pageSize,
+              },
+              method: 'printSeparator',
+            );
+            return;
+          } catch (e) {
+            debugPrint("Native separator failed: $e. Falling back to temp file...");
+          }
+        }
+      }
+
       final byteData = await rootBundle.load('assets/pdf/separator.pdf');
       final tempDir = await Directory.systemTemp.createTemp();
       tempFile = File(p.join(tempDir.path, 'separator.pdf'));
@@ -1997,8 +2331,7 @@ class _HomePageState extends State<HomePage> {
           await _printSeparatorWithSumatra(tempFile.path, printerName, pageSize);
         } else {
           try {
-            await platform.invokeMethod(
-              'printPDF',
+            await _invokeNativePrint(
               {
                 'filePath': tempFile.path,
                 'printerName': printerName,
@@ -2058,8 +2391,7 @@ class _HomePageState extends State<HomePage> {
 
   Future<void> _printFileForWindows(String printerName, File file, PrintJob job, String pageSize) async {
     try {
-      final String result = await platform.invokeMethod(
-        'printPDF',
+      final String result = await _invokeNativePrint(
         {
           'printJobId': job.id,
           'filePath': file.path,
@@ -2081,19 +2413,9 @@ class _HomePageState extends State<HomePage> {
     } on PlatformException catch (e, s) {
       debugPrint("Platform channel print failed: $e. Attempting fallback to SumatraPDF...");
 
-      bool isFallbackSuccess = await _printWithSumatra(file.path, printerName, job, pageSize, 0, 0);
+      bool isFallbackSuccess = await _printWithSumatra(file.path, printerName, job, pageSize, 0, 0, monitorJobId: job.id);
       if (isFallbackSuccess) {
         debugPrint("Fallback to SumatraPDF successful.");
-        await Future.delayed(const Duration(milliseconds: 500));
-
-        try {
-          await platform.invokeMethod('monitorLastJob', {
-            'printerName': printerName,
-            'printJobId': job.id,
-          });
-        } catch (e) {
-          debugPrint("Monitor failed: $e");
-        }
       } else {
         await Sentry.captureException(
           e,
@@ -2108,6 +2430,115 @@ class _HomePageState extends State<HomePage> {
       }
     }
   }
+  // Cetak rentang halaman langsung dari file asli dalam satu spool job (tanpa file batch).
+  Future<bool> _printRangeForWindows(File file, String printerName, PrintJob job, String pageSize, int startPage, int endPage) async {
+    final stopwatch = Stopwatch()..start();
+    try {
+      final String result = await _invokeNativePrint(
+        {
+          'printJobId': job.id,
+          'filePath': file.path,
+          'printerName': printerName,
+          'color': job.color ?? false,
+          'doubleSided': job.doubleSided,
+          'copies': job.copies ?? 1,
+          'pageSize': pageSize,
+          'pageOrientation': job.pageOrientation ?? 'auto',
+          'pagesStart': startPage,
+          'pageEnd': endPage,
+          'rasterDpi': 300,
+          'pipelineDepth': 4,
+          'monoMode': _monoDitherMode,
+        },
+      );
+      debugPrint("Direct range print $startPage-$endPage x${job.copies ?? 1}: $result (${stopwatch.elapsedMilliseconds} ms)");
+      return result == 'success' || result == 'Sent To Printer';
+    } on PlatformException catch (e) {
+      debugPrint("Direct range print failed: ${e.message}");
+      return false;
+    }
+  }
+
+  // Unduh file langsung ke engine native (beginStream/appendStream/endStream)
+  // dan minta printPDF sebelum unduhan selesai. PDF linearized mulai dicetak
+  // begitu halaman pertamanya tiba; file lain dicetak setelah unduhan lengkap.
+  // Mengembalikan false jika cara ini tidak bisa dipakai atau gagal.
+  Future<bool> _streamPrintForWindows(PrintJob job, String printerName) async {
+    String pageSize = (job.pageSize ?? "A4").toUpperCase().trim();
+    if (pageSize.isEmpty) pageSize = "A4";
+    final stopwatch = Stopwatch()..start();
+    String? streamId;
+    bool streamEnded = false;
+
+    setState(() {
+      _isDownloading = true;
+      _downloadProgress = 0.0;
+    });
+
+    try {
+      final response = await Dio().get<ResponseBody>(
+        job.filename,
+        options: Options(responseType: ResponseType.stream),
+      );
+      final int total = int.tryParse(response.headers.value(Headers.contentLengthHeader) ?? '') ?? -1;
+      streamId = await platform.invokeMethod<String>('beginStream', {'expectedLength': total});
+      if (streamId == null) return false;
+
+      // Hasil spool ditangkap sekarang supaya gagal lebih awal tidak jadi error tak tertangani
+      Object? spoolOutcome;
+      final spoolDone = _invokeNativePrint({
+        'streamId': streamId,
+        'printJobId': job.id,
+        'printerName': printerName,
+        'color': job.color ?? false,
+        'doubleSided': job.doubleSided,
+        'copies': job.copies ?? 1,
+        'pageSize': pageSize,
+        'pageOrientation': job.pageOrientation ?? 'auto',
+        'pagesStart': job.pagesStart,
+        'pageEnd': job.pageEnd,
+        'rasterDpi': 300,
+        'pipelineDepth': 4,
+        'monoMode': _monoDitherMode,
+      }).then((result) => spoolOutcome = result, onError: (Object e) => spoolOutcome = e);
+
+      int received = 0;
+      await for (final chunk in response.data!.stream) {
+        await platform.invokeMethod('appendStream', {'streamId': streamId, 'bytes': chunk});
+        received += chunk.length;
+        if (total > 0 && mounted) {
+          setState(() => _downloadProgress = received / total);
+        }
+        // Spool sudah gagal (mis. printer tidak ada), unduhan tidak perlu diteruskan
+        if (spoolOutcome is PlatformException) break;
+      }
+      if (spoolOutcome is PlatformException) {
+        debugPrint("Streamed print failed: $spoolOutcome");
+        return false;
+      }
+      await platform.invokeMethod('endStream', {'streamId': streamId});
+      streamEnded = true;
+      final downloadMs = stopwatch.elapsedMilliseconds;
+
+      await spoolDone;
+      debugPrint("Streamed print job #${job.id}: $received bytes downloaded in $downloadMs ms, "
+          "spooled after ${stopwatch.elapsedMilliseconds} ms: $spoolOutcome");
+      return spoolOutcome == 'success' || spoolOutcome == 'Sent To Printer';
+    } catch (e) {
+      debugPrint("Streamed print failed: $e");
+      return false;
+    } finally {
+      if (streamId != null && !streamEnded) {
+        try {
+          await platform.invokeMethod('endStream', {'streamId': streamId, 'failed': true});
+        } catch (_) {}
+      }
+      if (mounted) {
+        setState(() => _isDownloading = false);
+      }
+    }
+  }
+
   Future<void> _printFile(String printerName, File file, PrintJob job, String ipPrinter, String pageSize) async {
     if (Platform.isAndroid) {
       int pageOrientation;
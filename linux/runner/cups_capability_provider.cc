@@ -0,0 +1,136 @@
+#include "cups_capability_provider.h"
+
+#include <cups/cups.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+ipp_t* GetPrinterAttributes(const std::string& printer, const char* const* attributes,
+                            int count) {
+  char uri[HTTP_MAX_URI];
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", nullptr, "localhost", 0,
+                   "/printers/%s", printer.c_str());
+  ipp_t* request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", nullptr, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", nullptr,
+               cupsUser());
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", count,
+                nullptr, attributes);
+  return cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+}
+
+std::string VersionOf(ipp_t* response) {
+  ipp_attribute_t* model = ippFindAttribute(response, "printer-make-and-model", IPP_TAG_ZERO);
+  ipp_attribute_t* changed =
+      ippFindAttribute(response, "printer-config-change-time", IPP_TAG_INTEGER);
+  std::string version = model && ippGetString(model, 0, nullptr) ? ippGetString(model, 0, nullptr) : "";
+  if (changed) version += " " + std::to_string(ippGetInteger(changed, 0));
+  return version;
+}
+
+// "iso_a4_210x297mm", "na_letter_8.5x11in": the size is the last part.
+void ParseMediaSize(const std::string& keyword, int* width, int* height) {
+  size_t start = keyword.rfind('_');
+  if (start == std::string::npos) return;
+  const char* text = keyword.c_str() + start + 1;
+  char* end = nullptr;
+  double w = strtod(text, &end);
+  if (!end || *end != 'x') return;
+  double h = strtod(end + 1, &end);
+  if (!end) return;
+  double tenths = strcmp(end, "mm") == 0 ? 10.0 : strcmp(end, "in") == 0 ? 254.0 : 0.0;
+  *width = (int)(w * tenths + 0.5);
+  *height = (int)(h * tenths + 0.5);
+}
+
+// Smallest supported margin, from hundredths of a millimetre to points.
+double MarginPoints(ipp_t* response, const char* name) {
+  ipp_attribute_t* attr = ippFindAttribute(response, name, IPP_TAG_INTEGER);
+  if (!attr || ippGetCount(attr) == 0) return 0.0;
+  int smallest = ippGetInteger(attr, 0);
+  for (int i = 1; i < ippGetCount(attr); ++i) smallest = std::min(smallest, ippGetInteger(attr, i));
+  return smallest * 72.0 / 2540.0;
+}
+
+}  // namespace
+
+std::vector<std::string> CupsCapabilityProvider::ListPrinters() {
+  static const char* const kAttributes[] = {"printer-name"};
+  std::vector<std::string> printers;
+  ipp_t* request = ippNewRequest(IPP_OP_CUPS_GET_PRINTERS);
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", 1, nullptr,
+                kAttributes);
+  ipp_t* response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  for (ipp_attribute_t* attr = response ? ippFirstAttribute(response) : nullptr; attr;
+       attr = ippNextAttribute(response)) {
+    const char* name = ippGetName(attr);
+    if (name && strcmp(name, "printer-name") == 0 && ippGetString(attr, 0, nullptr)) {
+      printers.push_back(ippGetString(attr, 0, nullptr));
+    }
+  }
+  ippDelete(response);
+  return printers;
+}
+
+bool CupsCapabilityProvider::DriverVersion(const std::string& printer, std::string* version) {
+  static const char* const kAttributes[] = {"printer-make-and-model", "printer-config-change-time"};
+  ipp_t* response = GetPrinterAttributes(printer, kAttributes, 2);
+  if (!response || !ippFindAttribute(response, "printer-make-and-model", IPP_TAG_ZERO)) {
+    ippDelete(response);
+    return false;
+  }
+  *version = VersionOf(response);
+  ippDelete(response);
+  return true;
+}
+
+bool CupsCapabilityProvider::Query(const std::string& printer, PrinterCapabilities* caps) {
+  static const char* const kAttributes[] = {
+      "printer-make-and-model",       "printer-config-change-time", "media-supported",
+      "printer-resolution-supported", "sides-supported",            "color-supported",
+      "media-left-margin-supported",  "media-top-margin-supported", "media-right-margin-supported",
+      "media-bottom-margin-supported"};
+  ipp_t* response =
+      GetPrinterAttributes(printer, kAttributes, (int)(sizeof(kAttributes) / sizeof(kAttributes[0])));
+  if (!response || !ippFindAttribute(response, "printer-make-and-model", IPP_TAG_ZERO)) {
+    ippDelete(response);
+    return false;
+  }
+  caps->driverVersion = VersionOf(response);
+
+  ipp_attribute_t* media = ippFindAttribute(response, "media-supported", IPP_TAG_ZERO);
+  for (int i = 0; media && i < ippGetCount(media); ++i) {
+    const char* keyword = ippGetString(media, i, nullptr);
+    if (!keyword) continue;
+    PaperInfo paper;
+    paper.name = keyword;
+    ParseMediaSize(paper.name, &paper.width, &paper.height);
+    caps->papers.push_back(paper);
+  }
+
+  ipp_attribute_t* resolutions = ippFindAttribute(response, "printer-resolution-supported", IPP_TAG_ZERO);
+  for (int i = 0; resolutions && i < ippGetCount(resolutions); ++i) {
+    int yres = 0;
+    ipp_res_t units = IPP_RES_PER_INCH;
+    int xres = ippGetResolution(resolutions, i, &yres, &units);
+    caps->dpis.push_back(units == IPP_RES_PER_CM ? (int)(xres * 2.54 + 0.5) : xres);
+  }
+
+  ipp_attribute_t* sides = ippFindAttribute(response, "sides-supported", IPP_TAG_KEYWORD);
+  for (int i = 0; sides && i < ippGetCount(sides); ++i) {
+    const char* side = ippGetString(sides, i, nullptr);
+    if (side && strncmp(side, "two-sided", 9) == 0) caps->duplex = true;
+  }
+  ipp_attribute_t* color = ippFindAttribute(response, "color-supported", IPP_TAG_BOOLEAN);
+  caps->color = color && ippGetBoolean(color, 0);
+
+  caps->marginLeft = MarginPoints(response, "media-left-margin-supported");
+  caps->marginTop = MarginPoints(response, "media-top-margin-supported");
+  caps->marginRight = MarginPoints(response, "media-right-margin-supported");
+  caps->marginBottom = MarginPoints(response, "media-bottom-margin-supported");
+  ippDelete(response);
+  return true;
+}
@@ -0,0 +1,17 @@
+#ifndef FLUTTER_CUPS_CAPABILITY_PROVIDER_H_
+#define FLUTTER_CUPS_CAPABILITY_PROVIDER_H_
+
+#include "printer_capability_db.h"
+
+// CapabilityProvider on CUPS printer attributes. Paper names are the PWG
+// media keywords ("iso_a4_210x297mm"), whose sizes are read from the name;
+// printer-make-and-model plus printer-config-change-time serves as the
+// driver version.
+class CupsCapabilityProvider : public CapabilityProvider {
+ public:
+  std::vector<std::string> ListPrinters() override;
+  bool DriverVersion(const std::string& printer, std::string* version) override;
+  bool Query(const std::string& printer, PrinterCapabilities* caps) override;
+};
+
+#endif  // FLUTTER_CUPS_CAPABILITY_PROVIDER_H_
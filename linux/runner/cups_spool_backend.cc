@@ -0,0 +1,307 @@
+#include "cups_spool_backend.h"
+
+#include <cups/cups.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+std::string PrinterUri(const std::string& queue) {
+  char uri[HTTP_MAX_URI];
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", nullptr, "localhost", 0,
+                   "/printers/%s", queue.c_str());
+  return uri;
+}
+
+ipp_t* NewPrinterRequest(ipp_op_t op, const std::string& queue) {
+  ipp_t* request = ippNewRequest(op);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", nullptr,
+               PrinterUri(queue).c_str());
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", nullptr,
+               cupsUser());
+  return request;
+}
+
+bool HasReason(ipp_attribute_t* reasons, const char* prefix) {
+  for (int i = 0; reasons && i < ippGetCount(reasons); ++i) {
+    const char* reason = ippGetString(reasons, i, nullptr);
+    if (reason && strncmp(reason, prefix, strlen(prefix)) == 0) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+CupsSpoolBackend::~CupsSpoolBackend() {
+  while (!subscriptions_.empty()) RemoveQueue(subscriptions_.begin()->first);
+}
+
+bool CupsSpoolBackend::Subscribe(const std::string& queue, Subscription* subscription) {
+  static const char* const kEvents[] = {"job-created", "job-state-changed", "job-progress",
+                                       "job-completed", "printer-state-changed"};
+  ipp_t* request = NewPrinterRequest(IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS, queue);
+  ippAddStrings(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD, "notify-events",
+                (int)(sizeof(kEvents) / sizeof(kEvents[0])), nullptr, kEvents);
+  ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD, "notify-pull-method", nullptr,
+               "ippget");
+  ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration",
+                kLeaseSeconds);
+  ipp_t* response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  ipp_attribute_t* id =
+      response ? ippFindAttribute(response, "notify-subscription-id", IPP_TAG_INTEGER) : nullptr;
+  if (id) {
+    subscription->id = ippGetInteger(id, 0);
+    subscription->renewAt =
+        std::chrono::steady_clock::now() + std::chrono::seconds(kLeaseSeconds / 2);
+  }
+  ippDelete(response);
+  return id != nullptr;
+}
+
+bool CupsSpoolBackend::AddQueue(const std::string& queue) {
+  Subscription subscription;
+  if (!Subscribe(queue, &subscription)) return false;
+  subscriptions_[queue] = subscription;
+  return true;
+}
+
+void CupsSpoolBackend::RemoveQueue(const std::string& queue) {
+  auto it = subscriptions_.find(queue);
+  if (it == subscriptions_.end()) return;
+  ipp_t* request = NewPrinterRequest(IPP_OP_CANCEL_SUBSCRIPTION, queue);
+  ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id",
+                it->second.id);
+  ippDelete(cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/"));
+  subscriptions_.erase(it);
+}
+
+void CupsSpoolBackend::FetchNotifications(std::vector<std::string>* changed) {
+  auto now = std::chrono::steady_clock::now();
+  for (auto& entry : subscriptions_) {
+    if (now < entry.second.renewAt) continue;
+    ipp_t* request = NewPrinterRequest(IPP_OP_RENEW_SUBSCRIPTION, entry.first);
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id",
+                  entry.second.id);
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-lease-duration",
+                  kLeaseSeconds);
+    ippDelete(cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/"));
+    entry.second.renewAt = now + std::chrono::seconds(kLeaseSeconds / 2);
+  }
+
+  std::vector<int> ids, sequences;
+  std::map<int, std::string> queues;
+  for (const auto& entry : subscriptions_) {
+    ids.push_back(entry.second.id);
+    sequences.push_back(entry.second.nextSequence);
+    queues[entry.second.id] = entry.first;
+  }
+  ipp_t* request = NewPrinterRequest(IPP_OP_GET_NOTIFICATIONS, subscriptions_.begin()->first);
+  ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-ids",
+                 (int)ids.size(), ids.data());
+  ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-sequence-numbers",
+                 (int)sequences.size(), sequences.data());
+  ipp_t* response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  if (!response) return;
+
+  // Tiap event-notification group membawa id langganan dan nomor urutnya
+  int subscriptionId = 0;
+  for (ipp_attribute_t* attr = ippFirstAttribute(response); attr;
+       attr = ippNextAttribute(response)) {
+    if (ippGetGroupTag(attr) != IPP_TAG_EVENT_NOTIFICATION) continue;
+    const char* name = ippGetName(attr);
+    if (!name) continue;
+    if (strcmp(name, "notify-subscription-id") == 0) {
+      subscriptionId = ippGetInteger(attr, 0);
+    } else if (strcmp(name, "notify-sequence-number") == 0) {
+      auto queue = queues.find(subscriptionId);
+      if (queue == queues.end()) continue;
+      Subscription& subscription = subscriptions_[queue->second];
+      subscription.nextSequence = std::max(subscription.nextSequence, ippGetInteger(attr, 0) + 1);
+      if (std::find(changed->begin(), changed->end(), queue->second) == changed->end()) {
+        changed->push_back(queue->second);
+      }
+    }
+  }
+  ippDelete(response);
+}
+
+void CupsSpoolBackend::Wait(int timeoutMs, std::vector<std::string>* changed) {
+  auto deadline = timeoutMs < 0
+                      ? std::chrono::steady_clock::time_point::max()
+                      : std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    if (woken_) break;
+    if (!subscriptions_.empty()) {
+      lock.unlock();
+      FetchNotifications(changed);
+      lock.lock();
+      if (!changed->empty() || woken_) break;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) break;
+    auto wakeAt = subscriptions_.empty() ? deadline : std::min(deadline, now + kNotificationInterval);
+    cv_.wait_until(lock, wakeAt, [this] { return woken_; });
+  }
+  woken_ = false;
+}
+
+void CupsSpoolBackend::Wake() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  woken_ = true;
+  cv_.notify_all();
+}
+
+bool CupsSpoolBackend::QueryJob(const std::string& queue, int jobId, SpoolJobInfo* info) {
+  static const char* const kAttributes[] = {"job-state", "job-state-reasons",
+                                            "job-impressions-completed", "job-impressions",
+                                            "job-k-octets"};
+  char uri[HTTP_MAX_URI];
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", nullptr, "localhost", 0,
+                   "/jobs/%d", jobId);
+  ipp_t* request = ippNewRequest(IPP_OP_GET_JOB_ATTRIBUTES);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "job-uri", nullptr, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", nullptr,
+               cupsUser());
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                (int)(sizeof(kAttributes) / sizeof(kAttributes[0])), nullptr, kAttributes);
+  ipp_t* response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  ipp_attribute_t* state =
+      response ? ippFindAttribute(response, "job-state", IPP_TAG_ENUM) : nullptr;
+  // Riwayat job sudah dibersihkan CUPS: job dianggap selesai
+  if (!state) {
+    ippDelete(response);
+    return false;
+  }
+
+  ipp_attribute_t* reasons = ippFindAttribute(response, "job-state-reasons", IPP_TAG_KEYWORD);
+  ipp_attribute_t* completed =
+      ippFindAttribute(response, "job-impressions-completed", IPP_TAG_INTEGER);
+  ipp_attribute_t* total = ippFindAttribute(response, "job-impressions", IPP_TAG_INTEGER);
+  ipp_attribute_t* kOctets = ippFindAttribute(response, "job-k-octets", IPP_TAG_INTEGER);
+  int jobState = ippGetInteger(state, 0);
+  info->rawStatus = (uint32_t)jobState;
+  info->status = 0;
+  info->pagesPrinted = completed ? ippGetInteger(completed, 0) : 0;
+  info->totalPages = total ? ippGetInteger(total, 0) : 0;
+  info->spoolBytes = kOctets ? (int64_t)ippGetInteger(kOctets, 0) * 1024 : -1;
+  info->finished = jobState >= IPP_JSTATE_CANCELED;
+  switch (jobState) {
+    case IPP_JSTATE_PENDING:
+    case IPP_JSTATE_HELD:
+      info->status |= kSpoolJobSpooling;
+      break;
+    case IPP_JSTATE_PROCESSING:
+      info->status |= kSpoolJobPrinting;
+      break;
+    case IPP_JSTATE_STOPPED:
+      info->status |= kSpoolJobBlocked;
+      break;
+    case IPP_JSTATE_CANCELED:
+      info->status |= kSpoolJobDeleting;
+      break;
+    case IPP_JSTATE_ABORTED:
+      info->status |= kSpoolJobError;
+      break;
+    default:
+      break;
+  }
+  if (HasReason(reasons, "printer-stopped") || HasReason(reasons, "offline")) {
+    info->status |= kSpoolJobOffline;
+  }
+  if (HasReason(reasons, "media-empty")) info->status |= kSpoolJobPaperOut;
+  ippDelete(response);
+  return true;
+}
+
+bool CupsSpoolBackend::QueryQueue(const std::string& queue, SpoolQueueInfo* info) {
+  static const char* const kPrinterAttributes[] = {"printer-state", "printer-state-reasons"};
+  ipp_t* request = NewPrinterRequest(IPP_OP_GET_PRINTER_ATTRIBUTES, queue);
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                (int)(sizeof(kPrinterAttributes) / sizeof(kPrinterAttributes[0])), nullptr,
+                kPrinterAttributes);
+  ipp_t* response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  ipp_attribute_t* state =
+      response ? ippFindAttribute(response, "printer-state", IPP_TAG_ENUM) : nullptr;
+  if (!state) {
+    ippDelete(response);
+    return false;
+  }
+  ipp_attribute_t* reasons = ippFindAttribute(response, "printer-state-reasons", IPP_TAG_KEYWORD);
+  int printerState = ippGetInteger(state, 0);
+  info->rawStatus = (uint32_t)printerState;
+  info->status = 0;
+  if (printerState == IPP_PSTATE_PROCESSING) info->status |= kSpoolQueuePrinting;
+  if (printerState == IPP_PSTATE_STOPPED) info->status |= kSpoolQueuePaused;
+  if (HasReason(reasons, "offline") || HasReason(reasons, "connecting-to-device")) {
+    info->status |= kSpoolQueueOffline;
+  }
+  if (HasReason(reasons, "media-empty") || HasReason(reasons, "media-needed")) {
+    info->status |= kSpoolQueuePaperOut;
+  }
+  for (int i = 0; reasons && i < ippGetCount(reasons); ++i) {
+    const char* reason = ippGetString(reasons, i, nullptr);
+    size_t length = reason ? strlen(reason) : 0;
+    // "-error" severity suffix, e.g. "media-jam-error"
+    if (length > 6 && strcmp(reason + length - 6, "-error") == 0) info->status |= kSpoolQueueError;
+  }
+  ippDelete(response);
+
+  static const char* const kJobAttributes[] = {"job-id", "job-impressions-completed"};
+  request = NewPrinterRequest(IPP_OP_GET_JOBS, queue);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "which-jobs", nullptr,
+               "not-completed");
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                (int)(sizeof(kJobAttributes) / sizeof(kJobAttributes[0])), nullptr, kJobAttributes);
+  response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  info->jobPages.clear();
+  // Satu job group per job, dipisah atribut bertag IPP_TAG_ZERO
+  int jobId = 0, pages = 0;
+  for (ipp_attribute_t* attr = response ? ippFirstAttribute(response) : nullptr;;
+       attr = ippNextAttribute(response)) {
+    if (!attr || ippGetGroupTag(attr) != IPP_TAG_JOB) {
+      if (jobId) info->jobPages.emplace_back(jobId, pages);
+      jobId = pages = 0;
+      if (!attr) break;
+      continue;
+    }
+    const char* name = ippGetName(attr);
+    if (!name) continue;
+    if (strcmp(name, "job-id") == 0) jobId = ippGetInteger(attr, 0);
+    if (strcmp(name, "job-impressions-completed") == 0) pages = ippGetInteger(attr, 0);
+  }
+  ippDelete(response);
+  return true;
+}
+
+bool CupsSpoolBackend::ListDocuments(const std::string& queue,
+                                     std::vector<SpoolDocument>* documents) {
+  static const char* const kAttributes[] = {"job-id", "job-name"};
+  ipp_t* request = NewPrinterRequest(IPP_OP_GET_JOBS, queue);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "which-jobs", nullptr,
+               "not-completed");
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                (int)(sizeof(kAttributes) / sizeof(kAttributes[0])), nullptr, kAttributes);
+  ipp_t* response = cupsDoRequest(CUPS_HTTP_DEFAULT, request, "/");
+  if (!response) return false;
+  documents->clear();
+  SpoolDocument document;
+  for (ipp_attribute_t* attr = ippFirstAttribute(response);; attr = ippNextAttribute(response)) {
+    if (!attr || ippGetGroupTag(attr) != IPP_TAG_JOB) {
+      if (document.jobId) documents->push_back(document);
+      document = SpoolDocument();
+      if (!attr) break;
+      continue;
+    }
+    const char* name = ippGetName(attr);
+    if (!name) continue;
+    if (strcmp(name, "job-id") == 0) document.jobId = ippGetInteger(attr, 0);
+    if (strcmp(name, "job-name") == 0) {
+      const char* jobName = ippGetString(attr, 0, nullptr);
+      document.name = jobName ? jobName : "";
+    }
+  }
+  ippDelete(response);
+  return true;
+}
@@ -0,0 +1,54 @@
+#ifndef FLUTTER_CUPS_SPOOL_BACKEND_H_
+#define FLUTTER_CUPS_SPOOL_BACKEND_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "spool_watcher.h"
+
+// SpoolBackend on CUPS. Every watched queue gets a printer subscription for
+// job and printer state events with the "ippget" pull method. Wait fetches the events of all
+// subscriptions in one Get-Notifications request every
+// kNotificationInterval, and only queues that actually had events are
+// reported as changed, so jobs are only looked up when something happened.
+// CUPS calls use the watcher thread's default connection.
+class CupsSpoolBackend : public SpoolBackend {
+ public:
+  static constexpr std::chrono::milliseconds kNotificationInterval{250};
+  // Subscriptions expire on their own if the app dies without cancelling
+  // them; live ones are renewed at half this.
+  static constexpr int kLeaseSeconds = 3600;
+
+  CupsSpoolBackend() = default;
+  ~CupsSpoolBackend() override;
+
+  bool AddQueue(const std::string& queue) override;
+  void RemoveQueue(const std::string& queue) override;
+  void Wait(int timeoutMs, std::vector<std::string>* changed) override;
+  void Wake() override;
+  bool QueryJob(const std::string& queue, int jobId, SpoolJobInfo* info) override;
+  bool QueryQueue(const std::string& queue, SpoolQueueInfo* info) override;
+  bool ListDocuments(const std::string& queue, std::vector<SpoolDocument>* documents) override;
+
+ private:
+  struct Subscription {
+    int id = 0;
+    // Next event sequence number to ask for.
+    int nextSequence = 1;
+    std::chrono::steady_clock::time_point renewAt;
+  };
+
+  bool Subscribe(const std::string& queue, Subscription* subscription);
+  void FetchNotifications(std::vector<std::string>* changed);
+
+  std::map<std::string, Subscription> subscriptions_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool woken_ = false;
+};
+
+#endif  // FLUTTER_CUPS_SPOOL_BACKEND_H_
@@ -0,0 +1,99 @@
+#include "posix_ipp_connector.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+
+class SocketConnection : public IppConnection {
+ public:
+  explicit SocketConnection(int fd) : fd_(fd) {}
+  ~SocketConnection() override { close(fd_); }
+
+  // Prevent copying.
+  SocketConnection(SocketConnection const&) = delete;
+  SocketConnection& operator=(SocketConnection const&) = delete;
+
+  bool Write(const void* data, size_t size) override {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+      // MSG_NOSIGNAL: a printer that hung up must not raise SIGPIPE
+      ssize_t sent = send(fd_, bytes, size, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR) continue;
+      if (sent <= 0) return false;
+      bytes += sent;
+      size -= (size_t)sent;
+    }
+    return true;
+  }
+
+  int64_t Read(void* buffer, size_t capacity) override {
+    for (;;) {
+      ssize_t received = recv(fd_, buffer, capacity, 0);
+      if (received < 0 && errno == EINTR) continue;
+      return received;
+    }
+  }
+
+  bool Closed() override {
+    char byte;
+    ssize_t received = recv(fd_, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    // Data on an idle connection is as unusable as a closed one.
+    return !(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+
+ private:
+  int fd_;
+};
+
+}  // namespace
+
+std::unique_ptr<IppConnection> PosixIppConnector::Connect(const std::string& host, int port,
+                                                          std::string* error) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  int resolved = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+  if (resolved != 0) {
+    *error = "Cannot resolve " + host + ": " + gai_strerror(resolved);
+    return nullptr;
+  }
+
+  int fd = -1;
+  int lastErrno = 0;
+  for (struct addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+    fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+    if (fd < 0) {
+      lastErrno = errno;
+      continue;
+    }
+    if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+      lastErrno = errno;
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    *error = "Cannot connect to " + host + ":" + std::to_string(port) + ": " + strerror(lastErrno);
+    return nullptr;
+  }
+
+  int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  struct timeval timeout;
+  timeout.tv_sec = kIoTimeoutSeconds;
+  timeout.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  return std::make_unique<SocketConnection>(fd);
+}
@@ -0,0 +1,18 @@
+#ifndef FLUTTER_POSIX_IPP_CONNECTOR_H_
+#define FLUTTER_POSIX_IPP_CONNECTOR_H_
+
+#include "ipp_client.h"
+
+// IppConnector on BSD sockets: blocking TCP connections with Nagle off, so
+// small IPP requests are not held back, and send/receive timeouts of
+// kIoTimeoutSeconds so a printer that stops answering fails the request
+// instead of hanging the job thread.
+class PosixIppConnector : public IppConnector {
+ public:
+  static constexpr int kIoTimeoutSeconds = 30;
+
+  std::unique_ptr<IppConnection> Connect(const std::string& host, int port,
+                                         std::string* error) override;
+};
+
+#endif  // FLUTTER_POSIX_IPP_CONNECTOR_H_
@@ -0,0 +1,1093 @@
+#include "print_channel.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cups_capability_provider.h"
+#include "cups_spool_backend.h"
+#include "document_analyzer.h"
+#include "document_cache.h"
+#include "ipp_client.h"
+#include "ipp_job_pipeline.h"
+#include "job_correlation.h"
+#include "job_executor.h"
+#include "pdf_file_sink.h"
+#include "posix_ipp_connector.h"
+#include "print_event_queue.h"
+#include "print_transaction.h"
+#include "printer_capability_db.h"
+#include "printer_status_service.h"
+#include "raster_file_sink.h"
+#include "separator_cache.h"
+#include "spool_watcher.h"
+
+namespace {
+
+FlMethodChannel* g_channel = nullptr;
+std::unique_ptr<JobExecutor> g_executor;
+std::unique_ptr<SpoolWatcher> g_spool_watcher;
+// CUPS jobs of each print job still being watched, for getSpoolJobs.
+JobCorrelationIndex g_spool_jobs;
+// Submits jobs to the local CUPS over IPP, one kept-alive connection shared
+// by all of them.
+std::unique_ptr<IppClient> g_ipp_client;
+// Status of the printers the UI shows, pushed as onPrinterStatus on change.
+std::unique_ptr<PrinterStatusService> g_printer_status;
+// Media, resolutions, duplex/colour and margins per CUPS queue, persisted.
+std::unique_ptr<PrinterCapabilityDb> g_printer_caps;
+
+// Events from job and watcher threads. Posting copies a fixed-size record;
+// the main loop sends whatever has accumulated as one onPrintEvents batch,
+// at most once per kEventFrameMs.
+constexpr guint kEventFrameMs = 16;
+std::unique_ptr<PrintEventQueue> g_events;
+gint64 g_last_flush_us = 0;
+guint g_flush_source = 0;
+
+FlValue* EncodeEvent(const PrintEvent& event) {
+  FlValue* args = fl_value_new_map();
+  fl_value_set_string_take(args, "event", fl_value_new_string(PrintEventMethod(event.type)));
+  fl_value_set_string_take(args, "printJobId", fl_value_new_int(event.printJobId));
+  switch (event.type) {
+    case PrintEventType::kJobCompleted:
+      fl_value_set_string_take(args, "totalPages", fl_value_new_int(event.totalPages));
+      fl_value_set_string_take(args, "spoolBytes", fl_value_new_int(event.spoolBytes));
+      break;
+    case PrintEventType::kPrinterStatus:
+      fl_value_set_string_take(args, "printerName", fl_value_new_string(event.text));
+      fl_value_set_string_take(args, "online", fl_value_new_bool(event.online));
+      fl_value_set_string_take(args, "paperOut",
+                               fl_value_new_bool((event.status & kSpoolQueuePaperOut) != 0));
+      fl_value_set_string_take(args, "error", fl_value_new_bool((event.status & kSpoolQueueError) != 0));
+      fl_value_set_string_take(args, "paused", fl_value_new_bool((event.status & kSpoolQueuePaused) != 0));
+      fl_value_set_string_take(args, "printing",
+                               fl_value_new_bool((event.status & kSpoolQueuePrinting) != 0));
+      fl_value_set_string_take(args, "queuedJobs", fl_value_new_int(event.queuedJobs));
+      fl_value_set_string_take(args, "pagesPerMinute", fl_value_new_int(event.pagesPerMinute));
+      fl_value_set_string_take(args, "statusCode", fl_value_new_int(event.rawStatus));
+      break;
+    case PrintEventType::kJobFailed:
+      fl_value_set_string_take(args, "error", fl_value_new_string(event.text));
+      break;
+    case PrintEventType::kPrintProgress: {
+      SpoolJobInfo info;
+      info.status = event.status;
+      info.rawStatus = event.rawStatus;
+      info.pagesPrinted = event.pages;
+      info.totalPages = event.totalPages;
+      fl_value_set_string_take(args, "status",
+                               fl_value_new_string(FormatSpoolJobInfo(info).c_str()));
+      break;
+    }
+    case PrintEventType::kSpoolStarted:
+      fl_value_set_string_take(args, "jobHandle", fl_value_new_int(event.jobHandle));
+      fl_value_set_string_take(args, "setupMs", fl_value_new_float(event.ms));
+      break;
+    case PrintEventType::kSpoolFailed:
+      fl_value_set_string_take(args, "jobHandle", fl_value_new_int(event.jobHandle));
+      fl_value_set_string_take(args, "code", fl_value_new_string(event.code));
+      fl_value_set_string_take(args, "error", fl_value_new_string(event.text));
+      break;
+    case PrintEventType::kSpoolProgress:
+      fl_value_set_string_take(args, "jobHandle", fl_value_new_int(event.jobHandle));
+      fl_value_set_string_take(args, "pagesSpooled", fl_value_new_int(event.pages));
+      fl_value_set_string_take(args, "totalPages", fl_value_new_int(event.totalPages));
+      break;
+    case PrintEventType::kSpoolCompleted:
+      fl_value_set_string_take(args, "jobHandle", fl_value_new_int(event.jobHandle));
+      fl_value_set_string_take(args, "pagesSpooled", fl_value_new_int(event.pages));
+      fl_value_set_string_take(args, "outputPath", fl_value_new_string(event.text));
+      fl_value_set_string_take(args, "firstPageMs", fl_value_new_float(event.ms));
+      fl_value_set_string_take(args, "spoolBytes", fl_value_new_int(event.spoolBytes));
+      fl_value_set_string_take(args, "monoMode", fl_value_new_string(event.monoMode));
+      fl_value_set_string_take(args, "peakRssBytes", fl_value_new_int(event.peakRssBytes));
+      break;
+  }
+  return args;
+}
+
+// Runs on the GTK main loop; the channel may only be used there.
+gboolean FlushEvents(gpointer) {
+  g_flush_source = 0;
+  if (!g_events) return G_SOURCE_REMOVE;
+  gint64 now = g_get_monotonic_time();
+  gint64 sinceLastUs = now - g_last_flush_us;
+  if (sinceLastUs < (gint64)kEventFrameMs * 1000) {
+    g_flush_source = g_timeout_add(kEventFrameMs - (guint)(sinceLastUs / 1000), FlushEvents, nullptr);
+    return G_SOURCE_REMOVE;
+  }
+  g_last_flush_us = now;
+
+  static std::vector<PrintEvent> batch = [] {
+    std::vector<PrintEvent> reserved;
+    reserved.reserve(PrintEventQueue::kMaxBatch);
+    return reserved;
+  }();
+  g_events->Drain(&batch);
+  if (batch.empty() || !g_channel) return G_SOURCE_REMOVE;
+
+  g_autoptr(FlValue) args = fl_value_new_map();
+  FlValue* events = fl_value_new_list();
+  for (const PrintEvent& event : batch) fl_value_append_take(events, EncodeEvent(event));
+  PrintEventStats stats = g_events->stats();
+  fl_value_set_string_take(args, "events", events);
+  fl_value_set_string_take(args, "coalesced", fl_value_new_int((int64_t)stats.coalesced));
+  fl_value_set_string_take(args, "dropped", fl_value_new_int((int64_t)stats.dropped));
+  fl_method_channel_invoke_method(g_channel, "onPrintEvents", args, nullptr, nullptr, nullptr);
+  return G_SOURCE_REMOVE;
+}
+
+// Called by the producer that makes the queue non-empty; one idle source per
+// batch rather than one per event.
+void ScheduleFlush() {
+  g_idle_add(FlushEvents, nullptr);
+}
+
+void PostEvent(const PrintEvent& event) {
+  if (!g_events->Post(event)) g_warning("Print event queue full, event dropped");
+}
+
+PrintEvent NewEvent(PrintEventType type, int jobHandle, int printJobId) {
+  PrintEvent event;
+  event.type = type;
+  event.jobHandle = jobHandle;
+  event.printJobId = printJobId;
+  return event;
+}
+
+PrintEvent PrinterStatusEvent(const std::string& printer, const PrinterStatus& status) {
+  PrintEvent event = NewEvent(PrintEventType::kPrinterStatus, 0, 0);
+  event.SetText(printer.c_str());
+  event.online = status.online;
+  event.status = status.status;
+  event.rawStatus = status.rawStatus;
+  event.queuedJobs = status.queuedJobs;
+  event.pagesPerMinute = status.pagesPerMinute;
+  return event;
+}
+
+void PostSpoolFailed(int jobHandle, int printJobId, const std::string& code,
+                     const std::string& message) {
+  g_warning("Job handle %d failed: %s %s", jobHandle, code.c_str(), message.c_str());
+  PrintEvent event = NewEvent(PrintEventType::kSpoolFailed, jobHandle, printJobId);
+  event.SetCode(code.c_str());
+  event.SetText(message.c_str());
+  PostEvent(event);
+}
+
+std::string ReadString(FlValue* map, const char* key, const std::string& fallback) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  return value && fl_value_get_type(value) == FL_VALUE_TYPE_STRING
+             ? fl_value_get_string(value)
+             : fallback;
+}
+
+int ReadInt(FlValue* map, const char* key, int fallback) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  return value && fl_value_get_type(value) == FL_VALUE_TYPE_INT
+             ? (int)fl_value_get_int(value)
+             : fallback;
+}
+
+bool ReadBool(FlValue* map, const char* key, bool fallback) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  return value && fl_value_get_type(value) == FL_VALUE_TYPE_BOOL
+             ? fl_value_get_bool(value)
+             : fallback;
+}
+
+// A PDF sent as "fileBytes", registered with DocumentCache while a job uses
+// it. The GBytes keeps a reference to the FlValue, so nothing is copied.
+using BytesRegistration = std::shared_ptr<const std::string>;
+
+BytesRegistration RegisterChannelBytes(FlValue* map) {
+  FlValue* value = fl_value_lookup_string(map, "fileBytes");
+  if (!value || fl_value_get_type(value) != FL_VALUE_TYPE_UINT8_LIST ||
+      fl_value_get_length(value) == 0) {
+    return nullptr;
+  }
+  GBytes* bytes = g_bytes_new_with_free_func(
+      fl_value_get_uint8_list(value), fl_value_get_length(value),
+      reinterpret_cast<GDestroyNotify>(fl_value_unref), fl_value_ref(value));
+  std::string source = DocumentCache::Shared().RegisterBytes(bytes);
+  g_bytes_unref(bytes);
+  return BytesRegistration(new std::string(source), [](const std::string* registered) {
+    DocumentCache::Shared().UnregisterBytes(*registered);
+    delete registered;
+  });
+}
+
+std::string SpoolDirectory() {
+  const gchar* dir = g_getenv("HLAPRINT_SPOOL_DIR");
+  return dir && *dir ? dir : g_get_tmp_dir();
+}
+
+// |extension| without the dot ("pdf", "pwg", "pclm").
+std::string OutputPath(int jobHandle, const std::string& printerName, const std::string& extension) {
+  std::string name = printerName;
+  std::replace_if(name.begin(), name.end(),
+                  [](char c) { return !g_ascii_isalnum(c) && c != '-' && c != '_'; }, '_');
+  gchar* path = g_build_filename(SpoolDirectory().c_str(),
+                                 ("hlaprint-" + std::to_string(jobHandle) + "-" + name + "." + extension).c_str(),
+                                 nullptr);
+  std::string result = path;
+  g_free(path);
+  return result;
+}
+
+// Hands |path| to CUPS as one job. A CUPS job has a single sides setting, so
+// it is two-sided only when every section is; per-page sizes come from the PDF.
+// |jobId| gets the CUPS job id from lp's "request id is <queue>-<id>" line,
+// or 0 if it could not be read.
+std::string CupsPrinterUri(const std::string& printerName) {
+  gchar* escaped = g_uri_escape_string(printerName.c_str(), nullptr, FALSE);
+  std::string uri = std::string("ipp://localhost:631/printers/") + escaped;
+  g_free(escaped);
+  return uri;
+}
+
+// IPP goes straight to cupsd when it listens on localhost (the default);
+// otherwise jobs go through lp, which also reaches it through the domain
+// socket. The check also opens the connection the job then reuses.
+bool CupsIppReachable(const std::string& printerName) {
+  IppMessage printer;
+  std::string error;
+  if (g_ipp_client->GetPrinterAttributes(CupsPrinterUri(printerName),
+                                         {"printer-is-accepting-jobs"}, &printer, &error)) {
+    return true;
+  }
+  g_message("IPP to CUPS unavailable (%s), using lp", error.c_str());
+  return false;
+}
+
+// Sends the spooled PDF to CUPS as one Print-Job, streamed from the file
+// over the shared keep-alive connection.
+bool SubmitToCupsIpp(const std::string& printerName, const std::string& path,
+                     const std::string& title, bool duplex, int* jobId, std::string* error) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = "Cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  IppMessage job;
+  job.AddString(kIppTagJob, kIppTagKeyword, "sides",
+                duplex ? "two-sided-long-edge" : "one-sided");
+  bool ok = g_ipp_client->PrintJob(
+      CupsPrinterUri(printerName), title, "application/pdf", job.attributes,
+      [file](uint8_t* buffer, size_t capacity) -> int64_t {
+        size_t count = fread(buffer, 1, capacity, file);
+        return count == 0 && ferror(file) ? -1 : (int64_t)count;
+      },
+      jobId, error);
+  fclose(file);
+  return ok;
+}
+
+bool SubmitToCups(const std::string& printerName, const std::string& path,
+                  const std::vector<PreparedSection>& sections, int* jobId,
+                  std::string* error) {
+  bool duplex = std::all_of(sections.begin(), sections.end(),
+                            [](const PreparedSection& entry) { return entry.setup.duplex; });
+  std::string title = TagDocumentName("Hlaprint Print Job", NewDocumentTag());
+  if (CupsIppReachable(printerName)) {
+    return SubmitToCupsIpp(printerName, path, title, duplex, jobId, error);
+  }
+  gchar* argv[] = {
+      const_cast<gchar*>("lp"),
+      const_cast<gchar*>("-d"), const_cast<gchar*>(printerName.c_str()),
+      const_cast<gchar*>("-t"), const_cast<gchar*>(title.c_str()),
+      const_cast<gchar*>("-o"),
+      const_cast<gchar*>(duplex ? "sides=two-sided-long-edge" : "sides=one-sided"),
+      const_cast<gchar*>(path.c_str()),
+      nullptr};
+  gchar* standardOutput = nullptr;
+  gchar* standardError = nullptr;
+  gint status = 0;
+  GError* gerror = nullptr;
+  bool ok = g_spawn_sync(nullptr, argv, nullptr, G_SPAWN_SEARCH_PATH, nullptr, nullptr,
+                         &standardOutput, &standardError, &status, &gerror) &&
+            WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (!ok && error) {
+    *error = gerror ? gerror->message : "lp failed.";
+    if (standardError && *standardError) *error += std::string(": ") + standardError;
+  }
+  *jobId = 0;
+  const char* kRequestPrefix = "request id is ";
+  const gchar* request = ok && standardOutput ? strstr(standardOutput, kRequestPrefix) : nullptr;
+  if (request) {
+    // "<queue>-<id> (1 file(s))": the id follows the last dash of the word.
+    std::string requestId(request + strlen(kRequestPrefix));
+    requestId = requestId.substr(0, requestId.find_first_of(" \n"));
+    size_t dash = requestId.rfind('-');
+    if (dash != std::string::npos) *jobId = atoi(requestId.c_str() + dash + 1);
+  }
+  g_clear_error(&gerror);
+  g_free(standardOutput);
+  g_free(standardError);
+  return ok;
+}
+
+// Printers named by an "ipp://" URI are driverless (IPP Everywhere) devices
+// addressed directly, without a CUPS queue.
+bool IsDirectIppPrinter(const std::string& printerName) {
+  return printerName.compare(0, 6, "ipp://") == 0;
+}
+
+// Where a document goes and what it is spooled as.
+struct IppDestination {
+  std::string uri;
+  // CUPS queue the job is watched on; empty for printers addressed directly.
+  std::string cupsQueue;
+  std::string documentFormat = "application/pdf";
+  bool raster = false;
+  RasterSinkOptions rasterOptions;
+};
+
+bool HasValue(const IppAttribute* attribute, const std::string& text) {
+  if (!attribute) return false;
+  return std::any_of(attribute->values.begin(), attribute->values.end(),
+                     [&text](const IppValue& value) { return value.text == text; });
+}
+
+// Resolution from the resolution attribute |name|: 300 dpi if offered,
+// otherwise the lowest above it, otherwise the highest.
+int PickRasterDpi(const IppMessage& printer, const char* name) {
+  const IppAttribute* attribute = printer.Find(name);
+  if (!attribute) return 300;
+  int best = 0;
+  for (const IppValue& value : attribute->values) {
+    // units 4: dots per centimetre
+    int dpi = value.units == 4 ? (int)(value.integer * 2.54 + 0.5) : value.integer;
+    if (dpi == 300) return dpi;
+    bool above = dpi > 300, bestAbove = best > 300;
+    if (best == 0 || (above && (!bestAbove || dpi < best)) || (!above && !bestAbove && dpi > best)) {
+      best = dpi;
+    }
+  }
+  return best > 0 ? best : 300;
+}
+
+// Asks a driverless printer what it takes. Device raster wins over PDF: the
+// printer only has to decompress it instead of interpreting the page, which
+// is what makes cheap IPP Everywhere printers slow on invoices.
+bool QueryDirectIppPrinter(const std::string& uri, IppDestination* destination,
+                           std::string* error) {
+  IppMessage printer;
+  if (!g_ipp_client->GetPrinterAttributes(
+          uri, {"document-format-supported", "pwg-raster-document-resolution-supported",
+                "pwg-raster-document-type-supported", "pclm-source-resolution-supported",
+                "pclm-strip-height-preferred", "color-supported"},
+          &printer, error)) {
+    return false;
+  }
+  destination->uri = uri;
+  const IppAttribute* formats = printer.Find("document-format-supported");
+  RasterSinkOptions& options = destination->rasterOptions;
+  if (HasValue(formats, "image/pwg-raster")) {
+    const IppAttribute* types = printer.Find("pwg-raster-document-type-supported");
+    options.format = RasterFormat::kPwgRaster;
+    options.dpi = PickRasterDpi(printer, "pwg-raster-document-resolution-supported");
+    options.black1 = HasValue(types, "black_1");
+    options.gray8 = HasValue(types, "sgray_8") || !types;
+    options.rgb8 = HasValue(types, "srgb_8");
+    destination->raster = true;
+  } else if (HasValue(formats, "application/PCLm")) {
+    options.format = RasterFormat::kPclm;
+    options.dpi = PickRasterDpi(printer, "pclm-source-resolution-supported");
+    options.stripRows = printer.FindInteger("pclm-strip-height-preferred", options.stripRows);
+    options.rgb8 = printer.FindInteger("color-supported", 0) != 0;
+    destination->raster = true;
+  } else if (!HasValue(formats, "application/pdf")) {
+    *error = "Printer takes neither PWG raster, PCLm nor PDF.";
+    return false;
+  }
+  if (destination->raster) {
+    destination->documentFormat = RasterFormatMimeType(options.format);
+  }
+  return true;
+}
+
+// The "file" printer writes PDF unless HLAPRINT_FILE_FORMAT is "pwg" or
+// "pclm": then it writes what a driverless printer would get (300 dpi,
+// black_1/sgray_8/srgb_8), to check raster output and its cost locally.
+IppDestination FileDestination() {
+  IppDestination destination;
+  const gchar* format = g_getenv("HLAPRINT_FILE_FORMAT");
+  if (format && (g_strcmp0(format, "pwg") == 0 || g_strcmp0(format, "pclm") == 0)) {
+    destination.raster = true;
+    destination.rasterOptions.format =
+        g_strcmp0(format, "pclm") == 0 ? RasterFormat::kPclm : RasterFormat::kPwgRaster;
+    destination.rasterOptions.rgb8 = true;
+    destination.documentFormat = RasterFormatMimeType(destination.rasterOptions.format);
+  }
+  return destination;
+}
+
+const char* DocumentExtension(const IppDestination& destination) {
+  if (!destination.raster) return "pdf";
+  return destination.rasterOptions.format == RasterFormat::kPclm ? "pclm" : "pwg";
+}
+
+// Sink writing one document to |path| for |destination|; |raster| is set to
+// it when it is a RasterFileSink.
+std::unique_ptr<PrintSink> NewDocumentSink(const IppDestination& destination,
+                                           const std::string& path, const PageSetup& setup,
+                                           RasterFileSink** raster) {
+  *raster = nullptr;
+  if (!destination.raster) return std::make_unique<PdfFileSink>(path, setup);
+  auto sink = std::make_unique<RasterFileSink>(path, setup, destination.rasterOptions);
+  *raster = sink.get();
+  return sink;
+}
+
+// With HLAPRINT_VERIFY_RASTER set, raster documents are decoded again before
+// they are sent, so an encoder fault fails the spool instead of reaching
+// paper.
+bool VerifyRasterDocument(const IppDestination& destination, const std::string& path,
+                          std::string* error) {
+  if (!destination.raster || !g_getenv("HLAPRINT_VERIFY_RASTER")) return true;
+  int pages = 0;
+  if (!DecodeRasterFile(path, destination.rasterOptions.format,
+                        [&pages](int, const RasterPageImage&) {
+                          pages++;
+                          return true;
+                        },
+                        error)) {
+    return false;
+  }
+  g_message("Verified %s: %d pages decode", path.c_str(), pages);
+  return true;
+}
+
+// Reports the CUPS job through the same onPrintProgress/onPrintJobCompleted/
+// onPrintJobFailed events the Windows spool watcher sends.
+void WatchCupsJob(const std::string& printerName, int cupsJobId,
+                  const std::vector<int>& printJobIds, int totalPages) {
+  int progressJobId = printJobIds.front();
+  for (int printJobId : printJobIds) g_spool_jobs.Record(printJobId, printerName, cupsJobId);
+  g_spool_watcher->Watch(
+      printerName, cupsJobId, totalPages,
+      [progressJobId](const SpoolJobInfo& info) {
+        PrintEvent event = NewEvent(PrintEventType::kPrintProgress, 0, progressJobId);
+        event.status = info.status;
+        event.rawStatus = info.rawStatus;
+        event.pages = info.pagesPrinted;
+        event.totalPages = info.totalPages;
+        PostEvent(event);
+      },
+      [printerName, cupsJobId, printJobIds, totalPages](const SpoolOutcome& outcome) {
+        g_message("CUPS job %s-%d: %s", printerName.c_str(), cupsJobId, outcome.reason.c_str());
+        for (int printJobId : printJobIds) {
+          g_spool_jobs.Forget(printJobId);
+          PrintEvent event = NewEvent(outcome.success ? PrintEventType::kJobCompleted
+                                                      : PrintEventType::kJobFailed,
+                                      0, printJobId);
+          event.totalPages = totalPages;
+          event.spoolBytes = outcome.spoolBytes;
+          if (!outcome.success) event.SetText("Print Failed or Cancelled");
+          PostEvent(event);
+        }
+      });
+}
+
+// High-water mark of the process RSS. It never goes down, so compare banded
+// and whole-page runs in fresh processes.
+int64_t PeakResidentBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return (int64_t)usage.ru_maxrss * 1024;  // ru_maxrss is in KiB on Linux
+}
+
+// Print jobs of the transaction in section order, each once.
+std::vector<int> TransactionJobIds(const std::vector<PreparedSection>& prepared) {
+  std::vector<int> printJobIds;
+  for (const PreparedSection& entry : prepared) {
+    int id = entry.section.settings.printJobId;
+    if (id > 0 && std::find(printJobIds.begin(), printJobIds.end(), id) == printJobIds.end()) {
+      printJobIds.push_back(id);
+    }
+  }
+  return printJobIds;
+}
+
+void PostSpoolCompleted(int jobHandle, int printJobId, const SpoolResult& spool,
+                        const std::string& path, double firstPageMs, int64_t spoolBytes,
+                        int64_t peakRss) {
+  PrintEvent spooled = NewEvent(PrintEventType::kSpoolCompleted, jobHandle, printJobId);
+  spooled.pages = spool.pagesSpooled;
+  spooled.SetText(path.c_str());
+  spooled.ms = firstPageMs;
+  spooled.spoolBytes = spoolBytes;
+  spooled.monoMode = DitherModeName(spool.monoDither);
+  spooled.peakRssBytes = peakRss;
+  PostEvent(spooled);
+}
+
+// A transaction of several sections on a CUPS queue reachable over IPP, or
+// any transaction for a driverless printer, becomes one job: every section
+// is spooled to a document of its own (PDF, or raster the printer takes) and
+// sent as a Send-Document while the next one renders, so the printer gets
+// the first section without waiting for the last. Each document starts on a
+// new sheet; sides is a job attribute, set as for lp.
+void RunPipelinedTransaction(int jobHandle, const std::string& printerName,
+                             const IppDestination& destination,
+                             std::vector<PreparedSection>* prepared,
+                             std::chrono::steady_clock::time_point receivedAt,
+                             std::chrono::steady_clock::time_point setupStart) {
+  int printJobId = prepared->front().section.settings.printJobId;
+  std::vector<int> printJobIds = TransactionJobIds(*prepared);
+  bool duplex = std::all_of(prepared->begin(), prepared->end(),
+                            [](const PreparedSection& entry) { return entry.setup.duplex; });
+  IppMessage job;
+  job.AddString(kIppTagJob, kIppTagKeyword, "sides",
+                duplex ? "two-sided-long-edge" : "one-sided");
+  job.AddString(kIppTagJob, kIppTagKeyword, "multiple-document-handling",
+                "separate-documents-collated-copies");
+  IppJobPipeline pipeline(g_ipp_client.get(), destination.uri, destination.documentFormat);
+  std::string error;
+  if (!pipeline.Begin(TagDocumentName("Hlaprint Print Job", NewDocumentTag()), job.attributes,
+                      &error)) {
+    PostSpoolFailed(jobHandle, printJobId, "CUPS_SUBMIT_FAILED", error);
+    return;
+  }
+
+  PrintEvent started = NewEvent(PrintEventType::kSpoolStarted, jobHandle, printJobId);
+  started.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+  PostEvent(started);
+
+  int totalPages = 0;
+  for (const PreparedSection& entry : *prepared) totalPages += entry.estimatedPages;
+  SpoolResult spool;
+  double firstPageMs = -1.0, monoConvertMs = 0.0, encodeMs = 0.0;
+  int64_t spoolBytes = 0;
+  auto spoolStart = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < prepared->size(); ++i) {
+    std::string path = OutputPath(jobHandle, printerName + "-" + std::to_string(i + 1),
+                                  DocumentExtension(destination));
+    std::vector<PreparedSection> section;
+    section.push_back(std::move((*prepared)[i]));
+    RasterFileSink* raster = nullptr;
+    std::unique_ptr<PrintSink> sink = NewDocumentSink(destination, path, section.front().setup, &raster);
+    if (!sink->StartDocument("Hlaprint Print Job", nullptr)) {
+      PostSpoolFailed(jobHandle, printJobId, "START_DOC_FAILED", "Failed to create " + path);
+      return;
+    }
+    int pagesBefore = spool.pagesSpooled;
+    SpoolResult part = SpoolTransaction(sink.get(), &section, [&, jobHandle, printJobId](int pagesSpooled, int) {
+      if (firstPageMs < 0) {
+        firstPageMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - receivedAt).count();
+      }
+      int done = pagesBefore + pagesSpooled;
+      PrintEvent progress = NewEvent(PrintEventType::kSpoolProgress, jobHandle, printJobId);
+      progress.pages = done;
+      progress.totalPages = std::max(totalPages, done);
+      PostEvent(progress);
+    });
+    if (!part.ok) {
+      sink->AbortDocument();
+      PostSpoolFailed(jobHandle, printJobId, part.errorCode, part.errorMessage);
+      return;
+    }
+    if (!sink->EndDocument()) {
+      PostSpoolFailed(jobHandle, printJobId, "END_DOC_FAILED", "Failed to write " + path);
+      return;
+    }
+    if (!VerifyRasterDocument(destination, path, &error)) {
+      PostSpoolFailed(jobHandle, printJobId, "RASTER_INVALID", error);
+      return;
+    }
+    spool.pagesSpooled += part.pagesSpooled;
+    spool.banded = spool.banded || part.banded;
+    if (part.monoDither != DitherMode::kOff) spool.monoDither = part.monoDither;
+    monoConvertMs += sink->mono_convert_ms();
+    if (raster) encodeMs += raster->stats().encodeMs;
+    std::error_code sizeError;
+    uintmax_t fileSize = std::filesystem::file_size(path, sizeError);
+    if (!sizeError) spoolBytes += (int64_t)fileSize;
+    // Uploaded on the pipeline's thread, which deletes the file afterwards.
+    if (!pipeline.Add(path, &error)) {
+      PostSpoolFailed(jobHandle, printJobId, "CUPS_SUBMIT_FAILED", error);
+      return;
+    }
+  }
+  spool.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - spoolStart).count();
+  if (!pipeline.Finish(&error)) {
+    PostSpoolFailed(jobHandle, printJobId, "CUPS_SUBMIT_FAILED", error);
+    return;
+  }
+
+  IppPipelineStats upload = pipeline.stats();
+  int64_t peakRss = PeakResidentBytes();
+  g_message("Spooled %d pages in %d ms as IPP job %d on %s, %d %s documents (first page %d ms, %" G_GINT64_FORMAT
+            " bytes, upload %d ms, uploader idle %d ms, mono convert %d ms, raster encode %d ms, %s, peak RSS %"
+            G_GINT64_FORMAT " MB)",
+            spool.pagesSpooled, (int)spool.elapsedMs, pipeline.job_id(), destination.uri.c_str(),
+            upload.documentsSent, destination.documentFormat.c_str(), (int)firstPageMs,
+            (gint64)spoolBytes, (int)upload.uploadMs, (int)upload.idleMs, (int)monoConvertMs,
+            (int)encodeMs, spool.banded ? "banded" : "whole pages", (gint64)(peakRss / (1024 * 1024)));
+  // The section files are deleted once uploaded; report the printer instead.
+  PostSpoolCompleted(jobHandle, printJobId, spool, destination.uri, firstPageMs, spoolBytes, peakRss);
+  if (printJobIds.empty()) return;
+  if (!destination.cupsQueue.empty()) {
+    WatchCupsJob(destination.cupsQueue, pipeline.job_id(), printJobIds, spool.pagesSpooled);
+    return;
+  }
+  // Direct printers have no CUPS queue to watch; the job counts as done
+  // once the printer has accepted the last document.
+  for (int id : printJobIds) {
+    PrintEvent completed = NewEvent(PrintEventType::kJobCompleted, 0, id);
+    completed.totalPages = spool.pagesSpooled;
+    completed.spoolBytes = spoolBytes;
+    PostEvent(completed);
+  }
+}
+
+void RunTransactionJob(int jobHandle, const std::vector<TransactionSection>& sections,
+                       std::chrono::steady_clock::time_point receivedAt) {
+  int printJobId = sections.front().settings.printJobId;
+  const std::string& printerName = sections.front().settings.printerName;
+
+  auto setupStart = std::chrono::steady_clock::now();
+  std::vector<PreparedSection> prepared;
+  std::string errorCode, errorMessage;
+  if (!PrepareTransaction(sections, &prepared, &errorCode, &errorMessage)) {
+    PostSpoolFailed(jobHandle, printJobId, errorCode, errorMessage);
+    return;
+  }
+  if (IsDirectIppPrinter(printerName)) {
+    IppDestination destination;
+    std::string error;
+    if (!QueryDirectIppPrinter(printerName, &destination, &error)) {
+      PostSpoolFailed(jobHandle, printJobId, "IPP_PRINTER_UNAVAILABLE", error);
+      return;
+    }
+    RunPipelinedTransaction(jobHandle, printerName, destination, &prepared, receivedAt, setupStart);
+    return;
+  }
+  if (prepared.size() > 1 && printerName != "file" && CupsIppReachable(printerName)) {
+    IppDestination destination;
+    destination.uri = CupsPrinterUri(printerName);
+    destination.cupsQueue = printerName;
+    RunPipelinedTransaction(jobHandle, printerName, destination, &prepared, receivedAt, setupStart);
+    return;
+  }
+
+  // CUPS queues get PDF; only the "file" printer can be asked for raster.
+  IppDestination output = printerName == "file" ? FileDestination() : IppDestination();
+  std::string path = OutputPath(jobHandle, printerName, DocumentExtension(output));
+  RasterFileSink* raster = nullptr;
+  std::unique_ptr<PrintSink> sink = NewDocumentSink(output, path, prepared.front().setup, &raster);
+  if (!sink->StartDocument("Hlaprint Print Job", nullptr)) {
+    PostSpoolFailed(jobHandle, printJobId, "START_DOC_FAILED", "Failed to create " + path);
+    return;
+  }
+
+  PrintEvent started = NewEvent(PrintEventType::kSpoolStarted, jobHandle, printJobId);
+  started.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+  PostEvent(started);
+
+  double firstPageMs = -1.0;
+  SpoolResult spool = SpoolTransaction(sink.get(), &prepared, [&, jobHandle, printJobId](int pagesSpooled, int totalPages) {
+    if (firstPageMs < 0) {
+      firstPageMs = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - receivedAt).count();
+    }
+    PrintEvent progress = NewEvent(PrintEventType::kSpoolProgress, jobHandle, printJobId);
+    progress.pages = pagesSpooled;
+    progress.totalPages = totalPages;
+    PostEvent(progress);
+  });
+  if (!spool.ok) {
+    sink->AbortDocument();
+    PostSpoolFailed(jobHandle, printJobId, spool.errorCode, spool.errorMessage);
+    return;
+  }
+  if (!sink->EndDocument()) {
+    PostSpoolFailed(jobHandle, printJobId, "END_DOC_FAILED", "Failed to write " + path);
+    return;
+  }
+  std::string verifyError;
+  if (!VerifyRasterDocument(output, path, &verifyError)) {
+    PostSpoolFailed(jobHandle, printJobId, "RASTER_INVALID", verifyError);
+    return;
+  }
+
+  std::string lpError;
+  int cupsJobId = 0;
+  if (printerName != "file" && !SubmitToCups(printerName, path, prepared, &cupsJobId, &lpError)) {
+    PostSpoolFailed(jobHandle, printJobId, "CUPS_SUBMIT_FAILED", lpError);
+    return;
+  }
+
+  // The spool file here is the PDF handed to CUPS (or the file printer's output).
+  std::error_code sizeError;
+  uintmax_t fileSize = std::filesystem::file_size(path, sizeError);
+  int64_t spoolBytes = sizeError ? -1 : (int64_t)fileSize;
+  int64_t peakRss = PeakResidentBytes();
+  g_message("Spooled %d pages in %d ms to %s (first page %d ms, %" G_GINT64_FORMAT
+            " bytes, mono convert %d ms, %s, peak RSS %" G_GINT64_FORMAT " MB)",
+            spool.pagesSpooled, (int)spool.elapsedMs, path.c_str(), (int)firstPageMs,
+            (gint64)spoolBytes, (int)sink->mono_convert_ms(), spool.banded ? "banded" : "whole pages",
+            (gint64)(peakRss / (1024 * 1024)));
+  if (raster) {
+    const RasterSinkStats& stats = raster->stats();
+    g_message("Raster %s: %d pages at %d dpi, encode %d ms, %" G_GINT64_FORMAT
+              " bytes per page (%.1f%% of the raw pixels)",
+              output.documentFormat.c_str(), stats.pages, output.rasterOptions.dpi,
+              (int)stats.encodeMs, (gint64)(stats.encodedBytes / std::max(1, stats.pages)),
+              stats.rawBytes > 0 ? 100.0 * stats.encodedBytes / stats.rawBytes : 0.0);
+  }
+  PostSpoolCompleted(jobHandle, printJobId, spool, path, firstPageMs, spoolBytes, peakRss);
+
+  std::vector<int> printJobIds = TransactionJobIds(prepared);
+  if (cupsJobId > 0 && !printJobIds.empty()) {
+    WatchCupsJob(printerName, cupsJobId, printJobIds, spool.pagesSpooled);
+  }
+}
+
+FlMethodResponse* HandlePrintTransaction(FlValue* args) {
+  auto receivedAt = std::chrono::steady_clock::now();
+  FlValue* sectionList = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                             ? fl_value_lookup_string(args, "sections")
+                             : nullptr;
+  if (!sectionList || fl_value_get_type(sectionList) != FL_VALUE_TYPE_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "sections required", nullptr));
+  }
+
+  // Same grouping as Windows: one document per printer, section order kept.
+  std::vector<std::pair<std::string, std::vector<TransactionSection>>> groups;
+  std::vector<BytesRegistration> registrations;
+  for (size_t i = 0; i < fl_value_get_length(sectionList); ++i) {
+    FlValue* map = fl_value_get_list_value(sectionList, i);
+    if (fl_value_get_type(map) != FL_VALUE_TYPE_MAP) continue;
+
+    TransactionSection section;
+    section.type = ReadString(map, "type", "document") == "separator"
+                       ? TransactionSection::Type::kSeparator
+                       : TransactionSection::Type::kDocument;
+    section.filePath = ReadString(map, "filePath", "");
+    BytesRegistration registration = RegisterChannelBytes(map);
+    if (registration) {
+      section.filePath = *registration;
+      registrations.push_back(registration);
+    }
+    PrintSettings& settings = section.settings;
+    settings.printerName = ReadString(map, "printerName", "");
+    settings.color = ReadBool(map, "color", settings.color);
+    settings.doubleSided = ReadBool(map, "doubleSided", settings.doubleSided);
+    settings.copies = ReadInt(map, "copies", settings.copies);
+    settings.pageOrientation = ReadString(map, "pageOrientation", settings.pageOrientation);
+    settings.printJobId = ReadInt(map, "printJobId", settings.printJobId);
+    settings.pageSize = ReadString(map, "pageSize", settings.pageSize);
+    settings.pagesStart = ReadInt(map, "pagesStart", settings.pagesStart);
+    settings.pageEnd = ReadInt(map, "pageEnd", settings.pageEnd);
+    FlValue* pages = fl_value_lookup_string(map, "pages");
+    if (pages && fl_value_get_type(pages) == FL_VALUE_TYPE_LIST) {
+      for (size_t p = 0; p < fl_value_get_length(pages); ++p) {
+        FlValue* page = fl_value_get_list_value(pages, p);
+        if (fl_value_get_type(page) == FL_VALUE_TYPE_INT) {
+          settings.pages.push_back((int)fl_value_get_int(page));
+        }
+      }
+    }
+    settings.rasterDpi = ReadInt(map, "rasterDpi", settings.rasterDpi);
+    settings.pipelineDepth = ReadInt(map, "pipelineDepth", settings.pipelineDepth);
+    settings.monoDither = ParseDitherMode(ReadString(map, "monoMode", ""));
+    settings.bandHeight = ReadInt(map, "bandHeight", settings.bandHeight);
+
+    if (settings.printerName.empty() ||
+        (section.type == TransactionSection::Type::kDocument && section.filePath.empty())) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENTS", "Every section needs printerName, documents also filePath or fileBytes.",
+          nullptr));
+    }
+
+    auto group = std::find_if(groups.begin(), groups.end(),
+                              [&](const auto& entry) { return entry.first == settings.printerName; });
+    if (group == groups.end()) {
+      groups.emplace_back(settings.printerName, std::vector<TransactionSection>());
+      group = groups.end() - 1;
+    }
+    group->second.push_back(section);
+  }
+
+  if (groups.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "sections required", nullptr));
+  }
+
+  g_autoptr(FlValue) response = fl_value_new_map();
+  FlValue* jobHandles = fl_value_new_list();
+  for (auto& group : groups) {
+    std::vector<TransactionSection> sections = std::move(group.second);
+    // Each job holds the registrations until it has run or been dropped.
+    int jobHandle = g_executor->Submit(group.first, [sections, registrations, receivedAt](int handle) {
+      RunTransactionJob(handle, sections, receivedAt);
+    });
+    fl_value_append_take(jobHandles, fl_value_new_int(jobHandle));
+  }
+  fl_value_set_string_take(response, "jobHandles", jobHandles);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(response));
+}
+
+struct AnalyzeReply {
+  FlMethodCall* call;
+  bool ok = false;
+  DocumentAnalysis analysis;
+  AnalyzeStats stats;
+  std::string error;
+};
+
+// Runs on the GTK main loop; a method call may only be answered there.
+gboolean DeliverAnalyzeReply(gpointer data) {
+  std::unique_ptr<AnalyzeReply> reply(static_cast<AnalyzeReply*>(data));
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (!reply->ok) {
+    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "ANALYZE_FAILED", reply->error.c_str(), nullptr));
+  } else {
+    g_autoptr(FlValue) result = fl_value_new_map();
+    FlValue* pages = fl_value_new_list();
+    for (const PageAnalysis& page : reply->analysis.pages) {
+      FlValue* entry = fl_value_new_map();
+      fl_value_set_string_take(entry, "page", fl_value_new_int(page.pageIndex + 1));
+      fl_value_set_string_take(entry, "widthPts", fl_value_new_float(page.widthPts));
+      fl_value_set_string_take(entry, "heightPts", fl_value_new_float(page.heightPts));
+      fl_value_set_string_take(entry, "rotation", fl_value_new_int(page.rotation));
+      fl_value_set_string_take(entry, "orientation",
+                               fl_value_new_string(page.landscape ? "landscape" : "portrait"));
+      fl_value_set_string_take(entry, "color", fl_value_new_bool(page.color));
+      fl_value_set_string_take(entry, "blank", fl_value_new_bool(page.blank));
+      fl_value_append_take(pages, entry);
+    }
+    fl_value_set_string_take(result, "pages", pages);
+    fl_value_set_string_take(result, "colorPages", fl_value_new_int(reply->analysis.colorPages));
+    fl_value_set_string_take(result, "blankPages", fl_value_new_int(reply->analysis.blankPages));
+    fl_value_set_string_take(result, "cached", fl_value_new_bool(reply->stats.cached));
+    fl_value_set_string_take(result, "threads", fl_value_new_int(reply->stats.threadsUsed));
+    fl_value_set_string_take(result, "elapsedMs", fl_value_new_float(reply->stats.elapsedMs));
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  fl_method_call_respond(reply->call, response, nullptr);
+  g_object_unref(reply->call);
+  return G_SOURCE_REMOVE;
+}
+
+// Answers asynchronously: the analysis runs on its own thread so the main
+// loop keeps going, and the reply is posted back to it.
+void HandleAnalyzeDocument(FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "filePath or fileBytes required", nullptr, nullptr);
+    return;
+  }
+  std::string filePath = ReadString(args, "filePath", "");
+  BytesRegistration registration = RegisterChannelBytes(args);
+  if (registration) filePath = *registration;
+  if (filePath.empty()) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "filePath or fileBytes required", nullptr, nullptr);
+    return;
+  }
+  int threads = ReadInt(args, "threads", 0);
+
+  auto* reply = new AnalyzeReply{FL_METHOD_CALL(g_object_ref(method_call))};
+  std::thread([reply, filePath, threads, registration]() {
+    reply->ok = AnalyzeDocument(filePath, threads, &reply->analysis, &reply->stats, &reply->error);
+    g_message("Analyzed %d pages (%d colour, %d blank) with %d threads in %d ms%s",
+              (int)reply->analysis.pages.size(), reply->analysis.colorPages,
+              reply->analysis.blankPages, reply->stats.threadsUsed, (int)reply->stats.elapsedMs,
+              reply->stats.cached ? " (cached)" : "");
+    g_idle_add(DeliverAnalyzeReply, reply);
+  }).detach();
+}
+
+// Replaces the watched printers and returns the snapshots already known;
+// the rest follow as onPrinterStatus events.
+FlMethodResponse* HandleWatchPrinters(FlValue* args) {
+  std::vector<std::string> printers;
+  FlValue* list = fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                      ? fl_value_lookup_string(args, "printers")
+                      : nullptr;
+  for (size_t i = 0; list && fl_value_get_type(list) == FL_VALUE_TYPE_LIST &&
+                     i < fl_value_get_length(list);
+       ++i) {
+    FlValue* name = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(name) == FL_VALUE_TYPE_STRING) {
+      printers.push_back(fl_value_get_string(name));
+    }
+  }
+  g_printer_status->SetPrinters(printers);
+
+  g_autoptr(FlValue) statuses = fl_value_new_map();
+  for (const auto& entry : g_printer_status->Snapshot()) {
+    if (std::find(printers.begin(), printers.end(), entry.first) == printers.end()) continue;
+    fl_value_set_string_take(statuses, entry.first.c_str(),
+                             EncodeEvent(PrinterStatusEvent(entry.first, entry.second)));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(statuses));
+}
+
+// Snapshot lookup only: a printer that is not watched (or not queried yet)
+// reads as offline.
+FlMethodResponse* HandleGetPrinterStatus(FlValue* args) {
+  std::string printer =
+      fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? ReadString(args, "printerName", "") : "";
+  if (printer.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Printer name required", nullptr));
+  }
+  PrinterStatus status;
+  bool online = g_printer_status->Get(printer, &status) && status.online;
+  g_autoptr(FlValue) result = fl_value_new_bool(online);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Paper names of the printer ("ip" is the old key, kept for the Dart side).
+FlMethodResponse* HandleGetPrinterPaperSizes(FlValue* args) {
+  std::string printer;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    printer = ReadString(args, "ip", ReadString(args, "printerName", ""));
+  }
+  if (printer.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Printer name required", nullptr));
+  }
+  g_autoptr(FlValue) list = fl_value_new_list();
+  if (auto caps = g_printer_caps->Get(printer)) {
+    for (const PaperInfo& paper : caps->papers) {
+      fl_value_append_take(list, fl_value_new_string(paper.name.c_str()));
+    }
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(list));
+}
+
+// The printer's name for an app paper size, or null if it has none.
+FlMethodResponse* HandleResolvePaperName(FlValue* args) {
+  std::string printer, pageSize;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    printer = ReadString(args, "printerName", "");
+    pageSize = ReadString(args, "pageSize", "");
+  }
+  if (printer.empty() || pageSize.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "Printer name and page size required", nullptr));
+  }
+  std::string paperName;
+  g_autoptr(FlValue) result = g_printer_caps->ResolvePaperName(printer, pageSize, &paperName)
+                                  ? fl_value_new_string(paperName.c_str())
+                                  : fl_value_new_null();
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// The CUPS jobs a print job became, while they are watched.
+FlMethodResponse* HandleGetSpoolJobs(FlValue* args) {
+  int printJobId = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? ReadInt(args, "printJobId", 0) : 0;
+  g_autoptr(FlValue) list = fl_value_new_list();
+  std::vector<SpoolJobRef> jobs;
+  if (g_spool_jobs.Lookup(printJobId, &jobs)) {
+    for (const SpoolJobRef& job : jobs) {
+      FlValue* entry = fl_value_new_map();
+      fl_value_set_string_take(entry, "printerName", fl_value_new_string(job.queue.c_str()));
+      fl_value_set_string_take(entry, "jobId", fl_value_new_int(job.jobId));
+      fl_value_append_take(list, entry);
+    }
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(list));
+}
+
+void MethodCallCb(FlMethodChannel* channel, FlMethodCall* method_call,
+                  gpointer user_data) {
+  if (strcmp(fl_method_call_get_name(method_call), "analyzeDocument") == 0) {
+    HandleAnalyzeDocument(method_call);
+    return;
+  }
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(fl_method_call_get_name(method_call), "printTransaction") == 0) {
+    response = HandlePrintTransaction(fl_method_call_get_args(method_call));
+  } else if (strcmp(fl_method_call_get_name(method_call), "watchPrinters") == 0) {
+    response = HandleWatchPrinters(fl_method_call_get_args(method_call));
+  } else if (strcmp(fl_method_call_get_name(method_call), "getPrinterStatus") == 0) {
+    response = HandleGetPrinterStatus(fl_method_call_get_args(method_call));
+  } else if (strcmp(fl_method_call_get_name(method_call), "getPrinterPaperSizes") == 0) {
+    response = HandleGetPrinterPaperSizes(fl_method_call_get_args(method_call));
+  } else if (strcmp(fl_method_call_get_name(method_call), "resolvePaperName") == 0) {
+    response = HandleResolvePaperName(fl_method_call_get_args(method_call));
+  } else if (strcmp(fl_method_call_get_name(method_call), "getSpoolJobs") == 0) {
+    response = HandleGetSpoolJobs(fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+  fl_method_call_respond(method_call, response, nullptr);
+}
+
+std::string ExecutableDirectory() {
+  gchar* exe = g_file_read_link("/proc/self/exe", nullptr);
+  if (!exe) return ".";
+  gchar* dir = g_path_get_dirname(exe);
+  std::string result = dir;
+  g_free(dir);
+  g_free(exe);
+  return result;
+}
+
+}  // namespace
+
+void print_channel_register(FlPluginRegistry* registry) {
+  g_autoptr(FlPluginRegistrar) registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "HlaprintPrinting");
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_channel = fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                                    "com.hlaprint.app/printing", FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(g_channel, MethodCallCb, nullptr, nullptr);
+
+  g_events = std::make_unique<PrintEventQueue>(ScheduleFlush);
+  g_executor = std::make_unique<JobExecutor>(2);
+  g_spool_watcher = std::make_unique<SpoolWatcher>(std::make_unique<CupsSpoolBackend>());
+  g_ipp_client = std::make_unique<IppClient>(std::make_unique<PosixIppConnector>(), g_get_user_name());
+  g_printer_status = std::make_unique<PrinterStatusService>(
+      std::make_unique<CupsSpoolBackend>(),
+      [](const std::string& printer, const PrinterStatus& status) {
+        PostEvent(PrinterStatusEvent(printer, status));
+      });
+  DocumentCache::Shared().Configure(8, 256 * 1024 * 1024);
+  g_printer_caps = std::make_unique<PrinterCapabilityDb>(std::make_unique<CupsCapabilityProvider>());
+  g_printer_caps->Open(std::string(g_get_user_cache_dir()) + "/hlaprint/printer_caps.txt");
+  g_printer_caps->Preload();
+
+  std::string separatorError;
+  std::string separatorPath = ExecutableDirectory() + "/data/flutter_assets/assets/pdf/separator.pdf";
+  if (!SeparatorCache::Shared().Load(separatorPath, &separatorError)) {
+    g_warning("Separator not loaded: %s", separatorError.c_str());
+  }
+}
+
+void print_channel_shutdown() {
+  g_executor.reset();
+  g_spool_watcher.reset();
+  g_printer_status.reset();
+  g_printer_caps.reset();
+  if (g_flush_source) g_source_remove(g_flush_source);
+  g_events.reset();
+  DocumentCache::Shared().Clear();
+  g_clear_object(&g_channel);
+}
@@ -0,0 +1,32 @@
+#ifndef FLUTTER_PRINT_CHANNEL_H_
+#define FLUTTER_PRINT_CHANNEL_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+/**
+ * print_channel_register:
+ * @registry: the view's plugin registry.
+ *
+ * Registers the "com.hlaprint.app/printing" channel. On Linux it handles
+ * printTransaction, analyzeDocument, watchPrinters, getPrinterStatus,
+ * getPrinterPaperSizes and resolvePaperName. Each printer's sections are
+ * spooled into one PDF (see PdfFileSink) in $HLAPRINT_SPOOL_DIR or the temp
+ * directory, then handed to CUPS with lp unless the printer name is "file".
+ * Results arrive through the same onSpool* events as on Windows, and CUPS
+ * jobs are followed to completion by a SpoolWatcher on CUPS subscriptions
+ * (onPrintProgress, onPrintJobCompleted, onPrintJobFailed). The watched
+ * printers' status is kept by a PrinterStatusService and pushed as
+ * onPrinterStatus on change. Paper lookups are answered from a
+ * PrinterCapabilityDb built from CUPS attributes. As on Windows, events are
+ * batched into at most one onPrintEvents call per frame.
+ */
+void print_channel_register(FlPluginRegistry* registry);
+
+/**
+ * print_channel_shutdown:
+ *
+ * Waits for the transaction being spooled and drops the queued ones.
+ */
+void print_channel_shutdown();
+
+#endif  // FLUTTER_PRINT_CHANNEL_H_
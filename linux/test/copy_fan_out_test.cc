@@ -0,0 +1,173 @@
+#include "copy_fan_out.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "document_cache.h"
+#include "page_rasterizer.h"
+#include "pdf_file_sink.h"
+#include "print_job.h"
+#include "test_documents.h"
+
+namespace {
+
+constexpr int kPages = 5;
+
+// A printer at twice PDF resolution with hardware margins, so replays from
+// the spill file have to undo both.
+PrintPageGeometry MarginGeometry() {
+  PrintPageGeometry geometry;
+  geometry.dpiX = 144;
+  geometry.dpiY = 144;
+  geometry.physicalWidth = 288;
+  geometry.physicalHeight = 432;
+  geometry.offsetX = 10;
+  geometry.offsetY = 12;
+  geometry.printableWidth = 268;
+  geometry.printableHeight = 408;
+  return geometry;
+}
+
+// MarkerPage |index| recorded in device pixels of |geometry|, the way
+// SpoolPages records the first copy.
+cairo_surface_t* RecordMarkerPage(const PrintPageGeometry& geometry, int index) {
+  cairo_surface_t* recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, nullptr);
+  cairo_t* cr = cairo_create(recording);
+  cairo_scale(cr, geometry.dpiX / 72.0, geometry.dpiY / 72.0);
+  MarkerPage(index).draw(cr);
+  cairo_destroy(cr);
+  return recording;
+}
+
+// The marker of kept page |index| replayed onto a white printable area.
+int ReplayedMarker(CopyFanOut* fanOut, const PrintPageGeometry& geometry, int index) {
+  cairo_surface_t* image = cairo_image_surface_create(
+      CAIRO_FORMAT_RGB24, geometry.printableWidth, geometry.printableHeight);
+  cairo_t* cr = cairo_create(image);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  fanOut->Replay(index, cr);
+  cairo_destroy(cr);
+  int marker = ReadPageMarker(image, geometry.dpiX);
+  cairo_surface_destroy(image);
+  return marker;
+}
+
+TEST(CopyFanOutTest, ReplaysKeptPagesFromMemory) {
+  PrintPageGeometry geometry = MarginGeometry();
+  CopyFanOut fanOut(geometry, 64 * 1024 * 1024, kPages);
+  for (int i = 0; i < kPages; i++) fanOut.Keep(RecordMarkerPage(geometry, i), 0);
+  std::string error;
+  ASSERT_TRUE(fanOut.Finish(&error)) << error;
+  EXPECT_EQ(fanOut.page_count(), kPages);
+  EXPECT_EQ(fanOut.spilled_pages(), 0);
+  // Every copy replays the same pages.
+  for (int copy = 0; copy < 3; copy++) {
+    for (int i = 0; i < kPages; i++) EXPECT_EQ(ReplayedMarker(&fanOut, geometry, i), i);
+  }
+}
+
+// Vector pages past the limit go to the spill file and come back from there
+// at the same place on the paper.
+TEST(CopyFanOutTest, SpillsVectorPagesPastTheLimit) {
+  PrintPageGeometry geometry = MarginGeometry();
+  CopyFanOut fanOut(geometry, 64 * 1024 * 1024, 2);
+  for (int i = 0; i < kPages; i++) fanOut.Keep(RecordMarkerPage(geometry, i), 0);
+  std::string error;
+  ASSERT_TRUE(fanOut.Finish(&error)) << error;
+  EXPECT_EQ(fanOut.page_count(), kPages);
+  EXPECT_EQ(fanOut.spilled_pages(), kPages - 2);
+  for (int copy = 0; copy < 2; copy++) {
+    for (int i = 0; i < kPages; i++) EXPECT_EQ(ReplayedMarker(&fanOut, geometry, i), i);
+  }
+}
+
+// Pages painting prerendered images count their pixels against the budget.
+TEST(CopyFanOutTest, SpillsImagePagesPastTheBudget) {
+  PrintPageGeometry geometry = MarginGeometry();
+  constexpr size_t kImageBytes = 1000;
+  CopyFanOut fanOut(geometry, 2 * kImageBytes + kImageBytes / 2, kPages);
+  for (int i = 0; i < kPages; i++) fanOut.Keep(RecordMarkerPage(geometry, i), kImageBytes);
+  std::string error;
+  ASSERT_TRUE(fanOut.Finish(&error)) << error;
+  EXPECT_EQ(fanOut.spilled_pages(), kPages - 2);
+  for (int i = 0; i < kPages; i++) EXPECT_EQ(ReplayedMarker(&fanOut, geometry, i), i);
+}
+
+struct CopiesCase {
+  const char* name;
+  int pages;
+  int copies;
+  bool duplex;
+  std::vector<int> expected;
+};
+
+// Spools |pages| MarkerPages with software copies through a PdfFileSink and
+// reads back the marker of every output page, -1 for blank ones.
+std::vector<int> SpoolCopies(const CopiesCase& test, SpoolResult* result) {
+  std::vector<int> printed;
+  ScopedTestFile input("fan_out_input.pdf");
+  ScopedTestFile output("fan_out_output.pdf");
+  EXPECT_TRUE(WriteTestPdf(input.path(), MarkerPages(test.pages)));
+  std::string error;
+  DocumentLease lease = DocumentCache::Shared().Acquire(input.path(), &error);
+  EXPECT_TRUE(lease) << error;
+  if (!lease) return printed;
+
+  PrintSettings settings;
+  settings.copies = test.copies;
+  settings.softwareCopies = true;
+  settings.doubleSided = test.duplex;
+  PageSetup setup;
+  setup.duplex = test.duplex;
+  PdfFileSink sink(output.path(), setup);
+  PrintPageGeometry geometry = sink.Geometry();
+  EXPECT_TRUE(sink.StartDocument("Copies", nullptr));
+  *result = SpoolPages(&sink, &lease, input.path(), settings, nullptr);
+  EXPECT_TRUE(sink.EndDocument());
+  lease.Reset();
+  DocumentCache::Shared().Clear();
+
+  // Marker pages are scaled up to the paper from its top-left corner.
+  constexpr double kReadDpi = 36.0;
+  double scale = std::min(geometry.physicalWidth / kTestPageWidth,
+                          geometry.physicalHeight / kTestPageHeight);
+  PopplerDocument* document = OpenTestPdf(output.path());
+  EXPECT_NE(document, nullptr);
+  if (!document) return printed;
+  for (int i = 0; i < poppler_document_get_n_pages(document); i++) {
+    PopplerPage* page = poppler_document_get_page(document, i);
+    cairo_surface_t* image = RenderPageToImage(page, kReadDpi);
+    printed.push_back(image ? ReadPageMarker(image, kReadDpi * scale) : -2);
+    if (image) cairo_surface_destroy(image);
+    g_object_unref(page);
+  }
+  g_object_unref(document);
+  return printed;
+}
+
+// Copies come out collated; duplex copies of an odd page count each start
+// on a new sheet, so a blank back goes before copies 2..N.
+TEST(CopyFanOutTest, SpoolsCollatedCopies) {
+  const CopiesCase cases[] = {
+      {"3 pages, 3 copies", 3, 3, false, {0, 1, 2, 0, 1, 2, 0, 1, 2}},
+      {"3 pages, 3 copies, duplex", 3, 3, true, {0, 1, 2, -1, 0, 1, 2, -1, 0, 1, 2}},
+      {"2 pages, 3 copies, duplex", 2, 3, true, {0, 1, 0, 1, 0, 1}},
+      {"1 page, 4 copies, duplex", 1, 4, true, {0, -1, 0, -1, 0, -1, 0}},
+  };
+  for (const CopiesCase& test : cases) {
+    SCOPED_TRACE(test.name);
+    SpoolResult result;
+    std::vector<int> printed = SpoolCopies(test, &result);
+    EXPECT_TRUE(result.ok) << result.errorMessage;
+    // Padding is not counted as spooled pages.
+    EXPECT_EQ(result.pagesSpooled, test.pages * test.copies);
+    EXPECT_EQ(result.spilledPages, 0);
+    EXPECT_EQ(printed, test.expected);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,185 @@
+#include "document_analyzer.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_documents.h"
+
+namespace {
+
+TestPage ColourPage() {
+  TestPage page;
+  page.draw = [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.9, 0.1, 0.1);
+    cairo_rectangle(cr, 40.0, 60.0, 50.0, 50.0);
+    cairo_fill(cr);
+  };
+  return page;
+}
+
+// Black and grey only, anti-aliased edges included.
+TestPage GreyPage(double width, double height) {
+  TestPage page;
+  page.width = width;
+  page.height = height;
+  page.draw = [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_set_line_width(cr, 1.5);
+    cairo_move_to(cr, 12.0, 20.0);
+    cairo_line_to(cr, 120.0, 100.0);
+    cairo_stroke(cr);
+    cairo_set_source_rgb(cr, 0.5, 0.5, 0.5);
+    cairo_rectangle(cr, 20.0, 30.0, 40.0, 20.0);
+    cairo_fill(cr);
+  };
+  return page;
+}
+
+TestPage BlankPage() { return TestPage(); }
+
+// A one-page document that differs from every other |variant|.
+void WriteVariant(const std::string& path, int variant) {
+  TestPage page;
+  page.draw = [variant](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_rectangle(cr, 10.0, 10.0, 1.0 + variant, 4.0);
+    cairo_fill(cr);
+  };
+  ASSERT_TRUE(WriteTestPdf(path, {page}));
+}
+
+bool Analyze(const std::string& path, int threads, DocumentAnalysis* analysis,
+             AnalyzeStats* stats) {
+  std::string error;
+  bool ok = AnalyzeDocument(path, threads, analysis, stats, &error);
+  EXPECT_TRUE(ok) << error;
+  return ok;
+}
+
+TEST(DocumentAnalyzerTest, ClassifiesColourGreyAndBlankPages) {
+  ScopedTestFile file("analyzer_classes.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), {ColourPage(), GreyPage(kTestPageWidth, kTestPageHeight),
+                                         BlankPage(), GreyPage(kTestPageHeight, kTestPageWidth),
+                                         MarkerPage(0)}));
+  DocumentAnalysis analysis;
+  AnalyzeStats stats;
+  ASSERT_TRUE(Analyze(file.path(), 2, &analysis, &stats));
+  ASSERT_EQ(analysis.pages.size(), 5u);
+
+  const bool colour[] = {true, false, false, false, true};
+  const bool blank[] = {false, false, true, false, false};
+  for (int i = 0; i < 5; i++) {
+    SCOPED_TRACE("page " + std::to_string(i));
+    EXPECT_EQ(analysis.pages[i].pageIndex, i);
+    EXPECT_EQ(analysis.pages[i].color, colour[i]);
+    EXPECT_EQ(analysis.pages[i].blank, blank[i]);
+    EXPECT_EQ(analysis.pages[i].landscape, i == 3);
+    EXPECT_EQ(analysis.pages[i].rotation, 0);
+  }
+  EXPECT_DOUBLE_EQ(analysis.pages[3].widthPts, kTestPageHeight);
+  EXPECT_DOUBLE_EQ(analysis.pages[3].heightPts, kTestPageWidth);
+  EXPECT_EQ(analysis.colorPages, 2);
+  EXPECT_EQ(analysis.blankPages, 1);
+  EXPECT_FALSE(stats.cached);
+}
+
+TEST(DocumentAnalyzerTest, ResultDoesNotDependOnThreadCount) {
+  ScopedTestFile serialFile("analyzer_serial.pdf");
+  ScopedTestFile parallelFile("analyzer_parallel.pdf");
+  std::vector<TestPage> pages = MarkerPages(9);
+  pages.insert(pages.begin() + 4, BlankPage());
+  // The parallel file has one more page, so it is not served from the
+  // serial run's cache entry.
+  ASSERT_TRUE(WriteTestPdf(serialFile.path(), pages));
+  pages.push_back(GreyPage(kTestPageWidth, kTestPageHeight));
+  ASSERT_TRUE(WriteTestPdf(parallelFile.path(), pages));
+
+  DocumentAnalysis serial, parallel;
+  AnalyzeStats serialStats, parallelStats;
+  ASSERT_TRUE(Analyze(serialFile.path(), 1, &serial, &serialStats));
+  ASSERT_TRUE(Analyze(parallelFile.path(), 4, &parallel, &parallelStats));
+  EXPECT_EQ(serialStats.threadsUsed, 1);
+  EXPECT_EQ(parallelStats.threadsUsed, 4);
+  ASSERT_EQ(serial.pages.size(), 10u);
+  ASSERT_EQ(parallel.pages.size(), 11u);
+  for (size_t i = 0; i < serial.pages.size(); i++) {
+    SCOPED_TRACE("page " + std::to_string(i));
+    EXPECT_EQ(parallel.pages[i].pageIndex, (int)i);
+    EXPECT_EQ(parallel.pages[i].color, serial.pages[i].color);
+    EXPECT_EQ(parallel.pages[i].blank, serial.pages[i].blank);
+  }
+  EXPECT_EQ(serial.colorPages, 9);
+  EXPECT_EQ(serial.blankPages, 1);
+  EXPECT_EQ(parallel.colorPages, 9);
+  EXPECT_FALSE(parallel.pages[10].color);
+}
+
+TEST(DocumentAnalyzerTest, RepeatedAnalysisComesFromTheCache) {
+  ScopedTestFile file("analyzer_repeat.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), {ColourPage(), BlankPage()}));
+  DocumentAnalysis first, second;
+  AnalyzeStats firstStats, secondStats;
+  ASSERT_TRUE(Analyze(file.path(), 2, &first, &firstStats));
+  ASSERT_TRUE(Analyze(file.path(), 2, &second, &secondStats));
+  EXPECT_FALSE(firstStats.cached);
+  EXPECT_TRUE(secondStats.cached);
+  ASSERT_EQ(second.pages.size(), 2u);
+  EXPECT_TRUE(second.pages[0].color);
+  EXPECT_TRUE(second.pages[1].blank);
+
+  // New content in the same file is analysed again.
+  ASSERT_TRUE(WriteTestPdf(file.path(), {GreyPage(kTestPageWidth, kTestPageHeight)}));
+  std::filesystem::path path(file.path());
+  std::filesystem::last_write_time(
+      path, std::filesystem::last_write_time(path) + std::chrono::seconds(2));
+  DocumentAnalysis changed;
+  AnalyzeStats changedStats;
+  ASSERT_TRUE(Analyze(file.path(), 2, &changed, &changedStats));
+  EXPECT_FALSE(changedStats.cached);
+  ASSERT_EQ(changed.pages.size(), 1u);
+  EXPECT_FALSE(changed.pages[0].color);
+}
+
+// The cache keeps the 64 most recently used analyses.
+TEST(DocumentAnalyzerTest, LeastRecentlyUsedAnalysisIsEvicted) {
+  constexpr int kCapacity = 64;
+  std::vector<std::unique_ptr<ScopedTestFile>> files;
+  for (int i = 0; i < kCapacity + 1; i++) {
+    files.push_back(std::make_unique<ScopedTestFile>("analyzer_lru_" + std::to_string(i) + ".pdf"));
+    WriteVariant(files.back()->path(), i);
+  }
+
+  DocumentAnalysis analysis;
+  AnalyzeStats stats;
+  // Fills the cache with files 0..63, oldest first.
+  for (int i = 0; i < kCapacity; i++) {
+    ASSERT_TRUE(Analyze(files[i]->path(), 1, &analysis, &stats));
+    EXPECT_FALSE(stats.cached) << "file " << i;
+  }
+  // Using file 0 makes file 1 the least recently used; file 64 evicts it.
+  ASSERT_TRUE(Analyze(files[0]->path(), 1, &analysis, &stats));
+  EXPECT_TRUE(stats.cached);
+  ASSERT_TRUE(Analyze(files[kCapacity]->path(), 1, &analysis, &stats));
+  EXPECT_FALSE(stats.cached);
+
+  ASSERT_TRUE(Analyze(files[0]->path(), 1, &analysis, &stats));
+  EXPECT_TRUE(stats.cached);
+  ASSERT_TRUE(Analyze(files[2]->path(), 1, &analysis, &stats));
+  EXPECT_TRUE(stats.cached);
+  ASSERT_TRUE(Analyze(files[1]->path(), 1, &analysis, &stats));
+  EXPECT_FALSE(stats.cached);
+}
+
+TEST(DocumentAnalyzerTest, MissingFileFails) {
+  DocumentAnalysis analysis;
+  std::string error;
+  EXPECT_FALSE(AnalyzeDocument(TestFilePath("analyzer_missing.pdf"), 1, &analysis, nullptr, &error));
+  EXPECT_FALSE(error.empty());
+}
+
+}  // namespace
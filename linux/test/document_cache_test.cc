@@ -0,0 +1,288 @@
+#include "document_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "margin_cache.h"
+#include "page_rasterizer.h"
+#include "test_documents.h"
+
+namespace {
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Marker of page |index| of |lease|, -1 if it has none.
+int RenderedMarker(DocumentLease* lease, int index) {
+  PopplerPage* page = lease->page(index);
+  if (!page) return -1;
+  cairo_surface_t* image = RenderPageToImage(page, 72.0);
+  if (!image) return -1;
+  int marker = ReadPageMarker(image, 72.0);
+  cairo_surface_destroy(image);
+  return marker;
+}
+
+// A MarkerPages(|pages|) PDF grown past |size| bytes with comment lines
+// after its end and the last startxref repeated, so Poppler still finds the
+// original cross-reference table.
+bool WritePaddedPdf(const std::string& path, int pages, size_t size) {
+  if (!WriteTestPdf(path, MarkerPages(pages))) return false;
+  std::string pdf = ReadFile(path);
+  size_t at = pdf.rfind("startxref");
+  if (at == std::string::npos) return false;
+  std::string trailer = pdf.substr(at);
+  std::string line = "%" + std::string(1022, 'x') + "\n";
+  while (pdf.size() < size) pdf += line;
+  pdf += trailer;
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << pdf;
+  return true;
+}
+
+// PDFs sent over the channel are parsed from memory once, under a name
+// derived from their content, so the same bytes sent again hit the cache.
+TEST(DocumentCacheTest, MemorySourceIsParsedOnce) {
+  ScopedTestFile file("cache_memory.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), MarkerPages(3)));
+  std::string pdf = ReadFile(file.path());
+  GBytes* bytes = g_bytes_new(pdf.data(), pdf.size());
+  GBytes* resent = g_bytes_new(pdf.data(), pdf.size());
+
+  DocumentCache& cache = DocumentCache::Shared();
+  cache.Clear();
+  std::string source = cache.RegisterBytes(bytes);
+  EXPECT_EQ(cache.RegisterBytes(resent), source);
+  uint64_t hash = HashContent(pdf.data(), pdf.size());
+  EXPECT_EQ(source, "memory:" + std::to_string(hash) + "-" + std::to_string(pdf.size()));
+  EXPECT_TRUE(DocumentCache::IsMemorySource(source));
+  uint64_t keyHash = 0;
+  ASSERT_TRUE(cache.ContentHash(source, &keyHash));
+  EXPECT_EQ(keyHash, hash);
+
+  DocumentCacheStats before = cache.stats();
+  std::string error;
+  {
+    DocumentLease lease = cache.Acquire(source, &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_FALSE(lease.mapped());
+    EXPECT_EQ(lease.page_count(), 3);
+    EXPECT_EQ(RenderedMarker(&lease, 2), 2);
+  }
+  {
+    DocumentLease lease = cache.Acquire(source, &error);
+    ASSERT_TRUE(lease) << error;
+    // Pages parsed by the first lease come along with the document.
+    EXPECT_NE(lease.loaded_page(2), nullptr);
+    EXPECT_EQ(RenderedMarker(&lease, 1), 1);
+  }
+  DocumentCacheStats after = cache.stats();
+  EXPECT_EQ(after.misses - before.misses, 1);
+  EXPECT_EQ(after.memoryLoads - before.memoryLoads, 1);
+  EXPECT_EQ(after.hits - before.hits, 1);
+  EXPECT_EQ(after.idleDocuments, 1u);
+  EXPECT_EQ(after.idleBytes, pdf.size());
+
+  // The idle document keeps its own reference to the bytes; once it is
+  // gone too the name no longer resolves.
+  cache.UnregisterBytes(source);
+  cache.UnregisterBytes(source);
+  g_bytes_unref(resent);
+  g_bytes_unref(bytes);
+  EXPECT_TRUE(cache.Acquire(source, &error));
+  cache.Clear();
+  error.clear();
+  EXPECT_FALSE(cache.Acquire(source, &error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_FALSE(cache.ContentHash(source, &keyHash));
+}
+
+// Files of kMapThresholdBytes and more are mapped, and dropped when their
+// lease ends so the mapping does not outlive the print job.
+TEST(DocumentCacheTest, MappedDocumentIsNotKeptIdle) {
+  ScopedTestFile file("cache_mapped.pdf");
+  ASSERT_TRUE(WritePaddedPdf(file.path(), 2, DocumentCache::kMapThresholdBytes));
+
+  DocumentCache& cache = DocumentCache::Shared();
+  cache.Clear();
+  DocumentCacheStats before = cache.stats();
+  std::string error;
+  for (int round = 0; round < 2; round++) {
+    DocumentLease lease = cache.Acquire(file.path(), &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_TRUE(lease.mapped());
+    EXPECT_EQ(lease.page_count(), 2);
+    EXPECT_EQ(RenderedMarker(&lease, 1), 1);
+  }
+  DocumentCacheStats after = cache.stats();
+  EXPECT_EQ(after.mappedLoads - before.mappedLoads, 2);
+  EXPECT_EQ(after.misses - before.misses, 2);
+  EXPECT_EQ(after.hits, before.hits);
+  EXPECT_EQ(after.idleDocuments, 0u);
+  EXPECT_EQ(after.idleBytes, 0u);
+
+  // Just under the threshold the file is read into memory and kept.
+  ScopedTestFile small("cache_unmapped.pdf");
+  ASSERT_TRUE(WritePaddedPdf(small.path(), 2, DocumentCache::kMapThresholdBytes - 64 * 1024));
+  {
+    DocumentLease lease = cache.Acquire(small.path(), &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_FALSE(lease.mapped());
+  }
+  EXPECT_EQ(cache.stats().idleDocuments, 1u);
+  cache.Clear();
+}
+
+// Leases are exclusive: a file acquired while already leased gets its own
+// document, and both instances go back to the cache afterwards.
+TEST(DocumentCacheTest, ConcurrentLeasesGetTheirOwnDocument) {
+  ScopedTestFile file("cache_exclusive.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), MarkerPages(2)));
+  DocumentCache& cache = DocumentCache::Shared();
+  cache.Clear();
+  DocumentCacheStats before = cache.stats();
+  std::string error;
+  {
+    DocumentLease first = cache.Acquire(file.path(), &error);
+    DocumentLease second = cache.Acquire(file.path(), &error);
+    ASSERT_TRUE(first) << error;
+    ASSERT_TRUE(second) << error;
+    EXPECT_NE(first.document(), second.document());
+    EXPECT_EQ(RenderedMarker(&second, 1), 1);
+  }
+  DocumentCacheStats after = cache.stats();
+  EXPECT_EQ(after.misses - before.misses, 2);
+  EXPECT_EQ(after.idleDocuments, 2u);
+
+  DocumentLease lease = cache.Acquire(file.path(), &error);
+  ASSERT_TRUE(lease) << error;
+  EXPECT_EQ(cache.stats().hits - before.hits, 1);
+  // Reset hands the document back before the lease goes away.
+  lease.Reset();
+  EXPECT_FALSE(lease);
+  EXPECT_EQ(cache.stats().idleDocuments, 2u);
+  cache.Clear();
+}
+
+// Tests that change the cache limits put the defaults back.
+class DocumentCacheLimitsTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kDefaultIdleDocuments = 8;
+  static constexpr size_t kDefaultBudget = 256 * 1024 * 1024;
+
+  void SetUp() override { DocumentCache::Shared().Clear(); }
+  void TearDown() override {
+    DocumentCache::Shared().Configure(kDefaultIdleDocuments, kDefaultBudget);
+    DocumentCache::Shared().Clear();
+  }
+
+  // Acquires |path| and gives it straight back; true on a cache hit.
+  static bool Touch(const std::string& path) {
+    DocumentCache& cache = DocumentCache::Shared();
+    int64_t hits = cache.stats().hits;
+    std::string error;
+    DocumentLease lease = cache.Acquire(path, &error);
+    EXPECT_TRUE(lease) << path << ": " << error;
+    return cache.stats().hits > hits;
+  }
+};
+
+TEST_F(DocumentCacheLimitsTest, EvictsLeastRecentlyUsedByCount) {
+  ScopedTestFile a("cache_lru_a.pdf");
+  ScopedTestFile b("cache_lru_b.pdf");
+  ScopedTestFile c("cache_lru_c.pdf");
+  ASSERT_TRUE(WriteTestPdf(a.path(), MarkerPages(1)));
+  ASSERT_TRUE(WriteTestPdf(b.path(), MarkerPages(2)));
+  ASSERT_TRUE(WriteTestPdf(c.path(), MarkerPages(3)));
+
+  DocumentCache& cache = DocumentCache::Shared();
+  cache.Configure(2, kDefaultBudget);
+  int64_t evictions = cache.stats().evictions;
+  EXPECT_FALSE(Touch(a.path()));
+  EXPECT_FALSE(Touch(b.path()));
+  EXPECT_TRUE(Touch(a.path()));
+  // b is now the least recently used and makes room for c.
+  EXPECT_FALSE(Touch(c.path()));
+  EXPECT_EQ(cache.stats().evictions - evictions, 1);
+  EXPECT_EQ(cache.stats().idleDocuments, 2u);
+  EXPECT_TRUE(Touch(a.path()));
+  EXPECT_TRUE(Touch(c.path()));
+  EXPECT_FALSE(Touch(b.path()));
+
+  // Lowering the limit evicts right away.
+  cache.Configure(1, kDefaultBudget);
+  EXPECT_EQ(cache.stats().idleDocuments, 1u);
+  EXPECT_TRUE(Touch(b.path()));
+}
+
+TEST_F(DocumentCacheLimitsTest, EvictsLeastRecentlyUsedByBytes) {
+  ScopedTestFile a("cache_bytes_a.pdf");
+  ScopedTestFile b("cache_bytes_b.pdf");
+  ScopedTestFile c("cache_bytes_c.pdf");
+  constexpr size_t kFileBytes = 256 * 1024;
+  ASSERT_TRUE(WritePaddedPdf(a.path(), 1, kFileBytes));
+  ASSERT_TRUE(WritePaddedPdf(b.path(), 1, kFileBytes));
+  ASSERT_TRUE(WritePaddedPdf(c.path(), 1, kFileBytes));
+  size_t size = std::filesystem::file_size(a.path());
+
+  // Room for two of them, not three.
+  DocumentCache& cache = DocumentCache::Shared();
+  cache.Configure(8, size * 2 + size / 2);
+  EXPECT_FALSE(Touch(a.path()));
+  EXPECT_FALSE(Touch(b.path()));
+  EXPECT_EQ(cache.stats().idleBytes, size * 2);
+  EXPECT_FALSE(Touch(c.path()));
+  DocumentCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.idleDocuments, 2u);
+  EXPECT_LE(stats.idleBytes, size * 2 + size / 2);
+  EXPECT_TRUE(Touch(b.path()));
+  EXPECT_TRUE(Touch(c.path()));
+  EXPECT_FALSE(Touch(a.path()));
+
+  // A document larger than the whole budget is not kept at all.
+  cache.Configure(8, size / 2);
+  EXPECT_EQ(cache.stats().idleDocuments, 0u);
+  EXPECT_FALSE(Touch(a.path()));
+  EXPECT_EQ(cache.stats().idleBytes, 0u);
+}
+
+// Keys include the modification time, so a file rewritten in place is
+// parsed again instead of being served from the stale entry.
+TEST_F(DocumentCacheLimitsTest, ChangedFileIsParsedAgain) {
+  ScopedTestFile file("cache_changed.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), MarkerPages(2)));
+  DocumentCache& cache = DocumentCache::Shared();
+  std::string error;
+  {
+    DocumentLease lease = cache.Acquire(file.path(), &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_EQ(RenderedMarker(&lease, 1), 1);
+  }
+  EXPECT_TRUE(Touch(file.path()));
+
+  // Page 1 now shows marker 3, and the clock moves on even on file systems
+  // with coarse timestamps.
+  std::vector<TestPage> pages = {MarkerPage(0), MarkerPage(3)};
+  auto modified = std::filesystem::last_write_time(file.path());
+  ASSERT_TRUE(WriteTestPdf(file.path(), pages));
+  std::filesystem::last_write_time(file.path(), modified + std::chrono::seconds(2));
+
+  DocumentCacheStats before = cache.stats();
+  {
+    DocumentLease lease = cache.Acquire(file.path(), &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_EQ(RenderedMarker(&lease, 1), 3);
+  }
+  DocumentCacheStats after = cache.stats();
+  EXPECT_EQ(after.misses - before.misses, 1);
+  EXPECT_EQ(after.hits, before.hits);
+  EXPECT_TRUE(Touch(file.path()));
+}
+
+}  // namespace
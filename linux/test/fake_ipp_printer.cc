@@ -0,0 +1,297 @@
+#include "fake_ipp_printer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+constexpr uint16_t kSuccessfulOk = 0x0000;
+constexpr uint16_t kBadRequest = 0x0400;
+constexpr uint16_t kNotPossible = 0x0404;
+constexpr uint16_t kNotFound = 0x0406;
+constexpr uint16_t kInternalError = 0x0500;
+constexpr uint16_t kOperationNotSupported = 0x0501;
+
+std::string ToLower(std::string text) {
+  for (char& c : text) c = (char)tolower((unsigned char)c);
+  return text;
+}
+
+// Takes one complete HTTP request off the front of |inbound| and returns its
+// body, de-chunked. False if the request is not complete yet.
+bool TakeRequest(std::string* inbound, std::string* body) {
+  size_t headerEnd = inbound->find("\r\n\r\n");
+  if (headerEnd == std::string::npos) return false;
+
+  bool chunked = false;
+  size_t contentLength = 0;
+  size_t lineStart = inbound->find("\r\n") + 2;
+  while (lineStart < headerEnd) {
+    size_t lineEnd = inbound->find("\r\n", lineStart);
+    std::string line = ToLower(inbound->substr(lineStart, lineEnd - lineStart));
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      std::string name = line.substr(0, colon);
+      std::string value = line.substr(colon + 1);
+      if (name == "content-length") contentLength = strtoul(value.c_str(), nullptr, 10);
+      if (name == "transfer-encoding") chunked = value.find("chunked") != std::string::npos;
+    }
+    lineStart = lineEnd + 2;
+  }
+
+  size_t pos = headerEnd + 4;
+  std::string content;
+  if (chunked) {
+    for (;;) {
+      size_t lineEnd = inbound->find("\r\n", pos);
+      if (lineEnd == std::string::npos) return false;
+      size_t size = strtoul(inbound->c_str() + pos, nullptr, 16);
+      pos = lineEnd + 2;
+      if (inbound->size() < pos + size + 2) return false;
+      if (size == 0) {
+        pos += 2;
+        break;
+      }
+      content.append(*inbound, pos, size);
+      pos += size + 2;
+    }
+  } else {
+    if (inbound->size() < pos + contentLength) return false;
+    content.assign(*inbound, pos, contentLength);
+    pos += contentLength;
+  }
+  inbound->erase(0, pos);
+  *body = std::move(content);
+  return true;
+}
+
+}  // namespace
+
+class FakeIppPrinter::Connection : public IppConnection {
+ public:
+  Connection(std::shared_ptr<FakeIppPrinter> printer, int id)
+      : printer_(std::move(printer)), id_(id) {
+    std::lock_guard<std::mutex> lock(printer_->mutex_);
+    printer_->connections_.insert(this);
+  }
+
+  ~Connection() override {
+    std::lock_guard<std::mutex> lock(printer_->mutex_);
+    printer_->connections_.erase(this);
+  }
+
+  bool Write(const void* data, size_t size) override {
+    bool slow = false;
+    std::chrono::milliseconds delay;
+    {
+      std::lock_guard<std::mutex> lock(printer_->mutex_);
+      // A stale connection takes the bytes and drops them, like a socket
+      // whose peer is gone before the RST arrived.
+      if (closed_) return !noticed_;
+      inbound_.append((const char*)data, size);
+      std::string body;
+      while (!closed_ && TakeRequest(&inbound_, &body)) {
+        bool closeAfter = printer_->close_after_response_;
+        std::string response = printer_->Handle(id_, body, &slow);
+        if (closeAfter) {
+          response.insert(response.find("\r\n\r\n") + 2, "Connection: close\r\n");
+          closed_ = noticed_ = true;
+        }
+        outbound_ += response;
+      }
+      delay = printer_->document_delay_;
+    }
+    if (slow) std::this_thread::sleep_for(delay);
+    return true;
+  }
+
+  int64_t Read(void* buffer, size_t capacity) override {
+    std::lock_guard<std::mutex> lock(printer_->mutex_);
+    if (read_ < outbound_.size()) {
+      size_t count = std::min(capacity, outbound_.size() - read_);
+      memcpy(buffer, outbound_.data() + read_, count);
+      read_ += count;
+      if (read_ == outbound_.size()) {
+        outbound_.clear();
+        read_ = 0;
+      }
+      return (int64_t)count;
+    }
+    // Nothing more is coming: an orderly close, or a read timeout.
+    return closed_ ? 0 : -1;
+  }
+
+  bool Closed() override {
+    std::lock_guard<std::mutex> lock(printer_->mutex_);
+    return closed_ && noticed_;
+  }
+
+  // With the printer's mutex held.
+  bool Idle() const { return inbound_.empty() && outbound_.empty(); }
+  void Close(bool noticed) {
+    closed_ = true;
+    noticed_ = noticed;
+  }
+
+ private:
+  std::shared_ptr<FakeIppPrinter> printer_;
+  int id_;
+  // Guarded by the printer's mutex.
+  std::string inbound_;
+  std::string outbound_;
+  size_t read_ = 0;
+  bool closed_ = false;
+  bool noticed_ = false;
+};
+
+class FakeIppPrinter::Connector : public IppConnector {
+ public:
+  explicit Connector(std::shared_ptr<FakeIppPrinter> printer) : printer_(std::move(printer)) {}
+
+  std::unique_ptr<IppConnection> Connect(const std::string& /*host*/, int /*port*/,
+                                         std::string* /*error*/) override {
+    int id;
+    {
+      std::lock_guard<std::mutex> lock(printer_->mutex_);
+      id = ++printer_->connections_opened_;
+    }
+    return std::make_unique<Connection>(printer_, id);
+  }
+
+ private:
+  std::shared_ptr<FakeIppPrinter> printer_;
+};
+
+std::unique_ptr<IppConnector> FakeIppPrinter::NewConnector() {
+  return std::make_unique<Connector>(shared_from_this());
+}
+
+void FakeIppPrinter::CloseIdleConnections(bool noticed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Connection* connection : connections_) {
+    if (connection->Idle()) connection->Close(noticed);
+  }
+}
+
+void FakeIppPrinter::set_close_after_response(bool close) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  close_after_response_ = close;
+}
+
+void FakeIppPrinter::set_fail_send_document(int n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  fail_send_document_ = n;
+}
+
+void FakeIppPrinter::set_document_delay(std::chrono::milliseconds delay) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  document_delay_ = delay;
+}
+
+std::vector<FakeIppPrinter::Request> FakeIppPrinter::requests() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return requests_;
+}
+
+bool FakeIppPrinter::FindJob(int jobId, Job* job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(jobId);
+  if (it == jobs_.end()) return false;
+  *job = it->second;
+  return true;
+}
+
+int FakeIppPrinter::connections_opened() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return connections_opened_;
+}
+
+std::string FakeIppPrinter::Handle(int connection, const std::string& body, bool* slow) {
+  IppMessage request;
+  size_t consumed = 0;
+  IppMessage response;
+  if (!request.Decode((const uint8_t*)body.data(), body.size(), &consumed)) {
+    response.code = kBadRequest;
+  } else {
+    std::string document = body.substr(consumed);
+    Request entry;
+    entry.operation = request.code;
+    entry.jobId = request.FindInteger("job-id", 0);
+    entry.connection = connection;
+    entry.documentBytes = document.size();
+    const IppAttribute* last = request.Find("last-document");
+    entry.lastDocument = last && !last->values.empty() && last->values[0].integer != 0;
+
+    response.requestId = request.requestId;
+    response.AddString(kIppTagOperation, kIppTagCharset, "attributes-charset", "utf-8");
+    response.AddString(kIppTagOperation, kIppTagLanguage, "attributes-natural-language", "en");
+    response.code = kSuccessfulOk;
+    auto job = jobs_.find(entry.jobId);
+    switch (request.code) {
+      case kIppPrintJob:
+      case kIppCreateJob: {
+        entry.jobId = next_job_id_++;
+        Job& created = jobs_[entry.jobId];
+        created.name = request.FindString("job-name");
+        if (request.code == kIppPrintJob) {
+          created.documents.push_back(document);
+          created.complete = true;
+          *slow = !document.empty();
+        }
+        response.AddInteger(kIppTagJob, kIppTagInteger, "job-id", entry.jobId);
+        response.AddInteger(kIppTagJob, kIppTagEnum, "job-state", 3);
+        break;
+      }
+      case kIppSendDocument:
+        if (job == jobs_.end()) {
+          response.code = kNotFound;
+        } else if (job->second.canceled || job->second.complete) {
+          response.code = kNotPossible;
+        } else if (++send_documents_ == fail_send_document_) {
+          response.code = kInternalError;
+        } else {
+          // An empty request only closes the job.
+          if (!document.empty()) job->second.documents.push_back(document);
+          job->second.complete = entry.lastDocument;
+          *slow = !document.empty();
+        }
+        break;
+      case kIppCancelJob:
+        if (job == jobs_.end()) {
+          response.code = kNotFound;
+        } else if (job->second.complete) {
+          response.code = kNotPossible;
+        } else {
+          job->second.canceled = true;
+        }
+        break;
+      case kIppGetJobAttributes:
+        if (job == jobs_.end()) {
+          response.code = kNotFound;
+        } else {
+          // canceled, completed, or pending-held while documents come in.
+          int state = job->second.canceled ? 7 : job->second.complete ? 9 : 4;
+          response.AddInteger(kIppTagJob, kIppTagInteger, "job-id", entry.jobId);
+          response.AddInteger(kIppTagJob, kIppTagEnum, "job-state", state);
+        }
+        break;
+      case kIppGetPrinterAttributes:
+        response.AddString(kIppTagPrinter, kIppTagName, "printer-name", "Fake IPP Printer");
+        response.AddInteger(kIppTagPrinter, kIppTagEnum, "printer-state", 3);
+        break;
+      default:
+        response.code = kOperationNotSupported;
+        break;
+    }
+    requests_.push_back(entry);
+  }
+
+  std::vector<uint8_t> encoded;
+  response.Encode(&encoded);
+  std::string http = "HTTP/1.1 200 OK\r\nContent-Type: application/ipp\r\nContent-Length: " +
+                     std::to_string(encoded.size()) + "\r\n\r\n";
+  http.append(encoded.begin(), encoded.end());
+  return http;
+}
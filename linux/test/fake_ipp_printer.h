@@ -0,0 +1,90 @@
+#ifndef FLUTTER_FAKE_IPP_PRINTER_H_
+#define FLUTTER_FAKE_IPP_PRINTER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ipp_client.h"
+
+// An IPP printer in process for the print core tests, reached through the
+// IppConnectors made by NewConnector instead of TCP. A request is answered
+// as soon as its last byte is written, so tests see exactly which request
+// went over which connection. Thread-safe.
+class FakeIppPrinter : public std::enable_shared_from_this<FakeIppPrinter> {
+ public:
+  // One request the printer answered.
+  struct Request {
+    uint16_t operation = 0;
+    int jobId = 0;
+    // Connections are numbered from 1 in the order they were opened.
+    int connection = 0;
+    bool lastDocument = false;
+    size_t documentBytes = 0;
+  };
+
+  struct Job {
+    std::string name;
+    std::vector<std::string> documents;
+    // Print-Job, or a Send-Document with last-document arrived.
+    bool complete = false;
+    bool canceled = false;
+  };
+
+  FakeIppPrinter() = default;
+
+  // Prevent copying.
+  FakeIppPrinter(FakeIppPrinter const&) = delete;
+  FakeIppPrinter& operator=(FakeIppPrinter const&) = delete;
+
+  // A connector to this printer, whatever host and port it is given. It
+  // keeps the printer alive.
+  std::unique_ptr<IppConnector> NewConnector();
+
+  // Closes every connection that is not in the middle of a request, like a
+  // printer's keep-alive timeout. If |noticed| is false the client cannot
+  // tell from IppConnection::Closed; it finds out when its next request on
+  // the connection goes unanswered, as with a stale TCP connection.
+  void CloseIdleConnections(bool noticed);
+
+  // Answers with "Connection: close" and closes the connection after each
+  // response.
+  void set_close_after_response(bool close);
+  // Fails the |n|th Send-Document (counting from 1 across jobs) with
+  // server-error-internal-error; 0 for never.
+  void set_fail_send_document(int n);
+  // How long a Send-Document or Print-Job with data takes to answer, like a
+  // printer ingesting the document.
+  void set_document_delay(std::chrono::milliseconds delay);
+
+  std::vector<Request> requests();
+  // False if there is no such job.
+  bool FindJob(int jobId, Job* job);
+  int connections_opened();
+
+ private:
+  class Connection;
+  class Connector;
+
+  // With |mutex_| held. Returns the HTTP response to |body|, an IPP request
+  // possibly followed by document data.
+  std::string Handle(int connection, const std::string& body, bool* slow);
+
+  std::mutex mutex_;
+  std::set<Connection*> connections_;
+  std::vector<Request> requests_;
+  std::map<int, Job> jobs_;
+  int next_job_id_ = 1;
+  int connections_opened_ = 0;
+  int send_documents_ = 0;
+  int fail_send_document_ = 0;
+  bool close_after_response_ = false;
+  std::chrono::milliseconds document_delay_{0};
+};
+
+#endif  // FLUTTER_FAKE_IPP_PRINTER_H_
@@ -0,0 +1,308 @@
+#include "fake_spooler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+// What one SpoolWatcher sees of the spooler. State lives under the
+// spooler's mutex so Notify can reach every backend.
+class FakeSpooler::Backend : public SpoolBackend {
+ public:
+  explicit Backend(std::shared_ptr<FakeSpooler> spooler) : spooler_(std::move(spooler)) {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    spooler_->backends_.insert(this);
+  }
+
+  ~Backend() override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    spooler_->backends_.erase(this);
+  }
+
+  bool AddQueue(const std::string& queue) override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    spooler_->add_queue_calls_++;
+    queues_[queue]++;
+    return true;
+  }
+
+  void RemoveQueue(const std::string& queue) override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    spooler_->remove_queue_calls_++;
+    auto it = queues_.find(queue);
+    if (it != queues_.end() && --it->second == 0) queues_.erase(it);
+  }
+
+  void Wait(int timeoutMs, std::vector<std::string>* changed) override {
+    std::unique_lock<std::mutex> lock(spooler_->mutex_);
+    auto ready = [this] { return woken_ || !pending_.empty(); };
+    if (timeoutMs < 0) {
+      spooler_->changed_.wait(lock, ready);
+    } else {
+      spooler_->changed_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+    }
+    woken_ = false;
+    changed->insert(changed->end(), pending_.begin(), pending_.end());
+    pending_.clear();
+  }
+
+  void Wake() override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    woken_ = true;
+    spooler_->changed_.notify_all();
+  }
+
+  bool QueryJob(const std::string& queue, int jobId, SpoolJobInfo* info) override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    spooler_->query_job_calls_++;
+    Job* job = spooler_->Find(queue, jobId);
+    if (!job) return false;
+    *info = job->info;
+    return true;
+  }
+
+  bool QueryQueue(const std::string& queue, SpoolQueueInfo* info) override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    if (!queues_.count(queue) || spooler_->unreachable_.count(queue)) return false;
+    info->status = spooler_->queue_status_[queue];
+    info->rawStatus = info->status;
+    info->jobPages.clear();
+    for (const Job& job : spooler_->queues_[queue]) {
+      info->jobPages.emplace_back(job.id, job.info.pagesPrinted);
+    }
+    return true;
+  }
+
+  bool ListDocuments(const std::string& queue, std::vector<SpoolDocument>* documents) override {
+    std::lock_guard<std::mutex> lock(spooler_->mutex_);
+    spooler_->list_documents_calls_++;
+    if (!queues_.count(queue)) return false;
+    documents->clear();
+    for (const Job& job : spooler_->queues_[queue]) {
+      SpoolDocument document;
+      document.jobId = job.id;
+      document.name = job.documentName;
+      documents->push_back(document);
+    }
+    return true;
+  }
+
+  // With the spooler's mutex held.
+  void Changed(const std::string& queue) {
+    if (!queues_.count(queue)) return;
+    if (std::find(pending_.begin(), pending_.end(), queue) == pending_.end()) {
+      pending_.push_back(queue);
+    }
+  }
+  size_t queue_count() const { return queues_.size(); }
+
+ private:
+  std::shared_ptr<FakeSpooler> spooler_;
+  std::map<std::string, int> queues_;
+  std::vector<std::string> pending_;
+  bool woken_ = false;
+};
+
+int FakeSpooler::Submit(const std::string& queue, const std::string& documentName,
+                        int totalPages) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Job job;
+  job.id = next_job_id_++;
+  job.documentName = documentName;
+  job.info.status = kSpoolJobSpooling;
+  job.info.totalPages = totalPages;
+  queues_[queue].push_back(job);
+  Notify(queue);
+  return job.id;
+}
+
+bool FakeSpooler::Update(const std::string& queue, int jobId, const SpoolJobInfo& info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Job* job = Find(queue, jobId);
+  if (!job) return false;
+  job->info = info;
+  Notify(queue);
+  return true;
+}
+
+bool FakeSpooler::Complete(const std::string& queue, int jobId, int pages) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Job* job = Find(queue, jobId);
+  if (!job) return false;
+  job->info.status = 0;
+  job->info.pagesPrinted = pages < 0 ? job->info.totalPages : pages;
+  job->info.finished = true;
+  Notify(queue);
+  return true;
+}
+
+bool FakeSpooler::Cancel(const std::string& queue, int jobId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Job* job = Find(queue, jobId);
+  if (!job) return false;
+  job->info.status = kSpoolJobDeleting;
+  Notify(queue);
+  return true;
+}
+
+bool FakeSpooler::Remove(const std::string& queue, int jobId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Job>& jobs = queues_[queue];
+  auto it = std::find_if(jobs.begin(), jobs.end(), [jobId](const Job& job) { return job.id == jobId; });
+  if (it == jobs.end()) return false;
+  jobs.erase(it);
+  Notify(queue);
+  return true;
+}
+
+void FakeSpooler::SetQueueStatus(const std::string& queue, uint32_t status) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_status_[queue] = status;
+  Notify(queue);
+}
+
+void FakeSpooler::SetQueueReachable(const std::string& queue, bool reachable) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (reachable) {
+    unreachable_.erase(queue);
+  } else {
+    unreachable_.insert(queue);
+  }
+  Notify(queue);
+}
+
+void FakeSpooler::set_drop_notifications(bool drop) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  drop_notifications_ = drop;
+}
+
+std::unique_ptr<SpoolBackend> FakeSpooler::NewBackend() {
+  return std::make_unique<Backend>(shared_from_this());
+}
+
+std::vector<int> FakeSpooler::Jobs(const std::string& queue) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<int> ids;
+  for (const Job& job : queues_[queue]) ids.push_back(job.id);
+  return ids;
+}
+
+std::string FakeSpooler::DocumentName(const std::string& queue, int jobId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Job* job = Find(queue, jobId);
+  return job ? job->documentName : std::string();
+}
+
+int FakeSpooler::watched_queues() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (Backend* backend : backends_) count += backend->queue_count();
+  return (int)count;
+}
+
+int FakeSpooler::add_queue_calls() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return add_queue_calls_;
+}
+
+int FakeSpooler::remove_queue_calls() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return remove_queue_calls_;
+}
+
+int FakeSpooler::query_job_calls() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return query_job_calls_;
+}
+
+int FakeSpooler::list_documents_calls() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return list_documents_calls_;
+}
+
+FakeSpooler::Job* FakeSpooler::Find(const std::string& queue, int jobId) {
+  auto it = queues_.find(queue);
+  if (it == queues_.end()) return nullptr;
+  for (Job& job : it->second) {
+    if (job.id == jobId) return &job;
+  }
+  return nullptr;
+}
+
+void FakeSpooler::Notify(const std::string& queue) {
+  if (drop_notifications_) return;
+  for (Backend* backend : backends_) backend->Changed(queue);
+  changed_.notify_all();
+}
+
+SpoolWatcher::ResolvedCallback WatchRecorder::Resolved(int key) {
+  return [this, key](int jobId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    resolved_[key] = jobId;
+    changed_.notify_all();
+  };
+}
+
+SpoolWatcher::ProgressCallback WatchRecorder::Progress(int key) {
+  return [this, key](const SpoolJobInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    progress_[key].push_back(info);
+    changed_.notify_all();
+  };
+}
+
+SpoolWatcher::DoneCallback WatchRecorder::Done(int key) {
+  return [this, key](const SpoolOutcome& outcome) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!outcomes_.emplace(key, outcome).second) repeated_done_++;
+    changed_.notify_all();
+  };
+}
+
+bool WatchRecorder::WaitDone(size_t count, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return changed_.wait_for(lock, timeout, [this, count] { return outcomes_.size() >= count; });
+}
+
+bool WatchRecorder::WaitResolved(int key, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return changed_.wait_for(lock, timeout, [this, key] { return resolved_.count(key) > 0; });
+}
+
+bool WatchRecorder::WaitProgress(int key,
+                                 const std::function<bool(const SpoolJobInfo&)>& predicate,
+                                 std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return changed_.wait_for(lock, timeout, [&] {
+    const std::vector<SpoolJobInfo>& updates = progress_[key];
+    return std::any_of(updates.begin(), updates.end(), predicate);
+  });
+}
+
+size_t WatchRecorder::done_count() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return outcomes_.size();
+}
+
+bool WatchRecorder::Outcome(int key, SpoolOutcome* outcome) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = outcomes_.find(key);
+  if (it == outcomes_.end()) return false;
+  *outcome = it->second;
+  return true;
+}
+
+std::vector<SpoolJobInfo> WatchRecorder::ProgressOf(int key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return progress_[key];
+}
+
+int WatchRecorder::ResolvedJob(int key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = resolved_.find(key);
+  return it == resolved_.end() ? 0 : it->second;
+}
+
+int WatchRecorder::repeated_done() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return repeated_done_;
+}
@@ -0,0 +1,138 @@
+#ifndef FLUTTER_FAKE_SPOOLER_H_
+#define FLUTTER_FAKE_SPOOLER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "spool_watcher.h"
+
+// A print spooler in memory for the print core tests. Tests submit jobs and
+// move them along; SpoolBackends made by NewBackend see the queues like the
+// CUPS or Win32 backend would, including change notifications. Thread-safe.
+class FakeSpooler : public std::enable_shared_from_this<FakeSpooler> {
+ public:
+  FakeSpooler() = default;
+
+  // Prevent copying.
+  FakeSpooler(FakeSpooler const&) = delete;
+  FakeSpooler& operator=(FakeSpooler const&) = delete;
+
+  // Queues a job and returns its id. Ids count up per spooler, across queues,
+  // like CUPS job ids.
+  int Submit(const std::string& queue, const std::string& documentName, int totalPages);
+
+  // Replaces what the spooler reports for the job. Returns false if there is
+  // no such job.
+  bool Update(const std::string& queue, int jobId, const SpoolJobInfo& info);
+
+  // The job printed |pages| pages (all if < 0) and is finished; it stays
+  // listed like CUPS job history.
+  bool Complete(const std::string& queue, int jobId, int pages = -1);
+
+  // The job is being deleted without printing; Remove it once the watcher
+  // has seen that.
+  bool Cancel(const std::string& queue, int jobId);
+
+  // The spooler forgets the job.
+  bool Remove(const std::string& queue, int jobId);
+
+  // Replaces the printer status |queue| reports (SpoolQueueStatus bits).
+  void SetQueueStatus(const std::string& queue, uint32_t status);
+
+  // An unreachable printer fails QueryQueue, like one that was unplugged.
+  void SetQueueReachable(const std::string& queue, bool reachable);
+
+  // While set, changes are made without notifying anyone, as if the
+  // notification got lost.
+  void set_drop_notifications(bool drop);
+
+  // A backend over this spooler. It keeps the spooler alive.
+  std::unique_ptr<SpoolBackend> NewBackend();
+
+  // Jobs in |queue| in submission order.
+  std::vector<int> Jobs(const std::string& queue);
+  // Document name of |jobId|, empty if unknown.
+  std::string DocumentName(const std::string& queue, int jobId);
+
+  // Queues with notifications started by some backend and not stopped yet.
+  int watched_queues();
+  int add_queue_calls();
+  int remove_queue_calls();
+  int query_job_calls();
+  int list_documents_calls();
+
+ private:
+  class Backend;
+
+  struct Job {
+    int id = 0;
+    std::string documentName;
+    SpoolJobInfo info;
+  };
+
+  // With |mutex_| held.
+  Job* Find(const std::string& queue, int jobId);
+  void Notify(const std::string& queue);
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::map<std::string, std::vector<Job>> queues_;
+  std::map<std::string, uint32_t> queue_status_;
+  std::set<std::string> unreachable_;
+  std::set<Backend*> backends_;
+  int next_job_id_ = 1;
+  bool drop_notifications_ = false;
+  int add_queue_calls_ = 0;
+  int remove_queue_calls_ = 0;
+  int query_job_calls_ = 0;
+  int list_documents_calls_ = 0;
+};
+
+// Collects what a SpoolWatcher reports, per test-chosen key, and lets the
+// test wait for it. Callbacks come from the watcher thread.
+class WatchRecorder {
+ public:
+  WatchRecorder() = default;
+
+  // Prevent copying.
+  WatchRecorder(WatchRecorder const&) = delete;
+  WatchRecorder& operator=(WatchRecorder const&) = delete;
+
+  SpoolWatcher::ResolvedCallback Resolved(int key);
+  SpoolWatcher::ProgressCallback Progress(int key);
+  SpoolWatcher::DoneCallback Done(int key);
+
+  // Waits until |count| jobs are done. Returns false on timeout.
+  bool WaitDone(size_t count, std::chrono::milliseconds timeout);
+  // Waits until |key| is resolved to a job.
+  bool WaitResolved(int key, std::chrono::milliseconds timeout);
+  // Waits until a progress update of |key| matches |predicate|.
+  bool WaitProgress(int key, const std::function<bool(const SpoolJobInfo&)>& predicate,
+                    std::chrono::milliseconds timeout);
+
+  size_t done_count();
+  // Copies; false if |key| has not got there yet.
+  bool Outcome(int key, SpoolOutcome* outcome);
+  std::vector<SpoolJobInfo> ProgressOf(int key);
+  // Job id |key| resolved to, 0 if none.
+  int ResolvedJob(int key);
+  // Keys that got more than one done callback.
+  int repeated_done();
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::map<int, int> resolved_;
+  std::map<int, std::vector<SpoolJobInfo>> progress_;
+  std::map<int, SpoolOutcome> outcomes_;
+  int repeated_done_ = 0;
+};
+
+#endif  // FLUTTER_FAKE_SPOOLER_H_
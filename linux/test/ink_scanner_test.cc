@@ -0,0 +1,223 @@
+#include "ink_scanner.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const kPaths[] = {"scalar", "sse2", "avx2"};
+
+// Restores the detected path when a test is done forcing one.
+class ScopedScanPath {
+ public:
+  ScopedScanPath() : detected_(InkScannerPath()) {}
+  ~ScopedScanPath() { SetInkScannerPath(detected_.c_str()); }
+
+  // Prevent copying.
+  ScopedScanPath(ScopedScanPath const&) = delete;
+  ScopedScanPath& operator=(ScopedScanPath const&) = delete;
+
+ private:
+  std::string detected_;
+};
+
+// The paths this CPU can run, narrowest first.
+std::vector<const char*> SupportedPaths() {
+  ScopedScanPath restore;
+  std::vector<const char*> paths;
+  for (const char* path : kPaths) {
+    if (SetInkScannerPath(path)) paths.push_back(path);
+  }
+  return paths;
+}
+
+int BytesPerPixel(cairo_format_t format) {
+  return format == CAIRO_FORMAT_A8 ? 1 : 4;
+}
+
+// The definition from ink_scanner.h, one pixel at a time.
+bool ReferenceHasInk(const std::vector<unsigned char>& data, int offset, int stride, int width,
+                     int height, cairo_format_t format) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const unsigned char* p = &data[offset + (size_t)y * stride + x * BytesPerPixel(format)];
+      if (format == CAIRO_FORMAT_A8) {
+        if (*p != 0) return true;
+      } else if (format == CAIRO_FORMAT_RGB24) {
+        if (p[0] != 0xFF || p[1] != 0xFF || p[2] != 0xFF) return true;
+      } else {
+        uint32_t pixel;
+        memcpy(&pixel, p, sizeof(pixel));
+        if (pixel != 0 && pixel != 0xFFFFFFFF) return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ReferenceHasChroma(const std::vector<unsigned char>& data, int offset, int stride,
+                        int width, int height, int tolerance) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const unsigned char* p = &data[offset + (size_t)y * stride + x * 4];
+      if (std::abs(p[0] - p[1]) > tolerance || std::abs(p[1] - p[2]) > tolerance ||
+          std::abs(p[0] - p[2]) > tolerance) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// A clean block: white RGB24 with random unused alpha bytes, transparent or
+// opaque white ARGB32, zero A8. The padding after every row is full of ink
+// that must never be read.
+std::vector<unsigned char> CleanBlock(cairo_format_t format, int offset, int stride, int width,
+                                      int height, std::mt19937* random) {
+  std::vector<unsigned char> data(offset + (size_t)stride * height + 64, 0x5A);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      unsigned char* p = &data[offset + (size_t)y * stride + x * BytesPerPixel(format)];
+      if (format == CAIRO_FORMAT_A8) {
+        *p = 0;
+      } else if (format == CAIRO_FORMAT_RGB24) {
+        p[0] = p[1] = p[2] = 0xFF;
+        p[3] = (unsigned char)(*random)();
+      } else {
+        memset(p, (*random)() % 2 ? 0xFF : 0x00, 4);
+      }
+    }
+  }
+  return data;
+}
+
+class InkScannerTest : public ::testing::TestWithParam<const char*> {
+ protected:
+  void SetUp() override {
+    if (!SetInkScannerPath(GetParam())) GTEST_SKIP() << GetParam() << " not supported here";
+  }
+
+  ScopedScanPath restore_;
+};
+
+// Every width around the vector sizes, unaligned rows, and one ink pixel at
+// every position including the scalar tail.
+TEST_P(InkScannerTest, MatchesPixelDefinition) {
+  std::mt19937 random(7);
+  const cairo_format_t formats[] = {CAIRO_FORMAT_RGB24, CAIRO_FORMAT_ARGB32, CAIRO_FORMAT_A8};
+  for (cairo_format_t format : formats) {
+    for (int width = 1; width <= 70; width++) {
+      int offset = width % 5;
+      int stride = width * BytesPerPixel(format) + 3;
+      int height = 3;
+      SCOPED_TRACE("format " + std::to_string(format) + " width " + std::to_string(width));
+      std::vector<unsigned char> clean = CleanBlock(format, offset, stride, width, height, &random);
+      ASSERT_FALSE(RegionHasInk(&clean[offset], stride, width, height, format));
+
+      for (int x = 0; x < width; x++) {
+        std::vector<unsigned char> data = clean;
+        unsigned char* p = &data[offset + (size_t)stride + x * BytesPerPixel(format)];
+        if (format == CAIRO_FORMAT_A8) {
+          *p = 1 + random() % 255;
+        } else if (format == CAIRO_FORMAT_RGB24) {
+          p[random() % 3] = 0xFE;
+        } else {
+          // Neither transparent nor opaque white: a grey, or white with
+          // some alpha.
+          if (random() % 2) {
+            memset(p, 0x80, 4);
+          } else {
+            p[3] = 0xFE;
+          }
+        }
+        ASSERT_EQ(RegionHasInk(&data[offset], stride, width, height, format),
+                  ReferenceHasInk(data, offset, stride, width, height, format))
+            << "ink at " << x;
+        ASSERT_TRUE(RegionHasInk(&data[offset], stride, width, height, format)) << "ink at " << x;
+      }
+    }
+  }
+}
+
+TEST_P(InkScannerTest, ChromaMatchesPixelDefinition) {
+  std::mt19937 random(11);
+  for (int width = 1; width <= 40; width++) {
+    for (int tolerance : {0, 1, 16, 40, 254, 255, 300}) {
+      int offset = width % 3;
+      int stride = width * 4 + 8;
+      std::vector<unsigned char> data(offset + (size_t)stride * 2 + 64, 0);
+      // Grey pixels with channels up to |spread| apart, so results sit on
+      // both sides of the tolerance.
+      int spread = 1 + (int)(random() % 64);
+      for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < width; x++) {
+          unsigned char* p = &data[offset + (size_t)y * stride + x * 4];
+          int base = (int)(random() % (256 - spread));
+          for (int c = 0; c < 3; c++) p[c] = (unsigned char)(base + random() % (spread + 1));
+          p[3] = (unsigned char)random();
+        }
+      }
+      int clamped = std::min(tolerance, 255);
+      ASSERT_EQ(RegionHasChroma(&data[offset], stride, width, 2, tolerance),
+                ReferenceHasChroma(data, offset, stride, width, 2, clamped))
+          << "width " << width << " tolerance " << tolerance;
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(AllPaths, InkScannerTest, ::testing::ValuesIn(kPaths),
+                         [](const ::testing::TestParamInfo<const char*>& info) {
+                           return std::string(info.param);
+                         });
+
+TEST(InkScannerPathTest, UnknownOrUnsupportedPathIsRefused) {
+  ScopedScanPath restore;
+  std::string detected = InkScannerPath();
+  EXPECT_FALSE(SetInkScannerPath("neon"));
+  EXPECT_EQ(InkScannerPath(), detected);
+  EXPECT_TRUE(SetInkScannerPath("scalar"));
+  EXPECT_STREQ(InkScannerPath(), "scalar");
+}
+
+// A clean A4 page at 300 dpi is the worst case: every pixel is read. Prints
+// the throughput of each path; the SIMD paths must agree with scalar.
+TEST(InkScannerBenchmark, CleanA4PageAt300Dpi) {
+  constexpr int kWidth = 2480;
+  constexpr int kHeight = 3508;
+  constexpr int kStride = kWidth * 4;
+  constexpr int kRounds = 5;
+  std::vector<unsigned char> page((size_t)kStride * kHeight, 0xFF);
+
+  double scalarMs = 0.0;
+  for (const char* path : SupportedPaths()) {
+    ScopedScanPath restore;
+    ASSERT_TRUE(SetInkScannerPath(path));
+    double bestMs = 1e9;
+    for (int round = 0; round < kRounds; round++) {
+      auto start = std::chrono::steady_clock::now();
+      bool ink = RegionHasInk(page.data(), kStride, kWidth, kHeight, CAIRO_FORMAT_RGB24);
+      bool chroma = RegionHasChroma(page.data(), kStride, kWidth, kHeight, 8);
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                            start)
+                      .count();
+      ASSERT_FALSE(ink);
+      ASSERT_FALSE(chroma);
+      bestMs = std::min(bestMs, ms);
+    }
+    if (strcmp(path, "scalar") == 0) scalarMs = bestMs;
+    double megabytes = 2.0 * kStride * kHeight / (1024.0 * 1024.0);
+    printf("%-6s %7.2f ms  %8.0f MB/s  %.1fx scalar\n", path, bestMs, megabytes / bestMs * 1000.0,
+           scalarMs / bestMs);
+  }
+}
+
+}  // namespace
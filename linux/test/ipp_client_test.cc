@@ -0,0 +1,163 @@
+#include "ipp_client.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_ipp_printer.h"
+
+namespace {
+
+const char kPrinterUri[] = "ipp://printer.local:631/ipp/print";
+
+// Hands out |data| in reads of at most |step| bytes, so chunks come out
+// smaller than IppClient::kChunkSize too.
+IppDocumentReader ReadString(const std::string& data, size_t step) {
+  auto position = std::make_shared<size_t>(0);
+  return [data, step, position](uint8_t* buffer, size_t capacity) -> int64_t {
+    size_t count = std::min({capacity, step, data.size() - *position});
+    memcpy(buffer, data.data() + *position, count);
+    *position += count;
+    return (int64_t)count;
+  };
+}
+
+std::string TestDocument(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; i++) data[i] = (char)(i * 131 + i / 977);
+  return data;
+}
+
+class IppClientTest : public ::testing::Test {
+ protected:
+  IppClientTest()
+      : printer_(std::make_shared<FakeIppPrinter>()), client_(printer_->NewConnector(), "kasir") {}
+
+  bool PrinterAttributes(std::string* error) {
+    IppMessage response;
+    return client_.GetPrinterAttributes(kPrinterUri, {"printer-state"}, &response, error) &&
+           response.ok();
+  }
+
+  std::shared_ptr<FakeIppPrinter> printer_;
+  IppClient client_;
+};
+
+TEST_F(IppClientTest, RequestsShareOneKeepAliveConnection) {
+  std::string error;
+  for (int i = 0; i < 10; i++) ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  int jobId = 0;
+  ASSERT_TRUE(client_.PrintJob(kPrinterUri, "Struk", "application/pdf", {},
+                               ReadString("%PDF-1.4", 8), &jobId, &error))
+      << error;
+
+  EXPECT_EQ(printer_->connections_opened(), 1);
+  IppClientStats stats = client_.stats();
+  EXPECT_EQ(stats.requests, 11);
+  EXPECT_EQ(stats.connectionsOpened, 1);
+  EXPECT_EQ(stats.connectionsReused, 10);
+  for (const FakeIppPrinter::Request& request : printer_->requests()) {
+    EXPECT_EQ(request.connection, 1);
+  }
+}
+
+// A printer that dropped the idle connection without the client noticing:
+// the request goes out on the stale connection, gets no answer, and is
+// repeated once on a new one.
+TEST_F(IppClientTest, StaleConnectionIsRetriedOnANewOne) {
+  std::string error;
+  ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  printer_->CloseIdleConnections(false);
+
+  ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  EXPECT_EQ(printer_->connections_opened(), 2);
+  std::vector<FakeIppPrinter::Request> requests = printer_->requests();
+  ASSERT_EQ(requests.size(), 2u);
+  EXPECT_EQ(requests[1].connection, 2);
+
+  // The new connection is kept in turn.
+  ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  EXPECT_EQ(printer_->connections_opened(), 2);
+}
+
+TEST_F(IppClientTest, ClosedIdleConnectionIsNotUsed) {
+  std::string error;
+  ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  printer_->CloseIdleConnections(true);
+
+  ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  EXPECT_EQ(printer_->connections_opened(), 2);
+  EXPECT_EQ(client_.stats().connectionsReused, 0);
+}
+
+// Document data may already have been consumed from the reader, so a request
+// with a document is never repeated.
+TEST_F(IppClientTest, RequestWithDocumentIsNotRetried) {
+  std::string error;
+  ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  printer_->CloseIdleConnections(false);
+
+  int jobId = 0;
+  EXPECT_FALSE(client_.PrintJob(kPrinterUri, "Struk", "application/pdf", {},
+                                ReadString("%PDF-1.4", 8), &jobId, &error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_EQ(printer_->connections_opened(), 1);
+  EXPECT_EQ(printer_->requests().size(), 1u);
+}
+
+TEST_F(IppClientTest, ConnectionCloseIsHonoured) {
+  printer_->set_close_after_response(true);
+  std::string error;
+  for (int i = 0; i < 3; i++) ASSERT_TRUE(PrinterAttributes(&error)) << error;
+  EXPECT_EQ(printer_->connections_opened(), 3);
+  EXPECT_EQ(client_.stats().connectionsReused, 0);
+}
+
+// Several chunks, the last one short, arrive byte for byte.
+TEST_F(IppClientTest, ChunkedDocumentArrivesIntact) {
+  for (size_t step : {IppClient::kChunkSize, (size_t)1000}) {
+    std::string data = TestDocument(IppClient::kChunkSize * 3 + 12345);
+    std::string error;
+    int jobId = 0;
+    ASSERT_TRUE(client_.PrintJob(kPrinterUri, "Laporan", "application/pdf", {},
+                                 ReadString(data, step), &jobId, &error))
+        << error;
+    FakeIppPrinter::Job job;
+    ASSERT_TRUE(printer_->FindJob(jobId, &job));
+    EXPECT_EQ(job.name, "Laporan");
+    ASSERT_EQ(job.documents.size(), 1u);
+    EXPECT_TRUE(job.documents[0] == data) << "step " << step;
+    EXPECT_TRUE(job.complete);
+  }
+  EXPECT_EQ(printer_->connections_opened(), 1);
+}
+
+TEST_F(IppClientTest, ConcurrentRequestsEachGetAnAnswer) {
+  constexpr int kThreads = 4;
+  constexpr int kRequests = 50;
+  std::vector<std::thread> threads;
+  std::vector<int> failures(kThreads, 0);
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t, &failures] {
+      for (int i = 0; i < kRequests; i++) {
+        std::string error;
+        if (!PrinterAttributes(&error)) failures[t]++;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (int t = 0; t < kThreads; t++) EXPECT_EQ(failures[t], 0) << "thread " << t;
+
+  IppClientStats stats = client_.stats();
+  EXPECT_EQ(stats.requests, kThreads * kRequests);
+  EXPECT_EQ(stats.connectionsOpened + stats.connectionsReused, kThreads * kRequests);
+  EXPECT_EQ(printer_->connections_opened(), stats.connectionsOpened);
+  EXPECT_GT(stats.connectionsReused, 0);
+}
+
+}  // namespace
@@ -0,0 +1,210 @@
+#include "ipp_job_pipeline.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_ipp_printer.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+const char kPrinterUri[] = "ipp://printer.local:631/ipp/print";
+
+class IppJobPipelineTest : public ::testing::Test {
+ protected:
+  IppJobPipelineTest()
+      : printer_(std::make_shared<FakeIppPrinter>()), client_(printer_->NewConnector(), "kasir") {}
+
+  void TearDown() override {
+    std::error_code ec;
+    for (const std::string& path : files_) std::filesystem::remove(path, ec);
+  }
+
+  // A document file the pipeline will own.
+  std::string WriteDocument(const std::string& content) {
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("ipp_pipeline_" + std::to_string(files_.size()) + "_" +
+                         std::to_string((uintptr_t)this) + ".pdf"))
+                           .string();
+    std::ofstream(path, std::ios::binary) << content;
+    files_.push_back(path);
+    return path;
+  }
+
+  static bool Exists(const std::string& path) { return std::filesystem::exists(path); }
+
+  std::vector<FakeIppPrinter::Request> RequestsFor(uint16_t operation) {
+    std::vector<FakeIppPrinter::Request> matching;
+    for (const FakeIppPrinter::Request& request : printer_->requests()) {
+      if (request.operation == operation) matching.push_back(request);
+    }
+    return matching;
+  }
+
+  // Waits until the printer has received |count| Send-Document requests.
+  bool WaitForDocuments(size_t count) {
+    auto deadline = std::chrono::steady_clock::now() + milliseconds(2000);
+    while (RequestsFor(kIppSendDocument).size() < count) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+  }
+
+  std::shared_ptr<FakeIppPrinter> printer_;
+  IppClient client_;
+  std::vector<std::string> files_;
+};
+
+TEST_F(IppJobPipelineTest, DocumentsGoOutAsOneJobInOrder) {
+  const std::vector<std::string> contents = {"invoice", "separator", "attachment"};
+  std::string error;
+  IppJobPipeline pipeline(&client_, kPrinterUri, "application/pdf");
+  ASSERT_TRUE(pipeline.Begin("Transaksi 42", {}, &error)) << error;
+  std::vector<std::string> paths;
+  for (const std::string& content : contents) {
+    paths.push_back(WriteDocument(content));
+    ASSERT_TRUE(pipeline.Add(paths.back(), &error)) << error;
+  }
+  ASSERT_TRUE(pipeline.Finish(&error)) << error;
+
+  FakeIppPrinter::Job job;
+  ASSERT_TRUE(printer_->FindJob(pipeline.job_id(), &job));
+  EXPECT_EQ(job.name, "Transaksi 42");
+  EXPECT_EQ(job.documents, contents);
+  EXPECT_TRUE(job.complete);
+  EXPECT_FALSE(job.canceled);
+
+  // last-document is set on exactly the final request.
+  std::vector<FakeIppPrinter::Request> sends = RequestsFor(kIppSendDocument);
+  ASSERT_FALSE(sends.empty());
+  for (size_t i = 0; i < sends.size(); i++) {
+    EXPECT_EQ(sends[i].jobId, pipeline.job_id());
+    EXPECT_EQ(sends[i].lastDocument, i + 1 == sends.size()) << "request " << i;
+  }
+  for (const std::string& path : paths) EXPECT_FALSE(Exists(path)) << path;
+  EXPECT_EQ(pipeline.stats().documentsSent, 3);
+  EXPECT_EQ(RequestsFor(kIppCancelJob).size(), 0u);
+}
+
+// The only document went out before Finish, so it could not be marked last;
+// an empty Send-Document closes the job.
+TEST_F(IppJobPipelineTest, FinishAfterUploadSendsClosingDocument) {
+  std::string error;
+  IppJobPipeline pipeline(&client_, kPrinterUri, "application/pdf");
+  ASSERT_TRUE(pipeline.Begin("Struk", {}, &error)) << error;
+  ASSERT_TRUE(pipeline.Add(WriteDocument("receipt"), &error)) << error;
+  ASSERT_TRUE(WaitForDocuments(1));
+  ASSERT_TRUE(pipeline.Finish(&error)) << error;
+
+  std::vector<FakeIppPrinter::Request> sends = RequestsFor(kIppSendDocument);
+  ASSERT_EQ(sends.size(), 2u);
+  EXPECT_FALSE(sends[0].lastDocument);
+  EXPECT_TRUE(sends[1].lastDocument);
+  EXPECT_EQ(sends[1].documentBytes, 0u);
+  FakeIppPrinter::Job job;
+  ASSERT_TRUE(printer_->FindJob(pipeline.job_id(), &job));
+  EXPECT_EQ(job.documents, std::vector<std::string>{"receipt"});
+  EXPECT_TRUE(job.complete);
+}
+
+// A pipeline dropped without Finish, with documents still queued behind a
+// slow upload: the rest is not sent, the files are deleted and the job is
+// canceled rather than left open on the printer.
+TEST_F(IppJobPipelineTest, AbandonedPipelineCancelsTheJob) {
+  printer_->set_document_delay(milliseconds(50));
+  std::vector<std::string> paths;
+  int jobId = 0;
+  {
+    std::string error;
+    IppJobPipeline pipeline(&client_, kPrinterUri, "application/pdf");
+    ASSERT_TRUE(pipeline.Begin("Struk", {}, &error)) << error;
+    jobId = pipeline.job_id();
+    for (int i = 0; i < 4; i++) {
+      paths.push_back(WriteDocument("page " + std::to_string(i)));
+      ASSERT_TRUE(pipeline.Add(paths.back(), &error)) << error;
+    }
+    ASSERT_TRUE(WaitForDocuments(1));
+  }
+
+  EXPECT_LT(RequestsFor(kIppSendDocument).size(), paths.size());
+  std::vector<FakeIppPrinter::Request> cancels = RequestsFor(kIppCancelJob);
+  ASSERT_EQ(cancels.size(), 1u);
+  EXPECT_EQ(cancels[0].jobId, jobId);
+  FakeIppPrinter::Job job;
+  ASSERT_TRUE(printer_->FindJob(jobId, &job));
+  EXPECT_TRUE(job.canceled);
+  EXPECT_FALSE(job.complete);
+  for (const std::string& path : paths) EXPECT_FALSE(Exists(path)) << path;
+}
+
+TEST_F(IppJobPipelineTest, FailedUploadFailsTheJob) {
+  printer_->set_fail_send_document(2);
+  std::vector<std::string> paths;
+  int jobId = 0;
+  {
+    std::string error;
+    IppJobPipeline pipeline(&client_, kPrinterUri, "application/pdf");
+    ASSERT_TRUE(pipeline.Begin("Struk", {}, &error)) << error;
+    jobId = pipeline.job_id();
+    for (int i = 0; i < 2; i++) {
+      paths.push_back(WriteDocument("page " + std::to_string(i)));
+      ASSERT_TRUE(pipeline.Add(paths.back(), &error)) << error;
+    }
+    ASSERT_TRUE(WaitForDocuments(2));
+    EXPECT_FALSE(pipeline.Finish(&error));
+    EXPECT_FALSE(error.empty());
+
+    // Later documents are refused and deleted.
+    paths.push_back(WriteDocument("page 2"));
+    error.clear();
+    EXPECT_FALSE(pipeline.Add(paths.back(), &error));
+    EXPECT_FALSE(error.empty());
+  }
+
+  EXPECT_EQ(RequestsFor(kIppSendDocument).size(), 2u);
+  EXPECT_EQ(RequestsFor(kIppCancelJob).size(), 1u);
+  FakeIppPrinter::Job job;
+  ASSERT_TRUE(printer_->FindJob(jobId, &job));
+  EXPECT_TRUE(job.canceled);
+  for (const std::string& path : paths) EXPECT_FALSE(Exists(path)) << path;
+}
+
+// Rendering and uploading take about as long each; with the pipeline the
+// upload of one document overlaps the rendering of the next, so the job
+// takes well under the serial sum. Prints the times.
+TEST_F(IppJobPipelineTest, UploadOverlapsProduction) {
+  constexpr int kDocuments = 6;
+  constexpr milliseconds kStep(30);
+  printer_->set_document_delay(kStep);
+
+  std::string error;
+  auto start = std::chrono::steady_clock::now();
+  IppJobPipeline pipeline(&client_, kPrinterUri, "application/pdf");
+  ASSERT_TRUE(pipeline.Begin("Laporan", {}, &error)) << error;
+  for (int i = 0; i < kDocuments; i++) {
+    std::this_thread::sleep_for(kStep);
+    ASSERT_TRUE(pipeline.Add(WriteDocument("page " + std::to_string(i)), &error)) << error;
+  }
+  ASSERT_TRUE(pipeline.Finish(&error)) << error;
+  double ms =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  IppPipelineStats stats = pipeline.stats();
+  double serialMs = 2.0 * kDocuments * kStep.count();
+  printf("%d documents: %.0f ms pipelined, %.0f ms serial; upload %.0f ms, idle %.0f ms\n",
+         kDocuments, ms, serialMs, stats.uploadMs, stats.idleMs);
+  EXPECT_EQ(stats.documentsSent, kDocuments);
+  EXPECT_LT(ms, serialMs * 0.85);
+}
+
+}  // namespace
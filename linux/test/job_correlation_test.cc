@@ -0,0 +1,190 @@
+#include "job_correlation.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_spooler.h"
+#include "spool_watcher.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+TEST(JobCorrelationTest, TagsAreUniqueAcrossThreads) {
+  std::mutex mutex;
+  std::set<std::string> tags;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&] {
+      std::vector<std::string> mine;
+      for (int i = 0; i < 500; i++) mine.push_back(NewDocumentTag());
+      std::lock_guard<std::mutex> lock(mutex);
+      tags.insert(mine.begin(), mine.end());
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(tags.size(), 8u * 500u);
+
+  std::string found;
+  for (const std::string& tag : tags) {
+    ASSERT_TRUE(ExtractDocumentTag(TagDocumentName("Invoice INV-001", tag), &found));
+    ASSERT_EQ(found, tag);
+  }
+}
+
+TEST(JobCorrelationTest, TagIsFoundInSubmitterDocumentNames) {
+  std::string tag = NewDocumentTag();
+  std::string found;
+  for (const std::string& name :
+       {"C:\\Users\\kasir\\AppData\\Local\\Temp\\" + tag + ".pdf", "/tmp/" + tag + ".pdf",
+        TagDocumentName("Struk", tag), "hla-x " + tag}) {
+    found.clear();
+    EXPECT_TRUE(ExtractDocumentTag(name, &found)) << name;
+    EXPECT_EQ(found, tag) << name;
+  }
+
+  // "-1" must not be taken for "-12".
+  std::string longer = tag + "2";
+  ASSERT_TRUE(ExtractDocumentTag("/tmp/" + longer + ".pdf", &found));
+  EXPECT_EQ(found, longer);
+
+  for (const char* name : {"Microsoft Word - Laporan.docx", "hla-", "hla-0123abc-1",
+                           "hla-0123abcd-", "hla-0123ABCD-1", "hla-0123abcd_1"}) {
+    EXPECT_FALSE(ExtractDocumentTag(name, &found)) << name;
+  }
+}
+
+TEST(JobCorrelationTest, IndexKeepsEachSpoolerJobOnce) {
+  JobCorrelationIndex index;
+  std::vector<SpoolJobRef> jobs;
+  EXPECT_FALSE(index.Lookup(1, &jobs));
+
+  index.Record(1, "Kasir", 10);
+  index.Record(1, "Kasir", 10);
+  index.Record(1, "Kasir", 11);
+  index.Record(1, "Gudang", 10);
+  ASSERT_TRUE(index.Lookup(1, &jobs));
+  ASSERT_EQ(jobs.size(), 3u);
+  EXPECT_EQ(jobs[0].queue, "Kasir");
+  EXPECT_EQ(jobs[0].jobId, 10);
+  EXPECT_EQ(jobs[2].queue, "Gudang");
+
+  index.Forget(1);
+  EXPECT_FALSE(index.Lookup(1, &jobs));
+}
+
+// Hundreds of tagged documents submitted in random order on shared printers,
+// between jobs of other programs with ids handed out across all queues, as
+// on a busy CUPS server. Every print job must end up with exactly the
+// spooler job its document became.
+TEST(JobCorrelationTest, InterleavedJobsMapToTheirOwnSpoolerJobs) {
+  constexpr int kDocuments = 300;
+  constexpr int kForeignJobs = 300;
+  const std::vector<std::string> queues = {"Kasir", "Gudang", "Dapur", "Bar"};
+
+  struct Document {
+    std::string queue;
+    std::string name;
+    std::vector<int> printJobIds;
+  };
+  std::vector<Document> documents;
+  int nextPrintJobId = 1;
+  for (int i = 0; i < kDocuments; i++) {
+    Document document;
+    document.queue = queues[i % queues.size()];
+    std::string tag = NewDocumentTag();
+    // Every third document goes through an external submitter that names
+    // the job after the file.
+    document.name = i % 3 == 0 ? "/tmp/hlaprint/" + tag + ".pdf"
+                               : TagDocumentName("Invoice " + std::to_string(i), tag);
+    // Every fifth is a batch: two print jobs spooled as one document.
+    document.printJobIds.push_back(nextPrintJobId++);
+    if (i % 5 == 0) document.printJobIds.push_back(nextPrintJobId++);
+    documents.push_back(document);
+  }
+
+  auto spooler = std::make_shared<FakeSpooler>();
+  JobCorrelationIndex index;
+  WatchRecorder recorder;
+  {
+    SpoolWatcher watcher(spooler->NewBackend());
+    for (int i = 0; i < kDocuments; i++) {
+      const Document& document = documents[i];
+      std::string tag;
+      ASSERT_TRUE(ExtractDocumentTag(document.name, &tag));
+      SpoolWatcher::ResolvedCallback resolved = recorder.Resolved(i);
+      watcher.WatchDocument(
+          document.queue, tag, 1,
+          [&index, &document, resolved](int jobId) {
+            for (int printJobId : document.printJobIds) {
+              index.Record(printJobId, document.queue, jobId);
+            }
+            resolved(jobId);
+          },
+          recorder.Progress(i), recorder.Done(i));
+    }
+
+    // Four submitters, each with its share of our documents and of foreign
+    // jobs, shuffled.
+    std::vector<std::thread> submitters;
+    for (int s = 0; s < 4; s++) {
+      submitters.emplace_back([&, s] {
+        std::vector<int> work;
+        for (int i = s; i < kDocuments; i += 4) work.push_back(i);
+        for (int i = s; i < kForeignJobs; i += 4) work.push_back(-1 - i);
+        std::shuffle(work.begin(), work.end(), std::mt19937(s));
+        for (int item : work) {
+          if (item >= 0) {
+            spooler->Submit(documents[item].queue, documents[item].name, 1);
+          } else {
+            int foreign = -1 - item;
+            spooler->Submit(queues[foreign % queues.size()],
+                            foreign % 2 ? "Microsoft Word - Laporan " + std::to_string(foreign)
+                                        : "hla-report-" + std::to_string(foreign) + ".pdf",
+                            2);
+          }
+        }
+      });
+    }
+    for (auto& submitter : submitters) submitter.join();
+    for (int i = 0; i < kDocuments; i++) {
+      ASSERT_TRUE(recorder.WaitResolved(i, milliseconds(2000))) << "document " << i;
+    }
+
+    for (const std::string& queue : queues) {
+      for (int job : spooler->Jobs(queue)) spooler->Complete(queue, job);
+    }
+    ASSERT_TRUE(recorder.WaitDone(kDocuments, milliseconds(5000)));
+  }
+
+  std::set<std::pair<std::string, int>> claimed;
+  for (int i = 0; i < kDocuments; i++) {
+    const Document& document = documents[i];
+    int jobId = recorder.ResolvedJob(i);
+    EXPECT_EQ(spooler->DocumentName(document.queue, jobId), document.name) << "document " << i;
+    EXPECT_TRUE(claimed.emplace(document.queue, jobId).second) << "job claimed twice";
+
+    SpoolOutcome outcome;
+    ASSERT_TRUE(recorder.Outcome(i, &outcome));
+    EXPECT_TRUE(outcome.success);
+    for (int printJobId : document.printJobIds) {
+      std::vector<SpoolJobRef> jobs;
+      ASSERT_TRUE(index.Lookup(printJobId, &jobs));
+      ASSERT_EQ(jobs.size(), 1u);
+      EXPECT_EQ(jobs[0].queue, document.queue);
+      EXPECT_EQ(jobs[0].jobId, jobId);
+    }
+  }
+  EXPECT_EQ(recorder.repeated_done(), 0);
+}
+
+}  // namespace
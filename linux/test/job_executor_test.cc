@@ -0,0 +1,191 @@
+#include "job_executor.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_spooler.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// Blocks jobs until the test opens it.
+class Gate {
+ public:
+  void Open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = true;
+    changed_.notify_all();
+  }
+
+  bool Pass(milliseconds timeout = milliseconds(5000)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, timeout, [this] { return open_; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool open_ = false;
+};
+
+// Jobs spool into a FakeSpooler under their key as the queue, with the
+// handle as the document name, so the spooler sees what a printer would.
+class JobExecutorTest : public ::testing::Test {
+ protected:
+  JobExecutorTest() : spooler_(std::make_shared<FakeSpooler>()) {}
+
+  JobExecutor::Job Spool(const std::string& key, int pages = 1) {
+    return [this, key, pages](int handle) {
+      int running = ++running_[key];
+      EXPECT_EQ(running, 1) << key << " ran two jobs at once";
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      spooler_->Submit(key, std::to_string(handle), pages);
+      --running_[key];
+      ran_++;
+    };
+  }
+
+  // Handles in the order |key|'s jobs reached the spooler.
+  std::vector<int> Spooled(const std::string& key) {
+    std::vector<int> handles;
+    for (int job : spooler_->Jobs(key)) handles.push_back(std::stoi(spooler_->DocumentName(key, job)));
+    return handles;
+  }
+
+  std::shared_ptr<FakeSpooler> spooler_;
+  std::map<std::string, std::atomic<int>> running_;
+  std::atomic<int> ran_{0};
+};
+
+TEST_F(JobExecutorTest, SubmitReturnsBeforeTheJobRuns) {
+  Gate gate;
+  JobExecutor executor(1);
+  std::atomic<int> started{0};
+  int first = executor.Submit("Kasir", [&](int) {
+    started++;
+    gate.Pass();
+  });
+  int second = executor.Submit("Kasir", [&](int) { started++; });
+  EXPECT_GT(first, 0);
+  EXPECT_GT(second, first);
+
+  // The first job holds the only worker; the second waits its turn.
+  while (started == 0) std::this_thread::sleep_for(milliseconds(1));
+  EXPECT_EQ(executor.pending(), 1u);
+  gate.Open();
+  while (executor.pending() > 0 || started < 2) std::this_thread::sleep_for(milliseconds(1));
+  EXPECT_EQ(started.load(), 2);
+}
+
+TEST_F(JobExecutorTest, JobsOfOnePrinterKeepTheirOrder) {
+  running_["Kasir"] = 0;
+  std::vector<int> handles;
+  {
+    JobExecutor executor(4);
+    for (int i = 0; i < 40; i++) handles.push_back(executor.Submit("Kasir", Spool("Kasir")));
+    while (ran_ < 40) std::this_thread::sleep_for(milliseconds(1));
+  }
+  EXPECT_EQ(Spooled("Kasir"), handles);
+}
+
+TEST_F(JobExecutorTest, DifferentPrintersRunInParallel) {
+  // Each job waits for the other two to start; that only succeeds if the
+  // three keys run at the same time.
+  std::mutex mutex;
+  std::condition_variable changed;
+  int started = 0;
+  int finished = 0;
+  int together = 0;
+  auto job = [&](int) {
+    std::unique_lock<std::mutex> lock(mutex);
+    started++;
+    changed.notify_all();
+    if (changed.wait_for(lock, milliseconds(5000), [&] { return started == 3; })) together++;
+    finished++;
+    changed.notify_all();
+  };
+
+  JobExecutor executor(3);
+  executor.Submit("Kasir", job);
+  executor.Submit("Gudang", job);
+  executor.Submit("Dapur", job);
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(changed.wait_for(lock, milliseconds(10000), [&] { return finished == 3; }));
+  EXPECT_EQ(together, 3);
+}
+
+TEST_F(JobExecutorTest, DestructorDiscardsQueuedJobs) {
+  Gate gate;
+  std::atomic<int> started{0};
+  auto executor = std::make_unique<JobExecutor>(1);
+  executor->Submit("Kasir", [&](int) {
+    started++;
+    gate.Pass();
+  });
+  for (int i = 0; i < 5; i++) executor->Submit("Kasir", [&](int) { started++; });
+  while (started == 0) std::this_thread::sleep_for(milliseconds(1));
+
+  std::thread opener([&] {
+    std::this_thread::sleep_for(milliseconds(20));
+    gate.Open();
+  });
+  // Waits for the running job, drops the rest.
+  executor.reset();
+  opener.join();
+  EXPECT_EQ(started.load(), 1);
+}
+
+// Several threads submitting to ten printers at once, the way batches from
+// the UI arrive.
+TEST_F(JobExecutorTest, ConcurrentSubmittersKeepPerPrinterOrder) {
+  constexpr int kPrinters = 10;
+  constexpr int kSubmitters = 4;
+  constexpr int kJobsEach = 100;
+  std::vector<std::string> printers;
+  for (int p = 0; p < kPrinters; p++) {
+    printers.push_back("Printer " + std::to_string(p));
+    running_[printers.back()] = 0;
+  }
+
+  std::mutex mutex;
+  std::map<std::string, std::vector<int>> submitted;
+  std::vector<int> handles;
+  {
+    JobExecutor executor(6);
+    std::vector<std::thread> submitters;
+    for (int s = 0; s < kSubmitters; s++) {
+      submitters.emplace_back([&, s] {
+        for (int i = 0; i < kJobsEach; i++) {
+          const std::string& key = printers[(s * 7 + i) % kPrinters];
+          // Submitting under the lock keeps |submitted| in handle order.
+          std::lock_guard<std::mutex> lock(mutex);
+          int handle = executor.Submit(key, Spool(key));
+          submitted[key].push_back(handle);
+          handles.push_back(handle);
+        }
+      });
+    }
+    for (auto& submitter : submitters) submitter.join();
+    while (ran_ < kSubmitters * kJobsEach) std::this_thread::sleep_for(milliseconds(1));
+    EXPECT_EQ(executor.pending(), 0u);
+  }
+
+  std::sort(handles.begin(), handles.end());
+  EXPECT_EQ(std::unique(handles.begin(), handles.end()), handles.end()) << "handle reused";
+  for (const std::string& printer : printers) {
+    EXPECT_EQ(Spooled(printer), submitted[printer]) << printer;
+  }
+}
+
+}  // namespace
@@ -0,0 +1,214 @@
+#include "margin_analyzer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ink_scanner.h"
+#include "test_documents.h"
+
+namespace {
+
+// The analyzer's margin strips, one pixel per point.
+struct Strip {
+  int x0, y0, x1, y1;
+};
+
+// What HasContentInMargins replaced: the whole page rasterized at one pixel
+// per point and every margin strip scanned. Slow but obviously right.
+bool FullRasterHasContent(PopplerPage* page, const MarginBox& margins) {
+  double pdfW = 0, pdfH = 0;
+  poppler_page_get_size(page, &pdfW, &pdfH);
+  int w = (int)pdfW;
+  int h = (int)pdfH;
+  int left = std::min((int)margins.left, w);
+  int top = std::min((int)margins.top, h);
+  int right = std::min((int)margins.right, w);
+  int bottom = std::min((int)margins.bottom, h);
+  const Strip strips[4] = {
+      {0, 0, left, h}, {0, 0, w, top}, {w - right, 0, w, h}, {0, h - bottom, w, h}};
+
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+  cairo_t* cr = cairo_create(surface);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  poppler_page_render(page, cr);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+
+  unsigned char* data = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  bool hasContent = false;
+  for (const Strip& strip : strips) {
+    if (strip.x1 <= strip.x0 || strip.y1 <= strip.y0) continue;
+    if (RegionHasInk(data + strip.y0 * stride + strip.x0 * 4, stride, strip.x1 - strip.x0,
+                     strip.y1 - strip.y0, CAIRO_FORMAT_RGB24)) {
+      hasContent = true;
+      break;
+    }
+  }
+  cairo_surface_destroy(surface);
+  return hasContent;
+}
+
+void FillRect(cairo_t* cr, double x, double y, double w, double h) {
+  cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+  cairo_rectangle(cr, x, y, w, h);
+  cairo_fill(cr);
+}
+
+// One page of the corpus and whether it has ink in kMargins.
+struct CorpusPage {
+  const char* name;
+  TestPage page;
+  bool inkInMargins;
+};
+
+const MarginBox kMargins = {12.0, 12.0, 12.0, 12.0};
+
+std::vector<CorpusPage> Corpus() {
+  std::vector<CorpusPage> corpus;
+  auto add = [&corpus](const char* name, bool inkInMargins, std::function<void(cairo_t*)> draw,
+                       bool landscape = false) {
+    TestPage page;
+    if (landscape) std::swap(page.width, page.height);
+    page.draw = std::move(draw);
+    corpus.push_back({name, page, inkInMargins});
+  };
+
+  add("blank", false, nullptr);
+  add("centered block", false, [](cairo_t* cr) { FillRect(cr, 30, 40, 84, 136); });
+  add("block touching the safe area", false, [](cairo_t* cr) { FillRect(cr, 12, 12, 120, 192); });
+  add("marker", true, MarkerPage(3).draw);
+  add("left bar", true, [](cairo_t* cr) { FillRect(cr, 2, 80, 4, 40); });
+  add("right bar", true, [](cairo_t* cr) { FillRect(cr, 138, 80, 4, 40); });
+  add("bottom bar", true, [](cairo_t* cr) { FillRect(cr, 40, 208, 60, 4); });
+  add("top hairline", true, [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_set_line_width(cr, 0.3);
+    cairo_move_to(cr, 30, 5.5);
+    cairo_line_to(cr, 110, 5.5);
+    cairo_stroke(cr);
+  });
+  add("pale grey in margin", true, [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.93, 0.93, 0.93);
+    cairo_rectangle(cr, 134, 20, 8, 8);
+    cairo_fill(cr);
+  });
+  add("white box in margin", false, [](cairo_t* cr) {
+    FillRect(cr, 30, 40, 84, 136);
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_rectangle(cr, 0, 0, 144, 10);
+    cairo_fill(cr);
+  });
+  // The curve's control points lie in the left margin, so its extents do,
+  // but the curve itself stays out.
+  add("curve bulging toward the margin", false, [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.2, 0.4, 0.2);
+    cairo_move_to(cr, 30, 30);
+    cairo_curve_to(cr, 8, 100, 8, 100, 30, 170);
+    cairo_line_to(cr, 100, 170);
+    cairo_line_to(cr, 100, 30);
+    cairo_close_path(cr);
+    cairo_fill(cr);
+  });
+  add("text in the footer", true, [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_select_font_face(cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 9.0);
+    cairo_move_to(cr, 20, 212);
+    cairo_show_text(cr, "Terima kasih");
+  });
+  add("text in the body", false, [](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_select_font_face(cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 9.0);
+    cairo_move_to(cr, 20, 100);
+    cairo_show_text(cr, "Total 125.000");
+  });
+  add("image in the margin", true, [](cairo_t* cr) {
+    cairo_surface_t* image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 8, 8);
+    cairo_t* icr = cairo_create(image);
+    cairo_set_source_rgb(icr, 0.1, 0.1, 0.6);
+    cairo_paint(icr);
+    cairo_destroy(icr);
+    cairo_set_source_surface(cr, image, 134, 100);
+    cairo_paint(cr);
+    cairo_surface_destroy(image);
+  });
+  add("landscape clear", false, [](cairo_t* cr) { FillRect(cr, 20, 20, 176, 104); }, true);
+  add("landscape right edge", true, [](cairo_t* cr) { FillRect(cr, 206, 20, 8, 104); }, true);
+  return corpus;
+}
+
+class MarginAnalyzerTest : public ::testing::Test {
+ protected:
+  MarginAnalyzerTest() : file_("margin_corpus.pdf"), corpus_(Corpus()) {}
+
+  void SetUp() override {
+    std::vector<TestPage> pages;
+    for (const CorpusPage& entry : corpus_) pages.push_back(entry.page);
+    ASSERT_TRUE(WriteTestPdf(file_.path(), pages));
+    document_ = OpenTestPdf(file_.path());
+    ASSERT_NE(document_, nullptr);
+    ASSERT_EQ(poppler_document_get_n_pages(document_), (int)corpus_.size());
+  }
+
+  void TearDown() override {
+    if (document_) g_object_unref(document_);
+  }
+
+  bool Analyze(int index, const MarginBox& margins, bool* reference) {
+    PopplerPage* page = poppler_document_get_page(document_, index);
+    double w = 0, h = 0;
+    poppler_page_get_size(page, &w, &h);
+    bool result =
+        HasContentInMargins(page, w, h, margins.left, margins.top, margins.right, margins.bottom);
+    *reference = FullRasterHasContent(page, margins);
+    g_object_unref(page);
+    return result;
+  }
+
+  ScopedTestFile file_;
+  std::vector<CorpusPage> corpus_;
+  PopplerDocument* document_ = nullptr;
+};
+
+TEST_F(MarginAnalyzerTest, CorpusDecisionsAreRight) {
+  for (size_t i = 0; i < corpus_.size(); i++) {
+    SCOPED_TRACE(corpus_[i].name);
+    bool reference = false;
+    EXPECT_EQ(Analyze((int)i, kMargins, &reference), corpus_[i].inkInMargins);
+    EXPECT_EQ(reference, corpus_[i].inkInMargins);
+  }
+}
+
+// The strip analysis only rasterizes what the ink extents reach; it must
+// still decide like a full-page raster for any margins.
+TEST_F(MarginAnalyzerTest, MatchesFullRasterForEveryMarginSet) {
+  const MarginBox marginSets[] = {
+      {0.0, 0.0, 0.0, 0.0},     {12.0, 12.0, 12.0, 12.0}, {0.0, 20.0, 0.0, 20.0},
+      {18.0, 6.0, 18.0, 6.0},   {4.2, 4.2, 4.2, 4.2},     {30.0, 0.0, 0.0, 0.0},
+      {500.0, 0.0, 0.0, 0.0},
+  };
+  for (size_t i = 0; i < corpus_.size(); i++) {
+    for (const MarginBox& margins : marginSets) {
+      SCOPED_TRACE(std::string(corpus_[i].name) + " margins " + std::to_string(margins.left) +
+                   "/" + std::to_string(margins.top) + "/" + std::to_string(margins.right) + "/" +
+                   std::to_string(margins.bottom));
+      bool reference = false;
+      EXPECT_EQ(Analyze((int)i, margins, &reference), reference);
+    }
+  }
+}
+
+TEST_F(MarginAnalyzerTest, NoMarginsMeansNoContent) {
+  for (size_t i = 0; i < corpus_.size(); i++) {
+    bool reference = false;
+    EXPECT_FALSE(Analyze((int)i, MarginBox(), &reference)) << corpus_[i].name;
+  }
+}
+
+}  // namespace
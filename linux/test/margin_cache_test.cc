@@ -0,0 +1,172 @@
+#include "margin_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "test_documents.h"
+
+namespace {
+
+// Bytes of a large document; |variant| changes one byte in the middle only.
+std::string LargeDocument(size_t size, char variant) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; i++) data[i] = (char)(i * 31 + i / 251);
+  data[size / 2] = variant;
+  return data;
+}
+
+void WriteFile(const std::string& path, const std::string& data) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+}
+
+MarginCacheKey Key(uint64_t contentHash, int pageIndex) {
+  MarginBox margins;
+  margins.left = margins.right = 12.5;
+  margins.top = margins.bottom = 18.0;
+  return MakeMarginCacheKey(contentHash, pageIndex, margins);
+}
+
+TEST(MarginCacheTest, FileKeyIsTheContentHash) {
+  std::string data = LargeDocument(300 * 1024, 'a');
+  ScopedTestFile first("margin_key_first.pdf");
+  ScopedTestFile copy("margin_key_copy.pdf");
+  WriteFile(first.path(), data);
+  WriteFile(copy.path(), data);
+
+  uint64_t firstHash = 0, copyHash = 0;
+  ASSERT_TRUE(HashFileContent(first.path(), &firstHash));
+  ASSERT_TRUE(HashFileContent(copy.path(), &copyHash));
+  EXPECT_EQ(firstHash, copyHash);
+  EXPECT_EQ(firstHash, HashContent(data.data(), data.size()));
+  EXPECT_FALSE(HashFileContent(TestFilePath("margin_key_missing.pdf"), &firstHash));
+}
+
+// Two documents of the same size that only differ in the middle, the second
+// written after the first was deleted, as temporary batch files are. They
+// must not share margin decisions.
+TEST(MarginCacheTest, SameSizeFilesWithTheSameEndsGetDifferentKeys) {
+  uint64_t firstHash = 0, secondHash = 0;
+  {
+    ScopedTestFile first("margin_key_batch_1.pdf");
+    WriteFile(first.path(), LargeDocument(300 * 1024, 'a'));
+    ASSERT_TRUE(HashFileContent(first.path(), &firstHash));
+  }
+  ScopedTestFile second("margin_key_batch_2.pdf");
+  WriteFile(second.path(), LargeDocument(300 * 1024, 'b'));
+  ASSERT_TRUE(HashFileContent(second.path(), &secondHash));
+  EXPECT_NE(firstHash, secondHash);
+  EXPECT_NE(secondHash, 0u);
+}
+
+// The memo is keyed by path, size and modification time: a file rewritten in
+// place is hashed again.
+TEST(MarginCacheTest, RewrittenFileIsHashedAgain) {
+  ScopedTestFile file("margin_key_rewritten.pdf");
+  WriteFile(file.path(), LargeDocument(200 * 1024, 'a'));
+  uint64_t before = 0, after = 0;
+  ASSERT_TRUE(HashFileContent(file.path(), &before));
+
+  WriteFile(file.path(), LargeDocument(200 * 1024, 'b'));
+  std::filesystem::path path(file.path());
+  std::filesystem::last_write_time(
+      path, std::filesystem::last_write_time(path) + std::chrono::seconds(2));
+  ASSERT_TRUE(HashFileContent(file.path(), &after));
+  EXPECT_NE(before, after);
+}
+
+TEST(MarginCacheTest, LeastRecentlyUsedEntryIsEvicted) {
+  ScopedTestFile store("margin_cache_lru.txt");
+  MarginCache cache;
+  cache.Open(store.path(), 3);
+  cache.Store(Key(1, 0), true);
+  cache.Store(Key(2, 0), false);
+  cache.Store(Key(3, 0), true);
+
+  // Using the oldest entry makes the second one the least recently used.
+  bool decision = false;
+  ASSERT_TRUE(cache.Lookup(Key(1, 0), &decision));
+  EXPECT_TRUE(decision);
+  cache.Store(Key(4, 0), false);
+
+  EXPECT_FALSE(cache.Lookup(Key(2, 0), &decision));
+  EXPECT_TRUE(cache.Lookup(Key(1, 0), &decision));
+  EXPECT_TRUE(cache.Lookup(Key(3, 0), &decision));
+  EXPECT_TRUE(cache.Lookup(Key(4, 0), &decision));
+  MarginCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.entries, 3u);
+  EXPECT_EQ(stats.hits, 4);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+// Page index and the whole-point margins are part of the key.
+TEST(MarginCacheTest, KeyCoversPageAndMargins) {
+  MarginCache cache;
+  cache.Store(Key(7, 0), true);
+  bool decision = false;
+  EXPECT_FALSE(cache.Lookup(Key(7, 1), &decision));
+
+  MarginBox wider;
+  wider.left = wider.right = 13.0;
+  wider.top = wider.bottom = 18.0;
+  EXPECT_FALSE(cache.Lookup(MakeMarginCacheKey(7, 0, wider), &decision));
+
+  MarginBox sameWholePoints;
+  sameWholePoints.left = sameWholePoints.right = 12.9;
+  sameWholePoints.top = sameWholePoints.bottom = 18.2;
+  EXPECT_TRUE(cache.Lookup(MakeMarginCacheKey(7, 0, sameWholePoints), &decision));
+  EXPECT_TRUE(decision);
+}
+
+TEST(MarginCacheTest, EntriesSurviveFlushAndReload) {
+  ScopedTestFile store("margin_cache_persist.txt");
+  {
+    MarginCache cache;
+    cache.Open(store.path(), 10);
+    cache.Store(Key(0xFFFFFFFFFFFFFFF1ull, 0), true);
+    cache.Store(Key(0x1234, 2), false);
+    cache.Store(Key(0x5678, 1), true);
+    cache.Flush();
+  }
+
+  MarginCache reloaded;
+  reloaded.Open(store.path(), 10);
+  EXPECT_EQ(reloaded.stats().entries, 3u);
+  bool decision = false;
+  ASSERT_TRUE(reloaded.Lookup(Key(0xFFFFFFFFFFFFFFF1ull, 0), &decision));
+  EXPECT_TRUE(decision);
+  ASSERT_TRUE(reloaded.Lookup(Key(0x1234, 2), &decision));
+  EXPECT_FALSE(decision);
+  ASSERT_TRUE(reloaded.Lookup(Key(0x5678, 1), &decision));
+  EXPECT_TRUE(decision);
+
+  // Saved most recently used first: a smaller cache keeps the newest.
+  MarginCache smaller;
+  smaller.Open(store.path(), 2);
+  EXPECT_EQ(smaller.stats().entries, 2u);
+  EXPECT_FALSE(smaller.Lookup(Key(0xFFFFFFFFFFFFFFF1ull, 0), &decision));
+  EXPECT_TRUE(smaller.Lookup(Key(0x5678, 1), &decision));
+  EXPECT_TRUE(smaller.Lookup(Key(0x1234, 2), &decision));
+}
+
+TEST(MarginCacheTest, DamagedFileStartsEmpty) {
+  ScopedTestFile store("margin_cache_damaged.txt");
+  WriteFile(store.path(), "not a margin cache\n1 0 0 0 0 0 1\n");
+  MarginCache cache;
+  cache.Open(store.path(), 10);
+  EXPECT_EQ(cache.stats().entries, 0u);
+
+  // Saved over the damaged file on the next Flush.
+  cache.Store(Key(9, 0), true);
+  cache.Flush();
+  MarginCache reloaded;
+  reloaded.Open(store.path(), 10);
+  bool decision = false;
+  EXPECT_TRUE(reloaded.Lookup(Key(9, 0), &decision));
+}
+
+}  // namespace
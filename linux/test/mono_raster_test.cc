@@ -0,0 +1,289 @@
+#include "mono_raster.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "raster_file_sink.h"
+#include "test_documents.h"
+
+namespace {
+
+constexpr uint8_t kBayer8[8][8] = {
+    {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+    {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+uint32_t Grey(int value) { return (uint32_t)value * 0x010101u; }
+
+// An RGB24 image whose pixels come from |pixel|.
+template <typename PixelFn>
+cairo_surface_t* MakeImage(int width, int height, PixelFn pixel) {
+  cairo_surface_t* image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+  cairo_surface_flush(image);
+  uint8_t* data = cairo_image_surface_get_data(image);
+  int stride = cairo_image_surface_get_stride(image);
+  for (int y = 0; y < height; y++) {
+    uint32_t* row = reinterpret_cast<uint32_t*>(data + (size_t)y * stride);
+    for (int x = 0; x < width; x++) row[x] = pixel(x, y);
+  }
+  cairo_surface_mark_dirty(image);
+  return image;
+}
+
+// Rows [first, first + count) of |image| as an image of their own, as
+// RasterBands hands a page out.
+cairo_surface_t* Band(cairo_surface_t* image, int first, int count) {
+  const uint8_t* data = cairo_image_surface_get_data(image);
+  int stride = cairo_image_surface_get_stride(image);
+  return MakeImage(cairo_image_surface_get_width(image), count, [&](int x, int y) {
+    return reinterpret_cast<const uint32_t*>(data + (size_t)(first + y) * stride)[x];
+  });
+}
+
+// Threshold and ordered dithering worked out pixel by pixel, without the
+// vectorised packing ConvertToBilevel uses where it can.
+BilevelImage ReferenceBilevel(cairo_surface_t* image, DitherMode mode, int firstRow) {
+  BilevelImage out;
+  out.width = cairo_image_surface_get_width(image);
+  out.height = cairo_image_surface_get_height(image);
+  out.stride = ((out.width + 31) / 32) * 4;
+  out.bits.assign((size_t)out.stride * out.height, 0);
+  const uint8_t* data = cairo_image_surface_get_data(image);
+  int stride = cairo_image_surface_get_stride(image);
+  for (int y = 0; y < out.height; y++) {
+    const uint32_t* row = reinterpret_cast<const uint32_t*>(data + (size_t)y * stride);
+    for (int x = 0; x < out.width; x++) {
+      uint32_t p = row[x];
+      int luma = (77 * ((p >> 16) & 0xFF) + 150 * ((p >> 8) & 0xFF) + 29 * (p & 0xFF)) >> 8;
+      int threshold = mode == DitherMode::kOrdered ? kBayer8[(firstRow + y) & 7][x & 7] * 4 + 2 : 128;
+      if (luma >= threshold) out.bits[(size_t)y * out.stride + x / 8] |= (uint8_t)(0x80 >> (x % 8));
+    }
+  }
+  return out;
+}
+
+bool BitSet(const BilevelImage& image, int x, int y) {
+  return image.bits[(size_t)y * image.stride + x / 8] & (0x80 >> (x % 8));
+}
+
+// Pixel of a CAIRO_FORMAT_A1 image: 32-bit words, first pixel in the low
+// bit on little-endian machines and in the high bit on big-endian ones.
+bool A1Pixel(cairo_surface_t* mask, int x, int y) {
+  const uint8_t* data = cairo_image_surface_get_data(mask);
+  int stride = cairo_image_surface_get_stride(mask);
+  uint32_t word;
+  memcpy(&word, data + (size_t)y * stride + (x / 32) * 4, sizeof(word));
+  const uint16_t probe = 1;
+  bool littleEndian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+  return (word >> (littleEndian ? x % 32 : 31 - x % 32)) & 1;
+}
+
+// Widths around every boundary of the 16-pixel vector loop and the 8-pixel
+// bytes, with luma values on both sides of every threshold.
+TEST(MonoRasterTest, PackingMatchesThePixelByPixelReference) {
+  const int widths[] = {1, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 47, 63, 100};
+  uint32_t seed = 12345;
+  for (int width : widths) {
+    cairo_surface_t* image = MakeImage(width, 19, [&](int x, int) {
+      seed = seed * 1103515245u + 12345u;
+      // Every fourth pixel an exact grey next to the fixed threshold.
+      return x % 4 == 3 ? Grey(127 + (int)((seed >> 16) & 1)) : (seed >> 8) & 0xFFFFFF;
+    });
+    for (DitherMode mode : {DitherMode::kThreshold, DitherMode::kOrdered}) {
+      for (int firstRow : {0, 5}) {
+        SCOPED_TRACE(std::string(DitherModeName(mode)) + " width " + std::to_string(width) +
+                     " from row " + std::to_string(firstRow));
+        BilevelImage bilevel;
+        DitherState state;
+        state.row = firstRow;
+        ASSERT_TRUE(ConvertToBilevel(image, mode, &bilevel, &state));
+        BilevelImage expected = ReferenceBilevel(image, mode, firstRow);
+        EXPECT_EQ(bilevel.width, width);
+        EXPECT_EQ(bilevel.stride, expected.stride);
+        EXPECT_TRUE(bilevel.bits == expected.bits);
+        EXPECT_EQ(state.row, firstRow + 19);
+      }
+    }
+    cairo_surface_destroy(image);
+  }
+}
+
+// Rows padded to 32 bits, leftmost pixel in the most significant bit, set
+// bits white: what a Windows DIB with a black/white palette expects.
+TEST(MonoRasterTest, LeftmostPixelIsTheMostSignificantBit) {
+  cairo_surface_t* image = MakeImage(10, 2, [](int x, int y) {
+    return (x == 0 || x == 9 || (y == 1 && x == 4)) ? Grey(0) : Grey(255);
+  });
+  BilevelImage bilevel;
+  ASSERT_TRUE(ConvertToBilevel(image, DitherMode::kThreshold, &bilevel));
+  EXPECT_EQ(bilevel.stride, 4);
+  const uint8_t expected[] = {0x7F, 0x80, 0x00, 0x00, 0x77, 0x80, 0x00, 0x00};
+  ASSERT_EQ(bilevel.bits.size(), sizeof(expected));
+  for (size_t i = 0; i < sizeof(expected); i++) {
+    EXPECT_EQ(bilevel.bits[i], expected[i]) << "byte " << i;
+  }
+
+  // The ink mask has the black pixels set, in cairo's A1 bit order.
+  cairo_surface_t* mask = CreateInkMask(bilevel);
+  ASSERT_NE(mask, nullptr);
+  EXPECT_EQ(cairo_image_surface_get_format(mask), CAIRO_FORMAT_A1);
+  for (int y = 0; y < 2; y++) {
+    for (int x = 0; x < 10; x++) {
+      EXPECT_EQ(A1Pixel(mask, x, y), !BitSet(bilevel, x, y)) << x << "," << y;
+    }
+  }
+  cairo_surface_destroy(mask);
+  cairo_surface_destroy(image);
+}
+
+TEST(MonoRasterTest, InkMaskMatchesEveryPixel) {
+  cairo_surface_t* image = MakeImage(45, 9, [](int x, int y) { return Grey((x * 37 + y * 11) % 256); });
+  BilevelImage bilevel;
+  ASSERT_TRUE(ConvertToBilevel(image, DitherMode::kOrdered, &bilevel));
+  cairo_surface_t* mask = CreateInkMask(bilevel);
+  ASSERT_NE(mask, nullptr);
+  int mismatches = 0;
+  for (int y = 0; y < 9; y++) {
+    for (int x = 0; x < 45; x++) mismatches += A1Pixel(mask, x, y) == BitSet(bilevel, x, y);
+  }
+  EXPECT_EQ(mismatches, 0);
+  cairo_surface_destroy(mask);
+  cairo_surface_destroy(image);
+}
+
+// A page converted band by band with one DitherState must come out exactly
+// as the page converted in one piece: no seams where the bands meet.
+TEST(MonoRasterTest, BandsCarryTheDitherAcrossTheirEdges) {
+  cairo_surface_t* page = MakeImage(37, 40, [](int x, int y) { return Grey((x * 7 + y * 5) % 256); });
+  const int bandRows[] = {7, 13, 1, 19};
+  for (DitherMode mode : {DitherMode::kOrdered, DitherMode::kErrorDiffusion}) {
+    SCOPED_TRACE(DitherModeName(mode));
+    BilevelImage whole;
+    ASSERT_TRUE(ConvertToBilevel(page, mode, &whole, nullptr));
+
+    DitherState state;
+    std::vector<uint8_t> banded;
+    int first = 0;
+    for (int rows : bandRows) {
+      cairo_surface_t* band = Band(page, first, rows);
+      BilevelImage part;
+      ASSERT_TRUE(ConvertToBilevel(band, mode, &part, &state));
+      banded.insert(banded.end(), part.bits.begin(), part.bits.end());
+      cairo_surface_destroy(band);
+      first += rows;
+    }
+    EXPECT_EQ(state.row, 40);
+    EXPECT_TRUE(banded == whole.bits);
+  }
+
+  // Without the state the second band restarts the pattern and shows.
+  cairo_surface_t* flat = MakeImage(16, 8, [](int, int) { return Grey(128); });
+  BilevelImage whole, restarted;
+  ASSERT_TRUE(ConvertToBilevel(flat, DitherMode::kOrdered, &whole));
+  cairo_surface_t* band = Band(flat, 3, 5);
+  ASSERT_TRUE(ConvertToBilevel(band, DitherMode::kOrdered, &restarted));
+  EXPECT_FALSE(std::equal(restarted.bits.begin(), restarted.bits.end(),
+                          whole.bits.begin() + 3 * whole.stride));
+  cairo_surface_destroy(band);
+  cairo_surface_destroy(flat);
+  cairo_surface_destroy(page);
+}
+
+TEST(MonoRasterTest, RefusesWhatItCannotConvert) {
+  cairo_surface_t* image = MakeImage(8, 8, [](int, int) { return Grey(0); });
+  BilevelImage bilevel;
+  EXPECT_FALSE(ConvertToBilevel(image, DitherMode::kOff, &bilevel));
+  EXPECT_FALSE(ConvertToBilevel(nullptr, DitherMode::kThreshold, &bilevel));
+  cairo_surface_t* alpha = cairo_image_surface_create(CAIRO_FORMAT_A8, 8, 8);
+  EXPECT_FALSE(ConvertToBilevel(alpha, DitherMode::kThreshold, &bilevel));
+  cairo_surface_destroy(alpha);
+  cairo_surface_destroy(image);
+
+  EXPECT_EQ(ParseDitherMode("diffusion"), DitherMode::kErrorDiffusion);
+  EXPECT_EQ(ParseDitherMode("Threshold"), DitherMode::kOff);
+  EXPECT_STREQ(DitherModeName(ParseDitherMode("ordered")), "ordered");
+}
+
+// Text-like bars, a grey fill and a gradient strip, on A4.
+void DrawMonoDocumentPage(cairo_t* cr, int width, int height) {
+  cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+  for (int line = 0; line < 40; line++) {
+    cairo_rectangle(cr, width * 0.08, height * 0.05 + line * height * 0.012,
+                    width * (0.3 + 0.5 * ((line * 7) % 10) / 10.0), height * 0.005);
+  }
+  cairo_fill(cr);
+  cairo_set_source_rgb(cr, 0.6, 0.6, 0.6);
+  cairo_rectangle(cr, width * 0.08, height * 0.6, width * 0.4, height * 0.15);
+  cairo_fill(cr);
+  for (int step = 0; step < 16; step++) {
+    cairo_set_source_rgb(cr, step / 16.0, step / 16.0, step / 16.0);
+    cairo_rectangle(cr, width * (0.52 + step * 0.025), height * 0.6, width * 0.025, height * 0.15);
+    cairo_fill(cr);
+  }
+}
+
+// The same two-page document through the raster sink in every mode, with
+// what each mode puts on the wire. Mono pages are black_1: an eighth of the
+// sgray_8 rows before compression. Dithered greys compress worse than flat
+// sgray_8 runs, so only threshold is sure to be smaller written out; the
+// others are recorded for comparison.
+TEST(MonoRasterTest, MonoModesShrinkTheRaster) {
+  constexpr int kDpi = 150;
+  struct Written {
+    DitherMode mode;
+    RasterSinkStats stats;
+    int width;
+    int height;
+  };
+  std::vector<Written> written;
+  for (DitherMode mode : {DitherMode::kOff, DitherMode::kThreshold, DitherMode::kOrdered,
+                          DitherMode::kErrorDiffusion}) {
+    ScopedTestFile file(std::string("mono_") + DitherModeName(mode) + ".pwg");
+    RasterSinkOptions options;
+    options.dpi = kDpi;
+    options.threads = 2;
+    RasterFileSink sink(file.path(), PageSetup(), options);
+    RasterMode raster;
+    raster.dpi = kDpi;
+    raster.mono = mode;
+    raster.bandRows = 256;
+    sink.SetRasterMode(raster);
+    PrintPageGeometry geometry = sink.Geometry();
+    ASSERT_TRUE(sink.StartDocument("Mono modes", nullptr));
+    for (int page = 0; page < 2; page++) {
+      ASSERT_TRUE(sink.StartPage());
+      do {
+        cairo_t* cr = cairo_create(sink.PageSurface());
+        DrawMonoDocumentPage(cr, geometry.physicalWidth, geometry.physicalHeight);
+        cairo_destroy(cr);
+      } while (sink.NextBand());
+      ASSERT_TRUE(sink.EndPage());
+    }
+    ASSERT_TRUE(sink.EndDocument());
+    written.push_back({mode, sink.stats(), geometry.physicalWidth, geometry.physicalHeight});
+    printf("%-9s raw %9lld bytes, written %8lld bytes, %.1f ms\n", DitherModeName(mode),
+           (long long)sink.stats().rawBytes, (long long)sink.stats().encodedBytes,
+           sink.stats().encodeMs);
+  }
+
+  const Written& gray = written[0];
+  EXPECT_EQ(gray.stats.rawBytes, 2LL * gray.width * gray.height);
+  for (size_t i = 1; i < written.size(); i++) {
+    SCOPED_TRACE(DitherModeName(written[i].mode));
+    EXPECT_EQ(written[i].stats.pages, 2);
+    EXPECT_EQ(written[i].stats.rawBytes,
+              2LL * RasterBytesPerLine(RasterColorSpace::kBlack1, gray.width) * gray.height);
+    EXPECT_GT(written[i].stats.encodedBytes, 0);
+  }
+  EXPECT_LT(written[1].stats.encodedBytes, gray.stats.encodedBytes);
+}
+
+}  // namespace
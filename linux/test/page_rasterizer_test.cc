@@ -0,0 +1,145 @@
+#include "page_rasterizer.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_documents.h"
+
+namespace {
+
+constexpr double kDpi = 72.0;
+constexpr int kInputPages = 9;
+
+struct SurfaceDeleter {
+  void operator()(cairo_surface_t* surface) const { cairo_surface_destroy(surface); }
+};
+using Image = std::unique_ptr<cairo_surface_t, SurfaceDeleter>;
+
+// Renders every page of |path| at |dpi|, the same way for input and output.
+std::vector<Image> RenderAll(const std::string& path, double dpi) {
+  std::vector<Image> images;
+  PopplerDocument* document = OpenTestPdf(path);
+  if (!document) return images;
+  for (int i = 0; i < poppler_document_get_n_pages(document); i++) {
+    PopplerPage* page = poppler_document_get_page(document, i);
+    images.emplace_back(RenderPageToImage(page, dpi));
+    g_object_unref(page);
+  }
+  g_object_unref(document);
+  return images;
+}
+
+class PageRasterizerTest : public ::testing::Test {
+ protected:
+  PageRasterizerTest() : input_("rasterizer_input.pdf") {}
+
+  void SetUp() override { ASSERT_TRUE(WriteTestPdf(input_.path(), MarkerPages(kInputPages))); }
+
+  RasterizeOptions Options(const ScopedTestFile& output, int threads) const {
+    RasterizeOptions options;
+    options.inputPath = input_.path();
+    options.outputPath = output.path();
+    options.firstPage = 2;
+    options.lastPage = 8;
+    options.dpi = kDpi;
+    options.threadCount = threads;
+    return options;
+  }
+
+  ScopedTestFile input_;
+};
+
+TEST_F(PageRasterizerTest, ParallelOutputMatchesSerialRender) {
+  ScopedTestFile serialOut("rasterizer_serial.pdf");
+  ScopedTestFile parallelOut("rasterizer_parallel.pdf");
+  RasterizeStats serialStats, parallelStats;
+  std::string error;
+  ASSERT_TRUE(RasterizePages(Options(serialOut, 1), &serialStats, &error)) << error;
+  ASSERT_TRUE(RasterizePages(Options(parallelOut, 4), &parallelStats, &error)) << error;
+  EXPECT_EQ(serialStats.pagesRendered, 7);
+  EXPECT_EQ(parallelStats.pagesRendered, 7);
+  EXPECT_EQ(serialStats.threadsUsed, 1);
+  EXPECT_GT(parallelStats.threadsUsed, 1);
+  EXPECT_GT(parallelStats.outputBytes, 0);
+
+  std::vector<Image> input = RenderAll(input_.path(), kDpi);
+  std::vector<Image> serial = RenderAll(serialOut.path(), kDpi);
+  std::vector<Image> parallel = RenderAll(parallelOut.path(), kDpi);
+  ASSERT_EQ(input.size(), (size_t)kInputPages);
+  ASSERT_EQ(serial.size(), 7u);
+  ASSERT_EQ(parallel.size(), 7u);
+
+  for (int k = 0; k < 7; k++) {
+    SCOPED_TRACE("output page " + std::to_string(k + 1));
+    // Pages come out in document order even though workers finish in any
+    // order, and both runs encode the very same pixels.
+    EXPECT_EQ(ReadPageMarker(parallel[k].get(), kDpi), k + 1);
+    EXPECT_EQ(CountDifferentPixels(parallel[k].get(), serial[k].get(), 0), 0);
+    // Against rendering the source page directly, only resampling of the
+    // embedded image may differ.
+    int pixels = cairo_image_surface_get_width(input[k + 1].get()) *
+                 cairo_image_surface_get_height(input[k + 1].get());
+    int different = CountDifferentPixels(parallel[k].get(), input[k + 1].get(), 32);
+    ASSERT_GE(different, 0) << "page size changed";
+    EXPECT_LT(different, pixels / 200);
+  }
+}
+
+TEST_F(PageRasterizerTest, MonoOutputMatchesSerialRender) {
+  ScopedTestFile serialOut("rasterizer_mono_serial.pdf");
+  ScopedTestFile parallelOut("rasterizer_mono_parallel.pdf");
+  RasterizeOptions serialOptions = Options(serialOut, 1);
+  RasterizeOptions parallelOptions = Options(parallelOut, 3);
+  serialOptions.monoDither = parallelOptions.monoDither = DitherMode::kThreshold;
+  // Bands of a few rows, so every page is cut into many.
+  parallelOptions.bandHeight = 13;
+  std::string error;
+  ASSERT_TRUE(RasterizePages(serialOptions, nullptr, &error)) << error;
+  ASSERT_TRUE(RasterizePages(parallelOptions, nullptr, &error)) << error;
+
+  std::vector<Image> serial = RenderAll(serialOut.path(), kDpi);
+  std::vector<Image> parallel = RenderAll(parallelOut.path(), kDpi);
+  ASSERT_EQ(serial.size(), 7u);
+  ASSERT_EQ(parallel.size(), 7u);
+  for (int k = 0; k < 7; k++) {
+    SCOPED_TRACE("output page " + std::to_string(k + 1));
+    EXPECT_EQ(ReadPageMarker(parallel[k].get(), kDpi), k + 1);
+    EXPECT_EQ(CountDifferentPixels(parallel[k].get(), serial[k].get(), 0), 0);
+  }
+}
+
+TEST_F(PageRasterizerTest, BandedInkMaskMatchesWholePage) {
+  PopplerDocument* document = OpenTestPdf(input_.path());
+  ASSERT_NE(document, nullptr);
+  PopplerPage* page = poppler_document_get_page(document, 4);
+  Image whole(RenderPageToInkMask(page, 150.0, DitherMode::kOrdered, 0));
+  Image banded(RenderPageToInkMask(page, 150.0, DitherMode::kOrdered, 7));
+  g_object_unref(page);
+  g_object_unref(document);
+  ASSERT_TRUE(whole && banded);
+
+  ASSERT_EQ(cairo_image_surface_get_format(banded.get()), CAIRO_FORMAT_A1);
+  int height = cairo_image_surface_get_height(whole.get());
+  int stride = cairo_image_surface_get_stride(whole.get());
+  ASSERT_EQ(cairo_image_surface_get_height(banded.get()), height);
+  ASSERT_EQ(cairo_image_surface_get_stride(banded.get()), stride);
+  cairo_surface_flush(whole.get());
+  cairo_surface_flush(banded.get());
+  EXPECT_EQ(std::string((const char*)cairo_image_surface_get_data(whole.get()), (size_t)stride * height),
+            std::string((const char*)cairo_image_surface_get_data(banded.get()), (size_t)stride * height));
+}
+
+TEST_F(PageRasterizerTest, RangeOutsideDocumentFails) {
+  ScopedTestFile output("rasterizer_range.pdf");
+  RasterizeOptions options = Options(output, 2);
+  options.firstPage = kInputPages + 1;
+  options.lastPage = 0;
+  std::string error;
+  EXPECT_FALSE(RasterizePages(options, nullptr, &error));
+  EXPECT_FALSE(error.empty());
+}
+
+}  // namespace
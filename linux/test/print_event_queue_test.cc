@@ -0,0 +1,275 @@
+#include "print_event_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Counts heap allocations made by threads that asked for it, to prove that
+// posting stays allocation-free.
+namespace {
+thread_local bool t_countAllocations = false;
+std::atomic<int64_t> g_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  if (t_countAllocations) g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* block = malloc(size ? size : 1);
+  if (!block) abort();
+  return block;
+}
+void operator delete(void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+
+namespace {
+
+double NowMs() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+PrintEvent MakeEvent(PrintEventType type, int jobHandle, int printJobId, int pages = 0) {
+  PrintEvent event;
+  event.type = type;
+  event.jobHandle = jobHandle;
+  event.printJobId = printJobId;
+  event.pages = pages;
+  event.totalPages = pages;
+  return event;
+}
+
+class PrintEventQueueTest : public ::testing::Test {
+ protected:
+  PrintEventQueueTest() : queue_([this] { notified_++; }) {
+    batch_.reserve(PrintEventQueue::kMaxBatch);
+  }
+
+  const std::vector<PrintEvent>& Drain() {
+    queue_.Drain(&batch_);
+    return batch_;
+  }
+
+  std::atomic<int> notified_{0};
+  PrintEventQueue queue_;
+  std::vector<PrintEvent> batch_;
+};
+
+TEST_F(PrintEventQueueTest, ProgressIsCoalescedPerJob) {
+  for (int i = 1; i <= 10; i++) queue_.Post(MakeEvent(PrintEventType::kSpoolProgress, 1, 100, i));
+  for (int i = 1; i <= 5; i++) queue_.Post(MakeEvent(PrintEventType::kPrintProgress, 0, 200, i));
+  queue_.Post(MakeEvent(PrintEventType::kSpoolStarted, 2, 300));
+
+  const std::vector<PrintEvent>& events = Drain();
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].type, PrintEventType::kSpoolProgress);
+  EXPECT_EQ(events[0].pages, 10);
+  EXPECT_EQ(events[1].type, PrintEventType::kPrintProgress);
+  EXPECT_EQ(events[1].pages, 5);
+  EXPECT_EQ(events[2].type, PrintEventType::kSpoolStarted);
+  EXPECT_EQ(queue_.stats().coalesced, 13u);
+  // One notification for the whole batch.
+  EXPECT_EQ(notified_.load(), 1);
+}
+
+TEST_F(PrintEventQueueTest, FullRingDropsInsteadOfBlocking) {
+  for (size_t i = 0; i < PrintEventQueue::kRingCapacity; i++) {
+    ASSERT_TRUE(queue_.Post(MakeEvent(PrintEventType::kSpoolStarted, (int)i + 1, 0)));
+  }
+  EXPECT_FALSE(queue_.Post(MakeEvent(PrintEventType::kSpoolStarted, -1, 0)));
+  EXPECT_EQ(queue_.stats().dropped, 1u);
+
+  const std::vector<PrintEvent>& events = Drain();
+  ASSERT_EQ(events.size(), PrintEventQueue::kRingCapacity);
+  for (size_t i = 0; i < events.size(); i++) EXPECT_EQ(events[i].jobHandle, (int)i + 1);
+  EXPECT_TRUE(queue_.Post(MakeEvent(PrintEventType::kSpoolStarted, 1, 0)));
+}
+
+TEST_F(PrintEventQueueTest, FinishedJobsGiveTheirSlotsBack) {
+  // Far more jobs than slots: each one's progress must still be coalesced,
+  // which only works if the terminal events free the slots again.
+  for (int job = 1; job <= (int)PrintEventQueue::kProgressSlots * 3; job++) {
+    queue_.Post(MakeEvent(PrintEventType::kSpoolProgress, job, 0, 1));
+    queue_.Post(MakeEvent(PrintEventType::kSpoolProgress, job, 0, 2));
+    queue_.Post(MakeEvent(PrintEventType::kSpoolCompleted, job, 0, 2));
+    const std::vector<PrintEvent>& events = Drain();
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].pages, 2);
+  }
+  EXPECT_EQ(queue_.stats().coalesced, PrintEventQueue::kProgressSlots * 3);
+}
+
+// The slot of a finished job is freed by the consumer while the producer may
+// already post progress for the next job under the same id. That progress
+// must never be lost with the slot.
+TEST_F(PrintEventQueueTest, ReusedJobIdNeverLosesFinalProgress) {
+  constexpr int kRounds = 20000;
+  std::thread producer([&] {
+    for (int round = 1; round <= kRounds; round++) {
+      queue_.Post(MakeEvent(PrintEventType::kPrintProgress, 0, 7, round));
+      PrintEvent completed = MakeEvent(PrintEventType::kJobCompleted, 0, 7);
+      completed.totalPages = round;
+      while (!queue_.Post(completed)) std::this_thread::yield();
+    }
+  });
+
+  int lastProgress = 0;
+  int completedRounds = 0;
+  int lost = 0;
+  while (completedRounds < kRounds) {
+    const std::vector<PrintEvent>& events = Drain();
+    // Progress posted before a completion arrives no later than its batch;
+    // coalescing may still order a newer value after the completion.
+    for (const PrintEvent& event : events) {
+      if (event.type == PrintEventType::kPrintProgress) {
+        EXPECT_GT(event.pages, lastProgress) << "progress delivered twice";
+        lastProgress = std::max(lastProgress, event.pages);
+      }
+    }
+    for (const PrintEvent& event : events) {
+      if (event.type != PrintEventType::kJobCompleted) continue;
+      if (event.totalPages > lastProgress) lost++;
+      completedRounds++;
+    }
+  }
+  producer.join();
+  EXPECT_EQ(completedRounds, kRounds);
+  EXPECT_EQ(lastProgress, kRounds);
+  EXPECT_EQ(lost, 0);
+}
+
+// 100 concurrent jobs on 8 producer threads, each reporting spool and print
+// progress page by page, against a consumer draining like the UI does.
+TEST_F(PrintEventQueueTest, ConcurrentJobsPostWithoutAllocating) {
+  constexpr int kJobs = 100;
+  constexpr int kProducers = 8;
+  constexpr int kPages = 50;
+
+  std::atomic<int> running{kProducers};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p] {
+      t_countAllocations = true;
+      for (int page = 0; page <= kPages + 1; page++) {
+        for (int job = p + 1; job <= kJobs; job += kProducers) {
+          PrintEvent event;
+          if (page == 0) {
+            event = MakeEvent(PrintEventType::kSpoolStarted, job, job);
+          } else if (page <= kPages) {
+            event = MakeEvent(PrintEventType::kSpoolProgress, job, job, page);
+          } else {
+            event = MakeEvent(PrintEventType::kSpoolCompleted, job, job, kPages);
+          }
+          event.ms = NowMs();
+          EXPECT_TRUE(queue_.Post(event));
+          if (page > 0 && page <= kPages) {
+            PrintEvent printed = MakeEvent(PrintEventType::kPrintProgress, 0, job, page);
+            printed.ms = NowMs();
+            EXPECT_TRUE(queue_.Post(printed));
+          }
+        }
+        std::this_thread::yield();
+      }
+      for (int job = p + 1; job <= kJobs; job += kProducers) {
+        PrintEvent completed = MakeEvent(PrintEventType::kJobCompleted, 0, job);
+        completed.ms = NowMs();
+        EXPECT_TRUE(queue_.Post(completed));
+      }
+      t_countAllocations = false;
+      running--;
+    });
+  }
+
+  struct JobLog {
+    std::vector<PrintEventType> lifecycle;
+    int lastSpoolPages = 0;
+    int lastPrintPages = 0;
+    int spoolPagesAtCompletion = -1;
+    int printPagesAtCompletion = -1;
+    // Last sequence seen of the spool events and of the print events.
+    uint64_t lastSpoolSequence = 0;
+    uint64_t lastPrintSequence = 0;
+  };
+  std::map<int, JobLog> jobs;
+  double maxLatencyMs = 0.0;
+  int drains = 0;
+  bool ordered = true;
+  for (;;) {
+    bool finished = running == 0;
+    const std::vector<PrintEvent>& events = Drain();
+    drains++;
+    double now = NowMs();
+    // Posts racing each other have no order between them, so an event can
+    // land in a later batch than one numbered after it. Within a batch, and
+    // across batches for the spool events and the print events of one job,
+    // the order must hold.
+    uint64_t lastSequence = 0;
+    for (const PrintEvent& event : events) {
+      maxLatencyMs = std::max(maxLatencyMs, now - event.ms);
+      JobLog& log = jobs[event.printJobId];
+      bool spool = event.type == PrintEventType::kSpoolStarted ||
+                   event.type == PrintEventType::kSpoolProgress ||
+                   event.type == PrintEventType::kSpoolCompleted;
+      uint64_t& streamSequence = spool ? log.lastSpoolSequence : log.lastPrintSequence;
+      ordered = ordered && event.sequence > lastSequence && event.sequence > streamSequence;
+      lastSequence = event.sequence;
+      streamSequence = event.sequence;
+      switch (event.type) {
+        case PrintEventType::kSpoolProgress:
+          EXPECT_GT(event.pages, log.lastSpoolPages);
+          log.lastSpoolPages = event.pages;
+          break;
+        case PrintEventType::kPrintProgress:
+          EXPECT_GT(event.pages, log.lastPrintPages);
+          log.lastPrintPages = event.pages;
+          break;
+        case PrintEventType::kSpoolCompleted:
+          log.spoolPagesAtCompletion = log.lastSpoolPages;
+          log.lifecycle.push_back(event.type);
+          break;
+        case PrintEventType::kJobCompleted:
+          log.printPagesAtCompletion = log.lastPrintPages;
+          log.lifecycle.push_back(event.type);
+          break;
+        default:
+          log.lifecycle.push_back(event.type);
+          break;
+      }
+    }
+    if (finished && events.empty()) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (auto& producer : producers) producer.join();
+
+  EXPECT_EQ(g_allocations.load(), 0) << "Post allocated on a producer thread";
+  PrintEventStats stats = queue_.stats();
+  EXPECT_EQ(stats.dropped, 0u);
+  EXPECT_EQ(stats.posted, (uint64_t)kJobs * (3 + 2 * kPages));
+  EXPECT_TRUE(ordered) << "a batch was delivered out of posting order";
+  // At most one notification per drained batch.
+  EXPECT_LE(notified_.load(), drains);
+  EXPECT_LT(maxLatencyMs, 250.0);
+  printf("max latency %.2f ms over %d drains, %llu progress updates coalesced\n", maxLatencyMs,
+         drains, (unsigned long long)stats.coalesced);
+
+  ASSERT_EQ(jobs.size(), (size_t)kJobs);
+  const std::vector<PrintEventType> expected = {PrintEventType::kSpoolStarted,
+                                                PrintEventType::kSpoolCompleted,
+                                                PrintEventType::kJobCompleted};
+  for (const auto& entry : jobs) {
+    SCOPED_TRACE("job " + std::to_string(entry.first));
+    EXPECT_EQ(entry.second.lifecycle, expected);
+    // The final state of every job arrives before its completion.
+    EXPECT_EQ(entry.second.spoolPagesAtCompletion, kPages);
+    EXPECT_EQ(entry.second.printPagesAtCompletion, kPages);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,180 @@
+#include "print_job.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "document_cache.h"
+#include "page_rasterizer.h"
+#include "pdf_file_sink.h"
+#include "test_documents.h"
+
+namespace {
+
+// A4 in points, so fixture pages come out of PdfFileSink unscaled.
+constexpr double kA4Width = 595.28;
+constexpr double kA4Height = 841.89;
+
+// Page numbers are drawn as a row of black cells, one per bit, which reads
+// back at any size unlike MarkerPage's bar. The anchor cell below them is
+// always black.
+constexpr int kNumberBits = 10;
+constexpr double kCellLeft = 40.0;
+constexpr double kCellTop = 40.0;
+constexpr double kCellPitch = 50.0;
+constexpr double kCellSize = 30.0;
+constexpr double kAnchorTop = 100.0;
+
+constexpr int kFixturePages = 520;
+constexpr double kReadDpi = 36.0;
+
+TestPage NumberedPage(int index) {
+  TestPage page;
+  page.width = kA4Width;
+  page.height = kA4Height;
+  page.draw = [index](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    for (int bit = 0; bit < kNumberBits; bit++) {
+      if (index & (1 << bit)) {
+        cairo_rectangle(cr, kCellLeft + bit * kCellPitch, kCellTop, kCellSize, kCellSize);
+      }
+    }
+    cairo_rectangle(cr, kCellLeft, kAnchorTop, kCellSize, kCellSize);
+    cairo_fill(cr);
+  };
+  return page;
+}
+
+bool DarkAt(cairo_surface_t* image, double xPoints, double yPoints) {
+  double scale = kReadDpi / 72.0;
+  int x = (int)(xPoints * scale);
+  int y = (int)(yPoints * scale);
+  const unsigned char* pixel = cairo_image_surface_get_data(image) +
+                               (size_t)y * cairo_image_surface_get_stride(image) + x * 4;
+  return pixel[0] < 128 && pixel[1] < 128 && pixel[2] < 128;
+}
+
+// The NumberedPage index of a render at kReadDpi, -1 without the anchor.
+int ReadPageNumber(cairo_surface_t* image) {
+  cairo_surface_flush(image);
+  double half = kCellSize / 2;
+  if (!DarkAt(image, kCellLeft + half, kAnchorTop + half)) return -1;
+  int index = 0;
+  for (int bit = 0; bit < kNumberBits; bit++) {
+    if (DarkAt(image, kCellLeft + bit * kCellPitch + half, kCellTop + half)) index |= 1 << bit;
+  }
+  return index;
+}
+
+// Written once for the whole test program.
+const std::string& Fixture() {
+  static ScopedTestFile file("print_job_fixture.pdf");
+  static bool written = [] {
+    std::vector<TestPage> pages;
+    for (int i = 0; i < kFixturePages; i++) pages.push_back(NumberedPage(i));
+    return WriteTestPdf(file.path(), pages);
+  }();
+  EXPECT_TRUE(written);
+  return file.path();
+}
+
+// Spools |settings|' selection of the fixture through a PdfFileSink and
+// reads back which fixture page every output page shows, in output order.
+std::vector<int> SpoolFixture(const PrintSettings& settings, SpoolResult* result) {
+  std::vector<int> printed;
+  std::string error;
+  DocumentLease lease = DocumentCache::Shared().Acquire(Fixture(), &error);
+  EXPECT_TRUE(lease) << error;
+  if (!lease) return printed;
+
+  ScopedTestFile output("print_job_output.pdf");
+  PdfFileSink sink(output.path(), PageSetup());
+  EXPECT_TRUE(sink.StartDocument("Page range", nullptr));
+  *result = SpoolPages(&sink, &lease, Fixture(), settings, nullptr);
+  EXPECT_TRUE(sink.EndDocument());
+  EXPECT_EQ(sink.page_setups().size(), (size_t)result->pagesSpooled);
+
+  PopplerDocument* document = OpenTestPdf(output.path());
+  EXPECT_NE(document, nullptr);
+  if (!document) return printed;
+  for (int i = 0; i < poppler_document_get_n_pages(document); i++) {
+    PopplerPage* page = poppler_document_get_page(document, i);
+    cairo_surface_t* image = RenderPageToImage(page, kReadDpi);
+    printed.push_back(image ? ReadPageNumber(image) : -1);
+    if (image) cairo_surface_destroy(image);
+    g_object_unref(page);
+  }
+  g_object_unref(document);
+  return printed;
+}
+
+std::vector<int> Range(int first, int last) {
+  std::vector<int> indices;
+  for (int i = first; i <= last; i++) indices.push_back(i);
+  return indices;
+}
+
+TEST(PrintJobTest, PageSelectionBecomesValidIndices) {
+  PrintSettings settings;
+  EXPECT_EQ(ResolvePageIndices(settings, 3), Range(0, 2));
+
+  settings.pagesStart = 2;
+  settings.pageEnd = 4;
+  EXPECT_EQ(ResolvePageIndices(settings, 10), Range(1, 3));
+  // Past the end is cut to the document; 0 means to the last page.
+  settings.pageEnd = 40;
+  EXPECT_EQ(ResolvePageIndices(settings, 5), Range(1, 4));
+  settings.pageEnd = 0;
+  EXPECT_EQ(ResolvePageIndices(settings, 5), Range(1, 4));
+  settings.pagesStart = 7;
+  EXPECT_TRUE(ResolvePageIndices(settings, 5).empty());
+
+  // A list wins over the range, keeps its order and repeats, and drops
+  // pages the document does not have.
+  settings.pages = {3, 1, 0, 3, 6, -2};
+  EXPECT_EQ(ResolvePageIndices(settings, 5), (std::vector<int>{2, 0, 2}));
+}
+
+struct RangeCase {
+  const char* name;
+  int pagesStart;
+  int pageEnd;
+  std::vector<int> pages;
+  int pipelineDepth;
+  std::vector<int> expected;
+};
+
+// 10, 100 and 500 pages out of the 520-page fixture, straight from the
+// original document: every selected page once, in the order asked for.
+TEST(PrintJobTest, SpoolsPageRangesInOrder) {
+  std::vector<int> descending;
+  for (int page = 300; page > 200; page--) descending.push_back(page);
+  std::vector<int> descendingIndices;
+  for (int page : descending) descendingIndices.push_back(page - 1);
+
+  const RangeCase cases[] = {
+      {"10-page range", 5, 14, {}, 0, Range(4, 13)},
+      {"100-page list", 0, 0, descending, 4, descendingIndices},
+      {"500-page range", 11, 510, {}, 0, Range(10, 509)},
+      {"500-page range, pipelined", 11, 510, {}, 4, Range(10, 509)},
+      {"range past the end", 511, 600, {}, 0, Range(510, kFixturePages - 1)},
+  };
+  for (const RangeCase& test : cases) {
+    SCOPED_TRACE(test.name);
+    PrintSettings settings;
+    settings.pagesStart = test.pagesStart;
+    settings.pageEnd = test.pageEnd;
+    settings.pages = test.pages;
+    settings.pipelineDepth = test.pipelineDepth;
+    SpoolResult result;
+    std::vector<int> printed = SpoolFixture(settings, &result);
+    EXPECT_TRUE(result.ok) << result.errorMessage;
+    EXPECT_EQ(result.pagesSpooled, (int)test.expected.size());
+    EXPECT_EQ(printed, test.expected);
+    printf("%-26s %3d pages in %6.1f ms\n", test.name, result.pagesSpooled, result.elapsedMs);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,290 @@
+#include "print_transaction.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "page_rasterizer.h"
+#include "pdf_file_sink.h"
+#include "separator_cache.h"
+#include "test_documents.h"
+
+namespace {
+
+// Paper sizes in points, as PdfFileSink lays them out.
+constexpr double kA4Width = 595.28;
+constexpr double kA4Height = 841.89;
+constexpr double kA5Width = 419.53;
+constexpr double kA5Height = 595.28;
+
+// Every fixture page carries its section and page number as a row of black
+// cells, one per bit, with an always-black anchor cell below; the row fits
+// on A5 portrait. Blank padding pages have no anchor.
+constexpr int kPageBits = 3;
+constexpr int kCodeBits = 6;
+constexpr double kCellLeft = 40.0;
+constexpr double kCellTop = 40.0;
+constexpr double kCellPitch = 50.0;
+constexpr double kCellSize = 30.0;
+constexpr double kAnchorTop = 100.0;
+constexpr double kReadDpi = 36.0;
+constexpr int kBlank = -1;
+
+int PageCode(int section, int page) { return (section << kPageBits) | page; }
+
+TestPage CodedPage(double width, double height, int code) {
+  TestPage page;
+  page.width = width;
+  page.height = height;
+  page.draw = [code](cairo_t* cr) {
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    for (int bit = 0; bit < kCodeBits; bit++) {
+      if (code & (1 << bit)) {
+        cairo_rectangle(cr, kCellLeft + bit * kCellPitch, kCellTop, kCellSize, kCellSize);
+      }
+    }
+    cairo_rectangle(cr, kCellLeft, kAnchorTop, kCellSize, kCellSize);
+    cairo_fill(cr);
+  };
+  return page;
+}
+
+std::vector<TestPage> CodedPages(double width, double height, int section, int count) {
+  std::vector<TestPage> pages;
+  for (int i = 0; i < count; i++) pages.push_back(CodedPage(width, height, PageCode(section, i)));
+  return pages;
+}
+
+bool DarkAt(cairo_surface_t* image, double xPoints, double yPoints) {
+  double scale = kReadDpi / 72.0;
+  int x = (int)(xPoints * scale);
+  int y = (int)(yPoints * scale);
+  const unsigned char* pixel = cairo_image_surface_get_data(image) +
+                               (size_t)y * cairo_image_surface_get_stride(image) + x * 4;
+  return pixel[0] < 128 && pixel[1] < 128 && pixel[2] < 128;
+}
+
+// The PageCode of a render at kReadDpi, kBlank without the anchor.
+int ReadPageCode(cairo_surface_t* image) {
+  cairo_surface_flush(image);
+  double half = kCellSize / 2;
+  if (!DarkAt(image, kCellLeft + half, kAnchorTop + half)) return kBlank;
+  int code = 0;
+  for (int bit = 0; bit < kCodeBits; bit++) {
+    if (DarkAt(image, kCellLeft + bit * kCellPitch + half, kCellTop + half)) code |= 1 << bit;
+  }
+  return code;
+}
+
+struct OutputPage {
+  int code = kBlank;
+  double width = 0.0;
+  double height = 0.0;
+};
+
+std::vector<OutputPage> ReadOutput(const std::string& path) {
+  std::vector<OutputPage> pages;
+  PopplerDocument* document = OpenTestPdf(path);
+  EXPECT_NE(document, nullptr);
+  if (!document) return pages;
+  for (int i = 0; i < poppler_document_get_n_pages(document); i++) {
+    PopplerPage* page = poppler_document_get_page(document, i);
+    OutputPage output;
+    poppler_page_get_size(page, &output.width, &output.height);
+    cairo_surface_t* image = RenderPageToImage(page, kReadDpi);
+    if (image) {
+      output.code = ReadPageCode(image);
+      cairo_surface_destroy(image);
+    }
+    pages.push_back(output);
+    g_object_unref(page);
+  }
+  g_object_unref(document);
+  return pages;
+}
+
+// An A5 invoice, the separator and an A4 file, as the Flutter side sends a
+// customer transaction. Section numbers go into the page codes.
+class TransactionFiles {
+ public:
+  TransactionFiles(const std::string& name, int invoiceSection, int fileSection)
+      : invoice_(name + "_invoice.pdf"), file_(name + "_file.pdf") {
+    EXPECT_TRUE(WriteTestPdf(invoice_.path(), CodedPages(kA5Width, kA5Height, invoiceSection, 1)));
+    EXPECT_TRUE(WriteTestPdf(file_.path(), CodedPages(kA4Width, kA4Height, fileSection, 3)));
+  }
+
+  // Invoice on duplex A5; the separator on A4, landscape like its page; the
+  // file in colour, 2 collated copies.
+  std::vector<TransactionSection> Sections(const std::string& printerName) const {
+    TransactionSection invoice;
+    invoice.filePath = invoice_.path();
+    invoice.settings.printerName = printerName;
+    invoice.settings.pageSize = "A5";
+    invoice.settings.doubleSided = true;
+
+    TransactionSection separator;
+    separator.type = TransactionSection::Type::kSeparator;
+    separator.settings.printerName = printerName;
+    separator.settings.pageSize = "A4";
+
+    TransactionSection file;
+    file.filePath = file_.path();
+    file.settings.printerName = printerName;
+    file.settings.pageSize = "A4";
+    file.settings.color = true;
+    file.settings.copies = 2;
+    return {invoice, separator, file};
+  }
+
+ private:
+  ScopedTestFile invoice_;
+  ScopedTestFile file_;
+};
+
+constexpr int kSeparatorSection = 2;
+
+class PrintTransactionTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    static ScopedTestFile separator("transaction_separator.pdf");
+    ASSERT_TRUE(WriteTestPdf(separator.path(),
+                             CodedPages(kA4Height, kA4Width, kSeparatorSection, 1)));
+    std::string error;
+    ASSERT_TRUE(SeparatorCache::Shared().Load(separator.path(), &error)) << error;
+  }
+
+  // Prepares and spools |sections| into a PdfFileSink at |path| the way the
+  // Linux runner's "file" printer does.
+  static SpoolResult Spool(const std::vector<TransactionSection>& sections,
+                           const std::string& path, std::vector<PageSetup>* setups,
+                           std::vector<int>* progress) {
+    SpoolResult result;
+    std::vector<PreparedSection> prepared;
+    if (!PrepareTransaction(sections, &prepared, &result.errorCode, &result.errorMessage)) {
+      return result;
+    }
+    PdfFileSink sink(path, prepared.front().setup);
+    if (!sink.StartDocument("Transaction", nullptr)) return result;
+    result = SpoolTransaction(&sink, &prepared, [progress](int pagesSpooled, int) {
+      if (progress) progress->push_back(pagesSpooled);
+    });
+    if (!sink.EndDocument()) result.ok = false;
+    if (setups) *setups = sink.page_setups();
+    return result;
+  }
+};
+
+// One spooler document: invoice, blank back, separator, then both copies of
+// the file, each section on its own paper and orientation.
+TEST_F(PrintTransactionTest, SectionsComeOutInOrderWithTheirOwnSetup) {
+  TransactionFiles files("transaction", 1, 3);
+  std::vector<PreparedSection> prepared;
+  std::string errorCode, errorMessage;
+  ASSERT_TRUE(PrepareTransaction(files.Sections("Kasir"), &prepared, &errorCode, &errorMessage))
+      << errorMessage;
+  ASSERT_EQ(prepared.size(), 3u);
+  EXPECT_EQ(prepared[0].estimatedPages, 1);
+  EXPECT_EQ(prepared[1].estimatedPages, 1);
+  EXPECT_TRUE(prepared[1].setup.landscape);
+  EXPECT_EQ(prepared[2].estimatedPages, 6);
+  // Driver copies would repeat the whole transaction.
+  EXPECT_TRUE(prepared[2].section.settings.softwareCopies);
+  prepared.clear();
+
+  ScopedTestFile output("transaction_output.pdf");
+  std::vector<PageSetup> setups;
+  std::vector<int> progress;
+  SpoolResult result = Spool(files.Sections("Kasir"), output.path(), &setups, &progress);
+  ASSERT_TRUE(result.ok) << result.errorCode << ": " << result.errorMessage;
+  EXPECT_EQ(result.pagesSpooled, 8);
+  printf("transaction: %d pages in %.1f ms\n", result.pagesSpooled, result.elapsedMs);
+
+  struct Expected {
+    int code;
+    const char* pageSize;
+    bool landscape;
+    bool duplex;
+    bool color;
+  };
+  const Expected expected[] = {
+      {PageCode(1, 0), "A5", false, true, false},
+      {kBlank, "A5", false, true, false},
+      {PageCode(kSeparatorSection, 0), "A4", true, false, false},
+      {PageCode(3, 0), "A4", false, false, true},
+      {PageCode(3, 1), "A4", false, false, true},
+      {PageCode(3, 2), "A4", false, false, true},
+      {PageCode(3, 0), "A4", false, false, true},
+      {PageCode(3, 1), "A4", false, false, true},
+      {PageCode(3, 2), "A4", false, false, true},
+  };
+  std::vector<OutputPage> pages = ReadOutput(output.path());
+  ASSERT_EQ(pages.size(), std::size(expected));
+  ASSERT_EQ(setups.size(), std::size(expected));
+  for (size_t i = 0; i < pages.size(); i++) {
+    SCOPED_TRACE("output page " + std::to_string(i + 1));
+    EXPECT_EQ(pages[i].code, expected[i].code);
+    EXPECT_EQ(setups[i].pageSize, expected[i].pageSize);
+    EXPECT_EQ(setups[i].landscape, expected[i].landscape);
+    EXPECT_EQ(setups[i].duplex, expected[i].duplex);
+    EXPECT_EQ(setups[i].color, expected[i].color);
+
+    double width = 0.0, height = 0.0;
+    PageSizeInPoints(setups[i], &width, &height);
+    EXPECT_NEAR(pages[i].width, width, 0.5);
+    EXPECT_NEAR(pages[i].height, height, 0.5);
+  }
+
+  // Progress counts the transaction's pages, padding not included.
+  EXPECT_EQ(progress, (std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8}));
+}
+
+// A missing file fails the whole transaction before anything is spooled.
+TEST_F(PrintTransactionTest, MissingFileFailsBeforeSpooling) {
+  TransactionFiles files("transaction_missing", 1, 3);
+  std::vector<TransactionSection> sections = files.Sections("Kasir");
+  sections[2].filePath = TestFilePath("transaction_no_such_file.pdf");
+  std::vector<PreparedSection> prepared;
+  std::string errorCode, errorMessage;
+  EXPECT_FALSE(PrepareTransaction(sections, &prepared, &errorCode, &errorMessage));
+  EXPECT_EQ(errorCode, "POPPLER_LOAD_ERROR");
+}
+
+// Two transactions spooled at the same time, sharing the separator's
+// display lists, each end up with only their own pages in their own order.
+TEST_F(PrintTransactionTest, ConcurrentTransactionsDoNotInterleave) {
+  TransactionFiles first("transaction_a", 1, 3);
+  TransactionFiles second("transaction_b", 4, 5);
+  ScopedTestFile firstOutput("transaction_a_output.pdf");
+  ScopedTestFile secondOutput("transaction_b_output.pdf");
+
+  constexpr int kRounds = 4;
+  SpoolResult firstResult, secondResult;
+  std::vector<int> firstCodes, secondCodes;
+  for (int round = 0; round < kRounds; round++) {
+    SCOPED_TRACE("round " + std::to_string(round));
+    std::thread other([&] {
+      secondResult = Spool(second.Sections("Dapur"), secondOutput.path(), nullptr, nullptr);
+    });
+    firstResult = Spool(first.Sections("Kasir"), firstOutput.path(), nullptr, nullptr);
+    other.join();
+    ASSERT_TRUE(firstResult.ok) << firstResult.errorMessage;
+    ASSERT_TRUE(secondResult.ok) << secondResult.errorMessage;
+
+    firstCodes.clear();
+    for (const OutputPage& page : ReadOutput(firstOutput.path())) firstCodes.push_back(page.code);
+    secondCodes.clear();
+    for (const OutputPage& page : ReadOutput(secondOutput.path())) secondCodes.push_back(page.code);
+    EXPECT_EQ(firstCodes, (std::vector<int>{PageCode(1, 0), kBlank, PageCode(kSeparatorSection, 0),
+                                            PageCode(3, 0), PageCode(3, 1), PageCode(3, 2),
+                                            PageCode(3, 0), PageCode(3, 1), PageCode(3, 2)}));
+    EXPECT_EQ(secondCodes, (std::vector<int>{PageCode(4, 0), kBlank, PageCode(kSeparatorSection, 0),
+                                             PageCode(5, 0), PageCode(5, 1), PageCode(5, 2),
+                                             PageCode(5, 0), PageCode(5, 1), PageCode(5, 2)}));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,270 @@
+#include "printer_capability_db.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using std::chrono::milliseconds;
+
+PaperInfo Paper(int id, const std::string& name, int width, int height) {
+  PaperInfo paper;
+  paper.id = id;
+  paper.name = name;
+  paper.width = width;
+  paper.height = height;
+  return paper;
+}
+
+// Papers as a typical receipt-office laser driver names them.
+PrinterCapabilities LaserCapabilities(const std::string& driverVersion) {
+  PrinterCapabilities caps;
+  caps.driverVersion = driverVersion;
+  caps.papers = {Paper(9, "A4 210 x 297 mm", 2100, 2970),
+                 Paper(1, "Letter", 2159, 2794),
+                 Paper(5, "US Legal 8.5x14in", 2160, 3560),
+                 Paper(11, "A5 Extra", 1740, 2350),
+                 Paper(0, "A5", 1480, 2100),
+                 Paper(14, "Folio", 2159, 3302),
+                 Paper(27, "Envelope DL", 1100, 2200)};
+  caps.dpis = {300, 600};
+  caps.duplex = true;
+  caps.marginLeft = 4.25;
+  caps.marginTop = 4.5;
+  caps.marginRight = 4.25;
+  caps.marginBottom = 12.0;
+  return caps;
+}
+
+// Printers the test sets up, counting the database's calls. Thread-safe:
+// Preload calls in from the database thread.
+class FakeCapabilityProvider : public CapabilityProvider {
+ public:
+  struct State {
+    std::mutex mutex;
+    std::map<std::string, PrinterCapabilities> printers;
+    int queries = 0;
+  };
+
+  explicit FakeCapabilityProvider(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+  std::vector<std::string> ListPrinters() override {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    std::vector<std::string> names;
+    for (const auto& printer : state_->printers) names.push_back(printer.first);
+    return names;
+  }
+
+  bool DriverVersion(const std::string& printer, std::string* version) override {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    auto it = state_->printers.find(printer);
+    if (it == state_->printers.end()) return false;
+    *version = it->second.driverVersion;
+    return true;
+  }
+
+  bool Query(const std::string& printer, PrinterCapabilities* caps) override {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->queries++;
+    auto it = state_->printers.find(printer);
+    if (it == state_->printers.end()) return false;
+    *caps = it->second;
+    return true;
+  }
+
+ private:
+  std::shared_ptr<State> state_;
+};
+
+class PrinterCapabilityDbTest : public ::testing::Test {
+ protected:
+  PrinterCapabilityDbTest()
+      : path_((std::filesystem::temp_directory_path() /
+               ("printer_caps_" + std::to_string((uintptr_t)this) + ".txt"))
+                  .string()) {}
+
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+
+  // A database over its own fake provider, which |printers| go into.
+  std::unique_ptr<PrinterCapabilityDb> NewDb(
+      const std::map<std::string, PrinterCapabilities>& printers,
+      std::shared_ptr<FakeCapabilityProvider::State>* state) {
+    *state = std::make_shared<FakeCapabilityProvider::State>();
+    (*state)->printers = printers;
+    return std::make_unique<PrinterCapabilityDb>(std::make_unique<FakeCapabilityProvider>(*state));
+  }
+
+  static int Queries(const std::shared_ptr<FakeCapabilityProvider::State>& state) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->queries;
+  }
+
+  // Waits until |db| has rebuilt |count| entries.
+  static bool WaitRebuilds(PrinterCapabilityDb* db, int64_t count) {
+    auto deadline = std::chrono::steady_clock::now() + milliseconds(2000);
+    while (db->stats().rebuilds < count) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+  }
+
+  std::string path_;
+};
+
+TEST_F(PrinterCapabilityDbTest, PrinterIsQueriedOnce) {
+  std::shared_ptr<FakeCapabilityProvider::State> state;
+  auto db = NewDb({{"Kasir", LaserCapabilities("1.0")}}, &state);
+  auto first = db->Get("Kasir");
+  auto second = db->Get("Kasir");
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(Queries(state), 1);
+  EXPECT_EQ(db->stats().misses, 1);
+  EXPECT_EQ(db->stats().hits, 1);
+
+  EXPECT_FALSE(db->Get("Dapur"));
+
+  db->Invalidate("Kasir");
+  ASSERT_TRUE(db->Get("Kasir"));
+  EXPECT_EQ(Queries(state), 3);
+}
+
+TEST_F(PrinterCapabilityDbTest, EntriesSurviveSaveAndReload) {
+  PrinterCapabilities laser = LaserCapabilities("1.0");
+  PrinterCapabilities thermal;
+  thermal.driverVersion = "Thermal\t2";  // Tabs separate fields in the file.
+  thermal.papers = {Paper(0, "Roll 80 mm", 800, 2970)};
+  {
+    std::shared_ptr<FakeCapabilityProvider::State> state;
+    auto db = NewDb({{"Kasir", laser}, {"Dapur", thermal}}, &state);
+    db->Open(path_);
+    ASSERT_TRUE(db->Get("Kasir"));
+    ASSERT_TRUE(db->Get("Dapur"));
+  }
+
+  // No printers at all: everything has to come from the file.
+  std::shared_ptr<FakeCapabilityProvider::State> state;
+  auto db = NewDb({}, &state);
+  db->Open(path_);
+  auto caps = db->Get("Kasir");
+  ASSERT_TRUE(caps);
+  EXPECT_EQ(caps->driverVersion, "1.0");
+  EXPECT_EQ(caps->dpis, laser.dpis);
+  EXPECT_TRUE(caps->duplex);
+  EXPECT_FALSE(caps->color);
+  EXPECT_DOUBLE_EQ(caps->marginLeft, 4.25);
+  EXPECT_DOUBLE_EQ(caps->marginTop, 4.5);
+  EXPECT_DOUBLE_EQ(caps->marginRight, 4.25);
+  EXPECT_DOUBLE_EQ(caps->marginBottom, 12.0);
+  ASSERT_EQ(caps->papers.size(), laser.papers.size());
+  for (size_t i = 0; i < laser.papers.size(); i++) {
+    EXPECT_EQ(caps->papers[i].id, laser.papers[i].id);
+    EXPECT_EQ(caps->papers[i].name, laser.papers[i].name);
+    EXPECT_EQ(caps->papers[i].width, laser.papers[i].width);
+    EXPECT_EQ(caps->papers[i].height, laser.papers[i].height);
+  }
+
+  auto roll = db->Get("Dapur");
+  ASSERT_TRUE(roll);
+  EXPECT_EQ(roll->driverVersion, "Thermal 2");
+  EXPECT_TRUE(roll->dpis.empty());
+  ASSERT_EQ(roll->papers.size(), 1u);
+  EXPECT_EQ(roll->papers[0].name, "Roll 80 mm");
+  EXPECT_EQ(Queries(state), 0);
+}
+
+TEST_F(PrinterCapabilityDbTest, DriverUpdateRebuildsOnPreload) {
+  {
+    std::shared_ptr<FakeCapabilityProvider::State> state;
+    auto db = NewDb({{"Kasir", LaserCapabilities("1.0")}, {"Dapur", LaserCapabilities("7")}},
+                    &state);
+    db->Open(path_);
+    ASSERT_TRUE(db->Get("Kasir"));
+    ASSERT_TRUE(db->Get("Dapur"));
+  }
+
+  // The new driver calls its A4 paper differently.
+  PrinterCapabilities updated = LaserCapabilities("2.0");
+  updated.papers[0].name = "A4";
+  std::shared_ptr<FakeCapabilityProvider::State> state;
+  auto db = NewDb({{"Kasir", updated}, {"Dapur", LaserCapabilities("7")}}, &state);
+  db->Open(path_);
+  std::string name;
+  ASSERT_TRUE(db->ResolvePaperName("Kasir", "A4", &name));
+  EXPECT_EQ(name, "A4 210 x 297 mm");
+
+  db->Preload();
+  ASSERT_TRUE(WaitRebuilds(db.get(), 1));
+  EXPECT_EQ(db->Get("Kasir")->driverVersion, "2.0");
+  ASSERT_TRUE(db->ResolvePaperName("Kasir", "A4", &name));
+  EXPECT_EQ(name, "A4");
+  // The printer whose driver did not change was not queried again.
+  EXPECT_EQ(Queries(state), 1);
+  EXPECT_EQ(db->stats().rebuilds, 1);
+
+  db.reset();
+  auto reloaded = NewDb({}, &state);
+  reloaded->Open(path_);
+  ASSERT_TRUE(reloaded->Get("Kasir"));
+  EXPECT_EQ(reloaded->Get("Kasir")->driverVersion, "2.0");
+}
+
+TEST_F(PrinterCapabilityDbTest, ResolvesAppPaperNames) {
+  std::shared_ptr<FakeCapabilityProvider::State> state;
+  auto db = NewDb({{"Kasir", LaserCapabilities("1.0")}}, &state);
+  struct {
+    const char* target;
+    const char* expected;
+  } cases[] = {
+      {"A4", "A4 210 x 297 mm"},       // by standard size
+      {"letter", "Letter"},            // exact, any case
+      {"Legal", "US Legal 8.5x14in"},  // by size, within the tolerance
+      {"A5", "A5"},                    // exact beats the longer "A5 Extra"
+      {"F4", "Folio"},                 // drivers call F4 Folio or Oficio
+      {"DL", "Envelope DL"},           // the name contains the target
+  };
+  for (const auto& test : cases) {
+    std::string name;
+    EXPECT_TRUE(db->ResolvePaperName("Kasir", test.target, &name)) << test.target;
+    EXPECT_EQ(name, test.expected) << test.target;
+  }
+
+  // Nothing matches: the caller prints on the driver's default paper.
+  std::string name = "unchanged";
+  EXPECT_FALSE(db->ResolvePaperName("Kasir", "Tabloid", &name));
+  EXPECT_TRUE(name.empty());
+  EXPECT_FALSE(db->ResolvePaperName("Dapur", "A4", &name));
+}
+
+TEST_F(PrinterCapabilityDbTest, ResolvedNamesAreMemoised) {
+  std::shared_ptr<FakeCapabilityProvider::State> state;
+  auto db = NewDb({{"Kasir", LaserCapabilities("1.0")}}, &state);
+  std::string name;
+  ASSERT_TRUE(db->ResolvePaperName("Kasir", "A4", &name));
+  CapabilityDbStats before = db->stats();
+  ASSERT_TRUE(db->ResolvePaperName("Kasir", "a4", &name));
+  EXPECT_EQ(name, "A4 210 x 297 mm");
+  EXPECT_FALSE(db->ResolvePaperName("Kasir", "Tabloid", &name));
+  EXPECT_FALSE(db->ResolvePaperName("Kasir", "TABLOID", &name));
+  CapabilityDbStats after = db->stats();
+  // The second lookup of each name comes from the memo alone.
+  EXPECT_EQ(after.hits - before.hits, 3);
+  EXPECT_EQ(after.misses, before.misses);
+  EXPECT_EQ(Queries(state), 1);
+}
+
+}  // namespace
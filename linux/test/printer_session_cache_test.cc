@@ -0,0 +1,238 @@
+#include "printer_session_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// What the fake driver was asked to do; shared with the test because the
+// cache owns the driver.
+struct DriverLog {
+  std::mutex mutex;
+  std::set<std::string> printers = {"Kasir", "Gudang"};
+  std::map<std::string, int> opens;
+  std::map<std::string, int> builds;
+  std::set<std::string> changed;
+  std::set<PrinterDriver::Handle> open;
+  int closes = 0;
+};
+
+// PrinterDriver without a spooler. Handles are heap cells holding the
+// printer name; a DEVMODE is the request's fields as bytes.
+class FakePrinterDriver : public PrinterDriver {
+ public:
+  explicit FakePrinterDriver(std::shared_ptr<DriverLog> log) : log_(std::move(log)) {}
+
+  Handle Open(const std::string& printerName) override {
+    std::lock_guard<std::mutex> lock(log_->mutex);
+    log_->opens[printerName]++;
+    if (!log_->printers.count(printerName)) return nullptr;
+    Handle handle = new std::string(printerName);
+    log_->open.insert(handle);
+    return handle;
+  }
+
+  void Close(Handle handle) override {
+    std::lock_guard<std::mutex> lock(log_->mutex);
+    EXPECT_EQ(log_->open.erase(handle), 1u) << "closed twice or never opened";
+    log_->closes++;
+    delete static_cast<std::string*>(handle);
+  }
+
+  bool BuildDevMode(Handle handle, const std::string& printerName,
+                    const DevModeRequest& request,
+                    std::vector<unsigned char>* devMode,
+                    std::string* errorCode) override {
+    std::lock_guard<std::mutex> lock(log_->mutex);
+    EXPECT_TRUE(log_->open.count(handle));
+    EXPECT_EQ(*static_cast<std::string*>(handle), printerName);
+    log_->builds[printerName]++;
+    if (request.paperSize < 0) {
+      if (errorCode) *errorCode = "INVALID_DEVMODE";
+      return false;
+    }
+    *devMode = Encode(request);
+    return true;
+  }
+
+  bool ConsumeChange(Handle handle) override {
+    std::lock_guard<std::mutex> lock(log_->mutex);
+    return log_->changed.erase(*static_cast<std::string*>(handle)) > 0;
+  }
+
+  static std::vector<unsigned char> Encode(const DevModeRequest& request) {
+    return {static_cast<unsigned char>(request.paperSize),
+            static_cast<unsigned char>(request.color),
+            static_cast<unsigned char>(request.duplex),
+            static_cast<unsigned char>(request.landscape)};
+  }
+
+ private:
+  std::shared_ptr<DriverLog> log_;
+};
+
+class PrinterSessionCacheTest : public ::testing::Test {
+ protected:
+  PrinterSessionCacheTest()
+      : log_(std::make_shared<DriverLog>()),
+        cache_(std::make_unique<PrinterSessionCache>(
+            std::make_unique<FakePrinterDriver>(log_))) {}
+
+  bool Acquire(const std::string& printer, const DevModeRequest& request,
+               bool* hit, std::vector<unsigned char>* devMode = nullptr) {
+    std::vector<unsigned char> bytes;
+    std::string error;
+    bool ok = cache_->AcquireDevMode(printer, request, &bytes, hit, &error);
+    if (devMode) *devMode = bytes;
+    return ok;
+  }
+
+  std::shared_ptr<DriverLog> log_;
+  std::unique_ptr<PrinterSessionCache> cache_;
+};
+
+const DevModeRequest kA4Mono = {9, false, false, false};
+const DevModeRequest kA4ColorDuplex = {9, true, true, false};
+
+TEST_F(PrinterSessionCacheTest, RepeatedRequestSkipsTheDriver) {
+  bool hit = true;
+  std::vector<unsigned char> first;
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit, &first));
+  EXPECT_FALSE(hit);
+  EXPECT_EQ(first, FakePrinterDriver::Encode(kA4Mono));
+
+  for (int i = 0; i < 10; i++) {
+    std::vector<unsigned char> again;
+    ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit, &again));
+    EXPECT_TRUE(hit);
+    EXPECT_EQ(again, first);
+  }
+  EXPECT_EQ(log_->opens["Kasir"], 1);
+  EXPECT_EQ(log_->builds["Kasir"], 1);
+
+  PrinterSessionStats stats = cache_->stats();
+  EXPECT_EQ(stats.hits, 10);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+TEST_F(PrinterSessionCacheTest, EachCombinationIsBuiltOnceOnOneHandle) {
+  bool hit = false;
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  ASSERT_TRUE(Acquire("Kasir", kA4ColorDuplex, &hit));
+  EXPECT_FALSE(hit);
+  ASSERT_TRUE(Acquire("Kasir", kA4ColorDuplex, &hit));
+  EXPECT_TRUE(hit);
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  EXPECT_TRUE(hit);
+
+  EXPECT_EQ(log_->opens["Kasir"], 1);
+  EXPECT_EQ(log_->builds["Kasir"], 2);
+}
+
+TEST_F(PrinterSessionCacheTest, DriverChangeRebuildsTheSession) {
+  bool hit = false;
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  ASSERT_TRUE(Acquire("Gudang", kA4Mono, &hit));
+  log_->changed.insert("Kasir");
+
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  EXPECT_FALSE(hit);
+  EXPECT_EQ(log_->opens["Kasir"], 2);
+  EXPECT_EQ(log_->builds["Kasir"], 2);
+  EXPECT_EQ(log_->closes, 1);
+  EXPECT_EQ(cache_->stats().invalidations, 1);
+
+  // The other printer keeps its session.
+  ASSERT_TRUE(Acquire("Gudang", kA4Mono, &hit));
+  EXPECT_TRUE(hit);
+}
+
+TEST_F(PrinterSessionCacheTest, InvalidateClosesTheHandle) {
+  bool hit = false;
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  cache_->Invalidate("Kasir");
+  EXPECT_TRUE(log_->open.empty());
+  // Unknown printers are ignored.
+  cache_->Invalidate("Dapur");
+
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  EXPECT_FALSE(hit);
+  EXPECT_EQ(log_->opens["Kasir"], 2);
+}
+
+TEST_F(PrinterSessionCacheTest, UnknownPrinterIsRetried) {
+  std::vector<unsigned char> devMode;
+  std::string error;
+  bool hit = true;
+  EXPECT_FALSE(cache_->AcquireDevMode("Dapur", kA4Mono, &devMode, &hit, &error));
+  EXPECT_FALSE(hit);
+  EXPECT_EQ(error, "PRINTER_NOT_FOUND");
+
+  // Nothing negative is cached: once the printer is installed it opens.
+  log_->printers.insert("Dapur");
+  EXPECT_TRUE(cache_->AcquireDevMode("Dapur", kA4Mono, &devMode, &hit, &error));
+  EXPECT_EQ(log_->opens["Dapur"], 2);
+}
+
+TEST_F(PrinterSessionCacheTest, FailedBuildIsNotCached) {
+  DevModeRequest invalid = kA4Mono;
+  invalid.paperSize = -1;
+  std::vector<unsigned char> devMode;
+  std::string error;
+  EXPECT_FALSE(cache_->AcquireDevMode("Kasir", invalid, &devMode, nullptr, &error));
+  EXPECT_EQ(error, "INVALID_DEVMODE");
+  EXPECT_FALSE(cache_->AcquireDevMode("Kasir", invalid, &devMode, nullptr, &error));
+  EXPECT_EQ(log_->builds["Kasir"], 2);
+  // The handle itself stays open for the next request.
+  EXPECT_EQ(log_->opens["Kasir"], 1);
+}
+
+TEST_F(PrinterSessionCacheTest, DestructorClosesEveryHandle) {
+  bool hit = false;
+  ASSERT_TRUE(Acquire("Kasir", kA4Mono, &hit));
+  ASSERT_TRUE(Acquire("Gudang", kA4Mono, &hit));
+  EXPECT_EQ(log_->open.size(), 2u);
+  cache_.reset();
+  EXPECT_TRUE(log_->open.empty());
+  EXPECT_EQ(log_->closes, 2);
+}
+
+TEST_F(PrinterSessionCacheTest, ConcurrentJobsBuildEachDevModeOnce) {
+  const DevModeRequest requests[] = {kA4Mono, kA4ColorDuplex};
+  const char* printers[] = {"Kasir", "Gudang"};
+  std::atomic<int> failures{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 200; i++) {
+        const DevModeRequest& request = requests[(t + i) % 2];
+        std::vector<unsigned char> devMode;
+        std::string error;
+        if (!cache_->AcquireDevMode(printers[t % 2], request, &devMode, nullptr, &error) ||
+            devMode != FakePrinterDriver::Encode(request)) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_EQ(log_->opens["Kasir"], 1);
+  EXPECT_EQ(log_->opens["Gudang"], 1);
+  EXPECT_EQ(log_->builds["Kasir"], 2);
+  EXPECT_EQ(log_->builds["Gudang"], 2);
+  PrinterSessionStats stats = cache_->stats();
+  EXPECT_EQ(stats.hits + stats.misses, 8 * 200);
+  EXPECT_EQ(stats.misses, 4);
+}
+
+}  // namespace
@@ -0,0 +1,176 @@
+#include "printer_status_service.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fake_spooler.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// Well below PrinterStatusService::kRefreshInterval, so anything seen within
+// it came from a change notification.
+constexpr milliseconds kNotified{1000};
+
+// Long enough for a notification to have been handled, for checking that
+// nothing was published.
+constexpr milliseconds kQuiet{200};
+
+// Collects the service's change callbacks, which come from its thread.
+class StatusRecorder {
+ public:
+  PrinterStatusService::ChangeCallback Callback() {
+    return [this](const std::string& printer, const PrinterStatus& status) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      events_.emplace_back(printer, status);
+      changed_.notify_all();
+    };
+  }
+
+  // Waits until |count| events arrived in total. Returns false on timeout.
+  bool WaitEvents(size_t count, milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, timeout, [&] { return events_.size() >= count; });
+  }
+
+  std::vector<std::pair<std::string, PrinterStatus>> events() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+  }
+
+  PrinterStatus last() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_.empty() ? PrinterStatus() : events_.back().second;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::vector<std::pair<std::string, PrinterStatus>> events_;
+};
+
+class PrinterStatusServiceTest : public ::testing::Test {
+ protected:
+  PrinterStatusServiceTest()
+      : spooler_(std::make_shared<FakeSpooler>()),
+        service_(std::make_unique<PrinterStatusService>(spooler_->NewBackend(),
+                                                        recorder_.Callback())) {}
+
+  // Changes the printer status and waits for the event it causes.
+  void Transition(uint32_t status) {
+    size_t before = recorder_.events().size();
+    spooler_->SetQueueStatus("Kasir", status);
+    ASSERT_TRUE(recorder_.WaitEvents(before + 1, kNotified));
+    EXPECT_EQ(recorder_.last().status, status);
+  }
+
+  StatusRecorder recorder_;
+  std::shared_ptr<FakeSpooler> spooler_;
+  std::unique_ptr<PrinterStatusService> service_;
+};
+
+TEST_F(PrinterStatusServiceTest, NewPrinterIsQueriedRightAway) {
+  spooler_->Submit("Kasir", "struk.pdf", 1);
+  service_->SetPrinters({"Kasir", "Kasir", ""});
+  ASSERT_TRUE(recorder_.WaitEvents(1, kNotified));
+
+  PrinterStatus status;
+  ASSERT_TRUE(service_->Get("Kasir", &status));
+  EXPECT_TRUE(status.online);
+  EXPECT_EQ(status.status, 0u);
+  EXPECT_EQ(status.queuedJobs, 1);
+  EXPECT_FALSE(service_->Get("Dapur", &status));
+  EXPECT_EQ(service_->Snapshot().size(), 1u);
+  EXPECT_EQ(spooler_->watched_queues(), 1);
+}
+
+// Online, offline, paper out and error each come out as exactly one event;
+// notifications that change nothing come out as none.
+TEST_F(PrinterStatusServiceTest, EachTransitionIsOneEvent) {
+  service_->SetPrinters({"Kasir"});
+  ASSERT_TRUE(recorder_.WaitEvents(1, kNotified));
+
+  Transition(kSpoolQueueOffline);
+  EXPECT_FALSE(recorder_.last().online);
+  Transition(0);
+  EXPECT_TRUE(recorder_.last().online);
+  Transition(kSpoolQueuePaperOut);
+  EXPECT_TRUE(recorder_.last().online);
+  Transition(kSpoolQueueError | kSpoolQueuePaperOut);
+  EXPECT_FALSE(recorder_.last().online);
+  Transition(0);
+  EXPECT_TRUE(recorder_.last().online);
+
+  spooler_->SetQueueStatus("Kasir", 0);
+  spooler_->SetQueueStatus("Kasir", 0);
+  std::this_thread::sleep_for(kQuiet);
+  std::vector<std::pair<std::string, PrinterStatus>> events = recorder_.events();
+  ASSERT_EQ(events.size(), 6u);
+  for (size_t i = 1; i < events.size(); i++) {
+    EXPECT_EQ(events[i].first, "Kasir");
+    EXPECT_NE(events[i].second, events[i - 1].second) << "event " << i;
+  }
+}
+
+TEST_F(PrinterStatusServiceTest, UnreachablePrinterIsOffline) {
+  service_->SetPrinters({"Kasir"});
+  ASSERT_TRUE(recorder_.WaitEvents(1, kNotified));
+
+  spooler_->SetQueueReachable("Kasir", false);
+  ASSERT_TRUE(recorder_.WaitEvents(2, kNotified));
+  EXPECT_FALSE(recorder_.last().online);
+  EXPECT_EQ(recorder_.last().status, (uint32_t)kSpoolQueueOffline);
+
+  // Its queue is reopened on the next refresh.
+  spooler_->SetQueueReachable("Kasir", true);
+  ASSERT_TRUE(recorder_.WaitEvents(3, PrinterStatusService::kRefreshInterval + kNotified));
+  EXPECT_TRUE(recorder_.last().online);
+  EXPECT_EQ(recorder_.events().size(), 3u);
+}
+
+TEST_F(PrinterStatusServiceTest, RefreshCatchesMissedNotification) {
+  service_->SetPrinters({"Kasir"});
+  ASSERT_TRUE(recorder_.WaitEvents(1, kNotified));
+
+  spooler_->set_drop_notifications(true);
+  spooler_->SetQueueStatus("Kasir", kSpoolQueuePaperOut);
+  EXPECT_FALSE(recorder_.WaitEvents(2, kNotified));
+  ASSERT_TRUE(recorder_.WaitEvents(2, PrinterStatusService::kRefreshInterval + kNotified));
+  EXPECT_EQ(recorder_.last().status, (uint32_t)kSpoolQueuePaperOut);
+  EXPECT_EQ(recorder_.events().size(), 2u);
+}
+
+TEST_F(PrinterStatusServiceTest, RemovedPrinterIsDropped) {
+  service_->SetPrinters({"Kasir", "Dapur"});
+  ASSERT_TRUE(recorder_.WaitEvents(2, kNotified));
+  EXPECT_EQ(spooler_->watched_queues(), 2);
+
+  service_->SetPrinters({"Dapur"});
+  PrinterStatus status;
+  auto deadline = std::chrono::steady_clock::now() + kNotified;
+  while (service_->Get("Kasir", &status) && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  EXPECT_FALSE(service_->Get("Kasir", &status));
+  EXPECT_TRUE(service_->Get("Dapur", &status));
+  EXPECT_EQ(spooler_->watched_queues(), 1);
+
+  // A removed printer's changes are not reported.
+  spooler_->SetQueueStatus("Kasir", kSpoolQueueError);
+  std::this_thread::sleep_for(kQuiet);
+  EXPECT_EQ(recorder_.events().size(), 2u);
+
+  service_.reset();
+  EXPECT_EQ(spooler_->watched_queues(), 0);
+}
+
+}  // namespace
@@ -0,0 +1,224 @@
+#include "pwg_raster.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const RasterColorSpace kSpaces[] = {RasterColorSpace::kBlack1, RasterColorSpace::kGray8,
+                                    RasterColorSpace::kRgb8};
+
+uint8_t White(RasterColorSpace space) {
+  return space == RasterColorSpace::kBlack1 ? 0x00 : 0xFF;
+}
+
+// Rows of |width| pixels that exercise every code of the line compression:
+// blank and repeated lines (more than one repeat group), runs longer than
+// one code, literal stretches, and lines ending in ink or in a white tail.
+std::vector<uint8_t> TestRows(RasterColorSpace space, int width, int rows, std::mt19937* random) {
+  size_t bytesPerLine = (size_t)RasterBytesPerLine(space, width);
+  int unit = space == RasterColorSpace::kRgb8 ? 3 : 1;
+  std::vector<uint8_t> data(bytesPerLine * rows, White(space));
+  for (int y = 0; y < rows; y++) {
+    uint8_t* line = data.data() + (size_t)y * bytesPerLine;
+    switch ((*random)() % 6) {
+      case 0:
+        break;
+      case 1:
+        if (y > 0) memcpy(line, line - bytesPerLine, bytesPerLine);
+        break;
+      case 2: {
+        // A long run of one colour somewhere in the line.
+        size_t start = (*random)() % bytesPerLine / unit * unit;
+        uint8_t value = (uint8_t)(*random)();
+        for (size_t x = start; x < bytesPerLine; x++) line[x] = value;
+        break;
+      }
+      case 3:
+        for (size_t x = 0; x < bytesPerLine; x++) line[x] = (uint8_t)(*random)();
+        break;
+      case 4:
+        // Text-like: short runs and single pixels, white to the right.
+        for (size_t x = 0; x < bytesPerLine / 2; x++) {
+          if ((*random)() % 3 == 0) line[x] = (uint8_t)((*random)() % 4 * 85);
+        }
+        break;
+      default:
+        // Ink in the very last pixel only.
+        line[bytesPerLine - 1] = (uint8_t)~White(space);
+        break;
+    }
+    // Bits past the last black_1 pixel are white, as RasterFileSink writes
+    // them.
+    if (space == RasterColorSpace::kBlack1 && width % 8) {
+      line[bytesPerLine - 1] &= (uint8_t)(0xFF << (8 - width % 8));
+    }
+  }
+  // Long blank stretch: more than one line-repeat group.
+  if (rows > 600) {
+    std::fill(data.begin() + bytesPerLine * 100, data.begin() + bytesPerLine * 400, White(space));
+  }
+  return data;
+}
+
+std::vector<uint8_t> EncodePage(const PwgPageHeader& header, const std::vector<uint8_t>& pixels,
+                                int partRows) {
+  std::vector<uint8_t> out(kPwgSyncWord, kPwgSyncWord + sizeof(kPwgSyncWord));
+  out.resize(out.size() + kPwgHeaderSize);
+  EncodePwgHeader(header, out.data() + sizeof(kPwgSyncWord));
+  size_t bytesPerLine = (size_t)RasterBytesPerLine(header.space, header.width);
+  // Parts are encoded separately and concatenated, as RasterFileSink does
+  // on its threads.
+  for (int top = 0; top < header.height; top += partRows) {
+    int rows = std::min(partRows, header.height - top);
+    EncodePwgLines(pixels.data() + bytesPerLine * top, bytesPerLine, rows, header.space,
+                   header.width, &out);
+  }
+  return out;
+}
+
+TEST(PwgRasterTest, HeaderRoundTrips) {
+  for (RasterColorSpace space : kSpaces) {
+    PwgPageHeader header;
+    header.width = 2480;
+    header.height = 3508;
+    header.dpi = 300;
+    header.space = space;
+    header.pageWidth = 595;
+    header.pageHeight = 842;
+    header.duplex = true;
+    header.tumble = true;
+    header.mediaName = "iso_a4_210x297mm";
+    header.totalPages = 3;
+    uint8_t encoded[kPwgHeaderSize];
+    EncodePwgHeader(header, encoded);
+
+    PwgPageHeader decoded;
+    ASSERT_TRUE(DecodePwgHeader(encoded, &decoded)) << RasterColorSpaceName(space);
+    EXPECT_EQ(decoded.width, header.width);
+    EXPECT_EQ(decoded.height, header.height);
+    EXPECT_EQ(decoded.dpi, header.dpi);
+    EXPECT_EQ(decoded.space, header.space);
+    EXPECT_EQ(decoded.pageWidth, header.pageWidth);
+    EXPECT_EQ(decoded.pageHeight, header.pageHeight);
+    EXPECT_TRUE(decoded.duplex);
+    EXPECT_TRUE(decoded.tumble);
+    EXPECT_EQ(decoded.mediaName, header.mediaName);
+    EXPECT_EQ(decoded.totalPages, header.totalPages);
+  }
+}
+
+TEST(PwgRasterTest, LinesRoundTripInEveryColorSpace) {
+  std::mt19937 random(5);
+  for (RasterColorSpace space : kSpaces) {
+    for (int width : {1, 2, 7, 8, 9, 15, 16, 17, 33, 127, 128, 129, 300, 1001}) {
+      SCOPED_TRACE(std::string(RasterColorSpaceName(space)) + " width " + std::to_string(width));
+      PwgPageHeader header;
+      header.width = width;
+      header.height = 700;
+      header.space = space;
+      std::vector<uint8_t> pixels = TestRows(space, width, header.height, &random);
+      // Two pages with different part sizes.
+      std::vector<uint8_t> stream = EncodePage(header, pixels, 64);
+      std::vector<uint8_t> second = EncodePage(header, pixels, 1);
+      stream.insert(stream.end(), second.begin() + sizeof(kPwgSyncWord), second.end());
+
+      int pages = 0;
+      std::string error;
+      ASSERT_TRUE(DecodePwgRaster(stream.data(), stream.size(),
+                                  [&](int index, const RasterPageImage& page) {
+                                    EXPECT_EQ(index, pages);
+                                    EXPECT_EQ(page.width, width);
+                                    EXPECT_EQ(page.height, header.height);
+                                    EXPECT_EQ(page.space, space);
+                                    EXPECT_TRUE(page.pixels == pixels) << "page " << index;
+                                    pages++;
+                                    return true;
+                                  },
+                                  &error))
+          << error;
+      EXPECT_EQ(pages, 2);
+    }
+  }
+}
+
+// Every proper prefix of a stream is refused: a truncated upload must never
+// pass HLAPRINT_VERIFY_RASTER.
+TEST(PwgRasterTest, TruncatedStreamsAreRefused) {
+  std::mt19937 random(9);
+  PwgPageHeader header;
+  header.width = 45;
+  header.height = 40;
+  header.space = RasterColorSpace::kRgb8;
+  std::vector<uint8_t> stream = EncodePage(header, TestRows(header.space, 45, 40, &random), 16);
+  std::string error;
+  ASSERT_TRUE(DecodePwgRaster(stream.data(), stream.size(), nullptr, &error)) << error;
+  for (size_t size = 0; size < stream.size(); size++) {
+    error.clear();
+    EXPECT_FALSE(DecodePwgRaster(stream.data(), size, nullptr, &error)) << "size " << size;
+    EXPECT_FALSE(error.empty());
+  }
+
+  std::vector<uint8_t> bad = stream;
+  bad[0] = 'X';
+  EXPECT_FALSE(DecodePwgRaster(bad.data(), bad.size(), nullptr, &error));
+}
+
+// A 300 dpi A4 page of invoice-like lines in each format. Prints pages per
+// second and bytes per page.
+TEST(PwgRasterBenchmark, InvoicePageAt300Dpi) {
+  constexpr int kWidth = 2480;
+  constexpr int kHeight = 3508;
+  std::mt19937 random(3);
+  for (RasterColorSpace space : kSpaces) {
+    size_t bytesPerLine = (size_t)RasterBytesPerLine(space, kWidth);
+    std::vector<uint8_t> pixels(bytesPerLine * kHeight, White(space));
+    // Text lines of 40 rows every 60 rows, words of 20 to 200 bytes.
+    for (int y = 150; y + 40 < kHeight - 150; y += 60) {
+      for (size_t x = bytesPerLine / 12; x < bytesPerLine * 3 / 4;) {
+        size_t word = 20 + random() % 180;
+        for (int row = y; row < y + 40; row++) {
+          uint8_t* line = pixels.data() + (size_t)row * bytesPerLine;
+          for (size_t i = x; i < std::min(x + word, bytesPerLine); i++) {
+            if (random() % 4 == 0) line[i] = (uint8_t)~White(space);
+          }
+        }
+        x += word + 30;
+      }
+    }
+
+    PwgPageHeader header;
+    header.width = kWidth;
+    header.height = kHeight;
+    header.space = space;
+    double bestMs = 1e9;
+    std::vector<uint8_t> stream;
+    for (int round = 0; round < 3; round++) {
+      auto start = std::chrono::steady_clock::now();
+      stream = EncodePage(header, pixels, kHeight);
+      bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count());
+    }
+    std::string error;
+    ASSERT_TRUE(DecodePwgRaster(stream.data(), stream.size(),
+                                [&pixels](int, const RasterPageImage& page) {
+                                  EXPECT_TRUE(page.pixels == pixels);
+                                  return true;
+                                },
+                                &error))
+        << error;
+    printf("%-8s %6.1f ms/page  %6.1f pages/s  %8zu bytes/page (%.1f%% of raw)\n",
+           RasterColorSpaceName(space), bestMs, 1000.0 / bestMs, stream.size(),
+           100.0 * stream.size() / pixels.size());
+  }
+}
+
+}  // namespace
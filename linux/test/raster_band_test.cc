@@ -0,0 +1,175 @@
+#include "raster_band.h"
+
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "raster_file_sink.h"
+#include "test_documents.h"
+
+namespace {
+
+struct PaperCase {
+  const char* paper;
+  int dpi;
+  // Portrait size in millimetres.
+  double widthMm;
+  double heightMm;
+};
+
+constexpr PaperCase kPapers[] = {
+    {"A4", 300, 210.0, 297.0},
+    {"A4", 600, 210.0, 297.0},
+    {"A3", 300, 297.0, 420.0},
+    {"A3", 600, 297.0, 420.0},
+};
+
+int DevicePixels(double mm, int dpi) { return (int)std::lround(mm / 25.4 * dpi); }
+
+// Largest resident set so far, in bytes.
+int64_t PeakResidentBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (int64_t)usage.ru_maxrss * 1024;
+}
+
+uint32_t PixelAt(cairo_surface_t* surface, int x, int y) {
+  const uint8_t* data = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  return reinterpret_cast<const uint32_t*>(data + (size_t)y * stride)[x] & 0xFFFFFF;
+}
+
+// Automatic bands never exceed kMaxRasterBandBytes, are whole multiples of
+// 8 rows except for the last, and tile the page without gaps.
+TEST(RasterBandsTest, AutomaticBandsStayWithinTheLimit) {
+  for (const PaperCase& paper : kPapers) {
+    SCOPED_TRACE(std::string(paper.paper) + " at " + std::to_string(paper.dpi) + " dpi");
+    int width = DevicePixels(paper.widthMm, paper.dpi);
+    int height = DevicePixels(paper.heightMm, paper.dpi);
+    RasterBands bands(width, height, 1.0, 1.0, 0);
+    EXPECT_EQ(bands.width(), width);
+    EXPECT_EQ(bands.height(), height);
+
+    bool fits = (size_t)width * height * 4 <= kMaxRasterBandBytes;
+    EXPECT_EQ(bands.band_count() == 1, fits);
+    int rows = 0;
+    for (int band = 0; band < bands.band_count(); band++) {
+      EXPECT_LE((size_t)bands.band_rows(band) * width * 4, kMaxRasterBandBytes) << "band " << band;
+      if (band + 1 < bands.band_count()) {
+        EXPECT_EQ(bands.band_rows(band) % 8, 0) << "band " << band;
+      }
+      EXPECT_EQ(bands.band_top(band), rows);
+      EXPECT_EQ(bands.device_top(band), rows);
+      rows += bands.band_rows(band);
+      EXPECT_EQ(bands.device_bottom(band), rows);
+    }
+    EXPECT_EQ(rows, height);
+  }
+}
+
+TEST(RasterBandsTest, RequestedRowsRoundUpToEight) {
+  RasterBands bands(100, 100, 1.0, 1.0, 13);
+  EXPECT_EQ(bands.band_rows(0), 16);
+  EXPECT_EQ(bands.band_count(), 7);
+  EXPECT_EQ(bands.band_rows(6), 4);
+
+  RasterBands tall(100, 20, 1.0, 1.0, 64);
+  EXPECT_EQ(tall.band_count(), 1);
+  EXPECT_EQ(tall.band_rows(0), 20);
+}
+
+// Stored at half the device resolution: band edges map back to device rows
+// that still tile the page.
+TEST(RasterBandsTest, ScaledBandsCoverEveryDeviceRow) {
+  RasterBands bands(200, 101, 0.5, 0.5, 16);
+  EXPECT_EQ(bands.width(), 100);
+  EXPECT_EQ(bands.height(), 51);
+  ASSERT_EQ(bands.band_count(), 4);
+  EXPECT_EQ(bands.device_top(0), 0);
+  EXPECT_EQ(bands.device_top(1), 32);
+  EXPECT_EQ(bands.device_top(3), 96);
+  EXPECT_EQ(bands.device_bottom(3), 101);
+}
+
+// Callers draw in page device pixels on every band; each band keeps only
+// its own rows.
+TEST(RasterBandsTest, BandSurfacesDrawInPageCoordinates) {
+  RasterBands bands(64, 40, 1.0, 1.0, 16);
+  ASSERT_EQ(bands.band_count(), 3);
+  for (int band = 0; band < bands.band_count(); band++) {
+    cairo_surface_t* surface = bands.CreateBandSurface(band);
+    ASSERT_NE(surface, nullptr);
+    EXPECT_EQ(cairo_image_surface_get_height(surface), bands.band_rows(band));
+    cairo_t* cr = cairo_create(surface);
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_rectangle(cr, 8.0, 14.0, 16.0, 4.0);  // Rows 14 to 17, across bands 0 and 1.
+    cairo_fill(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+    for (int row = 0; row < bands.band_rows(band); row++) {
+      int pageRow = bands.band_top(band) + row;
+      bool ink = pageRow >= 14 && pageRow < 18;
+      EXPECT_EQ(PixelAt(surface, 10, row), ink ? 0u : 0xFFFFFFu) << "page row " << pageRow;
+      EXPECT_EQ(PixelAt(surface, 30, row), 0xFFFFFFu) << "page row " << pageRow;
+    }
+    cairo_surface_destroy(surface);
+  }
+}
+
+// A4 and A3 at 300 and 600 dpi spooled through RasterFileSink with
+// automatic bands. The largest page is 7016 x 9921 pixels, 278 MB as one
+// RGB24 image; banded, the process must not grow by much more than one
+// band. Run first in a fresh process the peak says the most; later runs
+// can only come out lower.
+TEST(RasterBandsTest, SpoolingLargePagesKeepsMemoryBounded) {
+  constexpr int64_t kAllowedGrowth = 2 * (int64_t)kMaxRasterBandBytes;
+  int64_t before = PeakResidentBytes();
+  for (const PaperCase& paper : kPapers) {
+    SCOPED_TRACE(std::string(paper.paper) + " at " + std::to_string(paper.dpi) + " dpi");
+    ScopedTestFile file(std::string("bands_") + paper.paper + "_" + std::to_string(paper.dpi));
+    PageSetup setup;
+    setup.pageSize = paper.paper;
+    RasterSinkOptions options;
+    options.dpi = paper.dpi;
+    options.threads = 2;
+    RasterFileSink sink(file.path(), setup, options);
+    RasterMode mode;
+    mode.dpi = paper.dpi;
+    sink.SetRasterMode(mode);
+    PrintPageGeometry geometry = sink.Geometry();
+
+    ASSERT_TRUE(sink.StartDocument("Large pages", nullptr));
+    ASSERT_TRUE(sink.StartPage());
+    int bands = 0;
+    do {
+      cairo_surface_t* surface = sink.PageSurface();
+      ASSERT_NE(surface, nullptr);
+      EXPECT_LE((size_t)cairo_image_surface_get_stride(surface) *
+                    cairo_image_surface_get_height(surface),
+                kMaxRasterBandBytes);
+      cairo_t* cr = cairo_create(surface);
+      cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+      cairo_rectangle(cr, 0.0, 0.0, geometry.physicalWidth, paper.dpi / 10.0);
+      cairo_rectangle(cr, 0.0, geometry.physicalHeight / 2.0, geometry.physicalWidth / 2.0,
+                      geometry.physicalHeight / 4.0);
+      cairo_fill(cr);
+      cairo_destroy(cr);
+      bands++;
+    } while (sink.NextBand());
+    ASSERT_TRUE(sink.EndPage());
+    ASSERT_TRUE(sink.EndDocument());
+
+    bool fits = (size_t)geometry.physicalWidth * geometry.physicalHeight * 4 <= kMaxRasterBandBytes;
+    EXPECT_EQ(bands == 1, fits) << bands << " bands";
+    int64_t growth = PeakResidentBytes() - before;
+    printf("%s %d dpi: %d x %d in %d bands, peak grew %lld MB\n", paper.paper, paper.dpi,
+           geometry.physicalWidth, geometry.physicalHeight, bands, (long long)(growth >> 20));
+    EXPECT_LT(growth, kAllowedGrowth);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,286 @@
+#include "raster_file_sink.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mono_raster.h"
+#include "test_documents.h"
+
+namespace {
+
+// Low enough that A4 pages stay small, with bands that cut through the
+// drawing.
+constexpr int kDpi = 72;
+constexpr int kBandRows = 64;
+
+// Rectangles on whole device pixels, so a page drawn band by band comes out
+// exactly like one drawn in one piece. The black bar marks the top-left
+// corner, for the orientation of rotated pages.
+void DrawTestPage(cairo_t* cr, int width, int height) {
+  struct Box {
+    double x, y, w, h, r, g, b;
+  };
+  const Box boxes[] = {
+      {0, 0, 60, 12, 0.0, 0.0, 0.0},
+      {width - 30.0, 100, 30, 70, 0.8, 0.1, 0.1},
+      {50, kBandRows - 1, 200, 3, 0.2, 0.2, 0.2},
+      {100, 200, 120, 90, 0.5, 0.5, 0.5},
+      {130, 230, 60, 30, 0.3, 0.9, 0.3},
+      {10, height - 20.0, width - 20.0, 20, 0.1, 0.3, 0.9},
+  };
+  for (const Box& box : boxes) {
+    cairo_set_source_rgb(cr, box.r, box.g, box.b);
+    cairo_rectangle(cr, box.x, box.y, box.w, box.h);
+    cairo_fill(cr);
+  }
+}
+
+// The page drawn in one piece on a white RGB24 image of the sink's
+// geometry, rotated like RasterFileSink rotates landscape pages: the top
+// edge to the left, read from the bottom.
+cairo_surface_t* ReferencePage(const PrintPageGeometry& geometry, bool rotate) {
+  int width = geometry.physicalWidth;
+  int height = geometry.physicalHeight;
+  cairo_surface_t* page = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+  cairo_t* cr = cairo_create(page);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  DrawTestPage(cr, width, height);
+  cairo_destroy(cr);
+  cairo_surface_flush(page);
+  if (!rotate) return page;
+
+  cairo_surface_t* rotated = cairo_image_surface_create(CAIRO_FORMAT_RGB24, height, width);
+  const uint8_t* in = cairo_image_surface_get_data(page);
+  uint8_t* out = cairo_image_surface_get_data(rotated);
+  int inStride = cairo_image_surface_get_stride(page);
+  int outStride = cairo_image_surface_get_stride(rotated);
+  for (int y = 0; y < width; y++) {
+    for (int x = 0; x < height; x++) {
+      memcpy(out + (size_t)y * outStride + x * 4, in + (size_t)x * inStride + (width - 1 - y) * 4,
+             4);
+    }
+  }
+  cairo_surface_mark_dirty(rotated);
+  cairo_surface_destroy(page);
+  return rotated;
+}
+
+// What the file must decode to for |page|.
+std::vector<uint8_t> ExpectedPixels(cairo_surface_t* page, RasterColorSpace space,
+                                    DitherMode mode) {
+  int width = cairo_image_surface_get_width(page);
+  int height = cairo_image_surface_get_height(page);
+  int stride = cairo_image_surface_get_stride(page);
+  const uint8_t* data = cairo_image_surface_get_data(page);
+  size_t bytesPerLine = (size_t)RasterBytesPerLine(space, width);
+  std::vector<uint8_t> pixels(bytesPerLine * height);
+
+  BilevelImage bilevel;
+  DitherState state;
+  if (space == RasterColorSpace::kBlack1) {
+    EXPECT_TRUE(ConvertToBilevel(page, mode, &bilevel, &state));
+  }
+  for (int y = 0; y < height; y++) {
+    uint8_t* row = pixels.data() + (size_t)y * bytesPerLine;
+    const uint32_t* in = reinterpret_cast<const uint32_t*>(data + (size_t)y * stride);
+    for (int x = 0; x < width; x++) {
+      int r = (in[x] >> 16) & 0xFF, g = (in[x] >> 8) & 0xFF, b = in[x] & 0xFF;
+      if (space == RasterColorSpace::kRgb8) {
+        row[3 * x] = (uint8_t)r;
+        row[3 * x + 1] = (uint8_t)g;
+        row[3 * x + 2] = (uint8_t)b;
+      } else if (space == RasterColorSpace::kGray8) {
+        row[x] = (uint8_t)((77 * r + 150 * g + 29 * b) >> 8);
+      } else {
+        // Bilevel bits are set for white; black_1 bits for ink.
+        bool white = bilevel.bits[(size_t)y * bilevel.stride + x / 8] & (0x80 >> (x % 8));
+        if (!white) row[x / 8] |= (uint8_t)(0x80 >> (x % 8));
+      }
+    }
+  }
+  return pixels;
+}
+
+struct SinkCase {
+  const char* name;
+  RasterFormat format;
+  bool color;
+  DitherMode mono;
+  bool landscape;
+  RasterColorSpace space;
+};
+
+void PrintTo(const SinkCase& test, std::ostream* os) {
+  *os << test.name;
+}
+
+class RasterFileSinkTest : public ::testing::TestWithParam<SinkCase> {};
+
+// Two pages drawn band by band through the sink, decoded back and compared
+// pixel for pixel with the page drawn in one piece.
+TEST_P(RasterFileSinkTest, DecodesToTheDrawnPages) {
+  const SinkCase& test = GetParam();
+  ScopedTestFile file(std::string("sink_") + test.name);
+  PageSetup setup;
+  setup.color = test.color;
+  setup.landscape = test.landscape;
+  RasterSinkOptions options;
+  options.format = test.format;
+  options.dpi = kDpi;
+  options.rgb8 = true;
+  options.threads = 3;
+  RasterFileSink sink(file.path(), setup, options);
+  RasterMode mode;
+  mode.dpi = kDpi;
+  mode.mono = test.mono;
+  mode.bandRows = kBandRows;
+  sink.SetRasterMode(mode);
+
+  PrintPageGeometry geometry = sink.Geometry();
+  ASSERT_TRUE(sink.StartDocument("Round trip", nullptr));
+  for (int page = 0; page < 2; page++) {
+    ASSERT_TRUE(sink.StartPage());
+    int bands = 0;
+    do {
+      cairo_t* cr = cairo_create(sink.PageSurface());
+      DrawTestPage(cr, geometry.physicalWidth, geometry.physicalHeight);
+      cairo_destroy(cr);
+      bands++;
+    } while (sink.NextBand());
+    EXPECT_GT(bands, 1);
+    ASSERT_TRUE(sink.EndPage());
+  }
+  ASSERT_TRUE(sink.EndDocument());
+  EXPECT_EQ(sink.stats().pages, 2);
+
+  cairo_surface_t* reference = ReferencePage(geometry, test.landscape);
+  std::vector<uint8_t> expected = ExpectedPixels(reference, test.space, test.mono);
+  int width = cairo_image_surface_get_width(reference);
+  int height = cairo_image_surface_get_height(reference);
+  cairo_surface_destroy(reference);
+
+  int pages = 0;
+  std::string error;
+  ASSERT_TRUE(DecodeRasterFile(file.path(), test.format,
+                               [&](int index, const RasterPageImage& page) {
+                                 EXPECT_EQ(page.width, width) << "page " << index;
+                                 EXPECT_EQ(page.height, height) << "page " << index;
+                                 EXPECT_EQ(page.dpi, kDpi) << "page " << index;
+                                 EXPECT_EQ(page.space, test.space) << "page " << index;
+                                 EXPECT_TRUE(page.pixels == expected) << "page " << index;
+                                 pages++;
+                                 return true;
+                               },
+                               &error))
+      << error;
+  EXPECT_EQ(pages, 2);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Formats, RasterFileSinkTest,
+    ::testing::Values(
+        SinkCase{"pwg_gray", RasterFormat::kPwgRaster, false, DitherMode::kOff, false,
+                 RasterColorSpace::kGray8},
+        SinkCase{"pwg_black_threshold", RasterFormat::kPwgRaster, false, DitherMode::kThreshold,
+                 false, RasterColorSpace::kBlack1},
+        SinkCase{"pwg_black_ordered", RasterFormat::kPwgRaster, false, DitherMode::kOrdered, false,
+                 RasterColorSpace::kBlack1},
+        SinkCase{"pwg_rgb", RasterFormat::kPwgRaster, true, DitherMode::kOff, false,
+                 RasterColorSpace::kRgb8},
+        SinkCase{"pwg_rgb_landscape", RasterFormat::kPwgRaster, true, DitherMode::kOff, true,
+                 RasterColorSpace::kRgb8},
+        SinkCase{"pwg_black_landscape", RasterFormat::kPwgRaster, false, DitherMode::kOrdered,
+                 true, RasterColorSpace::kBlack1},
+        SinkCase{"pclm_gray", RasterFormat::kPclm, false, DitherMode::kOff, false,
+                 RasterColorSpace::kGray8},
+        SinkCase{"pclm_rgb", RasterFormat::kPclm, true, DitherMode::kOff, false,
+                 RasterColorSpace::kRgb8},
+        SinkCase{"pclm_gray_landscape", RasterFormat::kPclm, false, DitherMode::kOff, true,
+                 RasterColorSpace::kGray8}),
+    [](const ::testing::TestParamInfo<SinkCase>& info) { return std::string(info.param.name); });
+
+// Separators and vector pages are drawn once, without NextBand; a rotated
+// page must still come out whole.
+TEST(RasterFileSinkRotationTest, LandscapePageDrawnOnceIsRotated) {
+  ScopedTestFile file("sink_landscape_once");
+  PageSetup setup;
+  setup.landscape = true;
+  RasterSinkOptions options;
+  options.dpi = kDpi;
+  RasterFileSink sink(file.path(), setup, options);
+  PrintPageGeometry geometry = sink.Geometry();
+  ASSERT_GT(geometry.physicalWidth, geometry.physicalHeight);
+
+  ASSERT_TRUE(sink.StartDocument("Separator", nullptr));
+  ASSERT_TRUE(sink.StartPage());
+  cairo_t* cr = cairo_create(sink.PageSurface());
+  DrawTestPage(cr, geometry.physicalWidth, geometry.physicalHeight);
+  cairo_destroy(cr);
+  ASSERT_TRUE(sink.EndPage());
+  ASSERT_TRUE(sink.EndDocument());
+
+  cairo_surface_t* reference = ReferencePage(geometry, true);
+  std::vector<uint8_t> expected =
+      ExpectedPixels(reference, RasterColorSpace::kGray8, DitherMode::kOff);
+  cairo_surface_destroy(reference);
+  std::string error;
+  int pages = 0;
+  ASSERT_TRUE(DecodeRasterFile(file.path(), RasterFormat::kPwgRaster,
+                               [&](int, const RasterPageImage& page) {
+                                 // Portrait, with the corner bar at the
+                                 // bottom left.
+                                 EXPECT_EQ(page.width, geometry.physicalHeight);
+                                 EXPECT_EQ(page.height, geometry.physicalWidth);
+                                 EXPECT_EQ(page.pixels[(size_t)(page.height - 1) * page.width], 0);
+                                 EXPECT_EQ(page.pixels[0], 255);
+                                 EXPECT_TRUE(page.pixels == expected);
+                                 pages++;
+                                 return true;
+                               },
+                               &error))
+      << error;
+  EXPECT_EQ(pages, 1);
+}
+
+TEST(RasterFileSinkDecodeTest, DamagedFilesAreRefused) {
+  for (RasterFormat format : {RasterFormat::kPwgRaster, RasterFormat::kPclm}) {
+    ScopedTestFile file("sink_damaged");
+    RasterSinkOptions options;
+    options.format = format;
+    options.dpi = kDpi;
+    RasterFileSink sink(file.path(), PageSetup(), options);
+    PrintPageGeometry geometry = sink.Geometry();
+    ASSERT_TRUE(sink.StartDocument("Damaged", nullptr));
+    ASSERT_TRUE(sink.StartPage());
+    cairo_t* cr = cairo_create(sink.PageSurface());
+    DrawTestPage(cr, geometry.physicalWidth, geometry.physicalHeight);
+    cairo_destroy(cr);
+    ASSERT_TRUE(sink.EndPage());
+    ASSERT_TRUE(sink.EndDocument());
+
+    FILE* in = fopen(file.path().c_str(), "rb");
+    ASSERT_NE(in, nullptr);
+    std::vector<uint8_t> data;
+    int c;
+    while ((c = fgetc(in)) != EOF) data.push_back((uint8_t)c);
+    fclose(in);
+
+    std::string error;
+    ASSERT_TRUE(DecodeRasterFile(file.path(), format, nullptr, &error)) << error;
+    // Cut in half: lines or strips and the PCLm xref are missing.
+    FILE* out = fopen(file.path().c_str(), "wb");
+    ASSERT_NE(out, nullptr);
+    fwrite(data.data(), 1, data.size() / 2, out);
+    fclose(out);
+    error.clear();
+    EXPECT_FALSE(DecodeRasterFile(file.path(), format, nullptr, &error))
+        << RasterFormatMimeType(format);
+    EXPECT_FALSE(error.empty());
+  }
+}
+
+}  // namespace
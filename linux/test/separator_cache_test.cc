@@ -0,0 +1,215 @@
+#include "separator_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_documents.h"
+
+namespace {
+
+using std::chrono::seconds;
+
+// Collects every page as an RGB24 image of a MarkerPage-sized sheet with no
+// hardware margins at |dpi|. Can hold the spooling thread before a given
+// page, as a slow spooler would.
+class ImageSink : public PrintSink {
+ public:
+  explicit ImageSink(int dpi, int holdBeforePage = -1)
+      : dpi_(dpi), hold_before_page_(holdBeforePage) {}
+  ~ImageSink() override {
+    if (surface_) cairo_surface_destroy(surface_);
+    for (cairo_surface_t* page : pages_) cairo_surface_destroy(page);
+  }
+
+  // Prevent copying.
+  ImageSink(ImageSink const&) = delete;
+  ImageSink& operator=(ImageSink const&) = delete;
+
+  const std::vector<cairo_surface_t*>& pages() const { return pages_; }
+
+  std::vector<int> Markers() const {
+    std::vector<int> markers;
+    for (cairo_surface_t* page : pages_) markers.push_back(ReadPageMarker(page, dpi_));
+    return markers;
+  }
+
+  bool WaitUntilHeld() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return held_changed_.wait_for(lock, seconds(5), [this] { return held_; });
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = true;
+    held_changed_.notify_all();
+  }
+
+  // PrintSink:
+  bool StartDocument(const std::string&, int* spoolJobId) override {
+    if (spoolJobId) *spoolJobId = 0;
+    return true;
+  }
+  bool StartPage() override {
+    if ((int)pages_.size() == hold_before_page_) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      held_ = true;
+      held_changed_.notify_all();
+      held_changed_.wait(lock, [this] { return released_; });
+    }
+    PrintPageGeometry geometry = Geometry();
+    surface_ = cairo_image_surface_create(CAIRO_FORMAT_RGB24, geometry.physicalWidth,
+                                          geometry.physicalHeight);
+    cairo_t* cr = cairo_create(surface_);
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    return true;
+  }
+  cairo_surface_t* PageSurface() override { return surface_; }
+  bool NextBand() override { return false; }
+  bool EndPage() override {
+    if (!surface_) return false;
+    pages_.push_back(surface_);
+    surface_ = nullptr;
+    return true;
+  }
+  bool EndDocument() override { return true; }
+  void AbortDocument() override {}
+  bool ChangePageSetup(const PageSetup&) override { return true; }
+  void SetRasterMode(const RasterMode&) override {}
+  double mono_convert_ms() const override { return 0.0; }
+  PrintPageGeometry Geometry() override {
+    PrintPageGeometry geometry;
+    geometry.physicalWidth = (int)(kTestPageWidth * dpi_ / 72);
+    geometry.physicalHeight = (int)(kTestPageHeight * dpi_ / 72);
+    geometry.printableWidth = geometry.physicalWidth;
+    geometry.printableHeight = geometry.physicalHeight;
+    geometry.dpiX = dpi_;
+    geometry.dpiY = dpi_;
+    return geometry;
+  }
+
+ private:
+  int dpi_;
+  int hold_before_page_;
+  cairo_surface_t* surface_ = nullptr;
+  std::vector<cairo_surface_t*> pages_;
+
+  std::mutex mutex_;
+  std::condition_variable held_changed_;
+  bool held_ = false;
+  bool released_ = false;
+};
+
+std::vector<TestPage> Pages(const std::vector<int>& markers) {
+  std::vector<TestPage> pages;
+  for (int marker : markers) pages.push_back(MarkerPage(marker));
+  return pages;
+}
+
+TEST(SeparatorCacheTest, RepeatedSpoolsReplayTheSamePages) {
+  ScopedTestFile file("separator.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), MarkerPages(3)));
+  SeparatorCache& cache = SeparatorCache::Shared();
+  std::string error;
+  ASSERT_TRUE(cache.Load(file.path(), &error)) << error;
+  EXPECT_TRUE(cache.loaded());
+  EXPECT_EQ(cache.page_count(), 3);
+  EXPECT_EQ(cache.orientation(), "portrait");
+
+  ImageSink first(72);
+  std::vector<int> progress;
+  SpoolResult result = cache.Spool(&first, "Kasir", [&](int pagesSpooled, int totalPages) {
+    EXPECT_EQ(totalPages, 3);
+    progress.push_back(pagesSpooled);
+  });
+  ASSERT_TRUE(result.ok) << result.errorMessage;
+  EXPECT_EQ(result.pagesSpooled, 3);
+  EXPECT_EQ(progress, (std::vector<int>{1, 2, 3}));
+  EXPECT_EQ(first.Markers(), (std::vector<int>{0, 1, 2}));
+
+  // Replayed from the display list: the same pixels every time.
+  for (int round = 0; round < 3; round++) {
+    ImageSink again(72);
+    ASSERT_TRUE(cache.Spool(&again, "Kasir", nullptr).ok);
+    ASSERT_EQ(again.pages().size(), first.pages().size());
+    for (size_t i = 0; i < first.pages().size(); i++) {
+      EXPECT_EQ(CountDifferentPixels(first.pages()[i], again.pages()[i], 0), 0) << "page " << i;
+    }
+  }
+
+  // Another paper geometry gets its own display list.
+  ImageSink fine(144);
+  ASSERT_TRUE(cache.Spool(&fine, "Kasir", nullptr).ok);
+  EXPECT_EQ(fine.Markers(), (std::vector<int>{0, 1, 2}));
+
+  // A failed reload keeps the separator that was loaded.
+  EXPECT_FALSE(cache.Load(TestFilePath("no_such_separator.pdf"), &error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_EQ(cache.page_count(), 3);
+}
+
+// While one spooler takes its time over a separator, the cache stays
+// available: other printers spool theirs and a reload goes through. The
+// slow replay keeps the pages it started with.
+TEST(SeparatorCacheTest, ReplayDoesNotHoldTheCache) {
+  ScopedTestFile file("separator_old.pdf");
+  ScopedTestFile updated("separator_new.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), MarkerPages(3)));
+  ASSERT_TRUE(WriteTestPdf(updated.path(), Pages({5, 6})));
+  SeparatorCache& cache = SeparatorCache::Shared();
+  std::string error;
+  ASSERT_TRUE(cache.Load(file.path(), &error)) << error;
+  // Builds the display list the slow replay will use.
+  ImageSink warm(72);
+  ASSERT_TRUE(cache.Spool(&warm, "Kasir", nullptr).ok);
+
+  ImageSink slow(72, 1);
+  SpoolResult slowResult;
+  std::thread slowSpool([&] { slowResult = cache.Spool(&slow, "Kasir", nullptr); });
+  bool held = slow.WaitUntilHeld();
+  if (!held) {
+    slow.Release();
+    slowSpool.join();
+  }
+  ASSERT_TRUE(held);
+
+  // A call that blocks on the cache mutex would hang; give up on it after a
+  // while and let the held replay go so the test can still finish.
+  auto finishes = [&](std::function<void()> work) {
+    std::future<void> done = std::async(std::launch::async, std::move(work));
+    if (done.wait_for(seconds(5)) == std::future_status::ready) return true;
+    slow.Release();
+    done.wait();
+    return false;
+  };
+
+  ImageSink other(72);
+  SpoolResult otherResult;
+  EXPECT_TRUE(finishes([&] { otherResult = cache.Spool(&other, "Dapur", nullptr); }));
+  EXPECT_TRUE(otherResult.ok);
+  EXPECT_EQ(other.Markers(), (std::vector<int>{0, 1, 2}));
+
+  bool reloaded = false;
+  EXPECT_TRUE(finishes([&] { reloaded = cache.Load(updated.path(), &error); }));
+  EXPECT_TRUE(reloaded) << error;
+
+  slow.Release();
+  slowSpool.join();
+  ASSERT_TRUE(slowResult.ok) << slowResult.errorMessage;
+  EXPECT_EQ(slow.Markers(), (std::vector<int>{0, 1, 2}));
+
+  ImageSink next(72);
+  ASSERT_TRUE(cache.Spool(&next, "Kasir", nullptr).ok);
+  EXPECT_EQ(next.Markers(), (std::vector<int>{5, 6}));
+}
+
+}  // namespace
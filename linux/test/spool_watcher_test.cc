@@ -0,0 +1,235 @@
+#include "spool_watcher.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_spooler.h"
+#include "job_correlation.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// Well below SpoolWatcher::kResyncInterval, so anything seen within it came
+// from a change notification.
+constexpr milliseconds kNotified{1000};
+
+class SpoolWatcherTest : public ::testing::Test {
+ protected:
+  SpoolWatcherTest()
+      : spooler_(std::make_shared<FakeSpooler>()),
+        watcher_(std::make_unique<SpoolWatcher>(spooler_->NewBackend())) {}
+
+  void Watch(const std::string& queue, int jobId, int totalPages) {
+    watcher_->Watch(queue, jobId, totalPages, recorder_.Progress(jobId), recorder_.Done(jobId));
+  }
+
+  // The watcher lets go of a job just after its done callback.
+  bool WaitIdle() {
+    auto deadline = std::chrono::steady_clock::now() + kNotified;
+    while (watcher_->watched_count() > 0) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+  }
+
+  std::shared_ptr<FakeSpooler> spooler_;
+  WatchRecorder recorder_;
+  std::unique_ptr<SpoolWatcher> watcher_;
+};
+
+TEST_F(SpoolWatcherTest, NotificationReportsCompletion) {
+  int job = spooler_->Submit("Kasir", "Invoice", 3);
+  Watch("Kasir", job, 3);
+  ASSERT_TRUE(recorder_.WaitProgress(job, [](const SpoolJobInfo&) { return true; }, kNotified));
+
+  auto start = std::chrono::steady_clock::now();
+  spooler_->Complete("Kasir", job);
+  ASSERT_TRUE(recorder_.WaitDone(1, kNotified));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, kNotified);
+
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(job, &outcome));
+  EXPECT_TRUE(outcome.success);
+  EXPECT_EQ(outcome.maxPagesPrinted, 3);
+  EXPECT_EQ(outcome.reason, "Success (Job finished/handed off to printer).");
+  ASSERT_TRUE(WaitIdle());
+  EXPECT_EQ(spooler_->watched_queues(), 0);
+}
+
+TEST_F(SpoolWatcherTest, ProgressFollowsTheSpooler) {
+  int job = spooler_->Submit("Kasir", "Invoice", 3);
+  Watch("Kasir", job, 3);
+  for (int page = 1; page <= 3; page++) {
+    SpoolJobInfo info;
+    info.status = kSpoolJobPrinting;
+    info.totalPages = 3;
+    info.pagesPrinted = page;
+    spooler_->Update("Kasir", job, info);
+    ASSERT_TRUE(recorder_.WaitProgress(
+        job, [page](const SpoolJobInfo& seen) { return seen.pagesPrinted == page; }, kNotified));
+  }
+
+  // Growing spool data alone is not a progress update.
+  size_t updates = recorder_.ProgressOf(job).size();
+  SpoolJobInfo grown;
+  grown.status = kSpoolJobPrinting;
+  grown.totalPages = 3;
+  grown.pagesPrinted = 3;
+  grown.spoolBytes = 4096;
+  spooler_->Update("Kasir", job, grown);
+  spooler_->Complete("Kasir", job);
+  ASSERT_TRUE(recorder_.WaitDone(1, kNotified));
+
+  std::vector<SpoolJobInfo> progress = recorder_.ProgressOf(job);
+  for (size_t i = 1; i < progress.size(); i++) {
+    EXPECT_NE(progress[i], progress[i - 1]) << "repeated state " << i;
+  }
+  EXPECT_LE(progress.size(), updates + 1);
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(job, &outcome));
+  EXPECT_TRUE(outcome.success);
+}
+
+TEST_F(SpoolWatcherTest, OutcomeCarriesTheLargestSpoolSize) {
+  int job = spooler_->Submit("Kasir", "Invoice", 2);
+  Watch("Kasir", job, 2);
+  SpoolJobInfo info;
+  info.status = kSpoolJobSpooling;
+  info.totalPages = 2;
+  for (int64_t bytes : {1024, 8192}) {
+    info.spoolBytes = bytes;
+    spooler_->Update("Kasir", job, info);
+    std::this_thread::sleep_for(milliseconds(20));
+  }
+  spooler_->Complete("Kasir", job);
+  ASSERT_TRUE(recorder_.WaitDone(1, kNotified));
+
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(job, &outcome));
+  EXPECT_EQ(outcome.spoolBytes, 8192);
+}
+
+TEST_F(SpoolWatcherTest, CancelledJobFails) {
+  int job = spooler_->Submit("Kasir", "Invoice", 2);
+  Watch("Kasir", job, 2);
+  spooler_->Cancel("Kasir", job);
+  ASSERT_TRUE(recorder_.WaitProgress(
+      job, [](const SpoolJobInfo& info) { return (info.status & kSpoolJobDeleting) != 0; },
+      kNotified));
+  spooler_->Remove("Kasir", job);
+  ASSERT_TRUE(recorder_.WaitDone(1, kNotified));
+
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(job, &outcome));
+  EXPECT_FALSE(outcome.success);
+  EXPECT_EQ(outcome.maxPagesPrinted, 0);
+}
+
+TEST_F(SpoolWatcherTest, JobGoneBeforeWatchIsAssumedPrinted) {
+  // A fast printer: the job is through the spooler before Watch runs.
+  int job = spooler_->Submit("Kasir", "Invoice", 1);
+  spooler_->Remove("Kasir", job);
+  Watch("Kasir", job, 1);
+  ASSERT_TRUE(recorder_.WaitDone(1, kNotified));
+
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(job, &outcome));
+  EXPECT_TRUE(outcome.success);
+  EXPECT_EQ(outcome.reason.rfind("Assumed Success", 0), 0u) << outcome.reason;
+}
+
+TEST_F(SpoolWatcherTest, MissedNotificationIsRecoveredByResync) {
+  int job = spooler_->Submit("Kasir", "Invoice", 1);
+  Watch("Kasir", job, 1);
+  ASSERT_TRUE(recorder_.WaitProgress(job, [](const SpoolJobInfo&) { return true; }, kNotified));
+
+  spooler_->set_drop_notifications(true);
+  spooler_->Complete("Kasir", job);
+  EXPECT_FALSE(recorder_.WaitDone(1, kNotified));
+  ASSERT_TRUE(recorder_.WaitDone(1, SpoolWatcher::kResyncInterval + kNotified));
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(job, &outcome));
+  EXPECT_TRUE(outcome.success);
+}
+
+TEST_F(SpoolWatcherTest, TaggedDocumentResolvesToItsJob) {
+  std::string tag = NewDocumentTag();
+  watcher_->WatchDocument("Kasir", tag, 2, recorder_.Resolved(1), recorder_.Progress(1),
+                          recorder_.Done(1));
+  // Another program's job lands in the queue first.
+  int foreign = spooler_->Submit("Kasir", "Microsoft Word - Laporan.docx", 5);
+  int job = spooler_->Submit("Kasir", "/tmp/" + tag + ".pdf", 2);
+  ASSERT_TRUE(recorder_.WaitResolved(1, kNotified));
+  EXPECT_EQ(recorder_.ResolvedJob(1), job);
+
+  spooler_->Complete("Kasir", foreign);
+  spooler_->Complete("Kasir", job);
+  ASSERT_TRUE(recorder_.WaitDone(1, kNotified));
+  SpoolOutcome outcome;
+  ASSERT_TRUE(recorder_.Outcome(1, &outcome));
+  EXPECT_TRUE(outcome.success);
+  EXPECT_EQ(outcome.maxPagesPrinted, 2);
+}
+
+TEST_F(SpoolWatcherTest, DestroyingTheWatcherStopsWatching) {
+  int job = spooler_->Submit("Kasir", "Invoice", 1);
+  Watch("Kasir", job, 1);
+  ASSERT_TRUE(recorder_.WaitProgress(job, [](const SpoolJobInfo&) { return true; }, kNotified));
+  EXPECT_EQ(spooler_->watched_queues(), 1);
+
+  watcher_.reset();
+  EXPECT_EQ(spooler_->watched_queues(), 0);
+  spooler_->Complete("Kasir", job);
+  EXPECT_EQ(recorder_.done_count(), 0u);
+}
+
+// 100 jobs on five printers, finished in random order by several threads,
+// all on the one watcher thread.
+TEST_F(SpoolWatcherTest, ManyJobsOnOneThread) {
+  constexpr int kJobs = 100;
+  const std::vector<std::string> queues = {"Kasir", "Gudang", "Dapur", "Bar", "Kantor"};
+  std::vector<std::pair<std::string, int>> jobs;
+  for (int i = 0; i < kJobs; i++) {
+    const std::string& queue = queues[i % queues.size()];
+    int job = spooler_->Submit(queue, "Invoice " + std::to_string(i), 1 + i % 4);
+    Watch(queue, job, 1 + i % 4);
+    jobs.emplace_back(queue, job);
+  }
+  EXPECT_EQ(watcher_->watched_count(), (size_t)kJobs);
+
+  std::shuffle(jobs.begin(), jobs.end(), std::mt19937(42));
+  std::vector<std::thread> printers;
+  for (int t = 0; t < 4; t++) {
+    printers.emplace_back([&, t] {
+      for (size_t i = t; i < jobs.size(); i += 4) {
+        spooler_->Complete(jobs[i].first, jobs[i].second);
+        std::this_thread::sleep_for(milliseconds(1));
+      }
+    });
+  }
+  for (auto& printer : printers) printer.join();
+
+  ASSERT_TRUE(recorder_.WaitDone(kJobs, kNotified * 3));
+  EXPECT_EQ(recorder_.repeated_done(), 0);
+  for (const auto& job : jobs) {
+    SpoolOutcome outcome;
+    ASSERT_TRUE(recorder_.Outcome(job.second, &outcome));
+    EXPECT_TRUE(outcome.success) << job.first << " job " << job.second;
+  }
+  ASSERT_TRUE(WaitIdle());
+  // Each printer's notifications were started once and stopped again.
+  EXPECT_EQ(spooler_->watched_queues(), 0);
+  EXPECT_EQ(spooler_->add_queue_calls(), spooler_->remove_queue_calls());
+  EXPECT_LE(spooler_->add_queue_calls(), kJobs);
+}
+
+}  // namespace
@@ -0,0 +1,356 @@
+#include "streaming_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document_cache.h"
+#include "page_rasterizer.h"
+#include "test_documents.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr size_t kChunkBytes = 4096;
+
+std::string Padded(size_t value) {
+  char digits[16];
+  snprintf(digits, sizeof(digits), "%010zu", value);
+  return digits;
+}
+
+// A linearized PDF of |pageCount| MarkerPage-style pages (the black bar
+// only), each padded with comment lines so the file is much larger than its
+// first page. Layout: linearization dictionary, first-page cross-reference
+// section and trailer, catalog, page tree, hint stream, page 1, the other
+// pages, and the main cross-reference table whose entries /T points at.
+// The hint stream carries no tables, so Poppler finds page 1 through the
+// page tree, which sits in the first-page section as well.
+std::string LinearizedTestPdf(int pageCount) {
+  const std::string kPlaceholder(10, '0');
+  int size = 5 + 2 * pageCount;  // Page i is object 5 + 2i, its content 6 + 2i.
+  std::vector<size_t> offsets(size, 0);
+  std::string pdf = "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n";
+  auto placeholder = [&]() {
+    size_t at = pdf.size();
+    pdf += kPlaceholder;
+    return at;
+  };
+  auto object = [&](int number, const std::string& body) {
+    offsets[number] = pdf.size();
+    pdf += std::to_string(number) + " 0 obj\n" + body + "\nendobj\n";
+  };
+  auto page = [&](int index) {
+    std::string content = "0 0 0 rg 8 200 " + std::to_string(8 * (index + 1)) + " 8 re f\n";
+    for (int line = 0; line < 200; line++) content += "% " + std::string(77, 'x') + "\n";
+    object(5 + 2 * index, "<</Type/Page/Parent 3 0 R/MediaBox[0 0 144 216]/Resources<<>>/Contents " +
+                              std::to_string(6 + 2 * index) + " 0 R>>");
+    object(6 + 2 * index, "<</Length " + std::to_string(content.size()) + ">>\nstream\n" +
+                              content + "endstream");
+  };
+
+  offsets[1] = pdf.size();
+  pdf += "1 0 obj\n<</Linearized 1/L ";
+  size_t lengthAt = placeholder();
+  pdf += "/H[";
+  size_t hintAt = placeholder();
+  pdf += " ";
+  size_t hintLengthAt = placeholder();
+  pdf += "]/O 5/E ";
+  size_t firstPageEndAt = placeholder();
+  pdf += "/N " + std::to_string(pageCount) + "/T ";
+  size_t mainEntriesAt = placeholder();
+  pdf += ">>\nendobj\n";
+
+  size_t firstXref = pdf.size();
+  pdf += "xref\n1 6\n";
+  std::vector<size_t> firstEntryAt(7, 0);
+  for (int number = 1; number <= 6; number++) {
+    firstEntryAt[number] = placeholder();
+    pdf += " 00000 n\r\n";
+  }
+  pdf += "trailer\n<</Size " + std::to_string(size) + "/Root 2 0 R/Prev ";
+  size_t prevAt = placeholder();
+  pdf += ">>\nstartxref\n0\n%%EOF\n";
+
+  std::string kids;
+  for (int i = 0; i < pageCount; i++) kids += std::to_string(5 + 2 * i) + " 0 R ";
+  object(2, "<</Type/Catalog/Pages 3 0 R>>");
+  object(3, "<</Type/Pages/Count " + std::to_string(pageCount) + "/Kids[" + kids + "]>>");
+  object(4, "<</S 0/Length 0>>\nstream\nendstream");
+  size_t hintLength = pdf.size() - offsets[4];
+  page(0);
+  size_t firstPageEnd = pdf.size();
+  for (int i = 1; i < pageCount; i++) page(i);
+
+  size_t mainXref = pdf.size();
+  pdf += "xref\n0 " + std::to_string(size) + "\n";
+  size_t mainEntries = pdf.size();
+  pdf += "0000000000 65535 f\r\n";
+  for (int number = 1; number < size; number++) pdf += Padded(offsets[number]) + " 00000 n\r\n";
+  pdf += "trailer\n<</Size " + std::to_string(size) + ">>\nstartxref\n" +
+         std::to_string(firstXref) + "\n%%EOF\n";
+
+  auto patch = [&](size_t at, size_t value) { pdf.replace(at, 10, Padded(value)); };
+  patch(lengthAt, pdf.size());
+  patch(hintAt, offsets[4]);
+  patch(hintLengthAt, hintLength);
+  patch(firstPageEndAt, firstPageEnd);
+  patch(mainEntriesAt, mainEntries);
+  for (int number = 1; number <= 6; number++) patch(firstEntryAt[number], offsets[number]);
+  patch(prevAt, mainXref);
+  return pdf;
+}
+
+// Offset just past page 1 of a LinearizedTestPdf (its /E).
+size_t FirstPageEnd(const std::string& pdf) {
+  size_t at = pdf.find("/E ");
+  return at == std::string::npos ? 0 : std::stoul(pdf.substr(at + 3, 10));
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Feeds |data| into a StreamingBuffer from its own thread in kChunkBytes
+// pieces with a pause after each, like a slow download. With |holdAt| > 0 it
+// stops after that many bytes until Release() (or five seconds), so a test
+// can check what was possible before the rest arrived.
+class SlowDownload {
+ public:
+  SlowDownload(std::shared_ptr<StreamingBuffer> buffer, std::string data, size_t holdAt)
+      : buffer_(std::move(buffer)), data_(std::move(data)), hold_at_(holdAt) {
+    thread_ = std::thread([this] { Run(); });
+  }
+  ~SlowDownload() {
+    Release();
+    thread_.join();
+  }
+
+  // Prevent copying.
+  SlowDownload(const SlowDownload&) = delete;
+  SlowDownload& operator=(const SlowDownload&) = delete;
+
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      released_ = true;
+    }
+    released_changed_.notify_all();
+  }
+
+  // Finish() has been called, or is about to be.
+  bool finished() const { return finished_; }
+
+ private:
+  void Run() {
+    size_t sent = 0;
+    while (sent < data_.size()) {
+      if (hold_at_ > 0 && sent == hold_at_) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        released_changed_.wait_for(lock, std::chrono::seconds(5), [this] { return released_; });
+      }
+      size_t end = std::min(sent + kChunkBytes, data_.size());
+      if (sent < hold_at_) end = std::min(end, hold_at_);
+      buffer_->Append(reinterpret_cast<const uint8_t*>(data_.data()) + sent, end - sent);
+      sent = end;
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    finished_ = true;
+    buffer_->Finish();
+  }
+
+  std::shared_ptr<StreamingBuffer> buffer_;
+  std::string data_;
+  size_t hold_at_;
+  std::mutex mutex_;
+  std::condition_variable released_changed_;
+  bool released_ = false;
+  std::atomic<bool> finished_{false};
+  std::thread thread_;
+};
+
+// Renders page |index| of |lease| and reads its marker, -1 if it has none.
+int RenderedMarker(DocumentLease* lease, int index) {
+  PopplerPage* page = lease->page(index);
+  if (!page) return -1;
+  cairo_surface_t* image = RenderPageToImage(page, 72.0);
+  if (!image) return -1;
+  int marker = ReadPageMarker(image, 72.0);
+  cairo_surface_destroy(image);
+  return marker;
+}
+
+TEST(StreamingBufferTest, ReadWaitsForTheRangeToArrive) {
+  auto buffer = std::make_shared<StreamingBuffer>(8);
+  std::atomic<bool> returned{false};
+  char out[4] = {};
+  int64_t read = 0;
+  std::thread reader([&] {
+    read = buffer->Read(2, out, 4);
+    returned = true;
+  });
+  const uint8_t first[] = {'a', 'b', 'c', 'd'};
+  buffer->Append(first, sizeof(first));
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_FALSE(returned);
+
+  const uint8_t second[] = {'e', 'f', 'g', 'h'};
+  buffer->Append(second, sizeof(second));
+  reader.join();
+  EXPECT_EQ(read, 4);
+  EXPECT_EQ(std::string(out, 4), "cdef");
+  EXPECT_EQ(buffer->received(), 8);
+}
+
+TEST(StreamingBufferTest, FinishEndsShortReads) {
+  auto buffer = std::make_shared<StreamingBuffer>(-1);
+  const uint8_t data[] = {'a', 'b', 'c'};
+  buffer->Append(data, sizeof(data));
+  buffer->Finish();
+  char out[8] = {};
+  EXPECT_EQ(buffer->Read(1, out, sizeof(out)), 2);
+  EXPECT_EQ(std::string(out, 2), "bc");
+  EXPECT_EQ(buffer->Read(3, out, sizeof(out)), 0);
+  EXPECT_TRUE(buffer->WaitForComplete());
+
+  // Nothing is added after Finish.
+  buffer->Append(data, sizeof(data));
+  EXPECT_EQ(buffer->received(), 3);
+}
+
+TEST(StreamingBufferTest, FailUnblocksABlockedRead) {
+  auto buffer = std::make_shared<StreamingBuffer>(1000);
+  const uint8_t data[10] = {};
+  buffer->Append(data, sizeof(data));
+  std::atomic<bool> returned{false};
+  int64_t read = 0;
+  bool complete = true;
+  std::thread reader([&] {
+    char out[100];
+    read = buffer->Read(0, out, sizeof(out));
+    complete = buffer->WaitForComplete();
+    returned = true;
+  });
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_FALSE(returned);
+
+  buffer->Fail();
+  reader.join();
+  EXPECT_EQ(read, -1);
+  EXPECT_FALSE(complete);
+  char out[4];
+  EXPECT_EQ(buffer->Read(0, out, sizeof(out)), -1);
+}
+
+TEST(StreamingBufferTest, LinearizedNeedsTheContentLength) {
+  std::string pdf = LinearizedTestPdf(3);
+  auto feed = [&pdf](int64_t expectedLength) {
+    auto buffer = std::make_shared<StreamingBuffer>(expectedLength);
+    buffer->Append(reinterpret_cast<const uint8_t*>(pdf.data()), pdf.size());
+    buffer->Finish();
+    return buffer;
+  };
+  EXPECT_TRUE(feed((int64_t)pdf.size())->WaitForLinearized());
+  // A Content-Length that does not match /L, or none at all.
+  EXPECT_FALSE(feed((int64_t)pdf.size() + 1)->WaitForLinearized());
+  EXPECT_FALSE(feed(-1)->WaitForLinearized());
+
+  std::string plain = "%PDF-1.4\n" + std::string(2000, ' ');
+  auto buffer = std::make_shared<StreamingBuffer>((int64_t)plain.size());
+  buffer->Append(reinterpret_cast<const uint8_t*>(plain.data()), plain.size());
+  EXPECT_FALSE(buffer->WaitForLinearized());
+}
+
+// The first page of a linearized download renders while most of the file
+// is still to come; the remaining pages follow once it arrives.
+TEST(StreamingDocumentTest, FirstPageRendersBeforeTheDownloadFinishes) {
+  constexpr int kPages = 30;
+  std::string pdf = LinearizedTestPdf(kPages);
+  size_t holdAt = std::min(pdf.size(), FirstPageEnd(pdf) + 4 * kChunkBytes);
+  ASSERT_LT(holdAt * 4, pdf.size());
+
+  auto buffer = std::make_shared<StreamingBuffer>((int64_t)pdf.size());
+  std::string source = DocumentCache::Shared().RegisterStream(buffer);
+  DocumentCacheStats before = DocumentCache::Shared().stats();
+  auto start = std::chrono::steady_clock::now();
+  {
+    SlowDownload download(buffer, pdf, holdAt);
+    std::string error;
+    DocumentLease lease = DocumentCache::Shared().Acquire(source, &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_TRUE(lease.progressive());
+    EXPECT_EQ(lease.page_count(), kPages);
+    EXPECT_EQ(RenderedMarker(&lease, 0), 0);
+    double firstPageMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    int64_t received = buffer->received();
+    EXPECT_FALSE(download.finished());
+    EXPECT_LT(received, (int64_t)pdf.size());
+    printf("first page after %.0f ms with %lld of %zu bytes received\n", firstPageMs,
+           (long long)received, pdf.size());
+
+    download.Release();
+    EXPECT_EQ(RenderedMarker(&lease, kPages - 1), kPages - 1);
+  }
+  DocumentCacheStats after = DocumentCache::Shared().stats();
+  EXPECT_EQ(after.streamLoads - before.streamLoads, 1);
+  EXPECT_EQ(after.progressiveLoads - before.progressiveLoads, 1);
+  DocumentCache::Shared().UnregisterStream(source);
+}
+
+// Without linearization Poppler needs the trailer at the end, so the
+// document is only parsed once the whole download is there.
+TEST(StreamingDocumentTest, NonLinearizedFileWaitsForTheWholeDownload) {
+  ScopedTestFile file("streaming_plain.pdf");
+  ASSERT_TRUE(WriteTestPdf(file.path(), MarkerPages(3)));
+  std::string pdf = ReadFile(file.path());
+  ASSERT_FALSE(pdf.empty());
+
+  auto buffer = std::make_shared<StreamingBuffer>((int64_t)pdf.size());
+  std::string source = DocumentCache::Shared().RegisterStream(buffer);
+  {
+    SlowDownload download(buffer, pdf, 0);
+    std::string error;
+    DocumentLease lease = DocumentCache::Shared().Acquire(source, &error);
+    ASSERT_TRUE(lease) << error;
+    EXPECT_TRUE(download.finished());
+    EXPECT_EQ(buffer->received(), (int64_t)pdf.size());
+    EXPECT_FALSE(lease.progressive());
+    EXPECT_EQ(lease.page_count(), 3);
+    EXPECT_EQ(RenderedMarker(&lease, 2), 2);
+  }
+  DocumentCache::Shared().UnregisterStream(source);
+}
+
+TEST(StreamingDocumentTest, FailedDownloadFailsTheLease) {
+  auto buffer = std::make_shared<StreamingBuffer>(100000);
+  std::string source = DocumentCache::Shared().RegisterStream(buffer);
+  const char head[] = "%PDF-1.4\n";
+  buffer->Append(reinterpret_cast<const uint8_t*>(head), sizeof(head) - 1);
+  std::thread failer([&buffer] {
+    std::this_thread::sleep_for(milliseconds(50));
+    buffer->Fail();
+  });
+  std::string error;
+  DocumentLease lease = DocumentCache::Shared().Acquire(source, &error);
+  failer.join();
+  EXPECT_FALSE(lease);
+  EXPECT_FALSE(error.empty());
+  DocumentCache::Shared().UnregisterStream(source);
+}
+
+}  // namespace
@@ -0,0 +1,140 @@
+#include "test_documents.h"
+
+#include <cairo/cairo-pdf.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+
+namespace {
+
+constexpr double kMarkerLeft = 8.0;
+constexpr double kMarkerTop = 8.0;
+constexpr double kMarkerHeight = 8.0;
+constexpr double kMarkerUnit = 8.0;
+constexpr double kPi = 3.14159265358979323846;
+
+bool IsDark(const unsigned char* pixel) {
+  // BGRx in memory on little-endian machines; all three channels dark.
+  return pixel[0] < 64 && pixel[1] < 64 && pixel[2] < 64;
+}
+
+}  // namespace
+
+std::string TestFilePath(const std::string& name) {
+  std::error_code ec;
+  std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+  if (ec) dir = "/tmp";
+  return (dir / ("hlaprint_test_" + std::to_string(getpid()) + "_" + name)).string();
+}
+
+ScopedTestFile::~ScopedTestFile() {
+  std::error_code ec;
+  std::filesystem::remove(path_, ec);
+}
+
+bool WriteTestPdf(const std::string& path, const std::vector<TestPage>& pages) {
+  if (pages.empty()) return false;
+  cairo_surface_t* surface =
+      cairo_pdf_surface_create(path.c_str(), pages.front().width, pages.front().height);
+  cairo_t* cr = cairo_create(surface);
+  for (const TestPage& page : pages) {
+    cairo_pdf_surface_set_size(surface, page.width, page.height);
+    cairo_save(cr);
+    if (page.draw) page.draw(cr);
+    cairo_restore(cr);
+    cairo_show_page(cr);
+  }
+  cairo_destroy(cr);
+  cairo_surface_finish(surface);
+  bool ok = cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS;
+  cairo_surface_destroy(surface);
+  return ok;
+}
+
+TestPage MarkerPage(int index) {
+  TestPage page;
+  page.draw = [index](cairo_t* cr) {
+    // Colour and anti-aliased edges under the marker, so pixel comparisons
+    // see more than black and white.
+    cairo_set_source_rgb(cr, 0.85, 0.1, 0.1);
+    cairo_arc(cr, 72.0, 110.0, 30.0 + index, 0.0, 2 * kPi);
+    cairo_fill(cr);
+    cairo_set_source_rgb(cr, 0.1, 0.2, 0.8);
+    cairo_set_line_width(cr, 1.5);
+    cairo_move_to(cr, 12.0, 200.0);
+    cairo_line_to(cr, 132.0, 40.0 + 4.0 * index);
+    cairo_stroke(cr);
+    cairo_set_source_rgb(cr, 0.6, 0.6, 0.6);
+    cairo_rectangle(cr, 20.0, 150.0, 40.0, 30.0);
+    cairo_fill(cr);
+
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_rectangle(cr, kMarkerLeft, kMarkerTop, kMarkerUnit * (index + 1), kMarkerHeight);
+    cairo_fill(cr);
+  };
+  return page;
+}
+
+std::vector<TestPage> MarkerPages(int count) {
+  std::vector<TestPage> pages;
+  for (int i = 0; i < count; i++) pages.push_back(MarkerPage(i));
+  return pages;
+}
+
+int ReadPageMarker(cairo_surface_t* image, double dpi) {
+  cairo_surface_flush(image);
+  double scale = dpi / 72.0;
+  int y = (int)((kMarkerTop + kMarkerHeight / 2) * scale);
+  int x = (int)std::ceil(kMarkerLeft * scale);
+  int width = cairo_image_surface_get_width(image);
+  if (y >= cairo_image_surface_get_height(image)) return -1;
+
+  const unsigned char* row =
+      cairo_image_surface_get_data(image) + (size_t)y * cairo_image_surface_get_stride(image);
+  int dark = 0;
+  while (x + dark < width && IsDark(row + (x + dark) * 4)) dark++;
+  if (dark == 0) return -1;
+  return (int)std::lround(dark / scale / kMarkerUnit) - 1;
+}
+
+PopplerDocument* OpenTestPdf(const std::string& path) {
+  GError* error = nullptr;
+  gchar* uri = g_filename_to_uri(path.c_str(), nullptr, &error);
+  PopplerDocument* document = uri ? poppler_document_new_from_file(uri, nullptr, &error) : nullptr;
+  g_free(uri);
+  if (error) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), error->message);
+    g_clear_error(&error);
+  }
+  return document;
+}
+
+int CountDifferentPixels(cairo_surface_t* a, cairo_surface_t* b, int tolerance) {
+  int width = cairo_image_surface_get_width(a);
+  int height = cairo_image_surface_get_height(a);
+  if (width != cairo_image_surface_get_width(b) || height != cairo_image_surface_get_height(b)) {
+    return -1;
+  }
+  cairo_surface_flush(a);
+  cairo_surface_flush(b);
+  int different = 0;
+  for (int y = 0; y < height; y++) {
+    const unsigned char* rowA =
+        cairo_image_surface_get_data(a) + (size_t)y * cairo_image_surface_get_stride(a);
+    const unsigned char* rowB =
+        cairo_image_surface_get_data(b) + (size_t)y * cairo_image_surface_get_stride(b);
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        if (std::abs(rowA[x * 4 + c] - rowB[x * 4 + c]) > tolerance) {
+          different++;
+          break;
+        }
+      }
+    }
+  }
+  return different;
+}
@@ -0,0 +1,67 @@
+#ifndef FLUTTER_TEST_DOCUMENTS_H_
+#define FLUTTER_TEST_DOCUMENTS_H_
+
+#include <cairo/cairo.h>
+#include <poppler/glib/poppler.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Documents for the rendering tests. They are drawn with cairo's PDF surface
+// when the test runs instead of being checked in, so every test shows what
+// is on its pages.
+
+// Page size of MarkerPage, in points.
+constexpr double kTestPageWidth = 144.0;
+constexpr double kTestPageHeight = 216.0;
+
+// Path of a scratch file |name| in the temp directory, unique to this
+// process. The file is not created.
+std::string TestFilePath(const std::string& name);
+
+// Deletes its file when it goes out of scope.
+class ScopedTestFile {
+ public:
+  explicit ScopedTestFile(const std::string& name) : path_(TestFilePath(name)) {}
+  ~ScopedTestFile();
+
+  // Prevent copying.
+  ScopedTestFile(ScopedTestFile const&) = delete;
+  ScopedTestFile& operator=(ScopedTestFile const&) = delete;
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+// One page of a test PDF. |draw| gets the page's context in PDF points, on
+// a page that is still blank.
+struct TestPage {
+  double width = kTestPageWidth;
+  double height = kTestPageHeight;
+  std::function<void(cairo_t* cr)> draw;
+};
+
+bool WriteTestPdf(const std::string& path, const std::vector<TestPage>& pages);
+
+// A page that says which one it is: a black bar across the top, 8 points
+// wide per |index| + 1, over anti-aliased colour shapes. ReadPageMarker gets
+// |index| back from a render of it, so page order can be checked after
+// rasterizing.
+TestPage MarkerPage(int index);
+std::vector<TestPage> MarkerPages(int count);
+
+// |image| is an RGB24 or ARGB32 render of a MarkerPage at |dpi|. Returns -1
+// if there is no marker.
+int ReadPageMarker(cairo_surface_t* image, double dpi);
+
+// Opens |path| with Poppler. Caller unrefs; nullptr on failure.
+PopplerDocument* OpenTestPdf(const std::string& path);
+
+// Pixels where RGB24/ARGB32 images |a| and |b| differ by more than
+// |tolerance| in any channel; -1 if their sizes differ.
+int CountDifferentPixels(cairo_surface_t* a, cairo_surface_t* b, int tolerance);
+
+#endif  // FLUTTER_TEST_DOCUMENTS_H_
@@ -0,0 +1,131 @@
+#include "copy_fan_out.h"
+
+#include <cairo/cairo-pdf.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+
+namespace {
+
+std::string MakeSpillPath() {
+  static std::atomic<int> counter{0};
+  std::error_code ec;
+  std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+  if (ec) return "";
+  long long stamp = (long long)std::chrono::steady_clock::now().time_since_epoch().count();
+  std::filesystem::path file = dir / ("hlaprint_copies_" + std::to_string(stamp) + "_" +
+                                      std::to_string(counter++) + ".pdf");
+  return file.u8string();
+}
+
+}  // namespace
+
+CopyFanOut::CopyFanOut(const PrintPageGeometry& geometry, size_t memoryBudget,
+                       int maxVectorPages)
+    : geometry_(geometry), memory_budget_(memoryBudget), max_vector_pages_(maxVectorPages) {}
+
+CopyFanOut::~CopyFanOut() {
+  for (cairo_surface_t* recording : recordings_) {
+    if (recording) cairo_surface_destroy(recording);
+  }
+  if (spill_cr_) cairo_destroy(spill_cr_);
+  if (spill_surface_) cairo_surface_destroy(spill_surface_);
+  if (spill_doc_) g_object_unref(spill_doc_);
+  if (!spill_path_.empty()) {
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::u8path(spill_path_), ec);
+  }
+}
+
+void CopyFanOut::Keep(cairo_surface_t* recording, size_t imageBytes) {
+  bool overBudget = imageBytes > 0 ? memory_used_ + imageBytes > memory_budget_
+                                   : vector_pages_ >= max_vector_pages_;
+  if (overBudget && SpillPage(recording)) {
+    cairo_surface_destroy(recording);
+    recordings_.push_back(nullptr);
+    spill_index_.push_back(spill_count_++);
+    return;
+  }
+  // Spill gagal: tetap simpan di memori daripada kehilangan halaman
+  memory_used_ += imageBytes;
+  if (imageBytes == 0) vector_pages_++;
+  recordings_.push_back(recording);
+  spill_index_.push_back(-1);
+}
+
+bool CopyFanOut::SpillPage(cairo_surface_t* recording) {
+  double dpiX = geometry_.dpiX > 0 ? geometry_.dpiX : 72.0;
+  double dpiY = geometry_.dpiY > 0 ? geometry_.dpiY : 72.0;
+
+  if (!spill_surface_) {
+    spill_path_ = MakeSpillPath();
+    if (spill_path_.empty()) return false;
+    // Satu halaman spill = satu kertas fisik, dalam point
+    spill_surface_ = cairo_pdf_surface_create(spill_path_.c_str(),
+                                              geometry_.physicalWidth * 72.0 / dpiX,
+                                              geometry_.physicalHeight * 72.0 / dpiY);
+    spill_cr_ = cairo_create(spill_surface_);
+    if (cairo_surface_status(spill_surface_) != CAIRO_STATUS_SUCCESS) return false;
+  }
+
+  // Koordinat device (asal = area cetak) dikembalikan ke koordinat kertas
+  cairo_save(spill_cr_);
+  cairo_scale(spill_cr_, 72.0 / dpiX, 72.0 / dpiY);
+  cairo_translate(spill_cr_, geometry_.offsetX, geometry_.offsetY);
+  cairo_set_source_surface(spill_cr_, recording, 0, 0);
+  cairo_paint(spill_cr_);
+  cairo_restore(spill_cr_);
+  cairo_show_page(spill_cr_);
+  return true;
+}
+
+bool CopyFanOut::Finish(std::string* error) {
+  if (!spill_surface_) return true;
+
+  cairo_destroy(spill_cr_);
+  spill_cr_ = nullptr;
+  cairo_surface_finish(spill_surface_);
+  cairo_status_t status = cairo_surface_status(spill_surface_);
+  cairo_surface_destroy(spill_surface_);
+  spill_surface_ = nullptr;
+  if (status != CAIRO_STATUS_SUCCESS) {
+    if (error) *error = "Failed to write copy spill file.";
+    return false;
+  }
+
+  GError* gerror = nullptr;
+  gchar* uri = g_filename_to_uri(spill_path_.c_str(), nullptr, &gerror);
+  if (uri) {
+    spill_doc_ = poppler_document_new_from_file(uri, nullptr, &gerror);
+    g_free(uri);
+  }
+  if (!spill_doc_) {
+    if (error) *error = gerror ? gerror->message : "Failed to read copy spill file.";
+    g_clear_error(&gerror);
+    return false;
+  }
+  return true;
+}
+
+void CopyFanOut::Replay(int index, cairo_t* cr) {
+  if (index < 0 || index >= (int)recordings_.size()) return;
+
+  if (recordings_[index]) {
+    cairo_set_source_surface(cr, recordings_[index], 0, 0);
+    cairo_paint(cr);
+    return;
+  }
+
+  PopplerPage* page = spill_doc_ ? poppler_document_get_page(spill_doc_, spill_index_[index]) : nullptr;
+  if (!page) return;
+  double dpiX = geometry_.dpiX > 0 ? geometry_.dpiX : 72.0;
+  double dpiY = geometry_.dpiY > 0 ? geometry_.dpiY : 72.0;
+  cairo_save(cr);
+  cairo_translate(cr, -geometry_.offsetX, -geometry_.offsetY);
+  cairo_scale(cr, dpiX / 72.0, dpiY / 72.0);
+  poppler_page_render_for_printing(page, cr);
+  cairo_restore(cr);
+  g_object_unref(page);
+}
@@ -0,0 +1,63 @@
+#ifndef RUNNER_COPY_FAN_OUT_H_
+#define RUNNER_COPY_FAN_OUT_H_
+
+#include <cairo/cairo.h>
+#include <poppler/glib/poppler.h>
+
+#include <string>
+#include <vector>
+
+#include "print_sink.h"
+
+// Keeps the pages of the first copy of a job as cairo recording surfaces
+// (display lists, in device pixels) so copies 2..N are replayed instead of
+// being rendered through Poppler again. Pages that would take the kept
+// pixel data past |memoryBudget|, and vector pages beyond
+// |maxVectorPages|, are flattened into a temporary PDF and read back from
+// there instead.
+class CopyFanOut {
+ public:
+  CopyFanOut(const PrintPageGeometry& geometry, size_t memoryBudget,
+             int maxVectorPages);
+  // Frees the recordings and deletes the spill file.
+  ~CopyFanOut();
+
+  // Prevent copying.
+  CopyFanOut(CopyFanOut const&) = delete;
+  CopyFanOut& operator=(CopyFanOut const&) = delete;
+
+  // Takes ownership of |recording| as the next page of the copy.
+  // |imageBytes| is the size of the prerendered page image it paints, or 0
+  // for a vector page: cairo does not report how much a display list holds
+  // (embedded images included), so those pages are counted instead.
+  void Keep(cairo_surface_t* recording, size_t imageBytes);
+
+  // Call once after the last Keep, before any Replay.
+  bool Finish(std::string* error);
+
+  int page_count() const { return (int)recordings_.size(); }
+  int spilled_pages() const { return spill_count_; }
+
+  // Draws kept page |index| onto |cr|, in device pixels.
+  void Replay(int index, cairo_t* cr);
+
+ private:
+  bool SpillPage(cairo_surface_t* recording);
+
+  PrintPageGeometry geometry_;
+  size_t memory_budget_;
+  size_t memory_used_ = 0;
+  int max_vector_pages_;
+  int vector_pages_ = 0;
+  // nullptr for pages that went to the spill file.
+  std::vector<cairo_surface_t*> recordings_;
+  std::vector<int> spill_index_;
+
+  std::string spill_path_;
+  cairo_surface_t* spill_surface_ = nullptr;
+  cairo_t* spill_cr_ = nullptr;
+  int spill_count_ = 0;
+  PopplerDocument* spill_doc_ = nullptr;
+};
+
+#endif  // RUNNER_COPY_FAN_OUT_H_
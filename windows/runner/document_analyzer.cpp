@@ -0,0 +1,158 @@
+#include "document_analyzer.h"
+
+#include <cairo/cairo.h>
+#include <poppler/glib/poppler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "document_cache.h"
+#include "ink_scanner.h"
+#include "page_rasterizer.h"
+
+namespace {
+
+// Selisih kanal maksimum yang masih dianggap abu-abu. Cukup longgar untuk
+// tinta hitam hasil scan dan anti-aliasing, cukup ketat untuk logo berwarna.
+constexpr int kChromaTolerance = 24;
+constexpr size_t kMaxCachedAnalyses = 64;
+
+class AnalysisCache {
+ public:
+  static AnalysisCache& Shared() {
+    static AnalysisCache cache;
+    return cache;
+  }
+
+  bool Lookup(uint64_t hash, DocumentAnalysis* out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = lru_.begin(); it != lru_.end(); ++it) {
+      if (it->first != hash) continue;
+      lru_.splice(lru_.begin(), lru_, it);
+      *out = lru_.front().second;
+      return true;
+    }
+    return false;
+  }
+
+  void Store(uint64_t hash, const DocumentAnalysis& analysis) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.remove_if([hash](const auto& entry) { return entry.first == hash; });
+    lru_.emplace_front(hash, analysis);
+    if (lru_.size() > kMaxCachedAnalyses) lru_.pop_back();
+  }
+
+ private:
+  AnalysisCache() = default;
+
+  std::mutex mutex_;
+  // Most recently used at the front.
+  std::list<std::pair<uint64_t, DocumentAnalysis>> lru_;
+};
+
+void AnalyzePage(PopplerPage* page, int pageIndex, PageAnalysis* out) {
+  out->pageIndex = pageIndex;
+  poppler_page_get_size(page, &out->widthPts, &out->heightPts);
+  out->landscape = out->widthPts > out->heightPts;
+
+  // Crop box tidak ikut diputar; kalau orientasinya terbalik terhadap ukuran
+  // tampilan berarti halaman diputar seperempat putaran.
+  PopplerRectangle crop;
+  poppler_page_get_crop_box(page, &crop);
+  double cropW = std::fabs(crop.x2 - crop.x1);
+  double cropH = std::fabs(crop.y2 - crop.y1);
+  if (std::fabs(cropW - cropH) > 1.0 && (cropW > cropH) != out->landscape) {
+    out->rotation = 90;
+  }
+
+  cairo_surface_t* image = RenderPageToImage(page, kAnalysisDpi);
+  if (!image) return;
+  const unsigned char* data = cairo_image_surface_get_data(image);
+  int stride = cairo_image_surface_get_stride(image);
+  int width = cairo_image_surface_get_width(image);
+  int height = cairo_image_surface_get_height(image);
+  out->blank = !RegionHasInk(data, stride, width, height, CAIRO_FORMAT_RGB24);
+  out->color = !out->blank && RegionHasChroma(data, stride, width, height, kChromaTolerance);
+  cairo_surface_destroy(image);
+}
+
+}  // namespace
+
+bool AnalyzeDocument(const std::string& source, int threadCount, DocumentAnalysis* out,
+                     AnalyzeStats* stats, std::string* error) {
+  auto startTime = std::chrono::steady_clock::now();
+  auto finish = [&](bool cached, int threads) {
+    if (!stats) return;
+    stats->cached = cached;
+    stats->threadsUsed = threads;
+    stats->elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - startTime).count();
+  };
+
+  uint64_t hash = 0;
+  bool cacheable = !DocumentCache::IsStreamSource(source) &&
+                   DocumentCache::Shared().ContentHash(source, &hash);
+  if (cacheable && AnalysisCache::Shared().Lookup(hash, out)) {
+    finish(true, 0);
+    return true;
+  }
+
+  DocumentLease document = DocumentCache::Shared().Acquire(source, error);
+  if (!document) return false;
+  int numPages = document.page_count();
+
+  if (threadCount <= 0) {
+    threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadCount = std::max(1, std::min(threadCount, numPages));
+
+  DocumentAnalysis analysis;
+  analysis.pages.resize(numPages);
+  std::atomic<int> nextPage{0};
+  std::atomic<bool> failed{false};
+
+  // Tiap worker memakai dokumennya sendiri; thread pemanggil ikut bekerja
+  // dengan lease yang sudah ada.
+  auto work = [&](DocumentLease* lease) {
+    for (int index = nextPage++; index < numPages; index = nextPage++) {
+      PopplerPage* page = lease->page(index);
+      if (!page) {
+        failed = true;
+        return;
+      }
+      AnalyzePage(page, index, &analysis.pages[index]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threadCount; ++i) {
+    workers.emplace_back([&]() {
+      std::string ignored;
+      DocumentLease lease = DocumentCache::Shared().Acquire(source, &ignored);
+      if (lease) work(&lease);
+    });
+  }
+  work(&document);
+  for (std::thread& worker : workers) worker.join();
+
+  if (failed) {
+    if (error) *error = "Failed to read a page of the document.";
+    return false;
+  }
+
+  for (const PageAnalysis& page : analysis.pages) {
+    if (page.color) analysis.colorPages++;
+    if (page.blank) analysis.blankPages++;
+  }
+  if (cacheable) AnalysisCache::Shared().Store(hash, analysis);
+  *out = std::move(analysis);
+  finish(false, threadCount);
+  return true;
+}
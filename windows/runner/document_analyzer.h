@@ -0,0 +1,49 @@
+#ifndef RUNNER_DOCUMENT_ANALYZER_H_
+#define RUNNER_DOCUMENT_ANALYZER_H_
+
+#include <string>
+#include <vector>
+
+// Preflight result for one page.
+struct PageAnalysis {
+  int pageIndex = 0;
+  // Displayed size, /Rotate applied.
+  double widthPts = 0.0;
+  double heightPts = 0.0;
+  // 0 or 90. Poppler's GLib API does not expose /Rotate, so a quarter turn is
+  // inferred from the crop box being transposed against the displayed size;
+  // 180 degrees reads as 0.
+  int rotation = 0;
+  bool landscape = false;
+  // Any pixel with chroma at the analysis resolution (see RegionHasChroma).
+  bool color = false;
+  // Nothing but white at the analysis resolution.
+  bool blank = false;
+};
+
+struct DocumentAnalysis {
+  std::vector<PageAnalysis> pages;
+  int colorPages = 0;
+  int blankPages = 0;
+};
+
+struct AnalyzeStats {
+  double elapsedMs = 0.0;
+  int threadsUsed = 0;
+  // The result came from the analysis cache.
+  bool cached = false;
+};
+
+// Resolution the preflight renders pages at. Coarse on purpose: it only has
+// to tell colour from grey and empty from printed.
+constexpr double kAnalysisDpi = 36.0;
+
+// Renders every page of |source| (a file path or a DocumentCache source) once
+// at kAnalysisDpi on |threadCount| workers (0: one per hardware thread), each
+// with its own document, and classifies it. Results are kept in a small LRU
+// keyed by DocumentCache::ContentHash, so repeated preflights of one file
+// return immediately; stream sources are never cached.
+bool AnalyzeDocument(const std::string& source, int threadCount, DocumentAnalysis* out,
+                     AnalyzeStats* stats, std::string* error);
+
+#endif  // RUNNER_DOCUMENT_ANALYZER_H_
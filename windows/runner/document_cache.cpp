@@ -0,0 +1,373 @@
+#include "document_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "margin_cache.h"
+
+namespace {
+
+constexpr char kMemorySourcePrefix[] = "memory:";
+constexpr char kStreamSourcePrefix[] = "stream:";
+
+bool HasPrefix(const std::string& source, const char* prefix) {
+  return source.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+// Rough cost of one parsed PopplerPage (page dict, resources, annots).
+constexpr size_t kPageCostBytes = 32 * 1024;
+
+bool MakeDocumentKey(const std::string& filePath, std::string* key,
+                     size_t* fileSize) {
+  std::filesystem::path file = std::filesystem::u8path(filePath);
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(file, ec);
+  if (ec) return false;
+  auto modified = std::filesystem::last_write_time(file, ec);
+  if (ec) return false;
+
+  *key = filePath + "|" + std::to_string(size) + "|" +
+         std::to_string(modified.time_since_epoch().count());
+  *fileSize = (size_t)size;
+  return true;
+}
+
+// Takes over the caller's reference to |bytes|.
+PopplerDocument* LoadFromBytes(GBytes* bytes, std::string* error) {
+  GError* gerror = nullptr;
+  PopplerDocument* doc = poppler_document_new_from_bytes(bytes, nullptr, &gerror);
+  g_bytes_unref(bytes);
+  if (!doc) {
+    if (error) *error = gerror ? gerror->message : "Failed to load PDF document.";
+    g_clear_error(&gerror);
+    return nullptr;
+  }
+  return doc;
+}
+
+PopplerDocument* LoadDocument(const std::string& filePath, bool mapped,
+                              std::string* error) {
+  GError* gerror = nullptr;
+  GBytes* bytes = nullptr;
+  if (mapped) {
+    // File besar dipetakan, bukan disalin; Poppler hanya menyentuh halaman yang dibaca
+    GMappedFile* mapping = g_mapped_file_new(filePath.c_str(), FALSE, &gerror);
+    if (mapping) {
+      bytes = g_mapped_file_get_bytes(mapping);
+      g_mapped_file_unref(mapping);
+    }
+  } else {
+    gchar* contents = nullptr;
+    gsize length = 0;
+    // Dokumen memegang referensi ke bytes, file di disk langsung bebas lagi
+    if (g_file_get_contents(filePath.c_str(), &contents, &length, &gerror)) {
+      bytes = g_bytes_new_take(contents, length);
+    }
+  }
+  if (!bytes) {
+    if (error) *error = gerror ? gerror->message : "Failed to read PDF file.";
+    g_clear_error(&gerror);
+    return nullptr;
+  }
+  return LoadFromBytes(bytes, error);
+}
+
+// Linearized downloads go through Poppler's on-demand loader, which blocks
+// in StreamingBuffer::Read until each range it needs has arrived; anything
+// else is parsed from the complete download.
+PopplerDocument* LoadFromStream(StreamingBuffer* buffer, bool* progressive,
+                                std::string* error) {
+  *progressive = buffer->WaitForLinearized();
+  if (!*progressive) {
+    if (!buffer->WaitForComplete()) {
+      if (error) *error = "PDF download failed.";
+      return nullptr;
+    }
+    return LoadFromBytes(buffer->Bytes(), error);
+  }
+
+  GError* gerror = nullptr;
+  GInputStream* input = buffer->NewInputStream();
+  PopplerDocument* doc = poppler_document_new_from_stream(
+      input, buffer->expected_length(), nullptr, nullptr, &gerror);
+  g_object_unref(input);
+  if (!doc) {
+    if (error) *error = gerror ? gerror->message : "Failed to parse PDF download.";
+    g_clear_error(&gerror);
+  }
+  return doc;
+}
+
+}  // namespace
+
+struct DocumentLease::Instance {
+  std::string key;
+  PopplerDocument* doc = nullptr;
+  std::vector<PopplerPage*> pages;
+  size_t bytes = 0;
+  double parseMs = 0.0;
+  // Memory-mapped file or download: never kept idle.
+  bool mapped = false;
+  bool streamed = false;
+  bool progressive = false;
+
+  ~Instance() {
+    for (PopplerPage* page : pages) {
+      if (page) g_object_unref(page);
+    }
+    if (doc) g_object_unref(doc);
+  }
+};
+
+DocumentLease::~DocumentLease() { Reset(); }
+
+DocumentLease::DocumentLease(DocumentLease&& other) noexcept
+    : cache_(other.cache_), instance_(other.instance_) {
+  other.instance_ = nullptr;
+}
+
+DocumentLease& DocumentLease::operator=(DocumentLease&& other) noexcept {
+  if (this != &other) {
+    Reset();
+    cache_ = other.cache_;
+    instance_ = other.instance_;
+    other.instance_ = nullptr;
+  }
+  return *this;
+}
+
+PopplerDocument* DocumentLease::document() const {
+  return instance_ ? instance_->doc : nullptr;
+}
+
+int DocumentLease::page_count() const {
+  return instance_ ? (int)instance_->pages.size() : 0;
+}
+
+bool DocumentLease::mapped() const {
+  return instance_ && instance_->mapped;
+}
+
+bool DocumentLease::progressive() const {
+  return instance_ && instance_->progressive;
+}
+
+PopplerPage* DocumentLease::page(int index) {
+  if (!instance_ || index < 0 || index >= (int)instance_->pages.size()) {
+    return nullptr;
+  }
+  PopplerPage*& page = instance_->pages[index];
+  if (!page) {
+    page = poppler_document_get_page(instance_->doc, index);
+    if (page) instance_->bytes += kPageCostBytes;
+  }
+  return page;
+}
+
+PopplerPage* DocumentLease::loaded_page(int index) const {
+  if (!instance_ || index < 0 || index >= (int)instance_->pages.size()) {
+    return nullptr;
+  }
+  return instance_->pages[index];
+}
+
+void DocumentLease::Reset() {
+  if (instance_) {
+    cache_->Release(instance_);
+    instance_ = nullptr;
+  }
+}
+
+DocumentCache& DocumentCache::Shared() {
+  static DocumentCache* cache = new DocumentCache();
+  return *cache;
+}
+
+void DocumentCache::Configure(size_t maxIdleDocuments, size_t memoryBudgetBytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_idle_documents_ = maxIdleDocuments;
+  memory_budget_ = memoryBudgetBytes;
+  EvictLocked();
+}
+
+DocumentLease DocumentCache::Acquire(const std::string& source,
+                                     std::string* error) {
+  bool isMemory = IsMemorySource(source);
+  bool isStream = IsStreamSource(source);
+  std::string key = source;
+  size_t fileSize = 0;
+  if (!isMemory && !isStream && !MakeDocumentKey(source, &key, &fileSize)) {
+    if (error) *error = "PDF file not found: " + source;
+    return DocumentLease();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = idle_.begin(); it != idle_.end(); ++it) {
+      if ((*it)->key != key) continue;
+      DocumentLease::Instance* instance = *it;
+      idle_.erase(it);
+      idle_bytes_ -= instance->bytes;
+      stats_.hits++;
+      stats_.savedMs += instance->parseMs;
+      return DocumentLease(this, instance);
+    }
+  }
+
+  GBytes* memoryBytes = nullptr;
+  if (isMemory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = memory_sources_.find(source);
+    if (it == memory_sources_.end()) {
+      if (error) *error = "PDF bytes are no longer registered: " + source;
+      return DocumentLease();
+    }
+    memoryBytes = g_bytes_ref(it->second.bytes);
+    fileSize = g_bytes_get_size(memoryBytes);
+  }
+  std::shared_ptr<StreamingBuffer> stream;
+  if (isStream) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(source);
+    if (it == streams_.end()) {
+      if (error) *error = "PDF download is no longer registered: " + source;
+      return DocumentLease();
+    }
+    stream = it->second;
+  }
+  bool mapped = !isMemory && !isStream && fileSize >= kMapThresholdBytes;
+
+  // Parsing di luar lock supaya file lain tidak ikut menunggu
+  auto start = std::chrono::steady_clock::now();
+  bool progressive = false;
+  PopplerDocument* doc = nullptr;
+  if (isMemory) {
+    doc = LoadFromBytes(memoryBytes, error);
+  } else if (isStream) {
+    doc = LoadFromStream(stream.get(), &progressive, error);
+    fileSize = (size_t)std::max<int64_t>(stream->expected_length(), stream->received());
+  } else {
+    doc = LoadDocument(source, mapped, error);
+  }
+  if (!doc) return DocumentLease();
+
+  auto* instance = new DocumentLease::Instance();
+  instance->key = key;
+  instance->doc = doc;
+  instance->pages.resize(std::max(0, poppler_document_get_n_pages(doc)), nullptr);
+  instance->bytes = fileSize;
+  instance->mapped = mapped;
+  instance->streamed = isStream;
+  instance->progressive = progressive;
+  instance->parseMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.misses++;
+  stats_.parseMs += instance->parseMs;
+  if (isMemory) stats_.memoryLoads++;
+  if (mapped) stats_.mappedLoads++;
+  if (isStream) stats_.streamLoads++;
+  if (progressive) stats_.progressiveLoads++;
+  return DocumentLease(this, instance);
+}
+
+void DocumentCache::Release(DocumentLease::Instance* instance) {
+  if (instance->mapped || instance->streamed) {
+    // Lepas mapping sekarang, di Windows file terkunci selama masih dipetakan.
+    // Unduhan punya nama sekali pakai, tidak ada gunanya disimpan.
+    delete instance;
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.push_front(instance);
+  idle_bytes_ += instance->bytes;
+  EvictLocked();
+}
+
+void DocumentCache::EvictLocked() {
+  while (!idle_.empty() &&
+         (idle_.size() > max_idle_documents_ || idle_bytes_ > memory_budget_)) {
+    DocumentLease::Instance* oldest = idle_.back();
+    idle_.pop_back();
+    idle_bytes_ -= oldest->bytes;
+    delete oldest;
+    stats_.evictions++;
+  }
+}
+
+std::string DocumentCache::RegisterBytes(GBytes* bytes) {
+  gsize size = 0;
+  const void* data = g_bytes_get_data(bytes, &size);
+  uint64_t hash = HashContent(data, size);
+  std::string source = kMemorySourcePrefix + std::to_string(hash) + "-" + std::to_string(size);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  MemorySource& entry = memory_sources_[source];
+  if (!entry.bytes) {
+    entry.bytes = g_bytes_ref(bytes);
+    entry.hash = hash;
+  }
+  entry.registrations++;
+  return source;
+}
+
+void DocumentCache::UnregisterBytes(const std::string& source) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = memory_sources_.find(source);
+  if (it == memory_sources_.end()) return;
+  if (--it->second.registrations > 0) return;
+  // Dokumen idle dari sumber ini tetap memegang referensinya sendiri
+  g_bytes_unref(it->second.bytes);
+  memory_sources_.erase(it);
+}
+
+bool DocumentCache::IsMemorySource(const std::string& source) {
+  return HasPrefix(source, kMemorySourcePrefix);
+}
+
+std::string DocumentCache::RegisterStream(std::shared_ptr<StreamingBuffer> buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string source = kStreamSourcePrefix + std::to_string(++next_stream_id_);
+  streams_[source] = std::move(buffer);
+  return source;
+}
+
+void DocumentCache::UnregisterStream(const std::string& source) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Dokumen yang sedang dibuka tetap memegang buffer lewat input stream-nya
+  streams_.erase(source);
+}
+
+bool DocumentCache::IsStreamSource(const std::string& source) {
+  return HasPrefix(source, kStreamSourcePrefix);
+}
+
+bool DocumentCache::ContentHash(const std::string& source, uint64_t* hash) {
+  // Isi unduhan belum lengkap saat halaman pertama dicetak
+  if (IsStreamSource(source)) return false;
+  if (!IsMemorySource(source)) return HashFileContent(source, hash);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = memory_sources_.find(source);
+  if (it == memory_sources_.end()) return false;
+  *hash = it->second.hash;
+  return true;
+}
+
+void DocumentCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (DocumentLease::Instance* instance : idle_) delete instance;
+  idle_.clear();
+  idle_bytes_ = 0;
+}
+
+DocumentCacheStats DocumentCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  DocumentCacheStats stats = stats_;
+  stats.idleDocuments = idle_.size();
+  stats.idleBytes = idle_bytes_;
+  return stats;
+}
@@ -0,0 +1,158 @@
+#ifndef RUNNER_DOCUMENT_CACHE_H_
+#define RUNNER_DOCUMENT_CACHE_H_
+
+#include <poppler/glib/poppler.h>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "streaming_buffer.h"
+
+class DocumentCache;
+
+// Exclusive use of one parsed document from DocumentCache. Poppler documents
+// are not thread-safe, so a document instance is only ever handed to one
+// lease at a time; concurrent users of the same file get separate instances.
+// The document goes back to the cache when the lease is destroyed.
+class DocumentLease {
+ public:
+  DocumentLease() = default;
+  ~DocumentLease();
+
+  DocumentLease(DocumentLease&& other) noexcept;
+  DocumentLease& operator=(DocumentLease&& other) noexcept;
+  DocumentLease(DocumentLease const&) = delete;
+  DocumentLease& operator=(DocumentLease const&) = delete;
+
+  explicit operator bool() const { return instance_ != nullptr; }
+
+  PopplerDocument* document() const;
+  int page_count() const;
+  // True if the document reads from a memory-mapped file.
+  bool mapped() const;
+  // True if the document was opened from a download still in progress.
+  bool progressive() const;
+
+  // Page |index| (0-based), parsed once and kept with the cached document.
+  // Owned by the cache: do not unref. Returns nullptr if out of range.
+  PopplerPage* page(int index);
+  // Page |index| only if it was parsed already; never touches the document,
+  // so it cannot block on a download. nullptr otherwise.
+  PopplerPage* loaded_page(int index) const;
+
+  // Returns the document to the cache early.
+  void Reset();
+
+ private:
+  friend class DocumentCache;
+  struct Instance;
+
+  DocumentLease(DocumentCache* cache, Instance* instance)
+      : cache_(cache), instance_(instance) {}
+
+  DocumentCache* cache_ = nullptr;
+  Instance* instance_ = nullptr;
+};
+
+struct DocumentCacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t evictions = 0;
+  // Total time spent parsing on misses, and the parse time hits avoided
+  // (the recorded parse time of each reused document).
+  double parseMs = 0.0;
+  double savedMs = 0.0;
+  size_t idleDocuments = 0;
+  size_t idleBytes = 0;
+  // Parses from channel bytes and from memory-mapped files (misses only).
+  int64_t memoryLoads = 0;
+  int64_t mappedLoads = 0;
+  // Parses from downloads, and those that started before the download
+  // completed (linearized files).
+  int64_t streamLoads = 0;
+  int64_t progressiveLoads = 0;
+};
+
+// Pool of parsed PopplerDocuments keyed by path, size and modification time,
+// so batches, copies and retries of one file are parsed once. Idle documents
+// are evicted least recently used first, bounded by count and by an
+// estimated memory budget.
+//
+// Small files are read into memory, so the cache never keeps them open and
+// Flutter can still delete its temp files. Files of kMapThresholdBytes and
+// more are memory-mapped instead of copied; those documents are dropped as
+// soon as their lease ends so the mapping (and the file lock on Windows) goes
+// with it. PDFs that arrive as bytes are registered as memory sources and
+// parsed straight from the caller's buffer; PDFs still downloading are
+// registered as stream sources (see RegisterStream).
+class DocumentCache {
+ public:
+  static constexpr size_t kMapThresholdBytes = 16 * 1024 * 1024;
+
+  static DocumentCache& Shared();
+
+  void Configure(size_t maxIdleDocuments, size_t memoryBudgetBytes);
+
+  // |source| is a file path or a name from RegisterBytes/RegisterStream.
+  // Returns an empty lease and fills |error| if it cannot be parsed. For a
+  // stream source this blocks until enough of the download has arrived.
+  DocumentLease Acquire(const std::string& source, std::string* error);
+
+  // Registers a PDF held in |bytes| (a reference is taken) and returns a
+  // source name ("memory:<content hash>") that can be used wherever a file
+  // path is accepted, pipeline workers included. Every document parsed from
+  // it shares the buffer. Registering identical content again returns the
+  // same name; each call needs its own UnregisterBytes.
+  std::string RegisterBytes(GBytes* bytes);
+  void UnregisterBytes(const std::string& source);
+  static bool IsMemorySource(const std::string& source);
+
+  // Registers a PDF that is still downloading into |buffer| and returns a
+  // source name ("stream:<n>"). A linearized file with a known length is
+  // opened as soon as its first page has arrived and Poppler fetches the
+  // rest on demand; any other file is parsed once the download completes.
+  // Documents from a stream are never kept idle.
+  std::string RegisterStream(std::shared_ptr<StreamingBuffer> buffer);
+  void UnregisterStream(const std::string& source);
+  static bool IsStreamSource(const std::string& source);
+
+  // Content hash for the margin cache: from the registration for memory
+  // sources, HashFileContent for files. Not available for streams.
+  bool ContentHash(const std::string& source, uint64_t* hash);
+
+  // Frees every idle document.
+  void Clear();
+
+  DocumentCacheStats stats();
+
+ private:
+  friend class DocumentLease;
+
+  DocumentCache() = default;
+  struct MemorySource {
+    GBytes* bytes = nullptr;
+    uint64_t hash = 0;
+    int registrations = 0;
+  };
+
+  void Release(DocumentLease::Instance* instance);
+  void EvictLocked();
+
+  std::mutex mutex_;
+  size_t max_idle_documents_ = 8;
+  size_t memory_budget_ = 256 * 1024 * 1024;
+  // Most recently used at the front.
+  std::list<DocumentLease::Instance*> idle_;
+  size_t idle_bytes_ = 0;
+  std::map<std::string, MemorySource> memory_sources_;
+  std::map<std::string, std::shared_ptr<StreamingBuffer>> streams_;
+  int next_stream_id_ = 0;
+  DocumentCacheStats stats_;
+};
+
+#endif  // RUNNER_DOCUMENT_CACHE_H_
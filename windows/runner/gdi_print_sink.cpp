@@ -0,0 +1,164 @@
+#include "gdi_print_sink.h"
+
+#include <cairo/cairo-win32.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+
+GdiPrintSink::GdiPrintSink(HDC hdc, DevModeSource devModeSource)
+    : hdc_(hdc), dev_mode_source_(std::move(devModeSource)) {}
+
+GdiPrintSink::~GdiPrintSink() {
+  DestroyPageSurface();
+}
+
+bool GdiPrintSink::StartDocument(const std::string& name, int* spoolJobId) {
+  int size = MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, nullptr, 0);
+  std::wstring wname(size > 0 ? size - 1 : 0, L'\0');
+  if (size > 1) {
+    MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, &wname[0], size);
+  }
+
+  DOCINFO docInfo;
+  ZeroMemory(&docInfo, sizeof(docInfo));
+  docInfo.cbSize = sizeof(docInfo);
+  docInfo.lpszDocName = wname.c_str();
+
+  int jobId = StartDoc(hdc_, &docInfo);
+  if (spoolJobId) *spoolJobId = jobId > 0 ? jobId : 0;
+  return jobId > 0;
+}
+
+bool GdiPrintSink::StartPage() {
+  if (::StartPage(hdc_) <= 0) return false;
+  if (raster_.dpi <= 0) {
+    page_surface_ = cairo_win32_printing_surface_create(hdc_);
+    return true;
+  }
+  // Mode raster: halaman digambar per pita beresolusi raster_.dpi
+  int deviceDpiX = GetDeviceCaps(hdc_, LOGPIXELSX);
+  int deviceDpiY = GetDeviceCaps(hdc_, LOGPIXELSY);
+  double scaleX = deviceDpiX > 0 ? (double)std::min(raster_.dpi, deviceDpiX) / deviceDpiX : 1.0;
+  double scaleY = deviceDpiY > 0 ? (double)std::min(raster_.dpi, deviceDpiY) / deviceDpiY : 1.0;
+  bands_ = std::make_unique<RasterBands>(GetDeviceCaps(hdc_, HORZRES), GetDeviceCaps(hdc_, VERTRES),
+                                         scaleX, scaleY, raster_.bandRows);
+  band_ = 0;
+  band_failed_ = false;
+  dither_ = DitherState();
+  page_surface_ = bands_->CreateBandSurface(0);
+  return page_surface_ != nullptr;
+}
+
+cairo_surface_t* GdiPrintSink::PageSurface() {
+  return page_surface_;
+}
+
+bool GdiPrintSink::NextBand() {
+  if (!bands_ || !page_surface_) return false;
+  if (!SendBand()) band_failed_ = true;
+  DestroyPageSurface();
+  if (++band_ >= bands_->band_count()) return false;
+  page_surface_ = bands_->CreateBandSurface(band_);
+  if (!page_surface_) band_failed_ = true;
+  return page_surface_ != nullptr;
+}
+
+bool GdiPrintSink::EndPage() {
+  bool sent = true;
+  if (bands_) {
+    // Pita terakhir belum dikirim jika pemanggil tidak memakai NextBand
+    if (page_surface_ && !SendBand()) band_failed_ = true;
+    sent = !band_failed_;
+    bands_.reset();
+  }
+  // Surface harus selesai (flush ke DC) sebelum EndPage
+  DestroyPageSurface();
+  return ::EndPage(hdc_) > 0 && sent;
+}
+
+bool GdiPrintSink::EndDocument() {
+  return EndDoc(hdc_) > 0;
+}
+
+void GdiPrintSink::AbortDocument() {
+  DestroyPageSurface();
+  EndDoc(hdc_);
+}
+
+bool GdiPrintSink::ChangePageSetup(const PageSetup& setup) {
+  if (!dev_mode_source_) return false;
+  std::vector<unsigned char> devMode;
+  if (!dev_mode_source_(setup, &devMode)) return false;
+  // ResetDC di antara halaman: kertas/warna/duplex berganti tanpa StartDoc baru
+  return ResetDCW(hdc_, reinterpret_cast<const DEVMODEW*>(devMode.data())) != nullptr;
+}
+
+void GdiPrintSink::SetRasterMode(const RasterMode& mode) {
+  raster_ = mode;
+}
+
+PrintPageGeometry GdiPrintSink::Geometry() {
+  PrintPageGeometry geometry;
+  geometry.physicalWidth = GetDeviceCaps(hdc_, PHYSICALWIDTH);
+  geometry.physicalHeight = GetDeviceCaps(hdc_, PHYSICALHEIGHT);
+  geometry.offsetX = GetDeviceCaps(hdc_, PHYSICALOFFSETX);
+  geometry.offsetY = GetDeviceCaps(hdc_, PHYSICALOFFSETY);
+  geometry.printableWidth = GetDeviceCaps(hdc_, HORZRES);
+  geometry.printableHeight = GetDeviceCaps(hdc_, VERTRES);
+  geometry.dpiX = GetDeviceCaps(hdc_, LOGPIXELSX);
+  geometry.dpiY = GetDeviceCaps(hdc_, LOGPIXELSY);
+  return geometry;
+}
+
+bool GdiPrintSink::SendBand() {
+  cairo_surface_flush(page_surface_);
+  int width = cairo_image_surface_get_width(page_surface_);
+  int rows = cairo_image_surface_get_height(page_surface_);
+  const void* bits = cairo_image_surface_get_data(page_surface_);
+
+  // DIB top-down. Warna: RGB24 cairo (BGRX) langsung jadi DIB 32bpp.
+  // Mono: 1bpp, indeks 0 hitam, 1 putih.
+  struct {
+    BITMAPINFOHEADER header;
+    RGBQUAD colors[2];
+  } info;
+  ZeroMemory(&info, sizeof(info));
+  info.header.biSize = sizeof(BITMAPINFOHEADER);
+  info.header.biWidth = width;
+  info.header.biHeight = -rows;
+  info.header.biPlanes = 1;
+  info.header.biBitCount = 32;
+  info.header.biCompression = BI_RGB;
+
+  BilevelImage image;
+  if (raster_.mono != DitherMode::kOff) {
+    auto start = std::chrono::steady_clock::now();
+    bool converted = ConvertToBilevel(page_surface_, raster_.mono, &image, &dither_);
+    mono_convert_ms_ += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!converted) return false;
+    bits = image.bits.data();
+    info.header.biBitCount = 1;
+    info.header.biClrUsed = 2;
+    info.colors[1].rgbRed = 255;
+    info.colors[1].rgbGreen = 255;
+    info.colors[1].rgbBlue = 255;
+  }
+
+  int top = bands_->device_top(band_);
+  int lines = StretchDIBits(hdc_, 0, top, GetDeviceCaps(hdc_, HORZRES), bands_->device_bottom(band_) - top,
+                            0, 0, width, rows, bits,
+                            reinterpret_cast<const BITMAPINFO*>(&info), DIB_RGB_COLORS, SRCCOPY);
+  // 0 atau GDI_ERROR (-1) berarti gagal
+  return lines > 0;
+}
+
+void GdiPrintSink::DestroyPageSurface() {
+  if (page_surface_) {
+    cairo_surface_finish(page_surface_);
+    cairo_surface_destroy(page_surface_);
+    page_surface_ = nullptr;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef RUNNER_GDI_PRINT_SINK_H_
+#define RUNNER_GDI_PRINT_SINK_H_
+
+#include <windows.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "print_sink.h"
+#include "raster_band.h"
+
+// Builds the DEVMODE (as raw bytes) for a page setup of the sink's printer.
+using DevModeSource =
+    std::function<bool(const PageSetup& setup, std::vector<unsigned char>* devMode)>;
+
+// PrintSink on top of a Win32 printer DC. Each page gets a fresh
+// cairo_win32_printing_surface. In raster mode pages are drawn on image bands
+// sent with StretchDIBits as 32bpp or 1bpp DIBs (the printing surface records
+// the whole page before emitting anything and only knows 24-bit images), so
+// only one band is ever in memory. Does not own |hdc|. Page setup changes go
+// through ResetDC with a DEVMODE from |devModeSource|; without one they fail.
+class GdiPrintSink : public PrintSink {
+ public:
+  explicit GdiPrintSink(HDC hdc, DevModeSource devModeSource = nullptr);
+  ~GdiPrintSink() override;
+
+  // Prevent copying.
+  GdiPrintSink(GdiPrintSink const&) = delete;
+  GdiPrintSink& operator=(GdiPrintSink const&) = delete;
+
+  // PrintSink:
+  bool StartDocument(const std::string& name, int* spoolJobId) override;
+  bool StartPage() override;
+  cairo_surface_t* PageSurface() override;
+  bool NextBand() override;
+  bool EndPage() override;
+  bool EndDocument() override;
+  void AbortDocument() override;
+  bool ChangePageSetup(const PageSetup& setup) override;
+  void SetRasterMode(const RasterMode& mode) override;
+  double mono_convert_ms() const override { return mono_convert_ms_; }
+  PrintPageGeometry Geometry() override;
+
+ private:
+  void DestroyPageSurface();
+  bool SendBand();
+
+  HDC hdc_;
+  DevModeSource dev_mode_source_;
+  cairo_surface_t* page_surface_ = nullptr;
+  RasterMode raster_;
+  // Halaman raster yang sedang digambar, per pita
+  std::unique_ptr<RasterBands> bands_;
+  int band_ = 0;
+  bool band_failed_ = false;
+  DitherState dither_;
+  double mono_convert_ms_ = 0.0;
+};
+
+#endif  // RUNNER_GDI_PRINT_SINK_H_
@@ -0,0 +1,304 @@
+#include "ink_scanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define INK_SCANNER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits any intrinsic without extra flags; GCC/Clang need the target
+// attribute so the AVX2 kernels build without -mavx2 on the whole file.
+#if defined(__GNUC__) || defined(__clang__)
+#define INK_TARGET_SSE2 __attribute__((target("sse2")))
+#define INK_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define INK_TARGET_SSE2
+#define INK_TARGET_AVX2
+#endif
+
+namespace {
+
+enum class ScanPath { kScalar, kSse2, kAvx2 };
+
+template <cairo_format_t Format>
+constexpr int BytesPerPixel() {
+  return Format == CAIRO_FORMAT_A8 ? 1 : 4;
+}
+
+template <cairo_format_t Format>
+bool IsInkPixel(const unsigned char* p) {
+  if constexpr (Format == CAIRO_FORMAT_A8) {
+    return *p != 0;
+  } else {
+    uint32_t pixel;
+    std::memcpy(&pixel, p, sizeof(pixel));
+    if constexpr (Format == CAIRO_FORMAT_RGB24) {
+      return (pixel & 0x00FFFFFF) != 0x00FFFFFF;
+    } else {
+      return pixel != 0 && pixel != 0xFFFFFFFF;
+    }
+  }
+}
+
+template <cairo_format_t Format>
+bool SpanHasInkScalar(const unsigned char* p, int count) {
+  constexpr int kBytes = BytesPerPixel<Format>();
+  for (int i = 0; i < count; i++) {
+    if (IsInkPixel<Format>(p + i * kBytes)) return true;
+  }
+  return false;
+}
+
+#ifdef INK_SCANNER_X86
+
+template <cairo_format_t Format>
+INK_TARGET_SSE2 bool SpanHasInkSse2(const unsigned char* p, int count) {
+  constexpr int kBytes = BytesPerPixel<Format>();
+  constexpr int kPixelsPerVector = 16 / kBytes;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi32(-1);
+  const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+  int i = 0;
+  for (; i + kPixelsPerVector <= count; i += kPixelsPerVector) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(p + i * kBytes));
+    __m128i clean;
+    if constexpr (Format == CAIRO_FORMAT_RGB24) {
+      // Byte alpha tidak dipakai di RGB24, paksa jadi 0xFF lalu bandingkan dengan putih
+      clean = _mm_cmpeq_epi32(_mm_or_si128(v, alpha), ones);
+    } else if constexpr (Format == CAIRO_FORMAT_ARGB32) {
+      clean = _mm_or_si128(_mm_cmpeq_epi32(v, zero), _mm_cmpeq_epi32(v, ones));
+    } else {
+      clean = _mm_cmpeq_epi8(v, zero);
+    }
+    if (_mm_movemask_epi8(clean) != 0xFFFF) return true;
+  }
+  return SpanHasInkScalar<Format>(p + i * kBytes, count - i);
+}
+
+template <cairo_format_t Format>
+INK_TARGET_AVX2 bool SpanHasInkAvx2(const unsigned char* p, int count) {
+  constexpr int kBytes = BytesPerPixel<Format>();
+  constexpr int kPixelsPerVector = 32 / kBytes;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+  int i = 0;
+  for (; i + kPixelsPerVector <= count; i += kPixelsPerVector) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(p + i * kBytes));
+    __m256i clean;
+    if constexpr (Format == CAIRO_FORMAT_RGB24) {
+      clean = _mm256_cmpeq_epi32(_mm256_or_si256(v, alpha), ones);
+    } else if constexpr (Format == CAIRO_FORMAT_ARGB32) {
+      clean = _mm256_or_si256(_mm256_cmpeq_epi32(v, zero), _mm256_cmpeq_epi32(v, ones));
+    } else {
+      clean = _mm256_cmpeq_epi8(v, zero);
+    }
+    if ((unsigned)_mm256_movemask_epi8(clean) != 0xFFFFFFFFu) return true;
+  }
+  return SpanHasInkScalar<Format>(p + i * kBytes, count - i);
+}
+
+#endif  // INK_SCANNER_X86
+
+bool IsChromaPixel(const unsigned char* p, int tolerance) {
+  int b = p[0], g = p[1], r = p[2];
+  return std::abs(b - g) > tolerance || std::abs(g - r) > tolerance ||
+         std::abs(b - r) > tolerance;
+}
+
+bool SpanHasChromaScalar(const unsigned char* p, int count, int tolerance) {
+  for (int i = 0; i < count; i++) {
+    if (IsChromaPixel(p + i * 4, tolerance)) return true;
+  }
+  return false;
+}
+
+#ifdef INK_SCANNER_X86
+
+// Per piksel BGRX: geser 8 dan 16 bit lalu selisih absolut per byte memberi
+// |B-G|, |G-R| (byte 0-1) dan |B-R| (byte 0); byte lain dibuang dengan mask.
+INK_TARGET_SSE2 bool SpanHasChromaSse2(const unsigned char* p, int count, int tolerance) {
+  const __m128i keep2 = _mm_set1_epi32(0x0000FFFF);
+  const __m128i keep1 = _mm_set1_epi32(0x000000FF);
+  const __m128i tol = _mm_set1_epi8((char)tolerance);
+  const __m128i zero = _mm_setzero_si128();
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 4));
+    __m128i s8 = _mm_srli_epi32(v, 8);
+    __m128i s16 = _mm_srli_epi32(v, 16);
+    __m128i d1 = _mm_or_si128(_mm_subs_epu8(v, s8), _mm_subs_epu8(s8, v));
+    __m128i d2 = _mm_or_si128(_mm_subs_epu8(v, s16), _mm_subs_epu8(s16, v));
+    __m128i d = _mm_max_epu8(_mm_and_si128(d1, keep2), _mm_and_si128(d2, keep1));
+    // Byte di atas toleransi tersisa setelah dikurangi toleransi
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(d, tol), zero)) != 0xFFFF) return true;
+  }
+  return SpanHasChromaScalar(p + i * 4, count - i, tolerance);
+}
+
+INK_TARGET_AVX2 bool SpanHasChromaAvx2(const unsigned char* p, int count, int tolerance) {
+  const __m256i keep2 = _mm256_set1_epi32(0x0000FFFF);
+  const __m256i keep1 = _mm256_set1_epi32(0x000000FF);
+  const __m256i tol = _mm256_set1_epi8((char)tolerance);
+  const __m256i zero = _mm256_setzero_si256();
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(p + i * 4));
+    __m256i s8 = _mm256_srli_epi32(v, 8);
+    __m256i s16 = _mm256_srli_epi32(v, 16);
+    __m256i d1 = _mm256_or_si256(_mm256_subs_epu8(v, s8), _mm256_subs_epu8(s8, v));
+    __m256i d2 = _mm256_or_si256(_mm256_subs_epu8(v, s16), _mm256_subs_epu8(s16, v));
+    __m256i d = _mm256_max_epu8(_mm256_and_si256(d1, keep2), _mm256_and_si256(d2, keep1));
+    if ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(d, tol), zero)) !=
+        0xFFFFFFFFu) {
+      return true;
+    }
+  }
+  return SpanHasChromaScalar(p + i * 4, count - i, tolerance);
+}
+
+#endif  // INK_SCANNER_X86
+
+ScanPath DetectScanPath() {
+#ifdef INK_SCANNER_X86
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  int maxLeaf = info[0];
+  __cpuid(info, 1);
+  bool sse2 = (info[3] & (1 << 26)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  // AVX2 hanya aman jika OS juga menyimpan register YMM (XCR0 bit 1 dan 2)
+  if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    if (info[1] & (1 << 5)) return ScanPath::kAvx2;
+  }
+  if (sse2) return ScanPath::kSse2;
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return ScanPath::kAvx2;
+  if (__builtin_cpu_supports("sse2")) return ScanPath::kSse2;
+#endif
+#endif
+  return ScanPath::kScalar;
+}
+
+ScanPath DetectedScanPath() {
+  static const ScanPath path = DetectScanPath();
+  return path;
+}
+
+// Normally the detected path; SetInkScannerPath may pick a narrower one.
+std::atomic<int> g_forcedPath{-1};
+
+ScanPath ActiveScanPath() {
+  int forced = g_forcedPath.load(std::memory_order_relaxed);
+  return forced < 0 ? DetectedScanPath() : (ScanPath)forced;
+}
+
+template <cairo_format_t Format>
+bool RegionHasInkFormat(const unsigned char* data, int stride, int width,
+                        int height) {
+  bool (*span)(const unsigned char*, int) = SpanHasInkScalar<Format>;
+#ifdef INK_SCANNER_X86
+  switch (ActiveScanPath()) {
+    case ScanPath::kAvx2:
+      span = SpanHasInkAvx2<Format>;
+      break;
+    case ScanPath::kSse2:
+      span = SpanHasInkSse2<Format>;
+      break;
+    case ScanPath::kScalar:
+      break;
+  }
+#endif
+
+  for (int y = 0; y < height; y++) {
+    if (span(data + (size_t)y * stride, width)) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool RegionHasInk(const unsigned char* data, int stride, int width, int height,
+                  cairo_format_t format) {
+  if (!data || width <= 0 || height <= 0) return false;
+
+  switch (format) {
+    case CAIRO_FORMAT_RGB24:
+      return RegionHasInkFormat<CAIRO_FORMAT_RGB24>(data, stride, width, height);
+    case CAIRO_FORMAT_ARGB32:
+      return RegionHasInkFormat<CAIRO_FORMAT_ARGB32>(data, stride, width, height);
+    case CAIRO_FORMAT_A8:
+      return RegionHasInkFormat<CAIRO_FORMAT_A8>(data, stride, width, height);
+    default:
+      return false;
+  }
+}
+
+bool RegionHasChroma(const unsigned char* data, int stride, int width, int height,
+                     int tolerance) {
+  if (!data || width <= 0 || height <= 0) return false;
+  tolerance = std::clamp(tolerance, 0, 255);
+
+  bool (*span)(const unsigned char*, int, int) = SpanHasChromaScalar;
+#ifdef INK_SCANNER_X86
+  switch (ActiveScanPath()) {
+    case ScanPath::kAvx2:
+      span = SpanHasChromaAvx2;
+      break;
+    case ScanPath::kSse2:
+      span = SpanHasChromaSse2;
+      break;
+    case ScanPath::kScalar:
+      break;
+  }
+#endif
+
+  for (int y = 0; y < height; y++) {
+    if (span(data + (size_t)y * stride, width, tolerance)) return true;
+  }
+  return false;
+}
+
+const char* InkScannerPath() {
+  switch (ActiveScanPath()) {
+    case ScanPath::kAvx2:
+      return "avx2";
+    case ScanPath::kSse2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+bool SetInkScannerPath(const char* path) {
+  ScanPath wanted;
+  if (strcmp(path, "avx2") == 0) {
+    wanted = ScanPath::kAvx2;
+  } else if (strcmp(path, "sse2") == 0) {
+    wanted = ScanPath::kSse2;
+  } else if (strcmp(path, "scalar") == 0) {
+    wanted = ScanPath::kScalar;
+  } else {
+    return false;
+  }
+  // Urutan enum = lebar vektor; jalur yang lebih lebar dari CPU tidak bisa
+  if ((int)wanted > (int)DetectedScanPath()) return false;
+  g_forcedPath.store((int)wanted, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef RUNNER_INK_SCANNER_H_
+#define RUNNER_INK_SCANNER_H_
+
+#include <cairo/cairo.h>
+
+// Returns true if the |width| x |height| pixel block starting at |data|
+// contains ink. What counts as ink depends on |format|:
+//   RGB24:  any pixel that is not white.
+//   ARGB32: any pixel that is neither fully transparent nor opaque white.
+//   A8:     any non-zero coverage.
+// Every row is scanned as one contiguous span with the widest SIMD path the
+// CPU supports (AVX2, SSE2, then scalar), picked once at runtime. Other
+// formats always return false.
+bool RegionHasInk(const unsigned char* data, int stride, int width, int height,
+                  cairo_format_t format);
+
+// Returns true if any RGB24 pixel of the block has chroma, i.e. two of its
+// channels differ by more than |tolerance|. Grey and black content, including
+// anti-aliased edges, never does. Same SIMD dispatch as RegionHasInk.
+bool RegionHasChroma(const unsigned char* data, int stride, int width, int height,
+                     int tolerance);
+
+// Name of the scan path picked for this CPU ("avx2", "sse2" or "scalar").
+const char* InkScannerPath();
+
+// Forces the scan path ("avx2", "sse2" or "scalar") for the whole process,
+// so tests and benchmarks can compare them on one machine. Returns false,
+// changing nothing, if the name is unknown or the CPU cannot run that path.
+bool SetInkScannerPath(const char* path);
+
+#endif  // RUNNER_INK_SCANNER_H_
@@ -0,0 +1,423 @@
+#include "ipp_client.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr int kDefaultIppPort = 631;
+constexpr size_t kReadBufferSize = 16 * 1024;
+// Respons IPP lebih besar dari ini dianggap rusak
+constexpr size_t kMaxResponseSize = 16 * 1024 * 1024;
+
+std::string ToLower(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](unsigned char c) { return (char)std::tolower(c); });
+  return text;
+}
+
+// Buffered reads of one HTTP response.
+class ResponseReader {
+ public:
+  explicit ResponseReader(IppConnection* connection) : connection_(connection) {}
+
+  // One line without its CRLF.
+  bool ReadLine(std::string* line) {
+    line->clear();
+    for (;;) {
+      if (start_ == end_ && !Fill()) return false;
+      const uint8_t* newline = (const uint8_t*)memchr(buffer_ + start_, '\n', end_ - start_);
+      size_t length = newline ? (size_t)(newline - (buffer_ + start_)) : end_ - start_;
+      line->append((const char*)buffer_ + start_, length);
+      start_ += length;
+      if (newline) {
+        start_++;
+        if (!line->empty() && line->back() == '\r') line->pop_back();
+        return true;
+      }
+      if (line->size() > kReadBufferSize) return false;
+    }
+  }
+
+  // Appends exactly |size| bytes to |out|.
+  bool Read(size_t size, std::vector<uint8_t>* out) {
+    while (size > 0) {
+      if (start_ == end_ && !Fill()) return false;
+      size_t take = std::min(size, end_ - start_);
+      out->insert(out->end(), buffer_ + start_, buffer_ + start_ + take);
+      start_ += take;
+      size -= take;
+    }
+    return true;
+  }
+
+  // Appends everything until the peer closes the connection.
+  bool ReadToEnd(std::vector<uint8_t>* out) {
+    for (;;) {
+      out->insert(out->end(), buffer_ + start_, buffer_ + end_);
+      start_ = end_;
+      if (out->size() > kMaxResponseSize) return false;
+      if (!Fill()) return !failed_;
+    }
+  }
+
+  int64_t received() const { return received_; }
+
+ private:
+  bool Fill() {
+    int64_t count = connection_->Read(buffer_, sizeof(buffer_));
+    if (count <= 0) {
+      failed_ = count < 0;
+      return false;
+    }
+    start_ = 0;
+    end_ = (size_t)count;
+    received_ += count;
+    return true;
+  }
+
+  IppConnection* connection_;
+  uint8_t buffer_[kReadBufferSize];
+  size_t start_ = 0;
+  size_t end_ = 0;
+  int64_t received_ = 0;
+  bool failed_ = false;
+};
+
+}  // namespace
+
+bool ParseIppUri(const std::string& uri, std::string* host, int* port, std::string* path) {
+  size_t schemeEnd = uri.find("://");
+  if (schemeEnd == std::string::npos) return false;
+  std::string scheme = ToLower(uri.substr(0, schemeEnd));
+  if (scheme != "ipp" && scheme != "http") return false;
+
+  size_t hostStart = schemeEnd + 3;
+  size_t pathStart = uri.find('/', hostStart);
+  std::string authority = uri.substr(hostStart, pathStart == std::string::npos
+                                                    ? std::string::npos
+                                                    : pathStart - hostStart);
+  *path = pathStart == std::string::npos ? "/" : uri.substr(pathStart);
+  *port = scheme == "http" ? 80 : kDefaultIppPort;
+
+  // "[fe80::1]:631" untuk IPv6, selain itu "host:631"
+  size_t colon = authority.rfind(':');
+  size_t bracket = authority.rfind(']');
+  if (colon != std::string::npos && (bracket == std::string::npos || colon > bracket)) {
+    *port = atoi(authority.c_str() + colon + 1);
+    authority.resize(colon);
+  }
+  if (authority.size() >= 2 && authority.front() == '[' && authority.back() == ']') {
+    authority = authority.substr(1, authority.size() - 2);
+  }
+  *host = authority;
+  return !host->empty() && *port > 0;
+}
+
+IppClient::IppClient(std::unique_ptr<IppConnector> connector, const std::string& userName)
+    : connector_(std::move(connector)), user_name_(userName) {}
+
+IppMessage IppClient::NewRequest(IppOperation operation, const std::string& printerUri) {
+  IppMessage request(operation, printerUri);
+  request.AddString(kIppTagOperation, kIppTagName, "requesting-user-name", user_name_);
+  return request;
+}
+
+std::unique_ptr<IppConnection> IppClient::Acquire(const std::string& host, int port, bool* reused,
+                                                  std::string* error) {
+  std::string key = host + ":" + std::to_string(port);
+  auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(key);
+    while (it != idle_.end() && !it->second.empty()) {
+      // Yang terakhir dipakai paling mungkin masih hidup
+      IdleConnection idle = std::move(it->second.back());
+      it->second.pop_back();
+      if (now - idle.since < kIdleTimeout && !idle.connection->Closed()) {
+        stats_.connectionsReused++;
+        *reused = true;
+        return std::move(idle.connection);
+      }
+    }
+  }
+
+  *reused = false;
+  std::unique_ptr<IppConnection> connection = connector_->Connect(host, port, error);
+  if (connection) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.connectionsOpened++;
+  }
+  return connection;
+}
+
+void IppClient::Release(const std::string& host, int port,
+                        std::unique_ptr<IppConnection> connection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<IdleConnection>& idle = idle_[host + ":" + std::to_string(port)];
+  if (idle.size() >= kMaxIdlePerPrinter) idle.erase(idle.begin());
+  IdleConnection entry;
+  entry.connection = std::move(connection);
+  entry.since = std::chrono::steady_clock::now();
+  idle.push_back(std::move(entry));
+}
+
+bool IppClient::Send(const std::string& printerUri, IppMessage* request,
+                     const IppDocumentReader& document, IppMessage* response, std::string* error) {
+  std::string host, path;
+  int port = 0;
+  if (!ParseIppUri(printerUri, &host, &port, &path)) {
+    *error = "Unsupported printer URI: " + printerUri;
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    request->requestId = next_request_id_++;
+    stats_.requests++;
+  }
+  std::vector<uint8_t> body;
+  request->Encode(&body);
+
+  // Koneksi lama yang ternyata sudah ditutup printer dicoba sekali lagi
+  // dengan koneksi baru
+  for (int attempt = 0;; ++attempt) {
+    bool reused = false;
+    std::unique_ptr<IppConnection> connection = Acquire(host, port, &reused, error);
+    if (!connection) return false;
+
+    bool keepAlive = false, retry = false;
+    IppClientStats counters;
+    bool ok = Exchange(connection.get(), host, port, path, body, document, response, &keepAlive,
+                       &retry, &counters, error);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.bytesSent += counters.bytesSent;
+      stats_.bytesReceived += counters.bytesReceived;
+    }
+    if (ok && keepAlive) Release(host, port, std::move(connection));
+    if (ok || !retry || !reused || attempt > 0) return ok;
+  }
+}
+
+bool IppClient::Exchange(IppConnection* connection, const std::string& host, int port,
+                         const std::string& path, const std::vector<uint8_t>& body,
+                         const IppDocumentReader& document, IppMessage* response, bool* keepAlive,
+                         bool* retry, IppClientStats* counters, std::string* error) {
+  std::string hostHeader = host.find(':') != std::string::npos ? "[" + host + "]" : host;
+  std::string head = "POST " + path + " HTTP/1.1\r\nHost: " + hostHeader + ":" +
+                     std::to_string(port) + "\r\nContent-Type: application/ipp\r\n";
+  // Tanpa dokumen panjangnya diketahui; dengan dokumen dikirim per chunk
+  head += document ? "Transfer-Encoding: chunked\r\n\r\n"
+                   : "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+
+  std::vector<uint8_t> packet(head.begin(), head.end());
+  if (document) {
+    char size[16];
+    snprintf(size, sizeof(size), "%zx\r\n", body.size());
+    packet.insert(packet.end(), size, size + strlen(size));
+  }
+  packet.insert(packet.end(), body.begin(), body.end());
+  if (document) packet.insert(packet.end(), {'\r', '\n'});
+  if (!connection->Write(packet.data(), packet.size())) {
+    *retry = true;
+    *error = "Failed to send the IPP request.";
+    return false;
+  }
+  counters->bytesSent += (int64_t)packet.size();
+
+  if (document) {
+    // Ruang di depan untuk ukuran chunk dan di belakang untuk CRLF, supaya
+    // satu chunk cukup satu kali Write tanpa menyalin data
+    constexpr size_t kChunkHeader = 10;
+    std::vector<uint8_t> chunk(kChunkHeader + kChunkSize + 2);
+    for (;;) {
+      int64_t count = document(chunk.data() + kChunkHeader, kChunkSize);
+      if (count < 0) {
+        *error = "Document data could not be read.";
+        return false;
+      }
+      if (count == 0) break;
+      char size[kChunkHeader + 1];
+      int sizeLength = snprintf(size, sizeof(size), "%llx\r\n", (unsigned long long)count);
+      uint8_t* start = chunk.data() + kChunkHeader - sizeLength;
+      memcpy(start, size, (size_t)sizeLength);
+      chunk[kChunkHeader + (size_t)count] = '\r';
+      chunk[kChunkHeader + (size_t)count + 1] = '\n';
+      size_t length = (size_t)sizeLength + (size_t)count + 2;
+      if (!connection->Write(start, length)) {
+        *error = "Connection lost while sending the document.";
+        return false;
+      }
+      counters->bytesSent += (int64_t)length;
+    }
+    static const char kLastChunk[] = "0\r\n\r\n";
+    if (!connection->Write(kLastChunk, sizeof(kLastChunk) - 1)) {
+      *error = "Connection lost while sending the document.";
+      return false;
+    }
+    counters->bytesSent += (int64_t)sizeof(kLastChunk) - 1;
+  }
+
+  ResponseReader reader(connection);
+  std::string line;
+  int status = 0;
+  bool http10 = false, chunked = false, close = false;
+  int64_t contentLength = -1;
+  // "100 Continue" boleh datang sebelum respons sebenarnya
+  do {
+    if (!reader.ReadLine(&line)) {
+      // Tidak ada satu byte pun: koneksi keep-alive yang sudah ditutup printer
+      *retry = !document && reader.received() == 0;
+      *error = "No response from the printer.";
+      counters->bytesReceived += reader.received();
+      return false;
+    }
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12) {
+      *error = "Malformed HTTP response: " + line;
+      return false;
+    }
+    http10 = line.compare(5, 3, "1.0") == 0;
+    status = atoi(line.c_str() + 9);
+    while (reader.ReadLine(&line) && !line.empty()) {
+      size_t colon = line.find(':');
+      if (colon == std::string::npos) continue;
+      std::string name = ToLower(line.substr(0, colon));
+      std::string value = ToLower(line.substr(colon + 1));
+      value.erase(0, value.find_first_not_of(' '));
+      if (name == "content-length") contentLength = atoll(value.c_str());
+      if (name == "transfer-encoding") chunked = value.find("chunked") != std::string::npos;
+      if (name == "connection") {
+        close = value.find("close") != std::string::npos;
+        if (value.find("keep-alive") != std::string::npos) http10 = false;
+      }
+    }
+  } while (status == 100);
+
+  std::vector<uint8_t> content;
+  bool complete = false;
+  if (chunked) {
+    for (;;) {
+      if (!reader.ReadLine(&line)) break;
+      size_t size = strtoul(line.c_str(), nullptr, 16);
+      if (size == 0) {
+        while (reader.ReadLine(&line) && !line.empty()) {
+        }
+        complete = true;
+        break;
+      }
+      if (content.size() + size > kMaxResponseSize || !reader.Read(size, &content) ||
+          !reader.ReadLine(&line)) {
+        break;
+      }
+    }
+  } else if (contentLength >= 0) {
+    complete = (size_t)contentLength <= kMaxResponseSize && reader.Read((size_t)contentLength, &content);
+  } else {
+    // Tanpa panjang: respons berakhir saat koneksi ditutup
+    complete = reader.ReadToEnd(&content);
+    close = true;
+  }
+  counters->bytesReceived += reader.received();
+  *keepAlive = complete && !close && !http10;
+
+  if (!complete) {
+    *error = "Truncated response from the printer.";
+    return false;
+  }
+  if (status != 200) {
+    *error = "Printer answered HTTP " + std::to_string(status) + ".";
+    return false;
+  }
+  size_t consumed = 0;
+  if (!response->Decode(content.data(), content.size(), &consumed)) {
+    *error = "Malformed IPP response.";
+    return false;
+  }
+  return true;
+}
+
+bool IppClient::CheckStatus(const IppMessage& response, const char* operation, std::string* error) {
+  if (response.ok()) return true;
+  *error = std::string(operation) + " failed: " + IppStatusName(response.code);
+  std::string message = response.FindString("status-message");
+  if (!message.empty()) *error += " (" + message + ")";
+  return false;
+}
+
+bool IppClient::PrintJob(const std::string& printerUri, const std::string& jobName,
+                         const std::string& documentFormat,
+                         const std::vector<IppAttribute>& jobAttributes,
+                         const IppDocumentReader& document, int* jobId, std::string* error) {
+  IppMessage request = NewRequest(kIppPrintJob, printerUri);
+  request.AddString(kIppTagOperation, kIppTagName, "job-name", jobName);
+  request.AddString(kIppTagOperation, kIppTagMimeType, "document-format", documentFormat);
+  request.attributes.insert(request.attributes.end(), jobAttributes.begin(), jobAttributes.end());
+  IppMessage response;
+  if (!Send(printerUri, &request, document, &response, error) ||
+      !CheckStatus(response, "Print-Job", error)) {
+    return false;
+  }
+  *jobId = response.FindInteger("job-id", 0);
+  return true;
+}
+
+bool IppClient::CreateJob(const std::string& printerUri, const std::string& jobName,
+                          const std::vector<IppAttribute>& jobAttributes, int* jobId,
+                          std::string* error) {
+  IppMessage request = NewRequest(kIppCreateJob, printerUri);
+  request.AddString(kIppTagOperation, kIppTagName, "job-name", jobName);
+  request.attributes.insert(request.attributes.end(), jobAttributes.begin(), jobAttributes.end());
+  IppMessage response;
+  if (!Send(printerUri, &request, nullptr, &response, error) ||
+      !CheckStatus(response, "Create-Job", error)) {
+    return false;
+  }
+  *jobId = response.FindInteger("job-id", 0);
+  return *jobId > 0;
+}
+
+bool IppClient::SendDocument(const std::string& printerUri, int jobId,
+                             const std::string& documentFormat, const IppDocumentReader& document,
+                             bool lastDocument, std::string* error) {
+  IppMessage request = NewRequest(kIppSendDocument, printerUri);
+  request.AddInteger(kIppTagOperation, kIppTagInteger, "job-id", jobId);
+  request.AddBoolean(kIppTagOperation, "last-document", lastDocument);
+  // last-document tanpa data hanya menutup job
+  if (document) {
+    request.AddString(kIppTagOperation, kIppTagMimeType, "document-format", documentFormat);
+  }
+  IppMessage response;
+  return Send(printerUri, &request, document, &response, error) &&
+         CheckStatus(response, "Send-Document", error);
+}
+
+bool IppClient::GetJobAttributes(const std::string& printerUri, int jobId,
+                                 const std::vector<std::string>& requested, IppMessage* response,
+                                 std::string* error) {
+  IppMessage request = NewRequest(kIppGetJobAttributes, printerUri);
+  request.AddInteger(kIppTagOperation, kIppTagInteger, "job-id", jobId);
+  if (!requested.empty()) {
+    request.AddStrings(kIppTagOperation, kIppTagKeyword, "requested-attributes", requested);
+  }
+  return Send(printerUri, &request, nullptr, response, error) &&
+         CheckStatus(*response, "Get-Job-Attributes", error);
+}
+
+bool IppClient::GetPrinterAttributes(const std::string& printerUri,
+                                     const std::vector<std::string>& requested,
+                                     IppMessage* response, std::string* error) {
+  IppMessage request = NewRequest(kIppGetPrinterAttributes, printerUri);
+  if (!requested.empty()) {
+    request.AddStrings(kIppTagOperation, kIppTagKeyword, "requested-attributes", requested);
+  }
+  return Send(printerUri, &request, nullptr, response, error) &&
+         CheckStatus(*response, "Get-Printer-Attributes", error);
+}
+
+IppClientStats IppClient::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
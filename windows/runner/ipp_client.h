@@ -0,0 +1,136 @@
+#ifndef RUNNER_IPP_CLIENT_H_
+#define RUNNER_IPP_CLIENT_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ipp_message.h"
+
+// A byte stream to a printer.
+class IppConnection {
+ public:
+  virtual ~IppConnection() = default;
+
+  // Writes all of |data|; false if the connection broke.
+  virtual bool Write(const void* data, size_t size) = 0;
+  // Reads up to |capacity| bytes. Returns 0 once the peer closed the
+  // connection, < 0 on errors and timeouts.
+  virtual int64_t Read(void* buffer, size_t capacity) = 0;
+  // Cheap check, without blocking, whether the peer has closed an idle
+  // connection.
+  virtual bool Closed() = 0;
+};
+
+// What the client needs from the platform: TCP connections. The Linux
+// implementation (PosixIppConnector) uses BSD sockets; tests can substitute
+// an in-process printer.
+class IppConnector {
+ public:
+  virtual ~IppConnector() = default;
+
+  virtual std::unique_ptr<IppConnection> Connect(const std::string& host, int port,
+                                                 std::string* error) = 0;
+};
+
+// Document data, pulled chunk by chunk while the request is sent. Fills
+// |buffer| and returns the byte count, 0 at the end of the document, < 0 to
+// abort the request.
+using IppDocumentReader = std::function<int64_t(uint8_t* buffer, size_t capacity)>;
+
+struct IppClientStats {
+  int64_t requests = 0;
+  int64_t connectionsOpened = 0;
+  int64_t connectionsReused = 0;
+  int64_t bytesSent = 0;
+  int64_t bytesReceived = 0;
+};
+
+// IPP over HTTP/1.1 with keep-alive connections per printer (host and port),
+// so a batch of requests to one printer pays for one TCP handshake. Document
+// data is sent with chunked transfer encoding straight from an
+// IppDocumentReader, without knowing its length up front or staging it.
+// "ipps" URIs are not supported. Thread-safe; each request holds its own
+// connection for its duration.
+class IppClient {
+ public:
+  // Document bytes per HTTP chunk.
+  static constexpr size_t kChunkSize = 64 * 1024;
+  // Idle connections are kept this long, below the usual printer keep-alive
+  // timeouts. A request on a connection the printer closed meanwhile is
+  // retried once if no document data was sent yet.
+  static constexpr std::chrono::seconds kIdleTimeout{10};
+  static constexpr size_t kMaxIdlePerPrinter = 2;
+
+  // |userName| goes out as requesting-user-name.
+  IppClient(std::unique_ptr<IppConnector> connector, const std::string& userName);
+
+  // Prevent copying.
+  IppClient(IppClient const&) = delete;
+  IppClient& operator=(IppClient const&) = delete;
+
+  // Sends |request| (its request-id is assigned here) followed by the data
+  // of |document| if set, and parses the response. Returns false if no IPP
+  // response arrived; an IPP error status still returns true.
+  bool Send(const std::string& printerUri, IppMessage* request, const IppDocumentReader& document,
+            IppMessage* response, std::string* error);
+
+  // A request for |operation| on |printerUri| with the operation attributes
+  // every request starts with, requesting-user-name included.
+  IppMessage NewRequest(IppOperation operation, const std::string& printerUri);
+
+  // The operations the app uses. They return false with |error| set unless
+  // the printer answered successful-ok. |jobAttributes| are added to the job
+  // group (copies, sides, media, ...).
+  bool PrintJob(const std::string& printerUri, const std::string& jobName,
+                const std::string& documentFormat, const std::vector<IppAttribute>& jobAttributes,
+                const IppDocumentReader& document, int* jobId, std::string* error);
+  bool CreateJob(const std::string& printerUri, const std::string& jobName,
+                 const std::vector<IppAttribute>& jobAttributes, int* jobId, std::string* error);
+  bool SendDocument(const std::string& printerUri, int jobId, const std::string& documentFormat,
+                    const IppDocumentReader& document, bool lastDocument, std::string* error);
+  bool GetJobAttributes(const std::string& printerUri, int jobId,
+                        const std::vector<std::string>& requested, IppMessage* response,
+                        std::string* error);
+  bool GetPrinterAttributes(const std::string& printerUri,
+                            const std::vector<std::string>& requested, IppMessage* response,
+                            std::string* error);
+
+  IppClientStats stats();
+
+ private:
+  struct IdleConnection {
+    std::unique_ptr<IppConnection> connection;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  // |reused| tells whether the connection came from the idle pool.
+  std::unique_ptr<IppConnection> Acquire(const std::string& host, int port, bool* reused,
+                                         std::string* error);
+  void Release(const std::string& host, int port, std::unique_ptr<IppConnection> connection);
+  // One HTTP exchange. |retry| is set when it failed in a way that is safe
+  // to repeat on a new connection. Adds the bytes moved to |counters|.
+  bool Exchange(IppConnection* connection, const std::string& host, int port,
+                const std::string& path, const std::vector<uint8_t>& body,
+                const IppDocumentReader& document, IppMessage* response, bool* keepAlive,
+                bool* retry, IppClientStats* counters, std::string* error);
+  bool CheckStatus(const IppMessage& response, const char* operation, std::string* error);
+
+  std::unique_ptr<IppConnector> connector_;
+  std::string user_name_;
+  std::mutex mutex_;
+  uint32_t next_request_id_ = 1;
+  std::map<std::string, std::vector<IdleConnection>> idle_;
+  IppClientStats stats_;
+};
+
+// Splits "ipp://host[:port]/path" (also http). False for other schemes.
+bool ParseIppUri(const std::string& uri, std::string* host, int* port, std::string* path);
+
+#endif  // RUNNER_IPP_CLIENT_H_
@@ -0,0 +1,150 @@
+#include "ipp_job_pipeline.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace {
+
+void RemoveFile(const std::string& path) {
+  std::error_code ec;
+  std::filesystem::remove(std::filesystem::u8path(path), ec);
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+IppJobPipeline::IppJobPipeline(IppClient* client, const std::string& printerUri,
+                               const std::string& documentFormat)
+    : client_(client), printer_uri_(printerUri), document_format_(documentFormat) {}
+
+IppJobPipeline::~IppJobPipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+    // Tanpa Finish: sisa antrean tidak dikirim, job dibatalkan di bawah
+    if (!last_sent_ && error_.empty()) error_ = "Pipeline abandoned.";
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) thread_.join();
+  for (const std::string& path : queue_) RemoveFile(path);
+
+  if (job_id_ > 0 && !last_sent_) {
+    IppMessage request = client_->NewRequest(kIppCancelJob, printer_uri_);
+    request.AddInteger(kIppTagOperation, kIppTagInteger, "job-id", job_id_);
+    IppMessage response;
+    std::string error;
+    client_->Send(printer_uri_, &request, nullptr, &response, &error);
+  }
+}
+
+bool IppJobPipeline::Begin(const std::string& jobName,
+                           const std::vector<IppAttribute>& jobAttributes, std::string* error) {
+  if (!client_->CreateJob(printer_uri_, jobName, jobAttributes, &job_id_, error)) return false;
+  thread_ = std::thread(&IppJobPipeline::Run, this);
+  return true;
+}
+
+bool IppJobPipeline::Add(const std::string& path, std::string* error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_.empty() && !closing_) {
+      queue_.push_back(path);
+      cv_.notify_all();
+      return true;
+    }
+    *error = error_.empty() ? "Pipeline already finished." : error_;
+  }
+  RemoveFile(path);
+  return false;
+}
+
+bool IppJobPipeline::Finish(std::string* error) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  closing_ = true;
+  cv_.notify_all();
+  cv_.wait(lock, [this] { return done_; });
+  if (!error_.empty()) {
+    *error = error_;
+    return false;
+  }
+  return true;
+}
+
+IppPipelineStats IppJobPipeline::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void IppJobPipeline::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    auto idleStart = std::chrono::steady_clock::now();
+    cv_.wait(lock, [this] { return !queue_.empty() || closing_ || !error_.empty(); });
+    stats_.idleMs += MsSince(idleStart);
+    if (!error_.empty()) break;
+
+    if (queue_.empty()) {
+      // Dokumen terakhir sudah terkirim tanpa tanda last-document
+      lock.unlock();
+      std::string error;
+      bool sent = SendFile(std::string(), true, &error);
+      lock.lock();
+      if (!sent) error_ = error;
+      last_sent_ = sent;
+      break;
+    }
+
+    std::string path = queue_.front();
+    queue_.pop_front();
+    // Hanya bisa dipastikan terakhir kalau Finish sudah dipanggil
+    bool last = closing_ && queue_.empty();
+    lock.unlock();
+    auto uploadStart = std::chrono::steady_clock::now();
+    std::string error;
+    bool sent = SendFile(path, last, &error);
+    RemoveFile(path);
+    lock.lock();
+    stats_.uploadMs += MsSince(uploadStart);
+    if (!sent) {
+      error_ = error;
+      break;
+    }
+    stats_.documentsSent++;
+    if (last) {
+      last_sent_ = true;
+      break;
+    }
+  }
+  done_ = true;
+  cv_.notify_all();
+}
+
+bool IppJobPipeline::SendFile(const std::string& path, bool last, std::string* error) {
+  if (path.empty()) {
+    return client_->SendDocument(printer_uri_, job_id_, document_format_, nullptr, true, error);
+  }
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = "Cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  int64_t bytes = 0;
+  bool ok = client_->SendDocument(
+      printer_uri_, job_id_, document_format_,
+      [file, &bytes](uint8_t* buffer, size_t capacity) -> int64_t {
+        size_t count = fread(buffer, 1, capacity, file);
+        bytes += (int64_t)count;
+        return count == 0 && ferror(file) ? -1 : (int64_t)count;
+      },
+      last, error);
+  fclose(file);
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.bytesSent += bytes;
+  return ok;
+}
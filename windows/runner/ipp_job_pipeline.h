@@ -0,0 +1,78 @@
+#ifndef RUNNER_IPP_JOB_PIPELINE_H_
+#define RUNNER_IPP_JOB_PIPELINE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ipp_client.h"
+
+struct IppPipelineStats {
+  int documentsSent = 0;
+  int64_t bytesSent = 0;
+  // Time the uploader spent sending documents, and waiting for the producer
+  // with nothing to send. Upload-bound jobs have little idle time.
+  double uploadMs = 0.0;
+  double idleMs = 0.0;
+};
+
+// One IPP job fed document by document: Create-Job up front, then every
+// document file handed to Add goes out as a Send-Document from a background
+// thread while the caller produces the next one, and Finish marks the last
+// document. A transaction's invoice, separators and files thus become one
+// job whose upload overlaps rendering, instead of a Print-Job per file that
+// each waits for the previous one.
+class IppJobPipeline {
+ public:
+  IppJobPipeline(IppClient* client, const std::string& printerUri,
+                 const std::string& documentFormat);
+  // Cancels the job if Finish was not reached.
+  ~IppJobPipeline();
+
+  // Prevent copying.
+  IppJobPipeline(IppJobPipeline const&) = delete;
+  IppJobPipeline& operator=(IppJobPipeline const&) = delete;
+
+  // Creates the job and starts the uploader.
+  bool Begin(const std::string& jobName, const std::vector<IppAttribute>& jobAttributes,
+             std::string* error);
+
+  // Queues the file at |path| as the next document; it is deleted once sent
+  // (or dropped). Returns false, without queueing, once an upload failed.
+  bool Add(const std::string& path, std::string* error);
+
+  // Waits for the queued documents, sending the last one with
+  // last-document set (or an empty closing Send-Document if it already
+  // went out). Returns false if any upload failed.
+  bool Finish(std::string* error);
+
+  int job_id() const { return job_id_; }
+  IppPipelineStats stats();
+
+ private:
+  void Run();
+  bool SendFile(const std::string& path, bool last, std::string* error);
+
+  IppClient* client_;
+  std::string printer_uri_;
+  std::string document_format_;
+  int job_id_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::string> queue_;
+  // Finish was called: the queue's last entry is the job's last document.
+  bool closing_ = false;
+  // The uploader sent the last document or gave up.
+  bool done_ = false;
+  bool last_sent_ = false;
+  std::string error_;
+  IppPipelineStats stats_;
+  std::thread thread_;
+};
+
+#endif  // RUNNER_IPP_JOB_PIPELINE_H_
@@ -0,0 +1,293 @@
+#include "ipp_message.h"
+
+#include <cstdio>
+
+namespace {
+
+void PutUint16(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back((uint8_t)(value >> 8));
+  out->push_back((uint8_t)value);
+}
+
+void PutInt32(std::vector<uint8_t>* out, int32_t value) {
+  uint32_t bits = (uint32_t)value;
+  out->push_back((uint8_t)(bits >> 24));
+  out->push_back((uint8_t)(bits >> 16));
+  out->push_back((uint8_t)(bits >> 8));
+  out->push_back((uint8_t)bits);
+}
+
+uint16_t GetUint16(const uint8_t* data) {
+  return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+int32_t GetInt32(const uint8_t* data) {
+  return (int32_t)(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                   ((uint32_t)data[2] << 8) | (uint32_t)data[3]);
+}
+
+void PutValue(std::vector<uint8_t>* out, IppTag valueTag, const std::string& name,
+              const IppValue& value) {
+  out->push_back(valueTag);
+  PutUint16(out, (uint32_t)name.size());
+  out->insert(out->end(), name.begin(), name.end());
+  switch (valueTag) {
+    case kIppTagInteger:
+    case kIppTagEnum:
+      PutUint16(out, 4);
+      PutInt32(out, value.integer);
+      return;
+    case kIppTagBoolean:
+      PutUint16(out, 1);
+      out->push_back(value.integer ? 1 : 0);
+      return;
+    case kIppTagRange:
+      PutUint16(out, 8);
+      PutInt32(out, value.integer);
+      PutInt32(out, value.upper);
+      return;
+    case kIppTagResolution:
+      PutUint16(out, 9);
+      PutInt32(out, value.integer);
+      PutInt32(out, value.upper);
+      out->push_back((uint8_t)value.units);
+      return;
+    case kIppTagCollection:
+      // Anggota koleksi disimpan apa adanya sesudah nilai pembuka yang kosong
+      PutUint16(out, 0);
+      out->insert(out->end(), value.text.begin(), value.text.end());
+      return;
+    default:
+      PutUint16(out, (uint32_t)value.text.size());
+      out->insert(out->end(), value.text.begin(), value.text.end());
+      return;
+  }
+}
+
+// One encoded "value-tag name value" entry.
+struct RawEntry {
+  uint8_t tag = 0;
+  const uint8_t* name = nullptr;
+  size_t nameLength = 0;
+  const uint8_t* value = nullptr;
+  size_t valueLength = 0;
+};
+
+bool ReadEntry(const uint8_t* data, size_t size, size_t* pos, RawEntry* entry) {
+  if (*pos + 3 > size) return false;
+  entry->tag = data[*pos];
+  entry->nameLength = GetUint16(data + *pos + 1);
+  *pos += 3;
+  if (*pos + entry->nameLength + 2 > size) return false;
+  entry->name = data + *pos;
+  *pos += entry->nameLength;
+  entry->valueLength = GetUint16(data + *pos);
+  *pos += 2;
+  if (*pos + entry->valueLength > size) return false;
+  entry->value = data + *pos;
+  *pos += entry->valueLength;
+  return true;
+}
+
+bool ParseValue(const RawEntry& entry, IppValue* value) {
+  switch (entry.tag) {
+    case kIppTagInteger:
+    case kIppTagEnum:
+      if (entry.valueLength != 4) return false;
+      value->integer = GetInt32(entry.value);
+      return true;
+    case kIppTagBoolean:
+      if (entry.valueLength != 1) return false;
+      value->integer = entry.value[0] ? 1 : 0;
+      return true;
+    case kIppTagRange:
+      if (entry.valueLength != 8) return false;
+      value->integer = GetInt32(entry.value);
+      value->upper = GetInt32(entry.value + 4);
+      return true;
+    case kIppTagResolution:
+      if (entry.valueLength != 9) return false;
+      value->integer = GetInt32(entry.value);
+      value->upper = GetInt32(entry.value + 4);
+      value->units = (int8_t)entry.value[8];
+      return true;
+    default:
+      value->text.assign((const char*)entry.value, entry.valueLength);
+      return true;
+  }
+}
+
+}  // namespace
+
+IppMessage::IppMessage(IppOperation operation, const std::string& printerUri) : code(operation) {
+  AddString(kIppTagOperation, kIppTagCharset, "attributes-charset", "utf-8");
+  AddString(kIppTagOperation, kIppTagLanguage, "attributes-natural-language", "en");
+  AddString(kIppTagOperation, kIppTagUri, "printer-uri", printerUri);
+}
+
+IppAttribute* IppMessage::AddInteger(IppTag group, IppTag valueTag, const std::string& name,
+                                     int32_t value) {
+  IppAttribute attribute;
+  attribute.group = group;
+  attribute.valueTag = valueTag;
+  attribute.name = name;
+  attribute.values.emplace_back();
+  attribute.values.back().integer = value;
+  attributes.push_back(std::move(attribute));
+  return &attributes.back();
+}
+
+IppAttribute* IppMessage::AddBoolean(IppTag group, const std::string& name, bool value) {
+  return AddInteger(group, kIppTagBoolean, name, value ? 1 : 0);
+}
+
+IppAttribute* IppMessage::AddString(IppTag group, IppTag valueTag, const std::string& name,
+                                    const std::string& value) {
+  return AddStrings(group, valueTag, name, {value});
+}
+
+IppAttribute* IppMessage::AddStrings(IppTag group, IppTag valueTag, const std::string& name,
+                                     const std::vector<std::string>& values) {
+  IppAttribute attribute;
+  attribute.group = group;
+  attribute.valueTag = valueTag;
+  attribute.name = name;
+  for (const std::string& text : values) {
+    attribute.values.emplace_back();
+    attribute.values.back().text = text;
+  }
+  attributes.push_back(std::move(attribute));
+  return &attributes.back();
+}
+
+const IppAttribute* IppMessage::Find(const std::string& name, IppTag group) const {
+  for (const IppAttribute& attribute : attributes) {
+    if (attribute.name == name && (group == kIppTagEnd || attribute.group == group)) {
+      return &attribute;
+    }
+  }
+  return nullptr;
+}
+
+int32_t IppMessage::FindInteger(const std::string& name, int32_t fallback) const {
+  const IppAttribute* attribute = Find(name);
+  return attribute && !attribute->values.empty() ? attribute->values.front().integer : fallback;
+}
+
+std::string IppMessage::FindString(const std::string& name) const {
+  const IppAttribute* attribute = Find(name);
+  return attribute && !attribute->values.empty() ? attribute->values.front().text : std::string();
+}
+
+void IppMessage::Encode(std::vector<uint8_t>* out) const {
+  out->push_back(versionMajor);
+  out->push_back(versionMinor);
+  PutUint16(out, code);
+  PutInt32(out, (int32_t)requestId);
+  // Tag grup hanya ditulis saat grupnya berganti
+  int group = -1;
+  for (const IppAttribute& attribute : attributes) {
+    if (attribute.group != group) {
+      group = attribute.group;
+      out->push_back(attribute.group);
+    }
+    if (attribute.values.empty()) {
+      PutValue(out, kIppTagNoValue, attribute.name, IppValue());
+      continue;
+    }
+    for (size_t i = 0; i < attribute.values.size(); ++i) {
+      PutValue(out, attribute.valueTag, i == 0 ? attribute.name : std::string(), attribute.values[i]);
+    }
+  }
+  out->push_back(kIppTagEnd);
+}
+
+bool IppMessage::Decode(const uint8_t* data, size_t size, size_t* consumed) {
+  if (size < 9) return false;
+  versionMajor = data[0];
+  versionMinor = data[1];
+  code = GetUint16(data + 2);
+  requestId = (uint32_t)GetInt32(data + 4);
+  attributes.clear();
+
+  size_t pos = 8;
+  IppTag group = kIppTagOperation;
+  while (pos < size) {
+    uint8_t tag = data[pos];
+    if (tag == kIppTagEnd) {
+      *consumed = pos + 1;
+      return true;
+    }
+    if (tag < kIppTagUnsupportedValue) {
+      group = (IppTag)tag;
+      ++pos;
+      continue;
+    }
+
+    RawEntry entry;
+    if (!ReadEntry(data, size, &pos, &entry)) return false;
+    IppValue value;
+    if (entry.tag == kIppTagCollection) {
+      // Simpan seluruh isi koleksi (termasuk koleksi bersarang) sebagai byte
+      size_t start = pos;
+      int depth = 1;
+      RawEntry member;
+      while (depth > 0) {
+        if (!ReadEntry(data, size, &pos, &member)) return false;
+        if (member.tag == kIppTagCollection) depth++;
+        if (member.tag == kIppTagEndCollection) depth--;
+      }
+      value.text.assign((const char*)data + start, pos - start);
+    } else if (!ParseValue(entry, &value)) {
+      return false;
+    }
+
+    // Nama kosong: nilai tambahan dari atribut sebelumnya (1setOf)
+    if (entry.nameLength == 0 && !attributes.empty()) {
+      attributes.back().values.push_back(std::move(value));
+      continue;
+    }
+    IppAttribute attribute;
+    attribute.group = group;
+    attribute.valueTag = (IppTag)entry.tag;
+    attribute.name.assign((const char*)entry.name, entry.nameLength);
+    // Nilai out-of-band (no-value, unknown, unsupported) tidak punya isi
+    if (entry.tag >= kIppTagUnsupportedValue && entry.tag < kIppTagInteger) {
+      attributes.push_back(std::move(attribute));
+      continue;
+    }
+    attribute.values.push_back(std::move(value));
+    attributes.push_back(std::move(attribute));
+  }
+  return false;
+}
+
+std::string IppStatusName(uint16_t status) {
+  switch (status) {
+    case 0x0000: return "successful-ok";
+    case 0x0001: return "successful-ok-ignored-or-substituted-attributes";
+    case 0x0002: return "successful-ok-conflicting-attributes";
+    case 0x0400: return "client-error-bad-request";
+    case 0x0401: return "client-error-forbidden";
+    case 0x0402: return "client-error-not-authenticated";
+    case 0x0403: return "client-error-not-authorized";
+    case 0x0404: return "client-error-not-possible";
+    case 0x0405: return "client-error-timeout";
+    case 0x0406: return "client-error-not-found";
+    case 0x0407: return "client-error-gone";
+    case 0x040a: return "client-error-document-format-not-supported";
+    case 0x040b: return "client-error-attributes-or-values-not-supported";
+    case 0x0500: return "server-error-internal-error";
+    case 0x0501: return "server-error-operation-not-supported";
+    case 0x0503: return "server-error-version-not-supported";
+    case 0x0504: return "server-error-device-error";
+    case 0x0506: return "server-error-not-accepting-jobs";
+    case 0x0507: return "server-error-busy";
+    case 0x0508: return "server-error-job-canceled";
+    default: {
+      char text[16];
+      snprintf(text, sizeof(text), "0x%04x", status);
+      return text;
+    }
+  }
+}
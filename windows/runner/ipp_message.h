@@ -0,0 +1,110 @@
+#ifndef RUNNER_IPP_MESSAGE_H_
+#define RUNNER_IPP_MESSAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// IPP operation ids (RFC 8011, 5.2.2).
+enum IppOperation : uint16_t {
+  kIppPrintJob = 0x0002,
+  kIppValidateJob = 0x0004,
+  kIppCreateJob = 0x0005,
+  kIppSendDocument = 0x0006,
+  kIppCancelJob = 0x0008,
+  kIppGetJobAttributes = 0x0009,
+  kIppGetJobs = 0x000a,
+  kIppGetPrinterAttributes = 0x000b,
+};
+
+// Delimiter and value tags (RFC 8010, 3.5).
+enum IppTag : uint8_t {
+  kIppTagOperation = 0x01,
+  kIppTagJob = 0x02,
+  kIppTagEnd = 0x03,
+  kIppTagPrinter = 0x04,
+  kIppTagUnsupported = 0x05,
+
+  kIppTagUnsupportedValue = 0x10,
+  kIppTagUnknown = 0x12,
+  kIppTagNoValue = 0x13,
+  kIppTagInteger = 0x21,
+  kIppTagBoolean = 0x22,
+  kIppTagEnum = 0x23,
+  kIppTagString = 0x30,
+  kIppTagDate = 0x31,
+  kIppTagResolution = 0x32,
+  kIppTagRange = 0x33,
+  kIppTagCollection = 0x34,
+  kIppTagEndCollection = 0x37,
+  kIppTagText = 0x41,
+  kIppTagName = 0x42,
+  kIppTagKeyword = 0x44,
+  kIppTagUri = 0x45,
+  kIppTagCharset = 0x47,
+  kIppTagLanguage = 0x48,
+  kIppTagMimeType = 0x49,
+  kIppTagMemberName = 0x4a,
+};
+
+// One value of an attribute. Integers, enums and booleans use |integer|;
+// ranges |integer|..|upper|; resolutions |integer| x |upper| in |units|;
+// everything else, including octet strings and dates, the raw bytes in |text|.
+struct IppValue {
+  int32_t integer = 0;
+  int32_t upper = 0;
+  int8_t units = 0;
+  std::string text;
+};
+
+struct IppAttribute {
+  IppTag group = kIppTagOperation;
+  IppTag valueTag = kIppTagKeyword;
+  std::string name;
+  std::vector<IppValue> values;
+};
+
+// An IPP request or response body without the document data that may follow
+// it. Collections are kept flat as their begin/member/end values, which is
+// enough to pass them through; nothing here interprets them.
+class IppMessage {
+ public:
+  IppMessage() = default;
+  // A request with the attributes-charset, attributes-natural-language and
+  // printer-uri operation attributes every request starts with.
+  IppMessage(IppOperation operation, const std::string& printerUri);
+
+  // Operation id in requests, status code in responses.
+  uint16_t code = 0;
+  uint32_t requestId = 1;
+  uint8_t versionMajor = 2;
+  uint8_t versionMinor = 0;
+  std::vector<IppAttribute> attributes;
+
+  IppAttribute* AddInteger(IppTag group, IppTag valueTag, const std::string& name, int32_t value);
+  IppAttribute* AddBoolean(IppTag group, const std::string& name, bool value);
+  IppAttribute* AddString(IppTag group, IppTag valueTag, const std::string& name,
+                          const std::string& value);
+  IppAttribute* AddStrings(IppTag group, IppTag valueTag, const std::string& name,
+                           const std::vector<std::string>& values);
+
+  // First attribute called |name|, in |group| unless that is kIppTagEnd.
+  const IppAttribute* Find(const std::string& name, IppTag group = kIppTagEnd) const;
+  int32_t FindInteger(const std::string& name, int32_t fallback) const;
+  std::string FindString(const std::string& name) const;
+
+  // Responses: successful-ok and its "ignored or substituted" variants.
+  bool ok() const { return code < 0x0100; }
+
+  void Encode(std::vector<uint8_t>* out) const;
+  // Parses a complete message from |data|; |consumed| receives its length
+  // (the document data, if any, starts there). False if malformed or
+  // truncated.
+  bool Decode(const uint8_t* data, size_t size, size_t* consumed);
+};
+
+// "successful-ok", "client-error-not-found", ... or the number in hex.
+std::string IppStatusName(uint16_t status);
+
+#endif  // RUNNER_IPP_MESSAGE_H_
@@ -0,0 +1,87 @@
+#include "job_correlation.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+
+constexpr char kTagPrefix[] = "hla-";
+constexpr size_t kSessionDigits = 8;
+
+const std::string& SessionId() {
+  // Acak per proses, supaya tag dari sesi sebelumnya yang masih di antrean
+  // tidak pernah cocok
+  static const std::string session = [] {
+    std::random_device random;
+    uint32_t seed = random() ^ (uint32_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    char text[kSessionDigits + 1];
+    snprintf(text, sizeof(text), "%08x", seed);
+    return std::string(text);
+  }();
+  return session;
+}
+
+bool IsHexDigit(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+}  // namespace
+
+std::string NewDocumentTag() {
+  static std::atomic<int> sequence{0};
+  return kTagPrefix + SessionId() + "-" + std::to_string(++sequence);
+}
+
+std::string TagDocumentName(const std::string& title, const std::string& tag) {
+  return title + " [" + tag + "]";
+}
+
+bool ExtractDocumentTag(const std::string& documentName, std::string* tag) {
+  const size_t prefixLength = strlen(kTagPrefix);
+  for (size_t start = documentName.find(kTagPrefix); start != std::string::npos;
+       start = documentName.find(kTagPrefix, start + 1)) {
+    size_t i = start + prefixLength;
+    size_t sessionEnd = i + kSessionDigits;
+    while (i < sessionEnd && i < documentName.size() && IsHexDigit(documentName[i])) ++i;
+    if (i != sessionEnd || i >= documentName.size() || documentName[i] != '-') continue;
+    size_t end = ++i;
+    while (end < documentName.size() && IsDigit(documentName[end])) ++end;
+    if (end == i) continue;
+    *tag = documentName.substr(start, end - start);
+    return true;
+  }
+  return false;
+}
+
+void JobCorrelationIndex::Record(int printJobId, const std::string& queue, int jobId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<SpoolJobRef>& jobs = jobs_[printJobId];
+  for (const SpoolJobRef& job : jobs) {
+    if (job.jobId == jobId && job.queue == queue) return;
+  }
+  SpoolJobRef job;
+  job.queue = queue;
+  job.jobId = jobId;
+  jobs.push_back(job);
+}
+
+bool JobCorrelationIndex::Lookup(int printJobId, std::vector<SpoolJobRef>* jobs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(printJobId);
+  if (it == jobs_.end()) return false;
+  *jobs = it->second;
+  return true;
+}
+
+void JobCorrelationIndex::Forget(int printJobId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.erase(printJobId);
+}
@@ -0,0 +1,50 @@
+#ifndef RUNNER_JOB_CORRELATION_H_
+#define RUNNER_JOB_CORRELATION_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every document the app hands to a spooler carries a tag unique to this
+// process in its document name ("hla-<session>-<sequence>"), so its spooler
+// job is found by name instead of guessing the newest job in the queue.
+// Thread-safe.
+std::string NewDocumentTag();
+
+// "<title> [<tag>]", the document name used for StartDoc and lp -t.
+std::string TagDocumentName(const std::string& title, const std::string& tag);
+
+// Finds a tag made by NewDocumentTag anywhere in |documentName|, so it also
+// survives submitters that use the file name ("C:\...\<tag>.pdf").
+bool ExtractDocumentTag(const std::string& documentName, std::string* tag);
+
+// A job in a spooler queue.
+struct SpoolJobRef {
+  std::string queue;
+  int jobId = 0;
+};
+
+// Which spooler jobs each app print job became; a batch spooled as one
+// document maps several print jobs to the same spooler job. Thread-safe.
+class JobCorrelationIndex {
+ public:
+  JobCorrelationIndex() = default;
+
+  // Prevent copying.
+  JobCorrelationIndex(JobCorrelationIndex const&) = delete;
+  JobCorrelationIndex& operator=(JobCorrelationIndex const&) = delete;
+
+  void Record(int printJobId, const std::string& queue, int jobId);
+
+  // Returns false if nothing was recorded for |printJobId|.
+  bool Lookup(int printJobId, std::vector<SpoolJobRef>* jobs);
+
+  void Forget(int printJobId);
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<int, std::vector<SpoolJobRef>> jobs_;
+};
+
+#endif  // RUNNER_JOB_CORRELATION_H_
@@ -0,0 +1,67 @@
+#include "job_executor.h"
+
+#include <algorithm>
+
+JobExecutor::JobExecutor(int workerCount) {
+  workerCount = std::max(1, workerCount);
+  for (int i = 0; i < workerCount; ++i) {
+    workers_.emplace_back(&JobExecutor::WorkerLoop, this);
+  }
+}
+
+JobExecutor::~JobExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+int JobExecutor::Submit(const std::string& key, Job job) {
+  int handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handle = next_handle_++;
+    queue_.push_back(Entry{handle, key, std::move(job)});
+  }
+  cv_.notify_all();
+  return handle;
+}
+
+size_t JobExecutor::pending() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+void JobExecutor::WorkerLoop() {
+  while (true) {
+    Entry entry;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      std::deque<Entry>::iterator next;
+      // Ambil job paling lama yang key-nya tidak sedang dikerjakan worker lain
+      cv_.wait(lock, [this, &next] {
+        if (stopping_) return true;
+        next = std::find_if(queue_.begin(), queue_.end(), [this](const Entry& e) {
+          return active_keys_.count(e.key) == 0;
+        });
+        return next != queue_.end();
+      });
+      if (stopping_) return;
+
+      entry = std::move(*next);
+      queue_.erase(next);
+      active_keys_.insert(entry.key);
+    }
+
+    entry.job(entry.handle);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      active_keys_.erase(entry.key);
+    }
+    cv_.notify_all();
+  }
+}
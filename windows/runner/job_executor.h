@@ -0,0 +1,54 @@
+#ifndef RUNNER_JOB_EXECUTOR_H_
+#define RUNNER_JOB_EXECUTOR_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Worker pool with a submission queue for native print jobs. Jobs sharing a
+// key (normally the printer name) run one at a time in submission order, so a
+// transaction's invoice, files and separator still reach the spooler in order;
+// jobs with different keys run in parallel. Platform-neutral.
+class JobExecutor {
+ public:
+  using Job = std::function<void(int jobHandle)>;
+
+  explicit JobExecutor(int workerCount);
+  // Finishes running jobs and discards the ones still queued.
+  ~JobExecutor();
+
+  // Prevent copying.
+  JobExecutor(JobExecutor const&) = delete;
+  JobExecutor& operator=(JobExecutor const&) = delete;
+
+  // Queues |job| and returns its handle (always > 0) immediately.
+  int Submit(const std::string& key, Job job);
+
+  // Jobs queued but not started yet.
+  size_t pending();
+
+ private:
+  struct Entry {
+    int handle = 0;
+    std::string key;
+    Job job;
+  };
+
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::deque<Entry> queue_;
+  // Keys with a job currently running.
+  std::set<std::string> active_keys_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int next_handle_ = 1;
+  bool stopping_ = false;
+};
+
+#endif  // RUNNER_JOB_EXECUTOR_H_
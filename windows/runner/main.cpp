@@ -4,6 +4,7 @@
 #include <flutter/method_channel.h>
 #include <flutter/standard_method_codec.h>
 #include <winspool.h>
+#include <psapi.h>
 #include <shlobj.h>
 #include <string>
 #include <thread>
@@ -11,22 +12,65 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <functional>
+#include <map>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <glib.h>
 #include <poppler/glib/poppler.h>
-#include <cairo/cairo-win32.h>
 #include "flutter_window.h"
+#include "document_analyzer.h"
+#include "document_cache.h"
+#include "gdi_print_sink.h"
+#include "job_correlation.h"
+#include "job_executor.h"
+#include "margin_cache.h"
+#include "page_rasterizer.h"
+#include "print_event_queue.h"
+#include "print_job.h"
+#include "print_transaction.h"
+#include "printer_capability_db.h"
+#include "printer_session_cache.h"
+#include "printer_status_service.h"
+#include "separator_cache.h"
+#include "spool_watcher.h"
+#include "streaming_buffer.h"
 #include "utils.h"
+#include "win32_capability_provider.h"
+#include "win32_printer_driver.h"
+#include "win32_spool_backend.h"
 
 #define WM_FLUTTER_PRINT_EVENT (WM_USER + 101)
+#define WM_FLUTTER_TASK_EVENT (WM_USER + 102)
 
 std::unique_ptr<flutter::MethodChannel<>> g_channel;
 
-struct PrintEventData {
-    int type; // 1 = Job Completed, 2 = Status Update
-    int printJobId;
-    int totalPages;
-    std::string statusMsg;
-};
+// Event print dari worker ke Flutter: tanpa alokasi di sisi pengirim, progress
+// digabung per job, dan dikirim sebagai satu batch onPrintEvents per frame.
+std::unique_ptr<PrintEventQueue> g_printEvents;
+constexpr std::chrono::milliseconds kPrintEventFrame(16);
+std::chrono::steady_clock::time_point g_lastPrintEventFlush;
+UINT_PTR g_printEventTimer = 0;
+
+// Worker pool untuk printPDF supaya parsing dan render tidak memblokir message loop.
+std::unique_ptr<JobExecutor> g_printExecutor;
+std::unique_ptr<SpoolWatcher> g_spoolWatcher;
+
+// Job spooler milik tiap printJobId, dicatat saat job ditemukan lewat nama
+// dokumennya, bukan ditebak dari job ID terbesar di antrean.
+JobCorrelationIndex g_spoolJobs;
+
+// Status printer yang dipilih, diperbarui dari notifikasi spooler dan
+// dikirim ke Flutter hanya saat berubah.
+std::unique_ptr<PrinterStatusService> g_printerStatus;
+
+// Handle printer dan DEVMODE tervalidasi yang dipakai ulang antar job.
+std::unique_ptr<PrinterSessionCache> g_printerSessions;
+
+// Kertas, DPI, duplex/warna dan margin hardware tiap printer, dibangun sekali
+// di background dan disimpan ke disk.
+std::unique_ptr<PrinterCapabilityDb> g_printerCaps;
 
 DWORD g_mainThreadId = 0;
 HWND g_mainWindowHandle = nullptr;
@@ -39,362 +83,345 @@ void LogStatus(std::string msg) {
     OutputDebugStringA(("[PrintMonitor] " + msg + "\n").c_str());
 }
 
-void MonitorPrintJob(HANDLE hPrinter, DWORD winJobId, int appPrintJobId, int totalPages) {
-    OutputDebugStringA(("START monitoring Windows Job ID: " + std::to_string(winJobId) + "\n").c_str());
-
-    // Struktur untuk menyimpan info job
-    DWORD bytesNeeded = 0;
-    DWORD returned = 0;
-
-    // Status flag untuk menentukan hasil akhir
-    DWORD maxPagesPrintedSeen = 0;
-    bool wasDeletedFlagSeen = false;
-    bool wasErrorFlagSeen = false;
-    bool wasOffline = false;
-
-    int maxRetries = 600; // Timeout monitoring (misal 10 menit)
-    int currentRetry = 0;
-
-    while (currentRetry < maxRetries) {
-        // 1. Coba ambil info Job spesifik dari Windows
-        GetJob(hPrinter, winJobId, 2, NULL, 0, &bytesNeeded);
-
-        if (bytesNeeded == 0) {
-            break;
-        }
-
-        std::vector<BYTE> buffer(bytesNeeded);
-        JOB_INFO_2* pJobInfo = reinterpret_cast<JOB_INFO_2*>(buffer.data());
-
-        if (!GetJob(hPrinter, winJobId, 2, (LPBYTE)pJobInfo, bytesNeeded, &returned)) {
-            // Gagal ambil job, kemungkinan besar Job sudah selesai dan dihapus dari spooler oleh Windows
-            LogStatus("GetJob failed (Job likely finished and removed from Spooler).");
-            break;
-        }
-
-        if (pJobInfo->PagesPrinted > maxPagesPrintedSeen) {
-            maxPagesPrintedSeen = pJobInfo->PagesPrinted;
-        }
-
-        // 2. Analisa Status
-        // Windows status adalah bitmask, bisa kombinasi beberapa status
-        DWORD status = pJobInfo->Status;
-
-        if ((status & JOB_STATUS_DELETING) || (status & JOB_STATUS_DELETED)) {
-            wasDeletedFlagSeen = true;
-        }
-        if (status & JOB_STATUS_ERROR) {
-            wasErrorFlagSeen = true;
-        }
-        if (status & JOB_STATUS_OFFLINE) {
-            wasOffline = true;
-        }
-        bool isBlocked = (status & JOB_STATUS_BLOCKED_DEVQ);
-
-        // Log detail untuk Anda debugging
-        std::string statusLog = "Status Code: " + std::to_string(status) +
-            " | Pages: " + std::to_string(pJobInfo->PagesPrinted) + "/" + std::to_string(pJobInfo->TotalPages);
-
-        if (status & JOB_STATUS_PRINTING) statusLog += " [Printing]";
-        if (status & JOB_STATUS_SPOOLING) statusLog += " [Spooling]";
-        if (status & JOB_STATUS_ERROR)    statusLog += " [Error]";
-        if (status & JOB_STATUS_OFFLINE)  statusLog += " [Offline]";
-        if (status & JOB_STATUS_PAPEROUT) statusLog += " [Paper Out]";
-        if (wasDeletedFlagSeen) statusLog += " [DELETING]";
-        if (isBlocked) statusLog += " [Blocked]";
+// Puncak working set proses sejak start. Untuk membandingkan memori mode
+// pita/halaman penuh, ukur di proses baru karena nilainya tidak pernah turun.
+int64_t PeakWorkingSetBytes() {
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (int64_t)counters.PeakWorkingSetSize;
+}
 
-        LogStatus(statusLog);
+// Folder data lokal aplikasi (%LOCALAPPDATA%\hlaprint) untuk cache native, dalam UTF-8.
+std::string GetAppDataDirectory() {
+    wchar_t buffer[MAX_PATH];
+    DWORD length = ::GetEnvironmentVariableW(L"LOCALAPPDATA", buffer, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return "";
+    }
+    return Utf8FromUtf16(buffer) + "\\hlaprint";
+}
 
-        // Kirim update progress ke Flutter secara AMAN (Thread-Safe)
-        PrintEventData* progressData = new PrintEventData();
-        progressData->type = 4; // Tipe 4 untuk Progress Status
-        progressData->printJobId = appPrintJobId;
-        progressData->statusMsg = statusLog;
-
-        BOOL isPosted = FALSE;
-        if (g_mainWindowHandle) {
-            isPosted = ::PostMessage(g_mainWindowHandle, WM_FLUTTER_PRINT_EVENT, (WPARAM)progressData, 0);
-        } else {
-            isPosted = ::PostThreadMessage(g_mainThreadId, WM_FLUTTER_PRINT_EVENT, (WPARAM)progressData, 0);
-        }
+// Folder tempat exe berada, dalam UTF-8. Asset Flutter ada di data\flutter_assets.
+std::string GetExecutableDirectory() {
+    wchar_t buffer[MAX_PATH];
+    DWORD length = ::GetModuleFileNameW(nullptr, buffer, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return ".";
+    }
+    std::wstring path(buffer, length);
+    size_t slash = path.find_last_of(L"\\/");
+    if (slash != std::wstring::npos) {
+        path.resize(slash);
+    }
+    return Utf8FromUtf16(path.c_str());
+}
 
-        // --- MENCEGAH LEAK: Jika gagal dikirim, langsung hapus memori ---
-        if (!isPosted) {
-            delete progressData;
-        }
+// Membaca argumen opsional bertipe T dari map channel; |value| tetap jika tidak ada.
+// False jika argumen ada tetapi tipenya bukan T, supaya handler bisa menolaknya.
+template <typename T>
+bool ReadArgument(const flutter::EncodableMap& args, const char* key, T* value) {
+    auto it = args.find(flutter::EncodableValue(key));
+    if (it == args.end() || std::holds_alternative<std::monostate>(it->second)) return true;
+    const T* typed = std::get_if<T>(&it->second);
+    if (!typed) return false;
+    *value = *typed;
+    return true;
+}
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        currentRetry++;
+// Membaca argumen "pages" (daftar nomor halaman). False jika bukan daftar int.
+bool ReadPagesArgument(const flutter::EncodableMap& args, std::vector<int>* pages) {
+    flutter::EncodableList list;
+    if (!ReadArgument(args, "pages", &list)) return false;
+    for (const auto& pageVal : list) {
+        const int* page = std::get_if<int>(&pageVal);
+        if (!page) return false;
+        pages->push_back(*page);
     }
+    return true;
+}
 
-    LogStatus("Loop Finished. Analyzing Final Result...");
-    LogStatus("Max Pages Seen: " + std::to_string(maxPagesPrintedSeen) + " / " + std::to_string(totalPages));
+// Membaca pengaturan cetak dari argumen printPDF atau satu bagian printTransaction.
+// Nama argumen pertama yang tipenya salah ditulis ke |wrongArgument|.
+bool ReadPrintSettings(const flutter::EncodableMap& args, PrintSettings* settings,
+                       std::string* wrongArgument) {
+    const char* wrong = nullptr;
+    auto read = [&](const char* key, auto* value) {
+        if (!wrong && !ReadArgument(args, key, value)) wrong = key;
+    };
+    read("printerName", &settings->printerName);
+    read("color", &settings->color);
+    read("doubleSided", &settings->doubleSided);
+    read("copies", &settings->copies);
+    read("pageOrientation", &settings->pageOrientation);
+    read("printJobId", &settings->printJobId);
+    read("pageSize", &settings->pageSize);
+    read("pagesStart", &settings->pagesStart);
+    read("pageEnd", &settings->pageEnd);
+    read("rasterDpi", &settings->rasterDpi);
+    read("pipelineDepth", &settings->pipelineDepth);
+    read("softwareCopies", &settings->softwareCopies);
+    // "threshold" / "ordered" / "diffusion": job hitam-putih dikirim 1 bit
+    std::string monoMode;
+    read("monoMode", &monoMode);
+    read("bandHeight", &settings->bandHeight);
+    if (!wrong && !ReadPagesArgument(args, &settings->pages)) wrong = "pages";
+    if (wrong) {
+        *wrongArgument = wrong;
+        return false;
+    }
+    settings->monoDither = ParseDitherMode(monoMode);
+    return true;
+}
 
+// Sumber DocumentCache (bytes atau unduhan) yang terdaftar selama job memakainya.
+// Dilepas saat job terakhir yang memegangnya selesai atau dibatalkan dari antrean.
+using SourceRegistration = std::shared_ptr<const std::string>;
 
-    bool isSuccess = false;
+// Unduhan yang masih menerima bytes dari Dart (beginStream sampai endStream).
+// Hanya dipakai di platform thread.
+struct OpenStream {
+    std::shared_ptr<StreamingBuffer> buffer;
+    SourceRegistration registration;
+};
+std::map<std::string, OpenStream> g_openStreams;
+
+// Mendaftarkan argumen "fileBytes" sebagai sumber "memory:" tanpa file sementara.
+// Argumen MethodCall hanya bisa dibaca (const), jadi bytes disalin sekali ke
+// GBytes; salinan di memori tetap jauh lebih murah daripada file sementara.
+// Null jika tidak ada bytes.
+SourceRegistration RegisterChannelBytes(const flutter::EncodableMap& args) {
+    auto it = args.find(flutter::EncodableValue("fileBytes"));
+    if (it == args.end()) return nullptr;
+    const auto* bytes = std::get_if<std::vector<uint8_t>>(&it->second);
+    if (!bytes || bytes->empty()) return nullptr;
+
+    GBytes* gbytes = g_bytes_new(bytes->data(), bytes->size());
+    std::string source = DocumentCache::Shared().RegisterBytes(gbytes);
+    g_bytes_unref(gbytes);
+    return SourceRegistration(new std::string(source), [](const std::string* registered) {
+        DocumentCache::Shared().UnregisterBytes(*registered);
+        delete registered;
+    });
+}
 
-    if (wasErrorFlagSeen && maxPagesPrintedSeen == 0) {
-        // Error muncul DAN tidak ada halaman tercetak sama sekali sebelum hilang
-        // (Asumsi: Error fatal, job dibatalkan sistem)
-        isSuccess = false;
-        LogStatus("RESULT: Failed (Error flag detected & 0 pages).");
-    }
-    else if (maxPagesPrintedSeen == 0 && totalPages > 0) {
-        if (!wasErrorFlagSeen && !wasOffline && !wasDeletedFlagSeen) {
-            isSuccess = true;
-            LogStatus("RESULT: Assumed Success (Job finished very fast before PagesPrinted could be polled).");
-        } else {
-            isSuccess = false;
-            LogStatus("RESULT: Failed (Job disappeared with 0 pages printed - likely Cancelled by Admin/User).");
-        }
-    }
-    else if (wasDeletedFlagSeen && maxPagesPrintedSeen == 0) {
-        // asumsikan berhasil karena banyak driver printer yang tidak melaporkan PagesPrinted.
-        if (!wasErrorFlagSeen && !wasOffline) {
-            isSuccess = true;
-            LogStatus("RESULT: Assumed Success (Job deleted without errors, likely driver doesn't report PagesPrinted).");
-        } else {
-            isSuccess = false;
-            LogStatus("RESULT: Failed (Job was cancelled before printing started).");
-        }
-    }
-    else {
-        isSuccess = true;
-        LogStatus("RESULT: Success (Job finished/handed off to printer).");
+// Unduhan yang belum selesai saat aplikasi ditutup: job yang menunggu bytes dilepas.
+void FailOpenStreams() {
+    for (auto& entry : g_openStreams) {
+        entry.second.buffer->Fail();
     }
+    g_openStreams.clear();
+}
 
-    // --- KIRIM STATUS ---
-    PrintEventData* data = new PrintEventData();
-    data->printJobId = appPrintJobId;
-    data->totalPages = totalPages;
-    if (isSuccess) {
-        data->type = 1; // Completed
-        LogStatus("SENT: Message posted to Flutter.");
+// Menjalankan |task| di platform thread. MethodResult dan g_channel hanya boleh
+// dipakai dari thread ini, jadi pekerjaan berat di background thread
+// mengirim hasilnya lewat sini.
+void PostToPlatformThread(std::function<void()> task) {
+    auto* taskData = new std::function<void()>(std::move(task));
+    BOOL isPosted = FALSE;
+    if (g_mainWindowHandle) {
+        isPosted = ::PostMessage(g_mainWindowHandle, WM_FLUTTER_TASK_EVENT, (WPARAM)taskData, 0);
+    } else {
+        isPosted = ::PostThreadMessage(g_mainThreadId, WM_FLUTTER_TASK_EVENT, (WPARAM)taskData, 0);
     }
-    else {
-        data->type = 3; // 3 = FAILED (Kita tentukan sendiri angka 3 ini sebagai kode Gagal)
-        data->statusMsg = "Print Failed or Cancelled";
-        LogStatus("SENT: FAILED to Flutter.");
+    if (!isPosted) {
+        delete taskData;
     }
-    BOOL isFinalPosted = FALSE;
+}
+
+// Membangunkan platform thread untuk mengirim batch event. Jika gagal
+// dikirim, event tetap di antrean dan Post berikutnya mencoba lagi.
+void SchedulePrintEvents() {
+    BOOL isPosted = FALSE;
     if (g_mainWindowHandle) {
-        isFinalPosted = ::PostMessage(g_mainWindowHandle, WM_FLUTTER_PRINT_EVENT, (WPARAM)data, 0);
-    }
-    else {
-        // Fallback thread message
-        isFinalPosted = ::PostThreadMessage(g_mainThreadId, WM_FLUTTER_PRINT_EVENT, (WPARAM)data, 0);
+        isPosted = ::PostMessage(g_mainWindowHandle, WM_FLUTTER_PRINT_EVENT, 0, 0);
+    } else {
+        isPosted = ::PostThreadMessage(g_mainThreadId, WM_FLUTTER_PRINT_EVENT, 0, 0);
     }
-    if (!isFinalPosted) {
-        delete data;
+    if (!isPosted) {
+        g_printEvents->Rearm();
     }
-    ClosePrinter(hPrinter);
 }
 
-// Helper untuk konversi WString ke String (UTF-8)
-std::string WStringToString(const std::wstring& wstr) {
-    if (wstr.empty()) return std::string();
-    int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-    std::string strTo(size_needed, 0);
-    WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-    return strTo;
+void PostPrintEvent(const PrintEvent& event) {
+    if (!g_printEvents->Post(event)) {
+        OutputDebugStringA("[PrintMonitor] Event queue full, event dropped\n");
+    }
 }
 
-// Fungsi untuk mendapatkan daftar nama kertas dari driver
-std::vector<std::string> GetPrinterPaperNames(const std::string& printerName) {
-    std::vector<std::string> paperNames;
-    std::wstring wPrinterName(printerName.begin(), printerName.end());
-    LPWSTR pPrinterName = const_cast<LPWSTR>(wPrinterName.c_str());
-
-    // Ambil Port Name (DeviceCapabilities butuh Port, meski kadang NULL bisa jalan, lebih aman pakai Port)
-    // Tapi untuk simplifikasi, biasanya NULL di parameter port DeviceCapabilities sudah cukup untuk driver modern.
-    // Jika gagal, kita bisa perluas kode untuk OpenPrinter -> GetPrinter -> Ambil pPortName.
-    // Kita coba NULL dulu (biasanya works).
-
-    // 1. Cek jumlah kertas yang didukung
-    DWORD count = DeviceCapabilitiesW(pPrinterName, NULL, DC_PAPERNAMES, NULL, NULL);
-
-    if (count > 0 && count != -1) {
-        // Buffer untuk nama kertas (Setiap nama max 64 karakter wide char)
-        wchar_t* pPaperNames = new wchar_t[count * 64];
+PrintEvent PrinterStatusEvent(const std::string& printerName, const PrinterStatus& status) {
+    PrintEvent event;
+    event.type = PrintEventType::kPrinterStatus;
+    event.SetText(printerName.c_str());
+    event.online = status.online;
+    event.status = status.status;
+    event.rawStatus = status.rawStatus;
+    event.queuedJobs = status.queuedJobs;
+    event.pagesPerMinute = status.pagesPerMinute;
+    return event;
+}
 
-        if (DeviceCapabilitiesW(pPrinterName, NULL, DC_PAPERNAMES, (LPWSTR)pPaperNames, NULL) != -1) {
-            for (DWORD i = 0; i < count; ++i) {
-                // Ambil pointer ke string ke-i
-                wchar_t* pName = pPaperNames + (i * 64);
-                paperNames.push_back(WStringToString(std::wstring(pName)));
-            }
+flutter::EncodableMap EncodePrintEvent(const PrintEvent& event) {
+    flutter::EncodableMap args = {
+        {flutter::EncodableValue("event"), flutter::EncodableValue(PrintEventMethod(event.type))},
+        {flutter::EncodableValue("printJobId"), flutter::EncodableValue(event.printJobId)}
+    };
+    auto set = [&args](const char* key, flutter::EncodableValue value) {
+        args[flutter::EncodableValue(key)] = std::move(value);
+    };
+    switch (event.type) {
+        case PrintEventType::kJobCompleted:
+            set("totalPages", flutter::EncodableValue(event.totalPages));
+            set("spoolBytes", flutter::EncodableValue(event.spoolBytes));
+            break;
+        case PrintEventType::kPrinterStatus:
+            set("printerName", flutter::EncodableValue(event.text));
+            set("online", flutter::EncodableValue(event.online));
+            set("paperOut", flutter::EncodableValue((event.status & kSpoolQueuePaperOut) != 0));
+            set("error", flutter::EncodableValue((event.status & kSpoolQueueError) != 0));
+            set("paused", flutter::EncodableValue((event.status & kSpoolQueuePaused) != 0));
+            set("printing", flutter::EncodableValue((event.status & kSpoolQueuePrinting) != 0));
+            set("queuedJobs", flutter::EncodableValue(event.queuedJobs));
+            set("pagesPerMinute", flutter::EncodableValue(event.pagesPerMinute));
+            set("statusCode", flutter::EncodableValue((int64_t)event.rawStatus));
+            break;
+        case PrintEventType::kJobFailed:
+            set("error", flutter::EncodableValue(event.text));
+            break;
+        case PrintEventType::kPrintProgress: {
+            SpoolJobInfo info;
+            info.status = event.status;
+            info.rawStatus = event.rawStatus;
+            info.pagesPrinted = event.pages;
+            info.totalPages = event.totalPages;
+            set("status", flutter::EncodableValue(FormatSpoolJobInfo(info)));
+            break;
         }
-        delete[] pPaperNames;
+        case PrintEventType::kSpoolStarted:
+            set("jobHandle", flutter::EncodableValue(event.jobHandle));
+            set("setupMs", flutter::EncodableValue(event.ms));
+            break;
+        case PrintEventType::kSpoolFailed:
+            set("jobHandle", flutter::EncodableValue(event.jobHandle));
+            set("code", flutter::EncodableValue(event.code));
+            set("error", flutter::EncodableValue(event.text));
+            break;
+        case PrintEventType::kSpoolProgress:
+            set("jobHandle", flutter::EncodableValue(event.jobHandle));
+            set("pagesSpooled", flutter::EncodableValue(event.pages));
+            set("totalPages", flutter::EncodableValue(event.totalPages));
+            break;
+        case PrintEventType::kSpoolCompleted:
+            set("jobHandle", flutter::EncodableValue(event.jobHandle));
+            set("pagesSpooled", flutter::EncodableValue(event.pages));
+            set("firstPageMs", flutter::EncodableValue(event.ms));
+            set("spoolBytes", flutter::EncodableValue(event.spoolBytes));
+            set("monoMode", flutter::EncodableValue(event.monoMode));
+            set("peakRssBytes", flutter::EncodableValue(event.peakRssBytes));
+            break;
     }
-
-    return paperNames;
+    return args;
 }
 
-bool HasContentInMargins(PopplerPage* page, double pdfW, double pdfH, double mL, double mT, double mR, double mB) {
-    int w = (int)pdfW;
-    int h = (int)pdfH;
-
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
-    cairo_t* cr = cairo_create(surface);
-
-    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-    cairo_paint(cr);
-
-    poppler_page_render(page, cr);
-
-    cairo_surface_flush(surface);
-    unsigned char* data = cairo_image_surface_get_data(surface);
-    int stride = cairo_image_surface_get_stride(surface);
-
-    bool hasContent = false;
-
-    int iML = (int)mL;
-    int iMT = (int)mT;
-    int iMR = (int)mR;
-    int iMB = (int)mB;
-
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < iML && x < w; x++) {
-            uint32_t* pixel = (uint32_t*)(data + y * stride + x * 4);
-            if ((*pixel & 0x00FFFFFF) != 0x00FFFFFF) {
-                hasContent = true; goto cleanup;
-            }
+// Dipanggil di platform thread. Paling banyak satu batch per frame; kalau
+// batch terakhir baru saja dikirim, sisanya ditunda lewat timer.
+void FlushPrintEvents() {
+    auto now = std::chrono::steady_clock::now();
+    auto sinceLast = now - g_lastPrintEventFlush;
+    if (sinceLast < kPrintEventFrame) {
+        if (!g_printEventTimer) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(kPrintEventFrame - sinceLast);
+            g_printEventTimer = ::SetTimer(g_mainWindowHandle, 1, (UINT)std::max<int64_t>(1, wait.count()), nullptr);
         }
+        return;
     }
-
-    for (int y = 0; y < iMT && y < h; y++) {
-        for (int x = 0; x < w; x++) {
-            uint32_t* pixel = (uint32_t*)(data + y * stride + x * 4);
-            if ((*pixel & 0x00FFFFFF) != 0x00FFFFFF) {
-                hasContent = true; goto cleanup;
-            }
-        }
+    g_lastPrintEventFlush = now;
+
+    static std::vector<PrintEvent> batch = [] {
+        std::vector<PrintEvent> reserved;
+        reserved.reserve(PrintEventQueue::kMaxBatch);
+        return reserved;
+    }();
+    g_printEvents->Drain(&batch);
+    if (batch.empty() || !g_channel) return;
+
+    flutter::EncodableList events;
+    events.reserve(batch.size());
+    for (const PrintEvent& event : batch) {
+        events.push_back(flutter::EncodableValue(EncodePrintEvent(event)));
     }
+    PrintEventStats stats = g_printEvents->stats();
+    flutter::EncodableMap args = {
+        {flutter::EncodableValue("events"), flutter::EncodableValue(events)},
+        {flutter::EncodableValue("coalesced"), flutter::EncodableValue((int64_t)stats.coalesced)},
+        {flutter::EncodableValue("dropped"), flutter::EncodableValue((int64_t)stats.dropped)}
+    };
+    g_channel->InvokeMethod("onPrintEvents", std::make_unique<flutter::EncodableValue>(args));
+}
 
-    for (int y = 0; y < h; y++) {
-        for (int x = (w - iMR); x < w; x++) {
-            if (x < 0) continue;
-            uint32_t* pixel = (uint32_t*)(data + y * stride + x * 4);
-            if ((*pixel & 0x00FFFFFF) != 0x00FFFFFF) {
-                hasContent = true; goto cleanup;
-            }
-        }
-    }
+SpoolWatcher::ProgressCallback SpoolProgressCallback(int appPrintJobId) {
+    return [appPrintJobId](const SpoolJobInfo& info) {
+        LogStatus(FormatSpoolJobInfo(info));
+
+        // Kirim update progress ke Flutter secara AMAN (Thread-Safe)
+        PrintEvent progress;
+        progress.type = PrintEventType::kPrintProgress;
+        progress.printJobId = appPrintJobId;
+        progress.status = info.status;
+        progress.rawStatus = info.rawStatus;
+        progress.pages = info.pagesPrinted;
+        progress.totalPages = info.totalPages;
+        PostPrintEvent(progress);
+    };
+}
 
-    for (int y = (h - iMB); y < h; y++) {
-        if (y < 0) continue;
-        for (int x = 0; x < w; x++) {
-            uint32_t* pixel = (uint32_t*)(data + y * stride + x * 4);
-            if ((*pixel & 0x00FFFFFF) != 0x00FFFFFF) {
-                hasContent = true; goto cleanup;
+SpoolWatcher::DoneCallback SpoolDoneCallback(std::vector<int> appPrintJobIds, int totalPages) {
+    return [appPrintJobIds, totalPages](const SpoolOutcome& outcome) {
+        LogStatus("Max Pages Seen: " + std::to_string(outcome.maxPagesPrinted) + " / " + std::to_string(totalPages) +
+            ", spool " + std::to_string(outcome.spoolBytes) + " bytes");
+        LogStatus("RESULT: " + outcome.reason);
+
+        // --- KIRIM STATUS ---
+        for (int jobId : appPrintJobIds) {
+            g_spoolJobs.Forget(jobId);
+            PrintEvent result;
+            result.printJobId = jobId;
+            result.totalPages = totalPages;
+            result.spoolBytes = outcome.spoolBytes;
+            if (outcome.success) {
+                result.type = PrintEventType::kJobCompleted;
             }
+            else {
+                result.type = PrintEventType::kJobFailed;
+                result.SetText("Print Failed or Cancelled");
+            }
+            PostPrintEvent(result);
         }
-    }
-
-cleanup:
-    cairo_destroy(cr);
-    cairo_surface_destroy(surface);
-    return hasContent;
+        LogStatus(outcome.success ? "SENT: Message posted to Flutter." : "SENT: FAILED to Flutter.");
+    };
 }
 
-void RenderPageBorderless(HDC hdc, PopplerPage* page) {
-    double width_points = 0.0, height_points = 0.0;
-    poppler_page_get_size(page, &width_points, &height_points);
-
-    // Ambil info kertas dari printer
-    int offsetX = GetDeviceCaps(hdc, PHYSICALOFFSETX);
-    int offsetY = GetDeviceCaps(hdc, PHYSICALOFFSETY);
-    int physicalW = GetDeviceCaps(hdc, PHYSICALWIDTH);
-    int physicalH = GetDeviceCaps(hdc, PHYSICALHEIGHT);
-    int resX = GetDeviceCaps(hdc, HORZRES);
-    int resY = GetDeviceCaps(hdc, VERTRES);
-
-    int physRightMargin = physicalW - resX - offsetX;
-    int physBottomMargin = physicalH - resY - offsetY;
-
-    int dpiX = GetDeviceCaps(hdc, LOGPIXELSX);
-    int dpiY = GetDeviceCaps(hdc, LOGPIXELSY);
-
-    double mLeftPts = (double)offsetX * 72.0 / dpiX;
-    double mTopPts = (double)offsetY * 72.0 / dpiY;
-    double mRightPts = (double)physRightMargin * 72.0 / dpiX;
-    double mBottomPts = (double)physBottomMargin * 72.0 / dpiY;
-    bool contentInDangerZone = false;
-
-    if (offsetX > 0 || offsetY > 0 || physRightMargin > 0 || physBottomMargin > 0) {
-        contentInDangerZone = HasContentInMargins(page, width_points, height_points, mLeftPts, mTopPts, mRightPts, mBottomPts);
-    }
-
-    double scale_x, scale_y;
-    double trans_x = 0, trans_y = 0;
-
-    if (contentInDangerZone) {
+// |appPrintJobIds|: job aplikasi yang dicetak dalam satu job Windows ini
+// (lebih dari satu untuk transaksi). Progress dilaporkan atas id pertama.
+// Semua job dipantau oleh satu thread SpoolWatcher, tidak ada thread per job.
+void WatchSpoolJob(const std::string& printerName, DWORD winJobId, std::vector<int> appPrintJobIds, int totalPages) {
+    int appPrintJobId = appPrintJobIds.empty() ? 0 : appPrintJobIds.front();
+    LogStatus("START monitoring Windows Job ID: " + std::to_string(winJobId) + " on " + printerName);
+    for (int jobId : appPrintJobIds) g_spoolJobs.Record(jobId, printerName, (int)winJobId);
 
-        OutputDebugStringA("[Render] Konten terdeteksi di margin. Menggunakan mode FIT TO PAGE.\n");
-
-        double paperCenterX = (double)physicalW / 2.0;
-        double paperCenterY = (double)physicalH / 2.0;
-
-        double distCenterToLeft = paperCenterX - (double)offsetX;
-        double distCenterToRight = ((double)physicalW - (double)physRightMargin) - paperCenterX;
-
-        double safeSymmetricW = std::min(distCenterToLeft, distCenterToRight) * 2.0;
-
-        double distCenterToTop = paperCenterY - (double)offsetY;
-        double distCenterToBottom = ((double)physicalH - (double)physBottomMargin) - paperCenterY;
-        double safeSymmetricH = std::min(distCenterToTop, distCenterToBottom) * 2.0;
-
-        scale_x = safeSymmetricW / width_points;
-        scale_y = safeSymmetricH / height_points;
-
-        double scale = std::min(scale_x, scale_y);
-        scale_x = scale;
-        scale_y = scale;
-
-        double finalW = width_points * scale;
-        double finalH = height_points * scale;
-
-        trans_x = (paperCenterX - (finalW / 2.0)) - (double)offsetX;
-        trans_y = (paperCenterY - (finalH / 2.0)) - (double)offsetY;
-
-        // Debug info untuk cek simetri
-        std::string debugMsg = "[Render] PhysW:" + std::to_string(physicalW) +
-            " OffL:" + std::to_string(offsetX) +
-            " OffR:" + std::to_string(physRightMargin) +
-            " -> SafeW:" + std::to_string((int)safeSymmetricW) + "\n";
-        OutputDebugStringA(debugMsg.c_str());
-
-    }
-    else {
-
-        scale_x = (double)physicalW / (width_points > 0 ? width_points : 1.0);
-        scale_y = (double)physicalH / (height_points > 0 ? height_points : 1.0);
-        double scale = std::min(scale_x, scale_y);
-        scale_x = scale;
-        scale_y = scale;
-
-        trans_x = -offsetX;
-        trans_y = -offsetY;
-    }
-
-    // Buat surface Cairo untuk rendering
-    cairo_surface_t* surface = cairo_win32_printing_surface_create(hdc);
-    cairo_t* cr = cairo_create(surface);
-
-    cairo_save(cr);
-
-    // Geser canvas agar margin hardware dikompensasi
-    cairo_translate(cr, trans_x, trans_y);
-
-    // Scale konten PDF ke ukuran fisik
-    cairo_scale(cr, scale_x, scale_y);
-
-    // Render halaman
-    poppler_page_render_for_printing(page, cr);
+    g_spoolWatcher->Watch(printerName, (int)winJobId, totalPages,
+        SpoolProgressCallback(appPrintJobId), SpoolDoneCallback(appPrintJobIds, totalPages));
+}
 
-    cairo_restore(cr);
-    cairo_destroy(cr);
-    cairo_surface_destroy(surface);
+// Untuk dokumen yang di-spool program lain (SumatraPDF): job-nya dikenali
+// dari |tag| di nama dokumen begitu muncul di antrean.
+void WatchSpoolDocument(const std::string& printerName, const std::string& tag, int appPrintJobId) {
+    LogStatus("START waiting for document " + tag + " on " + printerName);
+    g_spoolWatcher->WatchDocument(printerName, tag, 0,
+        [printerName, tag, appPrintJobId](int winJobId) {
+            LogStatus("Document " + tag + " is Windows Job ID: " + std::to_string(winJobId));
+            g_spoolJobs.Record(appPrintJobId, printerName, winJobId);
+        },
+        SpoolProgressCallback(appPrintJobId), SpoolDoneCallback({appPrintJobId}, 0));
 }
 
 short GetWindowsPaperSize(std::string sizeName) {
@@ -471,229 +498,319 @@ bool IsPrinterOnline(const std::string& printerName) {
     return true;
 }
 
-bool PrintPDFFile(const std::string& filePath, const std::string& printerName, bool color, bool doubleSided, int copies, const std::string& pageOrientation, int printJobId, const std::string& pageSize, std::unique_ptr<flutter::MethodResult<>> result) {
-    HANDLE hPrinter = nullptr;
-    std::wstring wprinter;
-    wprinter.assign(printerName.begin(), printerName.end());
-
-    if (!OpenPrinterW(const_cast<LPWSTR>(wprinter.c_str()), &hPrinter, nullptr)) {
-        result->Error("PRINTER_NOT_FOUND", "Printer not found or could not be opened.");
-        OutputDebugStringA("Gagal membuka printer.\n");
-        return false;
+// Kirim kSpoolFailed untuk |jobHandle|. Jika dokumen sudah mulai di-spool, job
+// aplikasi di dalamnya juga digagalkan (kJobFailed) karena sudah dilaporkan
+// "Sent To Printer".
+void PostSpoolFailed(int jobHandle, const std::vector<int>& printJobIds, bool isStarted,
+    const std::string& code, const std::string& message) {
+    LogStatus("Job handle " + std::to_string(jobHandle) + " failed: " + code + " " + message);
+    PrintEvent data;
+    data.type = PrintEventType::kSpoolFailed;
+    data.jobHandle = jobHandle;
+    data.printJobId = printJobIds.empty() ? 0 : printJobIds.front();
+    data.SetCode(code.c_str());
+    data.SetText(message.c_str());
+    PostPrintEvent(data);
+
+    if (!isStarted) return;
+    for (int printJobId : printJobIds) {
+        if (printJobId <= 0) continue;
+        PrintEvent failed;
+        failed.type = PrintEventType::kJobFailed;
+        failed.printJobId = printJobId;
+        failed.SetText(message.c_str());
+        PostPrintEvent(failed);
     }
+}
 
-    // Mendapatkan ukuran DEVMODE default
-    DWORD devModeSize = DocumentPropertiesW(nullptr, hPrinter, const_cast<LPWSTR>(wprinter.c_str()), nullptr, nullptr, 0);
-    if (devModeSize <= 0) {
-        ClosePrinter(hPrinter);
-        result->Error("GET_DEVMODE_SIZE_FAILED", "Failed to get DEVMODE size.");
-        return false;
-    }
+DevModeRequest ToDevModeRequest(const PageSetup& setup) {
+    DevModeRequest request;
+    request.paperSize = GetWindowsPaperSize(setup.pageSize);
+    request.color = setup.color;
+    request.duplex = setup.duplex;
+    request.landscape = setup.landscape;
+    return request;
+}
 
-    // Mengalokasikan memori untuk DEVMODE
-    PDEVMODE pDevMode = (PDEVMODE)GlobalAlloc(GPTR, devModeSize);
-    if (!pDevMode) {
-        ClosePrinter(hPrinter);
-        result->Error("ALLOC_DEVMODE_FAILED", "Failed to allocate memory for DEVMODE.");
-        return false;
+// Mengisi halaman ke sink yang dokumennya sudah dimulai.
+using SpoolContent = std::function<SpoolResult(PrintSink* sink, const PrintSettings& settings,
+    const SpoolProgressCallback& onProgress)>;
+
+// Dijalankan di worker JobExecutor, bukan di platform thread: siapkan DC
+// printer, spool |content| sebagai satu dokumen, lalu monitor job-nya. Hasil
+// dikirim ke Flutter lewat PrintEventQueue: kSpoolStarted, kSpoolFailed,
+// kSpoolProgress, lalu kSpoolCompleted begitu semua halaman di spooler.
+// Ukuran spool baru final setelah spooler selesai, jadi dilaporkan SpoolWatcher
+// di kJobCompleted. |printJobIds| adalah job aplikasi di dalam dokumen ini
+// (lebih dari satu untuk transaksi). |receivedAt| adalah waktu panggilan
+// channel, dasar firstPageMs di kSpoolCompleted.
+void RunSpoolJob(int jobHandle, const PrintSettings& settings, const std::vector<int>& printJobIds,
+    std::chrono::steady_clock::time_point receivedAt, const std::string& finalOrientation,
+    const SpoolContent& content) {
+    bool isStarted = false;
+    auto fail = [&](const std::string& code, const std::string& message) {
+        PostSpoolFailed(jobHandle, printJobIds, isStarted, code, message);
+    };
+
+    auto setupStart = std::chrono::steady_clock::now();
+    std::wstring wprinter;
+    wprinter.assign(settings.printerName.begin(), settings.printerName.end());
+
+    // DEVMODE tervalidasi diambil dari cache sesi printer; driver hanya ditanya
+    // untuk kombinasi kertas/warna/duplex/orientasi yang belum pernah dipakai
+    PageSetup setup;
+    setup.pageSize = settings.pageSize;
+    setup.color = settings.color;
+    setup.duplex = settings.doubleSided;
+    setup.landscape = finalOrientation != "portrait";
+    DevModeRequest devModeRequest = ToDevModeRequest(setup);
+
+    std::vector<unsigned char> devModeBuffer;
+    bool devModeCached = false;
+    std::string devModeError;
+    if (!g_printerSessions->AcquireDevMode(settings.printerName, devModeRequest, &devModeBuffer, &devModeCached, &devModeError)) {
+        OutputDebugStringA("Gagal membuka printer.\n");
+        fail(devModeError, devModeError == "PRINTER_NOT_FOUND"
+            ? "Printer not found or could not be opened."
+            : "Failed to get default DEVMODE.");
+        return;
     }
-
-    // Mendapatkan DEVMODE default
-    if (DocumentPropertiesW(nullptr, hPrinter, const_cast<LPWSTR>(wprinter.c_str()), pDevMode, nullptr, DM_OUT_BUFFER) != IDOK) {
-        GlobalFree(pDevMode);
-        ClosePrinter(hPrinter);
-        result->Error("GET_DEVMODE_FAILED", "Failed to get default DEVMODE.");
-        return false;
+    PDEVMODEW pDevMode = reinterpret_cast<PDEVMODEW>(devModeBuffer.data());
+
+    // Driver yang tidak bisa collate (DC_COLLATE != 1) akan mencetak 1,1,..,2,2,..
+    // jadi salinan dibuat sendiri: render sekali, putar ulang per salinan.
+    PrintSettings jobSettings = settings;
+    if (jobSettings.copies > 1 && !jobSettings.softwareCopies &&
+        DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_COLLATE, nullptr, pDevMode) != 1) {
+        jobSettings.softwareCopies = true;
     }
 
-    // --- prepare Poppler (glib) ---
-    GError* gerror = nullptr;
-    gchar* uri = g_filename_to_uri(filePath.c_str(), nullptr, &gerror);
-    if (!uri) {
-        if (gerror) {
-            result->Error("FILE_URI_ERROR", gerror->message);
-            g_clear_error(&gerror);
-        }
-        else {
-            result->Error("FILE_URI_ERROR", "Failed to create file URI.");
+    if (jobSettings.softwareCopies) {
+        pDevMode->dmCopies = 1;
+    }
+    else {
+        // Set jumlah salinan
+        pDevMode->dmCopies = static_cast<short>(jobSettings.copies);
+
+        // Semua halaman dikirim dalam satu spool job, jadi salinan harus collated
+        // (1..N, 1..N) seperti hasil loop per-batch sebelumnya.
+        if (jobSettings.copies > 1) {
+            pDevMode->dmFields |= DM_COLLATE;
+            pDevMode->dmCollate = DMCOLLATE_TRUE;
         }
-        GlobalFree(pDevMode);
-        ClosePrinter(hPrinter);
-        return false;
     }
 
-    PopplerDocument* doc = poppler_document_new_from_file(uri, nullptr, &gerror);
-    g_free(uri);
-    if (!doc) {
-        if (gerror) {
-            result->Error("POPPLER_LOAD_ERROR", gerror->message);
-            g_clear_error(&gerror);
-        }
-        else {
-            result->Error("POPPLER_LOAD_ERROR", "Failed to load PDF document.");
-        }
-        GlobalFree(pDevMode);
-        ClosePrinter(hPrinter);
-        return false;
+    HDC hdc = CreateDCW(nullptr, wprinter.c_str(), nullptr, pDevMode);
+    if (!hdc) {
+        // Bisa jadi driver berubah, jangan pakai sesi lama untuk job berikutnya
+        g_printerSessions->Invalidate(settings.printerName);
+        OutputDebugStringA("Gagal mendapatkan Device Context untuk printer.\n");
+        fail("PRINTER_NOT_FOUND", "Printer not found or Device Context could not be created.");
+        return;
     }
 
-    std::string finalOrientation = pageOrientation;
-    if (pageOrientation == "auto") {
-        int num_pages = poppler_document_get_n_pages(doc);
-        if (num_pages > 0) {
-            PopplerPage* first_page = poppler_document_get_page(doc, 0);
-            double width_points = 0.0, height_points = 0.0;
-            poppler_page_get_size(first_page, &width_points, &height_points);
-            g_object_unref(first_page);
+    double setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+    LogStatus("Job setup " + std::to_string((int)setupMs) + " ms (DEVMODE " + (devModeCached ? "cached" : "from driver") + ")");
 
-            if (width_points > height_points) {
-                finalOrientation = "landscape";
-            }
-            else {
-                finalOrientation = "portrait";
-            }
-        }
-        else {
-            // Jika tidak ada halaman, gunakan default portrait
-            finalOrientation = "portrait";
+    // Ganti setup di tengah dokumen (transaksi): DEVMODE juga dari cache sesi.
+    // Salinan selalu dibuat software di sana, jadi driver cukup 1 salinan.
+    GdiPrintSink sink(hdc, [&settings](const PageSetup& pageSetup, std::vector<unsigned char>* devMode) {
+        bool cached = false;
+        std::string error;
+        if (!g_printerSessions->AcquireDevMode(settings.printerName, ToDevModeRequest(pageSetup), devMode, &cached, &error)) {
+            return false;
         }
+        reinterpret_cast<PDEVMODEW>(devMode->data())->dmCopies = 1;
+        return true;
+    });
+    int jobId = 0;
+    if (!sink.StartDocument(TagDocumentName("Hlaprint Print Job", NewDocumentTag()), &jobId)) {
+        DeleteDC(hdc);
+        fail("START_DOC_FAILED", "Failed to start print document.");
+        return;
     }
 
-    // Mengatur metadata cetak
-    pDevMode->dmFields |= DM_COPIES | DM_DUPLEX | DM_COLOR | DM_ORIENTATION | DM_PRINTQUALITY | DM_YRESOLUTION | DM_PAPERSIZE;
-    pDevMode->dmPaperSize = GetWindowsPaperSize(pageSize);
-
-    // Set kualitas cetak
-    pDevMode->dmPrintQuality = DMRES_HIGH;
-    pDevMode->dmYResolution = pDevMode->dmPrintQuality;
-
-    // Set jumlah salinan
-    pDevMode->dmCopies = static_cast<short>(copies);
-
-    // Set cetak bolak-balik (duplex)
-    if (doubleSided) {
-        if (finalOrientation == "portrait") {
-            pDevMode->dmDuplex = DMDUP_VERTICAL;
-        }
-        else {
-            pDevMode->dmDuplex = DMDUP_HORIZONTAL;
+    // Kirim respons awal ke Flutter bahwa pekerjaan sudah dikirim ke printer
+    isStarted = true;
+    PrintEvent started;
+    started.type = PrintEventType::kSpoolStarted;
+    started.jobHandle = jobHandle;
+    started.printJobId = settings.printJobId;
+    started.ms = setupMs;
+    PostPrintEvent(started);
+
+    double firstPageMs = -1.0;
+    SpoolResult spool = content(&sink, jobSettings, [jobHandle, &settings, &firstPageMs, receivedAt](int pagesSpooled, int totalPages) {
+        if (firstPageMs < 0) {
+            firstPageMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - receivedAt).count();
         }
+        // Digabung per jobHandle: UI hanya melihat halaman terakhir per frame
+        PrintEvent progress;
+        progress.type = PrintEventType::kSpoolProgress;
+        progress.jobHandle = jobHandle;
+        progress.printJobId = settings.printJobId;
+        progress.pages = pagesSpooled;
+        progress.totalPages = totalPages;
+        PostPrintEvent(progress);
+    });
+
+    if (!spool.ok) {
+        sink.AbortDocument();
+        DeleteDC(hdc);
+        fail(spool.errorCode, spool.errorMessage);
+        return;
     }
-    else {
-        pDevMode->dmDuplex = DMDUP_SIMPLEX;
+
+    if (!sink.EndDocument()) {
+        DeleteDC(hdc);
+        fail("END_DOC_FAILED", "Failed to end print document.");
+        return;
     }
+    DeleteDC(hdc);
 
-    // Set orientasi
-    if (finalOrientation == "portrait") {
-        pDevMode->dmOrientation = DMORIENT_PORTRAIT;
+    // Semua halaman sudah di spooler, file sumber boleh dihapus oleh Flutter
+    PrintEvent spooled;
+    spooled.type = PrintEventType::kSpoolCompleted;
+    spooled.jobHandle = jobHandle;
+    spooled.printJobId = settings.printJobId;
+    spooled.pages = spool.pagesSpooled;
+    spooled.ms = firstPageMs;
+    spooled.monoMode = DitherModeName(spool.monoDither);
+    spooled.peakRssBytes = PeakWorkingSetBytes();
+    PostPrintEvent(spooled);
+
+    double pagesPerSec = spool.elapsedMs > 0 ? spool.pagesSpooled * 1000.0 / spool.elapsedMs : 0.0;
+    std::string modeLog = spool.workerCount > 0
+        ? "pipelined depth=" + std::to_string(settings.pipelineDepth) + " workers=" + std::to_string(spool.workerCount) +
+          " busy=" + std::to_string((int)spool.workerBusyMs) + " ms"
+        : "serial";
+    if (jobSettings.softwareCopies && jobSettings.copies > 1) {
+        modeLog += ", render-once copies spilled=" + std::to_string(spool.spilledPages);
     }
-    else {
-        pDevMode->dmOrientation = DMORIENT_LANDSCAPE;
+    if (spool.monoDither != DitherMode::kOff) {
+        modeLog += std::string(", mono ") + DitherModeName(spool.monoDither) +
+            " convert=" + std::to_string((int)spool.monoConvertMs) + " ms";
     }
-
-    // Set warna/hitam-putih
-    if (color) {
-        pDevMode->dmColor = DMCOLOR_COLOR;
+    if (spool.banded) {
+        modeLog += ", banded rows=" + (jobSettings.bandHeight > 0 ? std::to_string(jobSettings.bandHeight) : std::string("auto"));
     }
-    else {
-        pDevMode->dmColor = DMCOLOR_MONOCHROME;
+    // Pada mode salinan software, pagesSpooled sudah termasuk semua salinan
+    int driverCopies = jobSettings.softwareCopies ? 1 : jobSettings.copies;
+    LogStatus("Spooled " + std::to_string(spool.pagesSpooled) + " pages x" + std::to_string(driverCopies) +
+        " copies in " + std::to_string((int)spool.elapsedMs) + " ms (" + std::to_string(pagesPerSec) + " pages/s, " + modeLog +
+        ", first page " + std::to_string((int)firstPageMs) + " ms, peak RSS " +
+        std::to_string(PeakWorkingSetBytes() / (1024 * 1024)) + " MB)");
+
+    std::vector<int> monitoredJobIds;
+    for (int printJobId : printJobIds) {
+        if (printJobId > 0) monitoredJobIds.push_back(printJobId);
     }
+    if (monitoredJobIds.empty()) return;
+    WatchSpoolJob(settings.printerName, (DWORD)jobId, monitoredJobIds, spool.pagesSpooled);
+}
 
-    // Pastikan perubahan pada DEVMODE berhasil diterapkan
-    if (DocumentPropertiesW(nullptr, hPrinter, const_cast<LPWSTR>(wprinter.c_str()), pDevMode, pDevMode, DM_IN_BUFFER | DM_OUT_BUFFER) != IDOK) {
-        OutputDebugStringA("Gagal mengatur kualitas cetak tinggi. Melanjutkan dengan pengaturan default.\n");
+// |filePath| boleh berupa sumber "memory:" dari RegisterChannelBytes atau
+// "stream:" dari beginStream.
+void RunPrintJob(int jobHandle, const std::string& filePath, const PrintSettings& settings,
+    std::chrono::steady_clock::time_point receivedAt) {
+    // --- prepare Poppler (glib) ---
+    std::string loadError;
+    DocumentLease document = DocumentCache::Shared().Acquire(filePath, &loadError);
+    if (!document) {
+        PostSpoolFailed(jobHandle, {settings.printJobId}, false, "POPPLER_LOAD_ERROR", loadError);
+        return;
     }
-
-    HDC hdc = CreateDCW(nullptr, wprinter.c_str(), nullptr, pDevMode);
-    GlobalFree(pDevMode);
-
-    if (!hdc) {
-        g_object_unref(doc);
-        ClosePrinter(hPrinter);
-        result->Error("PRINTER_NOT_FOUND", "Printer not found or Device Context could not be created.");
-        OutputDebugStringA("Gagal mendapatkan Device Context untuk printer.\n");
-        return false;
+    std::string sourceKind = "file";
+    if (DocumentCache::IsMemorySource(filePath)) {
+        sourceKind = "channel bytes";
+    } else if (DocumentCache::IsStreamSource(filePath)) {
+        sourceKind = document.progressive() ? "download stream (linearized, progressive)" : "download stream (complete)";
+    } else if (document.mapped()) {
+        sourceKind = "mapped file";
     }
+    LogStatus("Document source: " + sourceKind);
+
+    std::string finalOrientation = ResolveOrientation(&document, settings);
+    RunSpoolJob(jobHandle, settings, {settings.printJobId}, receivedAt, finalOrientation,
+        [&](PrintSink* sink, const PrintSettings& jobSettings, const SpoolProgressCallback& onProgress) {
+            SpoolResult spool = SpoolPages(sink, &document, filePath, jobSettings, onProgress);
+            // Mapping file besar dilepas sebelum Flutter diberi tahu file boleh dihapus
+            document.Reset();
+            return spool;
+        });
+}
 
-    DOCINFO docInfo;
-    ZeroMemory(&docInfo, sizeof(docInfo));
-    docInfo.cbSize = sizeof(docInfo);
-    docInfo.lpszDocName = L"Hlaprint Print Job";
-
-    DWORD jobId = StartDoc(hdc, &docInfo);
-    if (jobId <= 0) {
-        g_object_unref(doc);
-        DeleteDC(hdc);
-        ClosePrinter(hPrinter);
-        result->Error("START_DOC_FAILED", "Failed to start print document.");
-        return false;
+// Separator dari cache native: tanpa file sementara, parsing ulang, atau analisa margin.
+void RunSeparatorJob(int jobHandle, const PrintSettings& settings,
+    std::chrono::steady_clock::time_point receivedAt) {
+    if (!SeparatorCache::Shared().loaded()) {
+        PostSpoolFailed(jobHandle, {settings.printJobId}, false, "SEPARATOR_NOT_LOADED", "Separator PDF is not loaded.");
+        return;
     }
 
-    // Kirim respons awal ke Flutter bahwa pekerjaan sudah dikirim ke printer
-    result->Success(flutter::EncodableValue("Sent To Printer"));
-
-    
-
-    int num_pages = poppler_document_get_n_pages(doc);
-
-    // Logika untuk menentukan rentang halaman yang akan dicetak
-    int start_index = 0;
-    int end_index = num_pages;
-
-    OutputDebugStringA(("Mencetak full dokumen: " + std::to_string(num_pages) + " halaman.\n").c_str());
-
-    // Pastikan rentang halaman tidak melebihi jumlah halaman total
-    end_index = std::min(num_pages, end_index);
-
-    int totalPagesToPrint = end_index - start_index;
-
-    for (int i = start_index; i < end_index; ++i) {
-        if (i < 0 || i >= num_pages) {
-            continue;
-        }
-
-        PopplerPage* page = poppler_document_get_page(doc, i);
-        if (!page) continue;
-
-        if (StartPage(hdc) <= 0) {
-            g_object_unref(page);
-            EndDoc(hdc);
-            g_object_unref(doc);
-            DeleteDC(hdc);
-            ClosePrinter(hPrinter);
-            result->Error("START_PAGE_FAILED", "Failed to start print page.");
-            return false;
-        }
-
-        RenderPageBorderless(hdc, page);
-
-        if (EndPage(hdc) <= 0) {
-            g_object_unref(page);
-            EndDoc(hdc);
-            g_object_unref(doc);
-            DeleteDC(hdc);
-            ClosePrinter(hPrinter);
-            result->Error("END_PAGE_FAILED", "Failed to end print page.");
-            return false;
-        }
+    RunSpoolJob(jobHandle, settings, {settings.printJobId}, receivedAt, SeparatorCache::Shared().orientation(),
+        [&](PrintSink* sink, const PrintSettings&, const SpoolProgressCallback& onProgress) {
+            return SeparatorCache::Shared().Spool(sink, settings.printerName, onProgress);
+        });
+}
 
-        g_object_unref(page);
+// Bagian transaksi untuk satu printer (invoice, file, separator) dicetak
+// sebagai satu dokumen spooler, setup kertas/warna/duplex diganti di antara halaman.
+void RunTransactionJob(int jobHandle, const std::vector<TransactionSection>& sections,
+    std::chrono::steady_clock::time_point receivedAt) {
+    std::vector<int> printJobIds;
+    for (const TransactionSection& section : sections) {
+        printJobIds.push_back(section.settings.printJobId);
     }
 
-    EndDoc(hdc);
-    DeleteDC(hdc);
-    g_object_unref(doc);
-
-    if (printJobId > 0) {
-        std::thread(MonitorPrintJob, hPrinter, jobId, printJobId, totalPagesToPrint).detach();
+    std::vector<PreparedSection> prepared;
+    std::string errorCode, errorMessage;
+    if (!PrepareTransaction(sections, &prepared, &errorCode, &errorMessage)) {
+        PostSpoolFailed(jobHandle, printJobIds, false, errorCode, errorMessage);
+        return;
     }
 
-    return true;
+    // Dokumen dibuka dengan setup bagian pertama; salinan per bagian dibuat software
+    PrintSettings settings = prepared.front().section.settings;
+    settings.copies = 1;
+    settings.softwareCopies = true;
+    RunSpoolJob(jobHandle, settings, printJobIds, receivedAt, prepared.front().setup.landscape ? "landscape" : "portrait",
+        [&](PrintSink* sink, const PrintSettings&, const SpoolProgressCallback& onProgress) {
+            return SpoolTransaction(sink, &prepared, onProgress);
+        });
 }
 
 
 void RegisterMethodChannel(flutter::FlutterViewController* flutter_controller) {
     OutputDebugStringA("Mendaftarkan Method Channel...\n");
+    g_printEvents = std::make_unique<PrintEventQueue>(SchedulePrintEvents);
+    g_printerSessions = std::make_unique<PrinterSessionCache>(std::make_unique<Win32PrinterDriver>());
+    g_printExecutor = std::make_unique<JobExecutor>(4);
+    g_spoolWatcher = std::make_unique<SpoolWatcher>(std::make_unique<Win32SpoolBackend>());
+    g_printerStatus = std::make_unique<PrinterStatusService>(std::make_unique<Win32SpoolBackend>(),
+        [](const std::string& printerName, const PrinterStatus& status) {
+            PostPrintEvent(PrinterStatusEvent(printerName, status));
+        });
+
+    // Dokumen yang sama sering datang berkali-kali (batch, salinan, retry)
+    DocumentCache::Shared().Configure(8, 256 * 1024 * 1024);
+
+    // Separator dibaca sekali dari asset bundle, tidak lewat file sementara lagi
+    std::string separatorError;
+    std::string separatorPath = GetExecutableDirectory() + "\\data\\flutter_assets\\assets\\pdf\\separator.pdf";
+    if (!SeparatorCache::Shared().Load(separatorPath, &separatorError)) {
+        LogStatus("Separator tidak dimuat: " + separatorError);
+    }
+
+    std::string appDataDir = GetAppDataDirectory();
+    if (!appDataDir.empty()) {
+        MarginCache::Shared().Open(appDataDir + "\\margin_cache.txt", 4096);
+    }
+    g_printerCaps = std::make_unique<PrinterCapabilityDb>(std::make_unique<Win32CapabilityProvider>());
+    if (!appDataDir.empty()) {
+        g_printerCaps->Open(appDataDir + "\\printer_caps.txt");
+    }
+    g_printerCaps->Preload();
     g_channel = std::make_unique<flutter::MethodChannel<>>(
         flutter_controller->engine()->messenger(), "com.hlaprint.app/printing",
         &flutter::StandardMethodCodec::GetInstance());
@@ -703,51 +820,61 @@ void RegisterMethodChannel(flutter::FlutterViewController* flutter_controller) {
             std::unique_ptr<flutter::MethodResult<>> result) {
                 if (call.method_name().compare("printPDF") == 0) {
                     OutputDebugStringA("Panggilan 'printPDF' diterima.\n");
+                    auto receivedAt = std::chrono::steady_clock::now();
                     const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
                     if (args) {
-                        const auto& file_path_val = args->find(flutter::EncodableValue("filePath"));
-                        const auto& printer_name_val = args->find(flutter::EncodableValue("printerName"));
-                        const auto& color_val = args->find(flutter::EncodableValue("color"));
-                        const auto& double_sided_val = args->find(flutter::EncodableValue("doubleSided"));
-                        const auto& copies_val = args->find(flutter::EncodableValue("copies"));
-                        const auto& orientation_val = args->find(flutter::EncodableValue("pageOrientation"));
-                        const auto& print_job_id_val = args->find(flutter::EncodableValue("printJobId"));
-                        std::string pageSize = "A4";
-                        auto itSize = args->find(flutter::EncodableValue("pageSize"));
-                        if (itSize != args->end()) {
-                            if (std::holds_alternative<std::string>(itSize->second)) {
-                                pageSize = std::get<std::string>(itSize->second);
+                        // fileBytes (PDF di memori) atau streamId (unduhan yang sedang
+                        // berjalan) menggantikan filePath jika dikirim
+                        SourceRegistration registration = RegisterChannelBytes(*args);
+                        std::string streamId;
+                        ReadArgument(*args, "streamId", &streamId);
+                        auto stream = g_openStreams.find(streamId);
+                        if (!registration && stream != g_openStreams.end()) {
+                            registration = stream->second.registration;
+                        }
+                        // Argumen wajib harus ada; tipe yang salah ditolak, bukan
+                        // dibiarkan melempar bad_variant_access dari std::get
+                        bool complete = (registration || args->count(flutter::EncodableValue("filePath"))) &&
+                            args->count(flutter::EncodableValue("printerName")) &&
+                            args->count(flutter::EncodableValue("color")) &&
+                            args->count(flutter::EncodableValue("doubleSided")) &&
+                            args->count(flutter::EncodableValue("copies")) &&
+                            args->count(flutter::EncodableValue("pageOrientation")) &&
+                            args->count(flutter::EncodableValue("printJobId"));
+                        std::string filePath;
+                        PrintSettings settings;
+                        if (complete) {
+                            std::string wrongArgument = ReadArgument(*args, "filePath", &filePath) ? "" : "filePath";
+                            if (!wrongArgument.empty() || !ReadPrintSettings(*args, &settings, &wrongArgument)) {
+                                result->Error("INVALID_ARGUMENTS", "Argument " + wrongArgument + " has the wrong type.");
+                                return;
                             }
+                            if (registration) filePath = *registration;
+                            complete = !filePath.empty() && !settings.printerName.empty();
                         }
-
-                        if (file_path_val != args->end() && printer_name_val != args->end() &&
-                            color_val != args->end() && double_sided_val != args->end() &&
-                            copies_val != args->end() && orientation_val != args->end() &&
-                            print_job_id_val != args->end()) {
-
-                            std::string filePath = std::get<std::string>(file_path_val->second);
-                            std::string printerName = std::get<std::string>(printer_name_val->second);
-                            bool color = std::get<bool>(color_val->second);
-                            bool doubleSided = std::get<bool>(double_sided_val->second);
-                            int copies = std::get<int>(copies_val->second);
-                            std::string pageOrientation = std::get<std::string>(orientation_val->second);
-                            int printJobId = std::get<int>(print_job_id_val->second);
-
-                            PrintPDFFile(filePath, printerName, color, doubleSided, copies, pageOrientation, printJobId, pageSize, std::move(result));
+                        if (complete) {
+                            // Jalankan di worker, Flutter langsung menerima handle job.
+                            // Hasil spool dikirim lewat event onSpoolStarted/onSpoolFailed.
+                            int jobHandle = g_printExecutor->Submit(settings.printerName,
+                                [filePath, settings, registration, receivedAt](int handle) {
+                                    RunPrintJob(handle, filePath, settings, receivedAt);
+                                });
+                            flutter::EncodableMap response = {
+                                {flutter::EncodableValue("jobHandle"), flutter::EncodableValue(jobHandle)}
+                            };
+                            result->Success(flutter::EncodableValue(response));
                             return;
                         }
                     }
-                    result->Error("INVALID_ARGUMENTS", "File path or printer name not provided.");
+                    result->Error("INVALID_ARGUMENTS", "File path/bytes/stream or printer name not provided.");
                 }
                 else if (call.method_name() == "getPrinterStatus") {
                     const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
                     std::string printerName;
 
-                    if (args) {
-                        auto it = args->find(flutter::EncodableValue("printerName"));
-                        if (it != args->end()) {
-                            printerName = std::get<std::string>(it->second);
-                        }
+                    if (args && !ReadArgument(*args, "printerName", &printerName)) {
+                        result->Error("INVALID_ARGUMENTS", "Argument printerName has the wrong type.");
+                        return;
                     }
 
                     if (printerName.empty()) {
@@ -755,66 +882,74 @@ void RegisterMethodChannel(flutter::FlutterViewController* flutter_controller) {
                         return;
                     }
 
-                    // Panggil fungsi helper baru
-                    bool isOnline = IsPrinterOnline(printerName);
+                    // Printer yang dipantau dibaca dari snapshot; selain itu cek langsung
+                    PrinterStatus status;
+                    bool isOnline = g_printerStatus->Get(printerName, &status) ? status.online
+                                                                               : IsPrinterOnline(printerName);
 
                     // Kembalikan boolean ke Flutter (true = Online, false = Offline)
                     result->Success(flutter::EncodableValue(isOnline));
                 }
-                else if (call.method_name() == "monitorLastJob") {
+                else if (call.method_name() == "watchPrinters") {
+                    // Ganti daftar printer yang dipantau; perubahan berikutnya datang lewat onPrinterStatus
                     const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
-                    std::string printerName;
-                    int printJobId = 0;
-
+                    std::vector<std::string> printers;
                     if (args) {
-                        auto it = args->find(flutter::EncodableValue("printerName"));
-                        if (it != args->end()) printerName = std::get<std::string>(it->second);
-
-                        it = args->find(flutter::EncodableValue("printJobId"));
-                        if (it != args->end()) printJobId = std::get<int>(it->second);
-                        if (printJobId <= 0) {
-                            std::cout << "Ignoring monitor request for system job ID: " << printJobId << std::endl;
-                            result->Success(flutter::EncodableValue("ignored"));
-                            return;
+                        auto it = args->find(flutter::EncodableValue("printers"));
+                        if (it != args->end() && std::holds_alternative<flutter::EncodableList>(it->second)) {
+                            for (const auto& name : std::get<flutter::EncodableList>(it->second)) {
+                                if (const auto* printerName = std::get_if<std::string>(&name)) {
+                                    printers.push_back(*printerName);
+                                }
+                            }
                         }
                     }
+                    g_printerStatus->SetPrinters(printers);
 
-                    // Jalankan monitoring di thread terpisah agar UI tidak freeze
-                    std::thread([printerName, printJobId]() {
-                        HANDLE hPrinter = nullptr;
-                        if (OpenPrinterA(const_cast<LPSTR>(printerName.c_str()), &hPrinter, nullptr)) {
-
-                            // 1. Cari Job ID terbaru (Highest ID) di Printer tersebut
-                            DWORD bytesNeeded = 0, count = 0;
-                            EnumJobs(hPrinter, 0, 100, 2, nullptr, 0, &bytesNeeded, &count);
-
-                            std::vector<BYTE> buffer(bytesNeeded);
-                            if (EnumJobs(hPrinter, 0, 100, 2, buffer.data(), bytesNeeded, &bytesNeeded, &count)) {
-                                JOB_INFO_2* jobs = reinterpret_cast<JOB_INFO_2*>(buffer.data());
-                                DWORD maxJobId = 0;
-
-                                // Loop untuk mencari ID terbesar (Terbaru)
-                                for (DWORD i = 0; i < count; ++i) {
-                                    if (jobs[i].JobId > maxJobId) {
-                                        maxJobId = jobs[i].JobId;
-                                    }
-                                }
+                    flutter::EncodableMap statuses;
+                    for (const auto& entry : g_printerStatus->Snapshot()) {
+                        if (std::find(printers.begin(), printers.end(), entry.first) == printers.end()) continue;
+                        statuses[flutter::EncodableValue(entry.first)] =
+                            flutter::EncodableValue(EncodePrintEvent(PrinterStatusEvent(entry.first, entry.second)));
+                    }
+                    result->Success(flutter::EncodableValue(statuses));
+                }
+                else if (call.method_name() == "expectSpoolJob") {
+                    // Dipanggil sebelum dokumen diserahkan ke SumatraPDF; nama
+                    // file yang dicetak harus memuat tag yang dikembalikan
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    std::string printerName;
+                    int printJobId = 0;
+                    if (args) {
+                        ReadArgument(*args, "printerName", &printerName);
+                        ReadArgument(*args, "printJobId", &printJobId);
+                    }
+                    if (printJobId <= 0 || printerName.empty()) {
+                        std::cout << "Ignoring monitor request for system job ID: " << printJobId << std::endl;
+                        result->Success();
+                        return;
+                    }
 
-                                if (maxJobId > 0) {
-                                    // 2. Gunakan fungsi Monitor yang sudah ada untuk memantau Job Sumatra ini
-                                    MonitorPrintJob(hPrinter, maxJobId, printJobId, 0);
-                                } else {
-                                    // Tidak ada job ditemukan (mungkin print sangat cepat selesai atau gagal masuk spooler)
-                                    // Kita bisa kirim completed langsung atau log error
-                                    PrintEventData* data = new PrintEventData{ 1, printJobId, 0, "No Job Found" };
-                                    PostThreadMessage(g_mainThreadId, WM_FLUTTER_PRINT_EVENT, (WPARAM)data, 0);
-                                    ClosePrinter(hPrinter);
-                                }
-                            }
+                    std::string tag = NewDocumentTag();
+                    WatchSpoolDocument(printerName, tag, printJobId);
+                    result->Success(flutter::EncodableValue(tag));
+                }
+                else if (call.method_name() == "getSpoolJobs") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    int printJobId = 0;
+                    if (args) ReadArgument(*args, "printJobId", &printJobId);
+
+                    flutter::EncodableList jobs;
+                    std::vector<SpoolJobRef> refs;
+                    if (g_spoolJobs.Lookup(printJobId, &refs)) {
+                        for (const SpoolJobRef& ref : refs) {
+                            jobs.push_back(flutter::EncodableValue(flutter::EncodableMap{
+                                {flutter::EncodableValue("printerName"), flutter::EncodableValue(ref.queue)},
+                                {flutter::EncodableValue("jobId"), flutter::EncodableValue(ref.jobId)}
+                            }));
                         }
-                    }).detach();
-
-                    result->Success(flutter::EncodableValue("Monitoring Started"));
+                    }
+                    result->Success(flutter::EncodableValue(jobs));
                 }
                 else if (call.method_name() == "getPrinterPaperSizes") {
                     const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
@@ -825,9 +960,11 @@ void RegisterMethodChannel(flutter::FlutterViewController* flutter_controller) {
                         auto it = args->find(flutter::EncodableValue("ip"));
                         if (it == args->end()) it = args->find(flutter::EncodableValue("printerName"));
 
-                        if (it != args->end()) {
-                            printerName = std::get<std::string>(it->second);
+                        if (it != args->end() && !std::holds_alternative<std::string>(it->second)) {
+                            result->Error("INVALID_ARGUMENTS", "Printer name must be a string.");
+                            return;
                         }
+                        if (it != args->end()) printerName = std::get<std::string>(it->second);
                     }
 
                     if (printerName.empty()) {
@@ -835,17 +972,372 @@ void RegisterMethodChannel(flutter::FlutterViewController* flutter_controller) {
                         return;
                     }
 
-                    // Panggil fungsi helper
-                    std::vector<std::string> papers = GetPrinterPaperNames(printerName);
-
-                    // Convert vector ke Flutter List
+                    // Dari database kapabilitas; driver hanya ditanya untuk printer yang belum dikenal
                     flutter::EncodableList list;
-                    for (const auto& name : papers) {
-                        list.push_back(flutter::EncodableValue(name));
+                    if (auto caps = g_printerCaps->Get(printerName)) {
+                        for (const auto& paper : caps->papers) {
+                            list.push_back(flutter::EncodableValue(paper.name));
+                        }
                     }
 
                     result->Success(list);
                 }
+                else if (call.method_name() == "resolvePaperName") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    std::string printerName;
+                    std::string pageSize;
+                    if (args) {
+                        ReadArgument(*args, "printerName", &printerName);
+                        ReadArgument(*args, "pageSize", &pageSize);
+                    }
+                    if (printerName.empty() || pageSize.empty()) {
+                        result->Error("INVALID_ARGUMENTS", "Printer name and page size required");
+                        return;
+                    }
+
+                    // null = tidak ada kertas yang cocok di driver
+                    std::string paperName;
+                    if (g_printerCaps->ResolvePaperName(printerName, pageSize, &paperName)) {
+                        result->Success(flutter::EncodableValue(paperName));
+                    }
+                    else {
+                        result->Success();
+                    }
+                }
+                else if (call.method_name() == "rasterizePages") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    RasterizeOptions options;
+
+                    if (args) {
+                        const char* wrong = nullptr;
+                        auto read = [&](const char* key, auto* value) {
+                            if (!wrong && !ReadArgument(*args, key, value)) wrong = key;
+                        };
+                        read("inputPath", &options.inputPath);
+                        read("outputPath", &options.outputPath);
+                        read("startPage", &options.firstPage);
+                        read("endPage", &options.lastPage);
+                        // dpi boleh int atau double dari Dart
+                        int intDpi = 0;
+                        if (ReadArgument(*args, "dpi", &intDpi)) {
+                            if (intDpi > 0) options.dpi = intDpi;
+                        } else {
+                            read("dpi", &options.dpi);
+                        }
+                        read("threads", &options.threadCount);
+                        std::string monoMode;
+                        read("monoMode", &monoMode);
+                        read("bandHeight", &options.bandHeight);
+                        if (wrong) {
+                            result->Error("INVALID_ARGUMENTS", std::string("Argument ") + wrong + " has the wrong type.");
+                            return;
+                        }
+                        options.monoDither = ParseDitherMode(monoMode);
+                    }
+
+                    if (options.inputPath.empty() || options.outputPath.empty() || options.dpi <= 0) {
+                        result->Error("INVALID_ARGUMENTS", "inputPath and outputPath required");
+                        return;
+                    }
+
+                    // Render di background thread agar message loop tetap jalan,
+                    // hasil dikembalikan ke Flutter lewat platform thread.
+                    std::shared_ptr<flutter::MethodResult<>> sharedResult(std::move(result));
+                    std::thread([options, sharedResult]() {
+                        RasterizeStats stats;
+                        std::string error;
+                        bool ok = RasterizePages(options, &stats, &error);
+
+                        LogStatus("Rasterize " + std::to_string(stats.pagesRendered) + " pages with " +
+                            std::to_string(stats.threadsUsed) + " threads in " +
+                            std::to_string((int)stats.elapsedMs) + " ms, mono " + DitherModeName(options.monoDither) +
+                            ", " + std::to_string(stats.outputBytes) + " bytes, peak RSS " +
+                            std::to_string(PeakWorkingSetBytes() / (1024 * 1024)) + " MB" + (ok ? "" : " FAILED: " + error));
+
+                        PostToPlatformThread([ok, stats, error, sharedResult]() {
+                            if (!ok) {
+                                sharedResult->Error("RASTERIZE_FAILED", error);
+                                return;
+                            }
+                            flutter::EncodableMap response = {
+                                {flutter::EncodableValue("pages"), flutter::EncodableValue(stats.pagesRendered)},
+                                {flutter::EncodableValue("threads"), flutter::EncodableValue(stats.threadsUsed)},
+                                {flutter::EncodableValue("elapsedMs"), flutter::EncodableValue(stats.elapsedMs)},
+                                {flutter::EncodableValue("outputBytes"), flutter::EncodableValue(stats.outputBytes)}
+                            };
+                            sharedResult->Success(flutter::EncodableValue(response));
+                        });
+                    }).detach();
+                }
+                else if (call.method_name() == "analyzeDocument") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    std::string filePath;
+                    int threads = 0;
+                    SourceRegistration registration;
+                    if (args) {
+                        ReadArgument(*args, "filePath", &filePath);
+                        ReadArgument(*args, "threads", &threads);
+                        registration = RegisterChannelBytes(*args);
+                        if (registration) filePath = *registration;
+                    }
+
+                    if (filePath.empty()) {
+                        result->Error("INVALID_ARGUMENTS", "filePath or fileBytes required");
+                        return;
+                    }
+
+                    // Sama seperti rasterizePages: dianalisis di background thread,
+                    // registrasi bytes ikut hidup sampai analisis selesai.
+                    std::shared_ptr<flutter::MethodResult<>> sharedResult(std::move(result));
+                    std::thread([filePath, threads, registration, sharedResult]() {
+                        DocumentAnalysis analysis;
+                        AnalyzeStats stats;
+                        std::string error;
+                        bool ok = AnalyzeDocument(filePath, threads, &analysis, &stats, &error);
+
+                        LogStatus("Analyze " + std::to_string(analysis.pages.size()) + " pages (" +
+                            std::to_string(analysis.colorPages) + " colour, " +
+                            std::to_string(analysis.blankPages) + " blank) with " +
+                            std::to_string(stats.threadsUsed) + " threads in " +
+                            std::to_string((int)stats.elapsedMs) + " ms" + (stats.cached ? " (cached)" : "") +
+                            (ok ? "" : " FAILED: " + error));
+
+                        PostToPlatformThread([ok, analysis, stats, error, sharedResult]() {
+                            if (!ok) {
+                                sharedResult->Error("ANALYZE_FAILED", error);
+                                return;
+                            }
+                            flutter::EncodableList pages;
+                            for (const PageAnalysis& page : analysis.pages) {
+                                pages.push_back(flutter::EncodableValue(flutter::EncodableMap{
+                                    {flutter::EncodableValue("page"), flutter::EncodableValue(page.pageIndex + 1)},
+                                    {flutter::EncodableValue("widthPts"), flutter::EncodableValue(page.widthPts)},
+                                    {flutter::EncodableValue("heightPts"), flutter::EncodableValue(page.heightPts)},
+                                    {flutter::EncodableValue("rotation"), flutter::EncodableValue(page.rotation)},
+                                    {flutter::EncodableValue("orientation"), flutter::EncodableValue(page.landscape ? "landscape" : "portrait")},
+                                    {flutter::EncodableValue("color"), flutter::EncodableValue(page.color)},
+                                    {flutter::EncodableValue("blank"), flutter::EncodableValue(page.blank)}
+                                }));
+                            }
+                            flutter::EncodableMap response = {
+                                {flutter::EncodableValue("pages"), flutter::EncodableValue(pages)},
+                                {flutter::EncodableValue("colorPages"), flutter::EncodableValue(analysis.colorPages)},
+                                {flutter::EncodableValue("blankPages"), flutter::EncodableValue(analysis.blankPages)},
+                                {flutter::EncodableValue("cached"), flutter::EncodableValue(stats.cached)},
+                                {flutter::EncodableValue("threads"), flutter::EncodableValue(stats.threadsUsed)},
+                                {flutter::EncodableValue("elapsedMs"), flutter::EncodableValue(stats.elapsedMs)}
+                            };
+                            sharedResult->Success(flutter::EncodableValue(response));
+                        });
+                    }).detach();
+                }
+                else if (call.method_name() == "printSeparator") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    PrintSettings settings;
+                    settings.printJobId = -2;
+                    settings.doubleSided = true;
+                    if (args) {
+                        auto it = args->find(flutter::EncodableValue("printerName"));
+                        if (it != args->end() && std::holds_alternative<std::string>(it->second)) {
+                            settings.printerName = std::get<std::string>(it->second);
+                        }
+                        it = args->find(flutter::EncodableValue("pageSize"));
+                        if (it != args->end() && std::holds_alternative<std::string>(it->second)) {
+                            settings.pageSize = std::get<std::string>(it->second);
+                        }
+                        it = args->find(flutter::EncodableValue("printJobId"));
+                        if (it != args->end() && std::holds_alternative<int>(it->second)) {
+                            settings.printJobId = std::get<int>(it->second);
+                        }
+                        it = args->find(flutter::EncodableValue("doubleSided"));
+                        if (it != args->end() && std::holds_alternative<bool>(it->second)) {
+                            settings.doubleSided = std::get<bool>(it->second);
+                        }
+                    }
+
+                    if (settings.printerName.empty()) {
+                        result->Error("INVALID_ARGUMENTS", "printerName required");
+                        return;
+                    }
+                    if (!SeparatorCache::Shared().loaded()) {
+                        result->Error("SEPARATOR_NOT_LOADED", "Separator PDF is not loaded.");
+                        return;
+                    }
+
+                    // Antri di printer yang sama supaya urutan dengan file transaksi tetap terjaga
+                    auto receivedAt = std::chrono::steady_clock::now();
+                    int jobHandle = g_printExecutor->Submit(settings.printerName, [settings, receivedAt](int handle) {
+                        RunSeparatorJob(handle, settings, receivedAt);
+                    });
+                    flutter::EncodableMap response = {
+                        {flutter::EncodableValue("jobHandle"), flutter::EncodableValue(jobHandle)}
+                    };
+                    result->Success(flutter::EncodableValue(response));
+                }
+                else if (call.method_name() == "printTransaction") {
+                    auto receivedAt = std::chrono::steady_clock::now();
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    const flutter::EncodableList* sectionList = nullptr;
+                    if (args) {
+                        auto it = args->find(flutter::EncodableValue("sections"));
+                        if (it != args->end()) {
+                            sectionList = std::get_if<flutter::EncodableList>(&it->second);
+                        }
+                    }
+
+                    // Urutan bagian dipertahankan per printer; printer berbeda = dokumen spooler berbeda
+                    std::vector<std::pair<std::string, std::vector<TransactionSection>>> groups;
+                    std::vector<SourceRegistration> registrations;
+                    if (sectionList) {
+                        for (const auto& sectionVal : *sectionList) {
+                            const auto* sectionArgs = std::get_if<flutter::EncodableMap>(&sectionVal);
+                            if (!sectionArgs) continue;
+
+                            TransactionSection section;
+                            std::string type = "document";
+                            ReadArgument(*sectionArgs, "type", &type);
+                            section.type = type == "separator"
+                                ? TransactionSection::Type::kSeparator
+                                : TransactionSection::Type::kDocument;
+                            ReadArgument(*sectionArgs, "filePath", &section.filePath);
+                            SourceRegistration registration = RegisterChannelBytes(*sectionArgs);
+                            if (registration) {
+                                section.filePath = *registration;
+                                registrations.push_back(registration);
+                            }
+
+                            PrintSettings& settings = section.settings;
+                            std::string wrongArgument;
+                            if (!ReadPrintSettings(*sectionArgs, &settings, &wrongArgument)) {
+                                result->Error("INVALID_ARGUMENTS", "Section argument " + wrongArgument + " has the wrong type.");
+                                return;
+                            }
+
+                            if (settings.printerName.empty() ||
+                                (section.type == TransactionSection::Type::kDocument && section.filePath.empty())) {
+                                result->Error("INVALID_ARGUMENTS", "Every section needs printerName, documents also filePath or fileBytes.");
+                                return;
+                            }
+
+                            auto group = std::find_if(groups.begin(), groups.end(),
+                                [&](const auto& entry) { return entry.first == settings.printerName; });
+                            if (group == groups.end()) {
+                                groups.emplace_back(settings.printerName, std::vector<TransactionSection>());
+                                group = groups.end() - 1;
+                            }
+                            group->second.push_back(section);
+                        }
+                    }
+
+                    if (groups.empty()) {
+                        result->Error("INVALID_ARGUMENTS", "sections required");
+                        return;
+                    }
+
+                    flutter::EncodableList jobHandles;
+                    for (auto& group : groups) {
+                        std::vector<TransactionSection> sections = std::move(group.second);
+                        int jobHandle = g_printExecutor->Submit(group.first, [sections, registrations, receivedAt](int handle) {
+                            RunTransactionJob(handle, sections, receivedAt);
+                        });
+                        jobHandles.push_back(flutter::EncodableValue(jobHandle));
+                    }
+                    flutter::EncodableMap response = {
+                        {flutter::EncodableValue("jobHandles"), flutter::EncodableValue(jobHandles)}
+                    };
+                    result->Success(flutter::EncodableValue(response));
+                }
+                else if (call.method_name() == "beginStream") {
+                    // PDF yang masih diunduh: Dart mengirim potongan lewat appendStream,
+                    // printPDF dengan streamId bisa dipanggil sebelum unduhan selesai
+                    int64_t expectedLength = -1;
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    if (args) {
+                        auto it = args->find(flutter::EncodableValue("expectedLength"));
+                        if (it != args->end() && (std::holds_alternative<int32_t>(it->second) ||
+                            std::holds_alternative<int64_t>(it->second))) {
+                            expectedLength = it->second.LongValue();
+                        }
+                    }
+                    auto buffer = std::make_shared<StreamingBuffer>(expectedLength);
+                    std::string source = DocumentCache::Shared().RegisterStream(buffer);
+                    SourceRegistration registration(new std::string(source), [](const std::string* registered) {
+                        DocumentCache::Shared().UnregisterStream(*registered);
+                        delete registered;
+                    });
+                    g_openStreams[source] = OpenStream{buffer, registration};
+                    result->Success(flutter::EncodableValue(source));
+                }
+                else if (call.method_name() == "appendStream") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    std::string streamId;
+                    const std::vector<uint8_t>* bytes = nullptr;
+                    if (args) {
+                        ReadArgument(*args, "streamId", &streamId);
+                        auto it = args->find(flutter::EncodableValue("bytes"));
+                        if (it != args->end()) {
+                            bytes = std::get_if<std::vector<uint8_t>>(&it->second);
+                        }
+                    }
+                    auto stream = g_openStreams.find(streamId);
+                    if (stream == g_openStreams.end() || !bytes) {
+                        result->Error("STREAM_NOT_FOUND", "Unknown or closed stream: " + streamId);
+                        return;
+                    }
+                    stream->second.buffer->Append(bytes->data(), bytes->size());
+                    result->Success();
+                }
+                else if (call.method_name() == "endStream") {
+                    const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+                    std::string streamId;
+                    bool failed = false;
+                    if (args) {
+                        ReadArgument(*args, "streamId", &streamId);
+                        ReadArgument(*args, "failed", &failed);
+                    }
+                    auto stream = g_openStreams.find(streamId);
+                    if (stream != g_openStreams.end()) {
+                        if (failed) {
+                            stream->second.buffer->Fail();
+                        } else {
+                            stream->second.buffer->Finish();
+                        }
+                        LogStatus("Stream " + streamId + (failed ? " failed after " : " complete, ") +
+                            std::to_string(stream->second.buffer->received()) + " bytes");
+                        // Job yang sudah menerima streamId tetap memegang registrasinya
+                        g_openStreams.erase(stream);
+                    }
+                    result->Success();
+                }
+                else if (call.method_name() == "getDocumentCacheStats") {
+                    DocumentCacheStats stats = DocumentCache::Shared().stats();
+                    int64_t lookups = stats.hits + stats.misses;
+                    flutter::EncodableMap response = {
+                        {flutter::EncodableValue("hits"), flutter::EncodableValue(stats.hits)},
+                        {flutter::EncodableValue("misses"), flutter::EncodableValue(stats.misses)},
+                        {flutter::EncodableValue("evictions"), flutter::EncodableValue(stats.evictions)},
+                        {flutter::EncodableValue("hitRate"), flutter::EncodableValue(lookups > 0 ? (double)stats.hits / lookups : 0.0)},
+                        {flutter::EncodableValue("parseMs"), flutter::EncodableValue(stats.parseMs)},
+                        {flutter::EncodableValue("savedMs"), flutter::EncodableValue(stats.savedMs)},
+                        {flutter::EncodableValue("idleDocuments"), flutter::EncodableValue((int64_t)stats.idleDocuments)},
+                        {flutter::EncodableValue("idleBytes"), flutter::EncodableValue((int64_t)stats.idleBytes)},
+                        {flutter::EncodableValue("memoryLoads"), flutter::EncodableValue(stats.memoryLoads)},
+                        {flutter::EncodableValue("mappedLoads"), flutter::EncodableValue(stats.mappedLoads)},
+                        {flutter::EncodableValue("streamLoads"), flutter::EncodableValue(stats.streamLoads)},
+                        {flutter::EncodableValue("progressiveLoads"), flutter::EncodableValue(stats.progressiveLoads)}
+                    };
+                    result->Success(flutter::EncodableValue(response));
+                }
+                else if (call.method_name() == "getMarginCacheStats") {
+                    MarginCacheStats stats = MarginCache::Shared().stats();
+                    flutter::EncodableMap response = {
+                        {flutter::EncodableValue("hits"), flutter::EncodableValue(stats.hits)},
+                        {flutter::EncodableValue("misses"), flutter::EncodableValue(stats.misses)},
+                        {flutter::EncodableValue("evictions"), flutter::EncodableValue(stats.evictions)},
+                        {flutter::EncodableValue("entries"), flutter::EncodableValue((int64_t)stats.entries)}
+                    };
+                    result->Success(flutter::EncodableValue(response));
+                }
                 else {
                     OutputDebugStringA("Metode tidak diimplementasikan.\\n");
                     result->NotImplemented();
@@ -886,35 +1378,20 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
     ::MSG msg;
     while (::GetMessage(&msg, nullptr, 0, 0)) {
         if (msg.message == WM_FLUTTER_PRINT_EVENT) {
-            PrintEventData* data = (PrintEventData*)msg.wParam;
-
-            if (data && g_channel) {
-                if (data->type == 1) { // Job Completed
-                    flutter::EncodableMap args = {
-                        {flutter::EncodableValue("printJobId"), flutter::EncodableValue(data->printJobId)},
-                        {flutter::EncodableValue("totalPages"), flutter::EncodableValue(data->totalPages)}
-                    };
-                    g_channel->InvokeMethod("onPrintJobCompleted", std::make_unique<flutter::EncodableValue>(args));
-                }
-                else if (data->type == 2) { // Status Update
-                    g_channel->InvokeMethod("onPrinterStatus", std::make_unique<flutter::EncodableValue>(data->statusMsg));
-                }
-                else if (data->type == 3) { // Job Failed / Cancelled
-                    flutter::EncodableMap args = {
-                            {flutter::EncodableValue("printJobId"), flutter::EncodableValue(data->printJobId)},
-                            {flutter::EncodableValue("error"), flutter::EncodableValue(data->statusMsg)}
-                    };
-                    g_channel->InvokeMethod("onPrintJobFailed", std::make_unique<flutter::EncodableValue>(args));
-                }
-                else if (data->type == 4) { // Progress Update dari PrintMonitor
-                    flutter::EncodableMap args = {
-                            {flutter::EncodableValue("status"), flutter::EncodableValue(data->statusMsg)},
-                            {flutter::EncodableValue("printJobId"), flutter::EncodableValue(data->printJobId)}
-                    };
-                    g_channel->InvokeMethod("onPrintProgress", std::make_unique<flutter::EncodableValue>(args));
-                }
-
-                delete data;
+            FlushPrintEvents();
+            continue;
+        }
+        if (msg.message == WM_TIMER && g_printEventTimer && msg.wParam == g_printEventTimer) {
+            ::KillTimer(g_mainWindowHandle, g_printEventTimer);
+            g_printEventTimer = 0;
+            FlushPrintEvents();
+            continue;
+        }
+        if (msg.message == WM_FLUTTER_TASK_EVENT) {
+            auto* task = (std::function<void()>*)msg.wParam;
+            if (task) {
+                (*task)();
+                delete task;
             }
             continue;
         }
@@ -922,6 +1399,15 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
         ::DispatchMessage(&msg);
     }
 
+    // Tunggu job yang sedang di-spool selesai, sisa antrian dibuang
+    FailOpenStreams();
+    g_printExecutor.reset();
+    g_spoolWatcher.reset();
+    g_printerStatus.reset();
+    g_printerSessions.reset();
+    g_printerCaps.reset();
+    DocumentCache::Shared().Clear();
+
     ::CoUninitialize();
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "margin_analyzer.h"
+
+#include <cairo/cairo.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "ink_scanner.h"
+
+namespace {
+
+struct PixelRect {
+  int x0 = 0;
+  int y0 = 0;
+  int x1 = 0;
+  int y1 = 0;
+
+  bool IsEmpty() const { return x1 <= x0 || y1 <= y0; }
+
+  PixelRect Intersect(const PixelRect& other) const {
+    PixelRect r;
+    r.x0 = std::max(x0, other.x0);
+    r.y0 = std::max(y0, other.y0);
+    r.x1 = std::min(x1, other.x1);
+    r.y1 = std::min(y1, other.y1);
+    return r;
+  }
+};
+
+// Replays |recording| into a white image covering only |rect|. The small
+// surface acts as the clip, so cairo skips every drawing operation outside
+// the strip instead of rasterizing the whole page.
+bool StripHasInk(cairo_surface_t* recording, const PixelRect& rect) {
+  int w = rect.x1 - rect.x0;
+  int h = rect.y1 - rect.y0;
+  cairo_surface_t* strip = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+  cairo_t* cr = cairo_create(strip);
+
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  cairo_set_source_surface(cr, recording, -rect.x0, -rect.y0);
+  cairo_paint(cr);
+
+  cairo_surface_flush(strip);
+  bool hasInk = RegionHasInk(cairo_image_surface_get_data(strip),
+                             cairo_image_surface_get_stride(strip), w, h,
+                             CAIRO_FORMAT_RGB24);
+  cairo_destroy(cr);
+  cairo_surface_destroy(strip);
+  return hasInk;
+}
+
+}  // namespace
+
+bool HasContentInMargins(PopplerPage* page, double pdfW, double pdfH, double mL, double mT, double mR, double mB) {
+  // Satu piksel = satu point, sama seperti metode raster sebelumnya
+  int w = (int)pdfW;
+  int h = (int)pdfH;
+  if (w <= 0 || h <= 0) return false;
+
+  int iML = std::min((int)mL, w);
+  int iMT = std::min((int)mT, h);
+  int iMR = std::min((int)mR, w);
+  int iMB = std::min((int)mB, h);
+
+  const PixelRect strips[4] = {
+      {0, 0, iML, h},      // kiri
+      {0, 0, w, iMT},      // atas
+      {w - iMR, 0, w, h},  // kanan
+      {0, h - iMB, w, h},  // bawah
+  };
+
+  // Tahap 1: rekam operasi gambar halaman (tanpa rasterisasi) dan ambil batas
+  // tinta vektornya. Batas ini mencakup teks, gambar, path dan anotasi.
+  cairo_surface_t* recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, nullptr);
+  cairo_t* cr = cairo_create(recording);
+  poppler_page_render(page, cr);
+  cairo_destroy(cr);
+
+  double inkX = 0, inkY = 0, inkW = 0, inkH = 0;
+  cairo_recording_surface_ink_extents(recording, &inkX, &inkY, &inkW, &inkH);
+
+  PixelRect ink;
+  if (inkW > 0 && inkH > 0) {
+    ink.x0 = (int)std::floor(inkX);
+    ink.y0 = (int)std::floor(inkY);
+    ink.x1 = (int)std::ceil(inkX + inkW);
+    ink.y1 = (int)std::ceil(inkY + inkH);
+  }
+
+  // Tahap 2: hanya bagian margin yang tersentuh batas tinta yang dirasterisasi.
+  // Halaman yang kontennya jelas di dalam area aman selesai tanpa raster sama sekali.
+  bool hasContent = false;
+  int stripsRasterized = 0;
+  for (const PixelRect& strip : strips) {
+    PixelRect region = strip.Intersect(ink);
+    if (region.IsEmpty()) continue;
+    stripsRasterized++;
+    if (StripHasInk(recording, region)) {
+      hasContent = true;
+      break;
+    }
+  }
+  cairo_surface_destroy(recording);
+
+  g_debug("[Margin] page %d: %s (%d strip raster)", poppler_page_get_index(page),
+          hasContent ? "content in margins" : "clear", stripsRasterized);
+
+  return hasContent;
+}
@@ -0,0 +1,29 @@
+#ifndef RUNNER_MARGIN_ANALYZER_H_
+#define RUNNER_MARGIN_ANALYZER_H_
+
+#include <poppler/glib/poppler.h>
+
+// Hardware (unprintable) margins of the target paper, in PDF points.
+struct MarginBox {
+  double left = 0.0;
+  double top = 0.0;
+  double right = 0.0;
+  double bottom = 0.0;
+
+  bool IsEmpty() const {
+    return left <= 0.0 && top <= 0.0 && right <= 0.0 && bottom <= 0.0;
+  }
+};
+
+// Returns true if any ink of |page| (pdfW x pdfH points) lands inside the
+// hardware margins, in which case the page has to be printed fit-to-page
+// instead of borderless.
+//
+// The page is first recorded (not rasterized) to get the ink extents of all
+// its text, images, paths and annotations; only the margin strips those
+// extents reach are rasterized. linux/test/margin_analyzer_test.cc checks the
+// decisions against a full-page raster over a corpus of pages.
+bool HasContentInMargins(PopplerPage* page, double pdfW, double pdfH,
+                         double mL, double mT, double mR, double mB);
+
+#endif  // RUNNER_MARGIN_ANALYZER_H_
@@ -0,0 +1,195 @@
+#include "margin_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+constexpr char kCacheHeader[] = "hlaprint-margin-cache 1";
+
+struct FileHashMemo {
+  uintmax_t size = 0;
+  std::filesystem::file_time_type modified;
+  uint64_t hash = 0;
+};
+
+std::mutex g_hashMemoMutex;
+std::unordered_map<std::string, FileHashMemo> g_hashMemo;
+
+}  // namespace
+
+bool MarginCacheKey::operator==(const MarginCacheKey& other) const {
+  return contentHash == other.contentHash && pageIndex == other.pageIndex &&
+         left == other.left && top == other.top && right == other.right &&
+         bottom == other.bottom;
+}
+
+MarginCacheKey MakeMarginCacheKey(uint64_t contentHash, int pageIndex,
+                                  const MarginBox& margins) {
+  MarginCacheKey key;
+  key.contentHash = contentHash;
+  key.pageIndex = pageIndex;
+  key.left = (int)margins.left;
+  key.top = (int)margins.top;
+  key.right = (int)margins.right;
+  key.bottom = (int)margins.bottom;
+  return key;
+}
+
+size_t MarginCache::KeyHash::operator()(const MarginCacheKey& key) const {
+  uint64_t h = key.contentHash;
+  for (int v : {key.pageIndex, key.left, key.top, key.right, key.bottom}) {
+    h = (h ^ (uint32_t)v) * kFnvPrime;
+  }
+  return (size_t)h;
+}
+
+MarginCache& MarginCache::Shared() {
+  static MarginCache* cache = new MarginCache();
+  return *cache;
+}
+
+void MarginCache::Open(const std::string& path, size_t maxEntries) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  path_ = path;
+  max_entries_ = maxEntries > 0 ? maxEntries : 1;
+
+  std::ifstream in(std::filesystem::u8path(path));
+  std::string line;
+  if (!in || !std::getline(in, line) || line != kCacheHeader) return;
+
+  // File disimpan dari yang paling baru dipakai, jadi urutan LRU tetap sama
+  while (std::getline(in, line) && lru_.size() < max_entries_) {
+    std::istringstream fields(line);
+    Entry entry;
+    int decision = 0;
+    fields >> std::hex >> entry.key.contentHash >> std::dec >> entry.key.pageIndex >>
+        entry.key.left >> entry.key.top >> entry.key.right >> entry.key.bottom >> decision;
+    if (fields.fail() || index_.count(entry.key)) continue;
+    entry.contentInMargins = decision != 0;
+    lru_.push_back(entry);
+    index_[entry.key] = std::prev(lru_.end());
+  }
+  stats_.entries = lru_.size();
+}
+
+bool MarginCache::Lookup(const MarginCacheKey& key, bool* contentInMargins) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    stats_.misses++;
+    return false;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  *contentInMargins = it->second->contentInMargins;
+  stats_.hits++;
+  return true;
+}
+
+void MarginCache::Store(const MarginCacheKey& key, bool contentInMargins) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    it->second->contentInMargins = contentInMargins;
+    lru_.splice(lru_.begin(), lru_, it->second);
+  } else {
+    lru_.push_front(Entry{key, contentInMargins});
+    index_[key] = lru_.begin();
+    EvictLocked();
+  }
+  stats_.entries = lru_.size();
+  dirty_ = true;
+}
+
+void MarginCache::EvictLocked() {
+  while (lru_.size() > max_entries_) {
+    index_.erase(lru_.back().key);
+    lru_.pop_back();
+    stats_.evictions++;
+  }
+}
+
+void MarginCache::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!dirty_ || path_.empty()) return;
+
+  // Tulis ke file sementara lalu rename, supaya file cache tidak pernah setengah jadi
+  std::filesystem::path target = std::filesystem::u8path(path_);
+  std::filesystem::path temp = target;
+  temp += ".tmp";
+  std::error_code ec;
+  std::filesystem::create_directories(target.parent_path(), ec);
+  {
+    std::ofstream out(temp, std::ios::trunc);
+    if (!out) return;
+    out << kCacheHeader << "\n";
+    for (const Entry& entry : lru_) {
+      out << std::hex << entry.key.contentHash << std::dec << " " << entry.key.pageIndex
+          << " " << entry.key.left << " " << entry.key.top << " " << entry.key.right
+          << " " << entry.key.bottom << " " << (entry.contentInMargins ? 1 : 0) << "\n";
+    }
+    if (!out) return;
+  }
+  std::filesystem::rename(temp, target, ec);
+  if (!ec) dirty_ = false;
+}
+
+MarginCacheStats MarginCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+uint64_t HashContent(const void* data, size_t size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t h = kFnvOffset;
+  for (size_t i = 0; i < size; i++) {
+    h = (h ^ bytes[i]) * kFnvPrime;
+  }
+  return h != 0 ? h : kFnvOffset;
+}
+
+bool HashFileContent(const std::string& path, uint64_t* hash) {
+  std::filesystem::path file = std::filesystem::u8path(path);
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(file, ec);
+  if (ec) return false;
+  std::filesystem::file_time_type modified = std::filesystem::last_write_time(file, ec);
+  if (ec) return false;
+
+  {
+    std::lock_guard<std::mutex> lock(g_hashMemoMutex);
+    auto it = g_hashMemo.find(path);
+    if (it != g_hashMemo.end() && it->second.size == size &&
+        it->second.modified == modified) {
+      *hash = it->second.hash;
+      return true;
+    }
+  }
+
+  std::ifstream in(file, std::ios::binary);
+  if (!in) return false;
+  uint64_t h = kFnvOffset;
+  std::vector<char> buffer(1 << 16);
+  while (in) {
+    in.read(buffer.data(), (std::streamsize)buffer.size());
+    std::streamsize n = in.gcount();
+    for (std::streamsize i = 0; i < n; i++) {
+      h = (h ^ (unsigned char)buffer[i]) * kFnvPrime;
+    }
+  }
+  // Hash 0 dipakai sebagai "tanpa cache" oleh pemanggil
+  if (h == 0) h = kFnvOffset;
+
+  std::lock_guard<std::mutex> lock(g_hashMemoMutex);
+  // File batch sementara selalu punya path baru, jangan biarkan memo tumbuh terus
+  if (g_hashMemo.size() >= 256) g_hashMemo.clear();
+  g_hashMemo[path] = FileHashMemo{size, modified, h};
+  *hash = h;
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef RUNNER_MARGIN_CACHE_H_
+#define RUNNER_MARGIN_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "margin_analyzer.h"
+
+// Identifies one margin decision: the document content, the page and the
+// hardware margins truncated to whole points, exactly as HasContentInMargins
+// uses them.
+struct MarginCacheKey {
+  uint64_t contentHash = 0;
+  int pageIndex = 0;
+  int left = 0;
+  int top = 0;
+  int right = 0;
+  int bottom = 0;
+
+  bool operator==(const MarginCacheKey& other) const;
+};
+
+MarginCacheKey MakeMarginCacheKey(uint64_t contentHash, int pageIndex,
+                                  const MarginBox& margins);
+
+struct MarginCacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t evictions = 0;
+  size_t entries = 0;
+};
+
+// Bounded LRU of fit-to-page/borderless decisions, persisted to a small text
+// file so reprints of the separator, invoice templates and repeat customer
+// files skip margin analysis entirely. Thread-safe; pipeline workers share
+// the one instance returned by Shared().
+class MarginCache {
+ public:
+  // The instance the print pipeline uses. Tests make their own.
+  static MarginCache& Shared();
+  MarginCache() = default;
+
+  // Prevent copying.
+  MarginCache(const MarginCache&) = delete;
+  MarginCache& operator=(const MarginCache&) = delete;
+
+  // Loads previously saved entries from |path| and saves there from now on.
+  // Without Open the cache only lives in memory.
+  void Open(const std::string& path, size_t maxEntries);
+
+  bool Lookup(const MarginCacheKey& key, bool* contentInMargins);
+  void Store(const MarginCacheKey& key, bool contentInMargins);
+
+  // Writes the entries to disk if anything changed since the last save.
+  void Flush();
+
+  MarginCacheStats stats();
+
+ private:
+  struct KeyHash {
+    size_t operator()(const MarginCacheKey& key) const;
+  };
+  struct Entry {
+    MarginCacheKey key;
+    bool contentInMargins = false;
+  };
+
+  void EvictLocked();
+
+  std::mutex mutex_;
+  std::string path_;
+  size_t max_entries_ = 4096;
+  // Most recently used at the front.
+  std::list<Entry> lru_;
+  std::unordered_map<MarginCacheKey, std::list<Entry>::iterator, KeyHash> index_;
+  bool dirty_ = false;
+  MarginCacheStats stats_;
+};
+
+// 64-bit FNV-1a hash of a buffer already in memory, never 0.
+uint64_t HashContent(const void* data, size_t size);
+
+// 64-bit FNV-1a hash of the file's bytes. Results are memoised by path, size
+// and modification time, so reprinting an unchanged file does not read it
+// again. Returns false if the file cannot be read.
+bool HashFileContent(const std::string& path, uint64_t* hash);
+
+#endif  // RUNNER_MARGIN_CACHE_H_
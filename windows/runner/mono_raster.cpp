@@ -0,0 +1,199 @@
+#include "mono_raster.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MONO_RASTER_SSE2 1
+#endif
+
+namespace {
+
+constexpr uint8_t kBayer8[8][8] = {
+    {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+    {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+std::array<uint8_t, 256> MakeReverseTable() {
+  std::array<uint8_t, 256> table{};
+  for (int i = 0; i < 256; ++i) {
+    uint8_t reversed = 0;
+    for (int bit = 0; bit < 8; ++bit) {
+      if (i & (1 << bit)) reversed |= (uint8_t)(0x80 >> bit);
+    }
+    table[i] = reversed;
+  }
+  return table;
+}
+
+const std::array<uint8_t, 256>& ReverseTable() {
+  static const std::array<uint8_t, 256> table = MakeReverseTable();
+  return table;
+}
+
+// Rec. 601 luma of one row of xRGB pixels, in 8-bit fixed point.
+void LumaRow(const uint32_t* pixels, int width, uint8_t* luma) {
+  for (int x = 0; x < width; ++x) {
+    uint32_t p = pixels[x];
+    luma[x] = (uint8_t)((77 * ((p >> 16) & 0xFF) + 150 * ((p >> 8) & 0xFF) + 29 * (p & 0xFF)) >> 8);
+  }
+}
+
+// Sets the bit of every pixel with luma >= its threshold (white). Threshold
+// and ordered dithering only differ in |thresholds|.
+void PackRow(const uint8_t* luma, const uint8_t* thresholds, int width, uint8_t* out) {
+  int x = 0;
+#ifdef MONO_RASTER_SSE2
+  const std::array<uint8_t, 256>& reverse = ReverseTable();
+  for (; x + 16 <= width; x += 16) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + x));
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds + x));
+    // l >= t  <=>  max(l, t) == l (tanpa perbandingan unsigned di SSE2)
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(l, t), l));
+    // movemask: bit 0 = piksel paling kiri, DIB: bit 7
+    out[x / 8] = reverse[mask & 0xFF];
+    out[x / 8 + 1] = reverse[(mask >> 8) & 0xFF];
+  }
+#endif
+  for (; x < width; ++x) {
+    if (luma[x] >= thresholds[x]) out[x >> 3] |= (uint8_t)(0x80 >> (x & 7));
+  }
+}
+
+// Serpentine Floyd-Steinberg. |current| and |next| hold the error carried
+// into this and the next row, times 16, with one guard cell on each side.
+void DiffuseRow(const uint8_t* luma, int width, bool leftToRight,
+                std::vector<int>* current, std::vector<int>* next, uint8_t* out) {
+  std::fill(next->begin(), next->end(), 0);
+  int dir = leftToRight ? 1 : -1;
+  for (int i = 0; i < width; ++i) {
+    int x = leftToRight ? i : width - 1 - i;
+    int value = luma[x] + (*current)[x + 1] / 16;
+    bool white = value >= 128;
+    if (white) out[x >> 3] |= (uint8_t)(0x80 >> (x & 7));
+    int error = value - (white ? 255 : 0);
+    (*current)[x + 1 + dir] += error * 7;
+    (*next)[x + 1 - dir] += error * 3;
+    (*next)[x + 1] += error * 5;
+    (*next)[x + 1 + dir] += error;
+  }
+  std::swap(*current, *next);
+}
+
+bool IsLittleEndian() {
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+}  // namespace
+
+DitherMode ParseDitherMode(const std::string& name) {
+  if (name == "threshold") return DitherMode::kThreshold;
+  if (name == "ordered") return DitherMode::kOrdered;
+  if (name == "diffusion") return DitherMode::kErrorDiffusion;
+  return DitherMode::kOff;
+}
+
+const char* DitherModeName(DitherMode mode) {
+  switch (mode) {
+    case DitherMode::kThreshold:
+      return "threshold";
+    case DitherMode::kOrdered:
+      return "ordered";
+    case DitherMode::kErrorDiffusion:
+      return "diffusion";
+    case DitherMode::kOff:
+      break;
+  }
+  return "off";
+}
+
+bool ConvertToBilevel(cairo_surface_t* surface, DitherMode mode, BilevelImage* out,
+                      DitherState* state) {
+  if (!surface || mode == DitherMode::kOff ||
+      cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+    return false;
+  }
+  cairo_format_t format = cairo_image_surface_get_format(surface);
+  if (format != CAIRO_FORMAT_RGB24 && format != CAIRO_FORMAT_ARGB32) return false;
+
+  cairo_surface_flush(surface);
+  int width = cairo_image_surface_get_width(surface);
+  int height = cairo_image_surface_get_height(surface);
+  int srcStride = cairo_image_surface_get_stride(surface);
+  const unsigned char* src = cairo_image_surface_get_data(surface);
+  if (!src || width <= 0 || height <= 0) return false;
+
+  out->width = width;
+  out->height = height;
+  out->stride = ((width + 31) / 32) * 4;
+  out->bits.assign((size_t)out->stride * height, 0);
+
+  int firstRow = state ? state->row : 0;
+  std::vector<uint8_t> luma(width);
+  // Ambang per piksel: konstan untuk threshold, pola Bayer per baris untuk ordered
+  std::vector<uint8_t> thresholds;
+  if (mode == DitherMode::kOrdered) {
+    thresholds.resize((size_t)8 * width);
+    for (int row = 0; row < 8; ++row) {
+      for (int x = 0; x < width; ++x) {
+        thresholds[(size_t)row * width + x] = (uint8_t)(kBayer8[row][x & 7] * 4 + 2);
+      }
+    }
+  } else if (mode == DitherMode::kThreshold) {
+    thresholds.assign(width, 128);
+  }
+  std::vector<int> current, next;
+  if (mode == DitherMode::kErrorDiffusion) {
+    current.assign(width + 2, 0);
+    next.assign(width + 2, 0);
+    if (state && state->error.size() == current.size()) current = state->error;
+  }
+
+  for (int y = 0; y < height; ++y) {
+    LumaRow(reinterpret_cast<const uint32_t*>(src + (size_t)y * srcStride), width, luma.data());
+    uint8_t* row = out->bits.data() + (size_t)y * out->stride;
+    if (mode == DitherMode::kErrorDiffusion) {
+      DiffuseRow(luma.data(), width, (firstRow + y) % 2 == 0, &current, &next, row);
+    } else {
+      const uint8_t* rowThresholds =
+          thresholds.data() + (mode == DitherMode::kOrdered ? (size_t)((firstRow + y) & 7) * width : 0);
+      PackRow(luma.data(), rowThresholds, width, row);
+    }
+  }
+  if (state) {
+    state->row += height;
+    state->error = std::move(current);
+  }
+  return true;
+}
+
+cairo_surface_t* CreateInkMask(const BilevelImage& image) {
+  cairo_surface_t* mask = cairo_image_surface_create(CAIRO_FORMAT_A1, image.width, image.height);
+  if (cairo_surface_status(mask) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(mask);
+    return nullptr;
+  }
+  cairo_surface_flush(mask);
+  unsigned char* dst = cairo_image_surface_get_data(mask);
+  int dstStride = cairo_image_surface_get_stride(mask);
+  int rowBytes = std::min(dstStride, image.stride);
+  // A1 mengikuti endianness: di little-endian piksel pertama ada di bit terendah
+  bool reverseBits = IsLittleEndian();
+  const std::array<uint8_t, 256>& reverse = ReverseTable();
+  for (int y = 0; y < image.height; ++y) {
+    const uint8_t* src = image.bits.data() + (size_t)y * image.stride;
+    unsigned char* row = dst + (size_t)y * dstStride;
+    for (int i = 0; i < rowBytes; ++i) {
+      uint8_t ink = (uint8_t)~src[i];
+      row[i] = reverseBits ? reverse[ink] : ink;
+    }
+  }
+  cairo_surface_mark_dirty(mask);
+  return mask;
+}
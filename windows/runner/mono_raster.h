@@ -0,0 +1,57 @@
+#ifndef RUNNER_MONO_RASTER_H_
+#define RUNNER_MONO_RASTER_H_
+
+#include <cairo/cairo.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How a black-and-white page is reduced to one bit per pixel.
+enum class DitherMode {
+  // Mono fast path disabled: pages keep going out as colour/vector data.
+  kOff,
+  // Fixed 50% threshold. Sharpest for text and line art.
+  kThreshold,
+  // 8x8 Bayer matrix. Keeps grey fills and photos readable, cheap.
+  kOrdered,
+  // Floyd-Steinberg. Best for photos and scans, serial per page.
+  kErrorDiffusion,
+};
+
+// "threshold", "ordered" or "diffusion"; anything else is kOff.
+DitherMode ParseDitherMode(const std::string& name);
+const char* DitherModeName(DitherMode mode);
+
+// One bit per pixel, rows top-down and padded to 32 bits as a Windows DIB
+// expects. The most significant bit is the leftmost pixel; a set bit is
+// white (palette index 1), a clear bit is black.
+struct BilevelImage {
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  std::vector<uint8_t> bits;
+};
+
+// Dithering carried from one band of a page to the next, so band edges do
+// not show. Use a fresh one per page.
+struct DitherState {
+  // Page row of the next band's first row (Bayer phase, scan direction).
+  int row = 0;
+  // Error diffused into that row, times 16.
+  std::vector<int> error;
+};
+
+// Reduces an RGB24/ARGB32 |surface| to one bit per pixel by luminance.
+// Returns false if |surface| is not such an image or |mode| is kOff. With
+// |state|, |surface| is taken as the next band of a page and |state| is
+// advanced past it.
+bool ConvertToBilevel(cairo_surface_t* surface, DitherMode mode, BilevelImage* out,
+                      DitherState* state = nullptr);
+
+// |image| as a CAIRO_FORMAT_A1 surface whose set pixels are the black ones,
+// for sinks that draw through cairo (mask it with a black source; cairo PDF
+// emits it as a 1-bit image mask). Caller owns.
+cairo_surface_t* CreateInkMask(const BilevelImage& image);
+
+#endif  // RUNNER_MONO_RASTER_H_
@@ -0,0 +1,174 @@
+#include "page_rasterizer.h"
+
+#include <cairo/cairo-pdf.h>
+#include <glib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+#include "document_cache.h"
+#include "print_pipeline.h"
+#include "raster_band.h"
+
+cairo_surface_t* RenderPageToImage(PopplerPage* page, double dpi) {
+  double widthPts = 0.0, heightPts = 0.0;
+  poppler_page_get_size(page, &widthPts, &heightPts);
+
+  double scale = dpi / 72.0;
+  int w = std::max(1, (int)std::ceil(widthPts * scale));
+  int h = std::max(1, (int)std::ceil(heightPts * scale));
+
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(surface);
+    return nullptr;
+  }
+
+  cairo_t* cr = cairo_create(surface);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  cairo_scale(cr, scale, scale);
+  poppler_page_render_for_printing(page, cr);
+  cairo_destroy(cr);
+
+  cairo_surface_flush(surface);
+  return surface;
+}
+
+cairo_surface_t* RenderPageToInkMask(PopplerPage* page, double dpi, DitherMode mode,
+                                     int bandRows) {
+  double widthPts = 0.0, heightPts = 0.0;
+  poppler_page_get_size(page, &widthPts, &heightPts);
+
+  double scale = dpi / 72.0;
+  RasterBands bands((int)std::ceil(widthPts), (int)std::ceil(heightPts), scale, scale, bandRows);
+  BilevelImage pageBits;
+  pageBits.width = bands.width();
+  pageBits.height = bands.height();
+  pageBits.stride = ((pageBits.width + 31) / 32) * 4;
+  pageBits.bits.assign((size_t)pageBits.stride * pageBits.height, 0);
+
+  DitherState dither;
+  for (int band = 0; band < bands.band_count(); ++band) {
+    cairo_surface_t* surface = bands.CreateBandSurface(band);
+    if (!surface) return nullptr;
+    cairo_t* cr = cairo_create(surface);
+    poppler_page_render_for_printing(page, cr);
+    cairo_destroy(cr);
+
+    BilevelImage bandBits;
+    bool converted = ConvertToBilevel(surface, mode, &bandBits, &dither);
+    cairo_surface_destroy(surface);
+    if (!converted) return nullptr;
+    std::copy(bandBits.bits.begin(), bandBits.bits.end(),
+              pageBits.bits.begin() + (size_t)bands.band_top(band) * pageBits.stride);
+  }
+  return CreateInkMask(pageBits);
+}
+
+bool RasterizePages(const RasterizeOptions& options, RasterizeStats* stats,
+                    std::string* error) {
+  auto startTime = std::chrono::steady_clock::now();
+
+  // Dokumen langsung dikembalikan ke cache supaya bisa dipakai ulang worker
+  DocumentLease document = DocumentCache::Shared().Acquire(options.inputPath, error);
+  if (!document) return false;
+  int numPages = document.page_count();
+  document.Reset();
+
+  int firstIndex = std::max(options.firstPage, 1) - 1;
+  int lastIndex = options.lastPage > 0 ? std::min(options.lastPage, numPages) - 1
+                                       : numPages - 1;
+  if (firstIndex > lastIndex) {
+    if (error) *error = "Requested page range is outside the document.";
+    return false;
+  }
+
+  int threadCount = options.threadCount;
+  if (threadCount <= 0) {
+    threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  PipelineOptions pipelineOptions;
+  pipelineOptions.filePath = options.inputPath;
+  for (int i = firstIndex; i <= lastIndex; ++i) {
+    pipelineOptions.pageIndices.push_back(i);
+  }
+  pipelineOptions.workerCount = threadCount;
+  // Batas berapa halaman boleh dirender di depan writer, supaya memori
+  // tidak membengkak untuk dokumen ratusan halaman di 300 dpi.
+  pipelineOptions.depth = threadCount * 2;
+  pipelineOptions.rasterDpi = (int)options.dpi;
+  // Mono: worker langsung menghasilkan mask 1 bit per pita
+  pipelineOptions.inkMask = options.monoDither;
+  pipelineOptions.bandRows = options.bandHeight;
+
+  PagePipeline pipeline(pipelineOptions);
+  pipeline.Start();
+
+  cairo_surface_t* pdf = nullptr;
+  cairo_t* cr = nullptr;
+  bool ok = true;
+  int pagesWritten = 0;
+
+  // Writer berjalan di thread pemanggil dan menulis halaman sesuai urutan,
+  // walaupun worker bisa selesai tidak berurutan.
+  PreparedPage page;
+  while (pipeline.Next(&page)) {
+    if (!page.ok) {
+      if (error) *error = "Failed to render page " + std::to_string(page.pageIndex + 1) + ".";
+      ok = false;
+      break;
+    }
+
+    if (!pdf) {
+      pdf = cairo_pdf_surface_create(options.outputPath.c_str(), page.widthPts, page.heightPts);
+      cr = cairo_create(pdf);
+    }
+    else {
+      cairo_pdf_surface_set_size(pdf, page.widthPts, page.heightPts);
+    }
+
+    cairo_save(cr);
+    cairo_scale(cr, 72.0 / pipelineOptions.rasterDpi, 72.0 / pipelineOptions.rasterDpi);
+    if (cairo_image_surface_get_format(page.image) == CAIRO_FORMAT_A1) {
+      // Halaman mono ditulis sebagai /ImageMask 1 bit, bukan gambar RGB
+      cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+      cairo_mask_surface(cr, page.image, 0, 0);
+    }
+    else {
+      cairo_set_source_surface(cr, page.image, 0, 0);
+      cairo_paint(cr);
+    }
+    cairo_restore(cr);
+    cairo_show_page(cr);
+
+    cairo_surface_destroy(page.image);
+    pagesWritten++;
+  }
+
+  if (cr) cairo_destroy(cr);
+  if (pdf) {
+    cairo_surface_finish(pdf);
+    if (ok && cairo_surface_status(pdf) != CAIRO_STATUS_SUCCESS) {
+      if (error) *error = cairo_status_to_string(cairo_surface_status(pdf));
+      ok = false;
+    }
+    cairo_surface_destroy(pdf);
+  }
+
+  if (stats) {
+    stats->pagesRendered = ok ? pagesWritten : 0;
+    stats->threadsUsed = pipeline.worker_count();
+    std::error_code ec;
+    uintmax_t size = ok ? std::filesystem::file_size(std::filesystem::u8path(options.outputPath), ec) : 0;
+    stats->outputBytes = ec ? 0 : (int64_t)size;
+    stats->elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - startTime).count();
+  }
+  return ok;
+}
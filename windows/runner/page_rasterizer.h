@@ -0,0 +1,61 @@
+#ifndef RUNNER_PAGE_RASTERIZER_H_
+#define RUNNER_PAGE_RASTERIZER_H_
+
+#include <cairo/cairo.h>
+#include <poppler/glib/poppler.h>
+
+#include <cstdint>
+#include <string>
+
+#include "mono_raster.h"
+
+// Options for RasterizePages. Page numbers are 1-based and inclusive, the
+// same convention as Ghostscript's -dFirstPage/-dLastPage.
+struct RasterizeOptions {
+  std::string inputPath;
+  std::string outputPath;
+  int firstPage = 1;
+  // 0 means "until the last page of the document".
+  int lastPage = 0;
+  double dpi = 300.0;
+  // 0 means one worker per hardware thread.
+  int threadCount = 0;
+  // Not kOff: pages are written as 1-bit image masks reduced with this mode
+  // (the in-process equivalent of -sDEVICE=pdfimage8 for mono printers,
+  // but at one bit instead of eight).
+  DitherMode monoDither = DitherMode::kOff;
+  // Mono only: band height in rows for RenderPageToInkMask, 0 automatic.
+  // Colour pages are rendered whole since the PDF keeps the page image anyway.
+  int bandHeight = 0;
+};
+
+struct RasterizeStats {
+  int pagesRendered = 0;
+  int threadsUsed = 0;
+  double elapsedMs = 0.0;
+  // Size of the written PDF, to compare colour and mono output.
+  int64_t outputBytes = 0;
+};
+
+// Renders |page| onto a new white RGB24 image surface at |dpi|. The caller
+// owns the returned surface. Returns nullptr if the surface could not be
+// allocated.
+cairo_surface_t* RenderPageToImage(PopplerPage* page, double dpi);
+
+// Renders |page| at |dpi| band by band (|bandRows| rows, 0: automatic),
+// reducing each band to one bit with |mode| as soon as it is drawn, and
+// returns the page as a CAIRO_FORMAT_A1 ink mask (see CreateInkMask). Peak
+// memory is one RGB24 band plus the 1-bit page. Caller owns; nullptr on
+// allocation failure.
+cairo_surface_t* RenderPageToInkMask(PopplerPage* page, double dpi, DitherMode mode,
+                                     int bandRows);
+
+// Renders the requested page range on a worker pool (one page per worker at a
+// time, each worker with its own PopplerDocument) and writes the result as an
+// image-only PDF to |options.outputPath|, in page order. This is the in-process
+// replacement for `gswin64c -sDEVICE=pdfimage24`. Does not touch Win32, so it
+// builds on any platform Poppler/Cairo build on.
+bool RasterizePages(const RasterizeOptions& options, RasterizeStats* stats,
+                    std::string* error);
+
+#endif  // RUNNER_PAGE_RASTERIZER_H_
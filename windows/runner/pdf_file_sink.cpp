@@ -0,0 +1,191 @@
+#include "pdf_file_sink.h"
+
+#include <cairo/cairo-pdf.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+
+namespace {
+
+// Ukuran kertas dalam point, nama sama dengan GetWindowsPaperSize di main.cpp.
+void PaperSizeInPoints(std::string name, double* width, double* height) {
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](unsigned char c) { return (char)std::toupper(c); });
+  *width = 595.28;
+  *height = 841.89;
+  if (name == "LETTER") {
+    *width = 612.0;
+    *height = 792.0;
+  } else if (name == "LEGAL") {
+    *width = 612.0;
+    *height = 1008.0;
+  } else if (name == "A3") {
+    *width = 841.89;
+    *height = 1190.55;
+  } else if (name == "A5") {
+    *width = 419.53;
+    *height = 595.28;
+  } else if (name == "F4") {
+    *width = 612.0;
+    *height = 936.0;
+  }
+}
+
+}  // namespace
+
+void PageSizeInPoints(const PageSetup& setup, double* width, double* height) {
+  PaperSizeInPoints(setup.pageSize, width, height);
+  if (setup.landscape) std::swap(*width, *height);
+}
+
+PdfFileSink::PdfFileSink(const std::string& path, const PageSetup& setup)
+    : path_(path), setup_(setup) {}
+
+PdfFileSink::~PdfFileSink() {
+  DestroySurface();
+}
+
+bool PdfFileSink::StartDocument(const std::string& name, int* spoolJobId) {
+  if (spoolJobId) *spoolJobId = 0;
+  double width = 0.0, height = 0.0;
+  PageSizeInPoints(setup_, &width, &height);
+  surface_ = cairo_pdf_surface_create(path_.c_str(), width, height);
+  if (cairo_surface_status(surface_) != CAIRO_STATUS_SUCCESS) {
+    DestroySurface();
+    return false;
+  }
+  cairo_pdf_surface_set_metadata(surface_, CAIRO_PDF_METADATA_TITLE, name.c_str());
+  return true;
+}
+
+bool PdfFileSink::StartPage() {
+  if (!surface_) return false;
+  if (raster_.dpi <= 0) return true;
+  PrintPageGeometry geometry = Geometry();
+  double scale = raster_.dpi / 72.0;
+  bands_ = std::make_unique<RasterBands>(geometry.printableWidth, geometry.printableHeight,
+                                         scale, scale, raster_.bandRows);
+  band_ = 0;
+  band_failed_ = false;
+  dither_ = DitherState();
+  band_surface_ = bands_->CreateBandSurface(0);
+  return band_surface_ != nullptr;
+}
+
+cairo_surface_t* PdfFileSink::PageSurface() {
+  return bands_ ? band_surface_ : surface_;
+}
+
+bool PdfFileSink::NextBand() {
+  if (!bands_ || !band_surface_) return false;
+  if (!WriteBand()) band_failed_ = true;
+  DestroyBand();
+  if (++band_ >= bands_->band_count()) return false;
+  band_surface_ = bands_->CreateBandSurface(band_);
+  if (!band_surface_) band_failed_ = true;
+  return band_surface_ != nullptr;
+}
+
+bool PdfFileSink::EndPage() {
+  if (!surface_) return false;
+  if (bands_) {
+    if (band_surface_ && !WriteBand()) band_failed_ = true;
+    DestroyBand();
+    bands_.reset();
+    if (band_failed_) return false;
+  }
+  cairo_surface_show_page(surface_);
+  page_setups_.push_back(setup_);
+  return cairo_surface_status(surface_) == CAIRO_STATUS_SUCCESS;
+}
+
+bool PdfFileSink::EndDocument() {
+  if (!surface_) return false;
+  cairo_surface_finish(surface_);
+  bool ok = cairo_surface_status(surface_) == CAIRO_STATUS_SUCCESS;
+  DestroySurface();
+  return ok;
+}
+
+void PdfFileSink::AbortDocument() {
+  DestroySurface();
+  std::error_code ec;
+  std::filesystem::remove(std::filesystem::u8path(path_), ec);
+}
+
+bool PdfFileSink::ChangePageSetup(const PageSetup& setup) {
+  setup_ = setup;
+  if (!surface_) return true;
+  double width = 0.0, height = 0.0;
+  PageSizeInPoints(setup_, &width, &height);
+  cairo_pdf_surface_set_size(surface_, width, height);
+  return cairo_surface_status(surface_) == CAIRO_STATUS_SUCCESS;
+}
+
+void PdfFileSink::SetRasterMode(const RasterMode& mode) {
+  raster_ = mode;
+}
+
+PrintPageGeometry PdfFileSink::Geometry() {
+  double width = 0.0, height = 0.0;
+  PageSizeInPoints(setup_, &width, &height);
+  PrintPageGeometry geometry;
+  geometry.physicalWidth = (int)(width + 0.5);
+  geometry.physicalHeight = (int)(height + 0.5);
+  geometry.printableWidth = geometry.physicalWidth;
+  geometry.printableHeight = geometry.physicalHeight;
+  geometry.dpiX = 72;
+  geometry.dpiY = 72;
+  return geometry;
+}
+
+bool PdfFileSink::WriteBand() {
+  cairo_surface_t* mask = nullptr;
+  if (raster_.mono != DitherMode::kOff) {
+    auto start = std::chrono::steady_clock::now();
+    BilevelImage image;
+    bool converted = ConvertToBilevel(band_surface_, raster_.mono, &image, &dither_);
+    mono_convert_ms_ += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!converted) return false;
+    mask = CreateInkMask(image);
+    if (!mask) return false;
+  }
+
+  cairo_t* cr = cairo_create(surface_);
+  cairo_scale(cr, 72.0 / raster_.dpi, 72.0 / raster_.dpi);
+  if (mask) {
+    // Mask hitam: cairo PDF menyimpannya sebagai /ImageMask 1 bit
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_mask_surface(cr, mask, 0, bands_->band_top(band_));
+    cairo_surface_destroy(mask);
+  }
+  else {
+    // Sebagai sumber, transform device pita harus dikembalikan ke piksel mentah
+    cairo_surface_set_device_scale(band_surface_, 1.0, 1.0);
+    cairo_surface_set_device_offset(band_surface_, 0, 0);
+    cairo_set_source_surface(cr, band_surface_, 0, bands_->band_top(band_));
+    cairo_paint(cr);
+  }
+  cairo_destroy(cr);
+  return cairo_surface_status(surface_) == CAIRO_STATUS_SUCCESS;
+}
+
+void PdfFileSink::DestroyBand() {
+  if (band_surface_) {
+    cairo_surface_destroy(band_surface_);
+    band_surface_ = nullptr;
+  }
+}
+
+void PdfFileSink::DestroySurface() {
+  DestroyBand();
+  bands_.reset();
+  if (surface_) {
+    cairo_surface_destroy(surface_);
+    surface_ = nullptr;
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef RUNNER_PDF_FILE_SINK_H_
+#define RUNNER_PDF_FILE_SINK_H_
+
+#include <cairo/cairo.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "print_sink.h"
+#include "raster_band.h"
+
+// Paper of |setup| in PDF points, width and height swapped for landscape.
+// Sinks without a device (PDF, raster files) size their pages from it.
+void PageSizeInPoints(const PageSetup& setup, double* width, double* height);
+
+// PrintSink that writes the spooled document to a PDF file at 72 dpi with no
+// hardware margins. Paper size and orientation changes become per-page PDF
+// sizes; colour and duplex cannot be expressed in the file and are only
+// recorded in page_setups(). In raster mode pages are written band by band,
+// as RGB images or, for mono, 1-bit image masks. cairo keeps a page's bands
+// until the page is finished, so banding here bounds the render working set
+// but not the page content itself. Used where there is no GDI spooler (the Linux
+// runner) and for checking transaction output locally.
+class PdfFileSink : public PrintSink {
+ public:
+  PdfFileSink(const std::string& path, const PageSetup& setup);
+  ~PdfFileSink() override;
+
+  // Prevent copying.
+  PdfFileSink(PdfFileSink const&) = delete;
+  PdfFileSink& operator=(PdfFileSink const&) = delete;
+
+  // Setup in effect for each page written so far.
+  const std::vector<PageSetup>& page_setups() const { return page_setups_; }
+
+  // PrintSink:
+  bool StartDocument(const std::string& name, int* spoolJobId) override;
+  bool StartPage() override;
+  cairo_surface_t* PageSurface() override;
+  bool NextBand() override;
+  bool EndPage() override;
+  bool EndDocument() override;
+  void AbortDocument() override;
+  bool ChangePageSetup(const PageSetup& setup) override;
+  void SetRasterMode(const RasterMode& mode) override;
+  double mono_convert_ms() const override { return mono_convert_ms_; }
+  PrintPageGeometry Geometry() override;
+
+ private:
+  void DestroySurface();
+  void DestroyBand();
+  bool WriteBand();
+
+  std::string path_;
+  PageSetup setup_;
+  cairo_surface_t* surface_ = nullptr;
+  RasterMode raster_;
+  // Mode raster: pita halaman yang sedang digambar, lalu ditempel ke PDF
+  std::unique_ptr<RasterBands> bands_;
+  cairo_surface_t* band_surface_ = nullptr;
+  int band_ = 0;
+  bool band_failed_ = false;
+  DitherState dither_;
+  double mono_convert_ms_ = 0.0;
+  std::vector<PageSetup> page_setups_;
+};
+
+#endif  // RUNNER_PDF_FILE_SINK_H_
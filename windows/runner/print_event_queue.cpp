@@ -0,0 +1,229 @@
+#include "print_event_queue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+static_assert(std::is_trivially_copyable<PrintEvent>::value,
+              "progress slots copy PrintEvent as raw words");
+
+// ProgressSlot::state bits below the key.
+constexpr uint64_t kSlotDirty = 1;
+constexpr uint64_t kSlotWriting = 2;
+
+constexpr uint64_t ProgressKey(PrintEventType type, int32_t id) {
+  return (((uint64_t)type << 32) | (uint32_t)id) + 1;
+}
+
+bool IsProgress(PrintEventType type) {
+  return type == PrintEventType::kPrintProgress || type == PrintEventType::kSpoolProgress;
+}
+
+}  // namespace
+
+void PrintEvent::SetCode(const char* value) {
+  strncpy(code, value ? value : "", sizeof(code) - 1);
+  code[sizeof(code) - 1] = '\0';
+}
+
+void PrintEvent::SetText(const char* value) {
+  strncpy(text, value ? value : "", sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+}
+
+const char* PrintEventMethod(PrintEventType type) {
+  switch (type) {
+    case PrintEventType::kJobCompleted:
+      return "onPrintJobCompleted";
+    case PrintEventType::kPrinterStatus:
+      return "onPrinterStatus";
+    case PrintEventType::kJobFailed:
+      return "onPrintJobFailed";
+    case PrintEventType::kPrintProgress:
+      return "onPrintProgress";
+    case PrintEventType::kSpoolStarted:
+      return "onSpoolStarted";
+    case PrintEventType::kSpoolFailed:
+      return "onSpoolFailed";
+    case PrintEventType::kSpoolProgress:
+      return "onSpoolProgress";
+    case PrintEventType::kSpoolCompleted:
+      return "onSpoolCompleted";
+  }
+  return "onPrinterStatus";
+}
+
+PrintEventQueue::PrintEventQueue(std::function<void()> notify)
+    : notify_(std::move(notify)),
+      cells_(new Cell[kRingCapacity]),
+      slots_(new ProgressSlot[kProgressSlots]) {
+  for (size_t i = 0; i < kRingCapacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < kProgressSlots; ++i) {
+    for (auto& word : slots_[i].words) word.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool PrintEventQueue::Post(PrintEvent event) {
+  posted_.fetch_add(1, std::memory_order_relaxed);
+  event.sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+  bool queued = IsProgress(event.type) ? PostProgress(event) : PushRing(event);
+  if (!queued) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  Schedule();
+  return true;
+}
+
+// Antrean terbatas Vyukov: tiap sel punya nomor urut yang memberi tahu
+// apakah sel kosong untuk posisi |pos| atau masih berisi event lama.
+bool PrintEventQueue::PushRing(const PrintEvent& event) {
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  for (;;) {
+    cell = &cells_[pos & (kRingCapacity - 1)];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      return false;  // penuh
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->event = event;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+// Slot dipegang dengan bit writing selama event ditulis, jadi konsumen tidak
+// bisa membebaskannya di tengah jalan dan hanya satu penulis per slot.
+// Isinya dilindungi seqlock terhadap pembaca.
+bool PrintEventQueue::PostProgress(const PrintEvent& event) {
+  int32_t id = event.type == PrintEventType::kPrintProgress ? event.printJobId : event.jobHandle;
+  uint64_t key = ProgressKey(event.type, id);
+  uint64_t owned = key << 2;
+  size_t start = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 40) % kProgressSlots;
+
+  for (size_t i = 0; i < kProgressSlots; ++i) {
+    ProgressSlot& slot = slots_[(start + i) % kProgressSlots];
+    uint64_t current = slot.state.load(std::memory_order_acquire);
+    bool pinned = false;
+    while (!pinned) {
+      if (current == 0 || (current & ~(kSlotDirty | kSlotWriting)) == owned) {
+        // Penulis lain untuk job yang sama sedang menulis: jangan menunggu
+        if (current & kSlotWriting) return PushRing(event);
+        pinned = slot.state.compare_exchange_weak(current, current | owned | kSlotWriting,
+                                                  std::memory_order_acq_rel);
+      } else {
+        break;
+      }
+    }
+    if (!pinned) continue;
+
+    uint64_t words[kEventWords] = {};
+    memcpy(words, &event, sizeof(PrintEvent));
+    uint32_t version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t w = 0; w < kEventWords; ++w) {
+      slot.words[w].store(words[w], std::memory_order_relaxed);
+    }
+    slot.version.store(version + 2, std::memory_order_release);
+
+    // Selama bit writing terpasang konsumen hanya bisa menghapus bit dirty,
+    // jadi state akhir bisa langsung ditulis
+    if (slot.state.exchange(owned | kSlotDirty, std::memory_order_acq_rel) & kSlotDirty) {
+      coalesced_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+  // Tabel penuh: kirim tanpa digabung
+  return PushRing(event);
+}
+
+void PrintEventQueue::ReleaseProgressSlot(const PrintEvent& terminal) {
+  uint64_t key = 0;
+  switch (terminal.type) {
+    case PrintEventType::kJobCompleted:
+    case PrintEventType::kJobFailed:
+      key = ProgressKey(PrintEventType::kPrintProgress, terminal.printJobId);
+      break;
+    case PrintEventType::kSpoolCompleted:
+    case PrintEventType::kSpoolFailed:
+      key = ProgressKey(PrintEventType::kSpoolProgress, terminal.jobHandle);
+      break;
+    default:
+      return;
+  }
+  // Hanya slot yang tidak dirty dan tidak sedang ditulis yang dibebaskan;
+  // progress yang masuk setelah Drain tetap terkirim di batch berikutnya
+  for (size_t i = 0; i < kProgressSlots; ++i) {
+    uint64_t expected = key << 2;
+    slots_[i].state.compare_exchange_strong(expected, 0, std::memory_order_acq_rel,
+                                            std::memory_order_relaxed);
+  }
+}
+
+void PrintEventQueue::Schedule() {
+  if (!scheduled_.exchange(true, std::memory_order_seq_cst) && notify_) notify_();
+}
+
+void PrintEventQueue::Drain(std::vector<PrintEvent>* out) {
+  // Dilepas dulu: event yang masuk selama Drain memicu notify berikutnya
+  scheduled_.store(false, std::memory_order_seq_cst);
+  out->clear();
+
+  // Paling banyak satu putaran ring, supaya |out| tidak melewati kMaxBatch
+  for (size_t popped = 0; popped < kRingCapacity; ++popped) {
+    Cell& cell = cells_[head_ & (kRingCapacity - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) break;
+    out->push_back(cell.event);
+    cell.sequence.store(head_ + kRingCapacity, std::memory_order_release);
+    head_++;
+  }
+
+  for (size_t i = 0; i < kProgressSlots; ++i) {
+    ProgressSlot& slot = slots_[i];
+    if (!(slot.state.fetch_and(~kSlotDirty, std::memory_order_acq_rel) & kSlotDirty)) continue;
+    uint64_t words[kEventWords];
+    for (;;) {
+      uint32_t before = slot.version.load(std::memory_order_acquire);
+      if (before & 1) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t w = 0; w < kEventWords; ++w) {
+        words[w] = slot.words[w].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.version.load(std::memory_order_relaxed) == before) break;
+    }
+    PrintEvent latest;
+    memcpy(&latest, words, sizeof(PrintEvent));
+    if (latest.sequence == slot.delivered) continue;
+    slot.delivered = latest.sequence;
+    out->push_back(latest);
+  }
+
+  std::sort(out->begin(), out->end(),
+            [](const PrintEvent& a, const PrintEvent& b) { return a.sequence < b.sequence; });
+  for (const PrintEvent& event : *out) ReleaseProgressSlot(event);
+  if (!out->empty()) batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+PrintEventStats PrintEventQueue::stats() const {
+  PrintEventStats result;
+  result.posted = posted_.load(std::memory_order_relaxed);
+  result.coalesced = coalesced_.load(std::memory_order_relaxed);
+  result.dropped = dropped_.load(std::memory_order_relaxed);
+  result.batches = batches_.load(std::memory_order_relaxed);
+  return result;
+}
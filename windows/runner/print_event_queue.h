@@ -0,0 +1,145 @@
+#ifndef RUNNER_PRINT_EVENT_QUEUE_H_
+#define RUNNER_PRINT_EVENT_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Event kinds; the numbers are the old PrintEventData types.
+enum class PrintEventType : uint8_t {
+  kJobCompleted = 1,   // onPrintJobCompleted
+  kPrinterStatus = 2,  // onPrinterStatus, only on change
+  kJobFailed = 3,      // onPrintJobFailed
+  kPrintProgress = 4,  // onPrintProgress, coalesced per printJobId
+  kSpoolStarted = 5,   // onSpoolStarted
+  kSpoolFailed = 6,    // onSpoolFailed
+  kSpoolProgress = 7,  // onSpoolProgress, coalesced per jobHandle
+  kSpoolCompleted = 8, // onSpoolCompleted
+};
+
+// Fixed-size event record, copied by value so posting never allocates.
+// Strings are truncated to their buffers.
+struct PrintEvent {
+  uint64_t sequence = 0;  // Set by PrintEventQueue; delivery order.
+  PrintEventType type = PrintEventType::kPrinterStatus;
+  int32_t jobHandle = 0;
+  int32_t printJobId = 0;
+  // kSpoolProgress/kSpoolCompleted: pages spooled; kPrintProgress: printed.
+  int32_t pages = 0;
+  int32_t totalPages = 0;
+  // kPrintProgress: SpoolJobInfo::status and rawStatus; kPrinterStatus:
+  // PrinterStatus::status and rawStatus.
+  uint32_t status = 0;
+  uint32_t rawStatus = 0;
+  // kPrinterStatus only.
+  bool online = false;
+  int32_t queuedJobs = 0;
+  int32_t pagesPerMinute = 0;
+  // kSpoolStarted: setupMs; kSpoolCompleted: firstPageMs.
+  double ms = 0.0;
+  // kSpoolCompleted: bytes the app wrote itself (Linux files and uploads);
+  // kJobCompleted: the spooler's final size of the job. -1 if unknown.
+  int64_t spoolBytes = -1;
+  int64_t peakRssBytes = 0;
+  // Static string (DitherModeName).
+  const char* monoMode = "off";
+  char code[32] = {};
+  // Error message, printer name or output path.
+  char text[224] = {};
+
+  void SetCode(const char* value);
+  void SetText(const char* value);
+};
+
+// Channel method name of |type| ("onSpoolProgress", ...).
+const char* PrintEventMethod(PrintEventType type);
+
+struct PrintEventStats {
+  uint64_t posted = 0;
+  // Progress updates overwritten before they were delivered.
+  uint64_t coalesced = 0;
+  // Events lost to a full ring.
+  uint64_t dropped = 0;
+  uint64_t batches = 0;
+};
+
+// Print events from worker threads to the platform thread. Producers never
+// block or allocate:
+//  - lifecycle events go through a bounded lock-free MPSC ring,
+//  - progress events (kPrintProgress, kSpoolProgress) overwrite the latest
+//    state of their job in a fixed slot table, so a job that ticks faster
+//    than the UI drains costs one delivered event per batch.
+// |notify| is called by the producer that makes the queue non-empty after a
+// Drain, i.e. at most once per batch, and should schedule the Drain on the
+// consumer thread.
+class PrintEventQueue {
+ public:
+  static constexpr size_t kRingCapacity = 1024;  // power of two
+  static constexpr size_t kProgressSlots = 256;
+
+  explicit PrintEventQueue(std::function<void()> notify);
+
+  // Prevent copying.
+  PrintEventQueue(PrintEventQueue const&) = delete;
+  PrintEventQueue& operator=(PrintEventQueue const&) = delete;
+
+  // Any thread. Returns false if the event was dropped (ring full).
+  bool Post(PrintEvent event);
+
+  // Consumer thread only. Replaces |out| with everything posted since the
+  // last call, in posting order. Reserve kMaxBatch in |out| once to keep
+  // this allocation-free too.
+  static constexpr size_t kMaxBatch = kRingCapacity + kProgressSlots;
+  void Drain(std::vector<PrintEvent>* out);
+
+  // Lets Drain run |notify| again without an intervening Post, e.g. when the
+  // consumer could not schedule itself.
+  void Rearm() { scheduled_.store(false, std::memory_order_release); }
+
+  PrintEventStats stats() const;
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    PrintEvent event;
+  };
+  static constexpr size_t kEventWords = (sizeof(PrintEvent) + 7) / 8;
+  struct ProgressSlot {
+    // key << 2 | kSlotWriting | kSlotDirty, 0 while free; key is
+    // (type << 32 | id) + 1. One word, so the consumer frees a slot only if
+    // it is neither dirty nor being written, in a single CAS.
+    std::atomic<uint64_t> state{0};
+    // Seqlock over |words|: odd while the owner writes.
+    std::atomic<uint32_t> version{0};
+    // The latest event as relaxed atomic words, so a read that overlaps a
+    // write is caught by |version| instead of being a data race.
+    std::atomic<uint64_t> words[kEventWords];
+    // Consumer only: sequence of the event last delivered from this slot.
+    // A write that finishes after Drain cleared kSlotDirty is read in that
+    // batch and would otherwise be delivered again in the next one.
+    uint64_t delivered = 0;
+  };
+
+  bool PushRing(const PrintEvent& event);
+  bool PostProgress(const PrintEvent& event);
+  void ReleaseProgressSlot(const PrintEvent& terminal);
+  void Schedule();
+
+  std::function<void()> notify_;
+  std::unique_ptr<Cell[]> cells_;
+  std::atomic<size_t> tail_{0};
+  size_t head_ = 0;  // consumer only
+  std::unique_ptr<ProgressSlot[]> slots_;
+  std::atomic<uint64_t> next_sequence_{1};
+  std::atomic<bool> scheduled_{false};
+
+  std::atomic<uint64_t> posted_{0};
+  std::atomic<uint64_t> coalesced_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> batches_{0};
+};
+
+#endif  // RUNNER_PRINT_EVENT_QUEUE_H_
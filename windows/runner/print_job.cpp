@@ -0,0 +1,347 @@
+#include "print_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "copy_fan_out.h"
+#include "margin_cache.h"
+#include "raster_band.h"
+
+namespace {
+
+// Batas memori gambar halaman raster pada rekaman salinan pertama sebelum
+// halaman dipindah ke file spill.
+constexpr size_t kCopyFanOutBudget = 256 * 1024 * 1024;
+// Ukuran display list halaman vektor tidak dilaporkan cairo (gambar hasil
+// scan bisa puluhan MB per halaman), jadi jumlahnya yang dibatasi.
+constexpr int kCopyFanOutVectorPages = 16;
+
+// Turns the sink's raster mode on for one SpoolPages call and off again on
+// every return, so separator pages and the next section start clean.
+class ScopedRasterMode {
+ public:
+  ScopedRasterMode(PrintSink* sink, const RasterMode& mode)
+      : sink_(sink), active_(mode.dpi > 0), start_ms_(sink->mono_convert_ms()) {
+    if (active_) sink_->SetRasterMode(mode);
+  }
+  ~ScopedRasterMode() {
+    if (active_) sink_->SetRasterMode(RasterMode());
+  }
+
+  ScopedRasterMode(ScopedRasterMode const&) = delete;
+  ScopedRasterMode& operator=(ScopedRasterMode const&) = delete;
+
+  double convert_ms() const { return sink_->mono_convert_ms() - start_ms_; }
+
+ private:
+  PrintSink* sink_;
+  bool active_;
+  double start_ms_;
+};
+
+// True if a raster page of |geometry| at |dpi| is cut into more than one band.
+bool SplitsIntoBands(const PrintPageGeometry& geometry, int dpi, int bandRows) {
+  if (dpi <= 0) return false;
+  RasterBands bands(geometry.printableWidth, geometry.printableHeight,
+                    (double)dpi / std::max(1, geometry.dpiX), (double)dpi / std::max(1, geometry.dpiY),
+                    bandRows);
+  return bands.band_count() > 1;
+}
+
+}  // namespace
+
+std::vector<int> ResolvePageIndices(const PrintSettings& settings, int numPages) {
+  std::vector<int> indices;
+  if (!settings.pages.empty()) {
+    for (int pageNumber : settings.pages) {
+      if (pageNumber >= 1 && pageNumber <= numPages) {
+        indices.push_back(pageNumber - 1);
+      }
+    }
+    return indices;
+  }
+
+  int first = settings.pagesStart > 0 ? settings.pagesStart : 1;
+  int last = settings.pageEnd > 0 ? std::min(settings.pageEnd, numPages) : numPages;
+  for (int pageNumber = first; pageNumber <= last; ++pageNumber) {
+    indices.push_back(pageNumber - 1);
+  }
+  return indices;
+}
+
+std::string ResolveOrientation(DocumentLease* document, const PrintSettings& settings) {
+  if (settings.pageOrientation != "auto") return settings.pageOrientation;
+
+  // Jika tidak ada halaman yang dicetak, gunakan default portrait
+  std::vector<int> pageIndices = ResolvePageIndices(settings, document->page_count());
+  if (pageIndices.empty()) return "portrait";
+
+  // Suara terbanyak dari halaman yang dicetak; seri ikut halaman pertamanya.
+  // Unduhan progresif hanya memakai halaman yang sudah diparse, karena
+  // page() akan menunggu sisa unduhan
+  bool progressive = document->progressive();
+  int landscape = 0, portrait = 0;
+  bool firstLandscape = false;
+  bool firstSeen = false;
+  auto vote = [&](PopplerPage* page) {
+    double width_points = 0.0, height_points = 0.0;
+    poppler_page_get_size(page, &width_points, &height_points);
+    bool isLandscape = width_points > height_points;
+    if (!firstSeen) firstLandscape = isLandscape;
+    firstSeen = true;
+    (isLandscape ? landscape : portrait)++;
+  };
+  for (int index : pageIndices) {
+    PopplerPage* page = progressive ? document->loaded_page(index) : document->page(index);
+    if (page) vote(page);
+  }
+
+  // File linear selalu membawa halaman pertama di depan
+  if (!firstSeen) {
+    PopplerPage* first_page = document->page(0);
+    if (!first_page) return "portrait";
+    vote(first_page);
+  }
+
+  if (landscape != portrait) return landscape > portrait ? "landscape" : "portrait";
+  return firstLandscape ? "landscape" : "portrait";
+}
+
+void RenderPreparedPage(cairo_t* cr, const PrintPageGeometry& geometry,
+                        PopplerPage* page, const PreparedPage& prepared,
+                        int rasterDpi) {
+  double width_points = prepared.widthPts;
+  double height_points = prepared.heightPts;
+
+  // Info kertas dari printer
+  int offsetX = geometry.offsetX;
+  int offsetY = geometry.offsetY;
+  int physicalW = geometry.physicalWidth;
+  int physicalH = geometry.physicalHeight;
+  int physRightMargin = geometry.rightMargin();
+  int physBottomMargin = geometry.bottomMargin();
+
+  double scale_x, scale_y;
+  double trans_x = 0, trans_y = 0;
+
+  if (prepared.contentInMargins) {
+    // Konten terdeteksi di margin. Menggunakan mode FIT TO PAGE.
+    double paperCenterX = (double)physicalW / 2.0;
+    double paperCenterY = (double)physicalH / 2.0;
+
+    double distCenterToLeft = paperCenterX - (double)offsetX;
+    double distCenterToRight = ((double)physicalW - (double)physRightMargin) - paperCenterX;
+
+    double safeSymmetricW = std::min(distCenterToLeft, distCenterToRight) * 2.0;
+
+    double distCenterToTop = paperCenterY - (double)offsetY;
+    double distCenterToBottom = ((double)physicalH - (double)physBottomMargin) - paperCenterY;
+    double safeSymmetricH = std::min(distCenterToTop, distCenterToBottom) * 2.0;
+
+    scale_x = safeSymmetricW / width_points;
+    scale_y = safeSymmetricH / height_points;
+
+    double scale = std::min(scale_x, scale_y);
+    scale_x = scale;
+    scale_y = scale;
+
+    double finalW = width_points * scale;
+    double finalH = height_points * scale;
+
+    trans_x = (paperCenterX - (finalW / 2.0)) - (double)offsetX;
+    trans_y = (paperCenterY - (finalH / 2.0)) - (double)offsetY;
+
+    g_debug("[Render] FIT TO PAGE PhysW:%d OffL:%d OffR:%d -> SafeW:%d",
+            physicalW, offsetX, physRightMargin, (int)safeSymmetricW);
+  }
+  else {
+    scale_x = (double)physicalW / (width_points > 0 ? width_points : 1.0);
+    scale_y = (double)physicalH / (height_points > 0 ? height_points : 1.0);
+    double scale = std::min(scale_x, scale_y);
+    scale_x = scale;
+    scale_y = scale;
+
+    trans_x = -offsetX;
+    trans_y = -offsetY;
+  }
+
+  cairo_save(cr);
+
+  // Geser canvas agar margin hardware dikompensasi
+  cairo_translate(cr, trans_x, trans_y);
+
+  // Scale konten PDF ke ukuran fisik
+  cairo_scale(cr, scale_x, scale_y);
+
+  // Render halaman
+  if (prepared.image && rasterDpi > 0) {
+    cairo_scale(cr, 72.0 / rasterDpi, 72.0 / rasterDpi);
+    cairo_set_source_surface(cr, prepared.image, 0, 0);
+    cairo_paint(cr);
+  }
+  else if (page) {
+    poppler_page_render_for_printing(page, cr);
+  }
+
+  cairo_restore(cr);
+}
+
+SpoolResult SpoolPages(PrintSink* sink, DocumentLease* document,
+                       const std::string& filePath,
+                       const PrintSettings& settings,
+                       const SpoolProgressCallback& onProgress) {
+  SpoolResult result;
+  auto startTime = std::chrono::steady_clock::now();
+
+  int num_pages = document->page_count();
+  // Halaman dicetak langsung dari dokumen asli, tanpa dipecah jadi file batch
+  std::vector<int> pageIndices = ResolvePageIndices(settings, num_pages);
+  PrintPageGeometry geometry = sink->Geometry();
+  MarginBox printerMargins = geometry.MarginsInPoints();
+
+  // Salinan 2..N diputar ulang dari rekaman salinan pertama. Untuk duplex
+  // dengan jumlah halaman ganjil, tiap salinan dimulai di lembar baru.
+  std::unique_ptr<CopyFanOut> fanOut;
+  int copies = 1;
+  bool padCopies = false;
+  if (settings.softwareCopies && settings.copies > 1) {
+    fanOut = std::make_unique<CopyFanOut>(geometry, kCopyFanOutBudget, kCopyFanOutVectorPages);
+    copies = settings.copies;
+    padCopies = settings.doubleSided && pageIndices.size() % 2 == 1;
+  }
+  int totalPages = (int)pageIndices.size() * copies;
+
+  // Mode mono 1 bit hanya untuk job hitam-putih. Halaman yang terlalu besar
+  // untuk satu pita (A3, 600 dpi) dirender per pita langsung di sink, tanpa
+  // gambar satu halaman penuh dari worker.
+  result.monoDither = settings.color ? DitherMode::kOff : settings.monoDither;
+  RasterMode rasterMode;
+  rasterMode.mono = result.monoDither;
+  rasterMode.bandRows = settings.bandHeight;
+  int rasterDpi = settings.rasterDpi;
+  if (rasterMode.mono != DitherMode::kOff && rasterDpi <= 0) rasterDpi = kDefaultMonoDpi;
+  result.banded = SplitsIntoBands(geometry, rasterDpi, settings.bandHeight);
+  if (rasterMode.mono != DitherMode::kOff || result.banded) rasterMode.dpi = rasterDpi;
+  int prerenderDpi = result.banded ? 0 : settings.rasterDpi;
+  ScopedRasterMode scopedRaster(sink, rasterMode);
+
+  auto emitPage = [&](const std::function<void(cairo_t*)>& draw) {
+    if (!sink->StartPage()) {
+      result.errorCode = "START_PAGE_FAILED";
+      result.errorMessage = "Failed to start print page.";
+      return false;
+    }
+    // Mode pita: seluruh halaman digambar ulang untuk tiap pita
+    do {
+      cairo_t* cr = cairo_create(sink->PageSurface());
+      draw(cr);
+      cairo_destroy(cr);
+    } while (sink->NextBand());
+    if (!sink->EndPage()) {
+      result.errorCode = "END_PAGE_FAILED";
+      result.errorMessage = "Failed to end print page.";
+      return false;
+    }
+    return true;
+  };
+
+  // Keputusan margin per halaman disimpan per isi file, jadi file yang sering
+  // dicetak ulang (separator, invoice) tidak perlu dianalisa lagi
+  uint64_t contentHash = 0;
+  if (!printerMargins.IsEmpty() && !DocumentCache::Shared().ContentHash(filePath, &contentHash)) {
+    contentHash = 0;
+  }
+
+  // Mode pipeline: worker menganalisa margin (dan rasterisasi) halaman
+  // berikutnya selagi thread ini masih mengirim halaman sekarang ke spooler.
+  std::unique_ptr<PagePipeline> pipeline;
+  if (settings.pipelineDepth > 0 && pageIndices.size() > 1) {
+    PipelineOptions pipelineOptions;
+    pipelineOptions.filePath = filePath;
+    pipelineOptions.pageIndices = pageIndices;
+    pipelineOptions.depth = settings.pipelineDepth;
+    pipelineOptions.rasterDpi = prerenderDpi;
+    pipelineOptions.margins = printerMargins;
+    pipelineOptions.contentHash = contentHash;
+    pipeline = std::make_unique<PagePipeline>(pipelineOptions);
+    pipeline->Start();
+  }
+
+  for (int i : pageIndices) {
+    PreparedPage prepared;
+    PopplerPage* page = nullptr;
+    if (pipeline) {
+      pipeline->Next(&prepared);
+    }
+    // Render vektor tetap harus di thread ini (surface printer), begitu juga
+    // halaman yang gagal disiapkan worker.
+    if (!prepared.ok || !prepared.image) {
+      page = document->page(i);
+      if (!page) continue;
+      if (!prepared.ok) {
+        PreparePage(page, prerenderDpi, printerMargins, contentHash, &prepared);
+      }
+    }
+
+    // Salinan software: render sekali ke display list, kirim ke printer,
+    // simpan untuk salinan berikutnya
+    cairo_surface_t* recording = nullptr;
+    if (fanOut) {
+      recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, nullptr);
+      cairo_t* recordCr = cairo_create(recording);
+      RenderPreparedPage(recordCr, geometry, page, prepared, prerenderDpi);
+      cairo_destroy(recordCr);
+    }
+
+    bool pageOk = emitPage([&](cairo_t* cr) {
+      if (!recording) {
+        RenderPreparedPage(cr, geometry, page, prepared, prerenderDpi);
+        return;
+      }
+      cairo_set_source_surface(cr, recording, 0, 0);
+      cairo_paint(cr);
+    });
+
+    if (recording) {
+      size_t imageBytes = prepared.image
+          ? (size_t)cairo_image_surface_get_stride(prepared.image) * cairo_image_surface_get_height(prepared.image)
+          : 0;
+      fanOut->Keep(recording, imageBytes);
+    }
+    if (prepared.image) cairo_surface_destroy(prepared.image);
+    if (!pageOk) return result;
+
+    result.pagesSpooled++;
+    if (onProgress) onProgress(result.pagesSpooled, totalPages);
+  }
+
+  if (contentHash != 0) MarginCache::Shared().Flush();
+
+  if (fanOut) {
+    if (!fanOut->Finish(&result.errorMessage)) {
+      result.errorCode = "COPY_SPILL_FAILED";
+      return result;
+    }
+    for (int copy = 2; copy <= copies; ++copy) {
+      if (padCopies && !emitPage([](cairo_t*) {})) return result;
+      for (int k = 0; k < fanOut->page_count(); ++k) {
+        if (!emitPage([&](cairo_t* cr) { fanOut->Replay(k, cr); })) return result;
+        result.pagesSpooled++;
+        if (onProgress) onProgress(result.pagesSpooled, totalPages);
+      }
+    }
+    result.spilledPages = fanOut->spilled_pages();
+  }
+
+  result.elapsedMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - startTime).count();
+  if (pipeline) {
+    result.workerCount = pipeline->worker_count();
+    result.workerBusyMs = pipeline->worker_busy_ms();
+  }
+  result.monoConvertMs = scopedRaster.convert_ms();
+
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,97 @@
+#ifndef RUNNER_PRINT_JOB_H_
+#define RUNNER_PRINT_JOB_H_
+
+#include <poppler/glib/poppler.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "document_cache.h"
+#include "print_pipeline.h"
+#include "print_sink.h"
+
+struct PrintSettings {
+  std::string printerName;
+  bool color = false;
+  bool doubleSided = false;
+  int copies = 1;
+  std::string pageOrientation = "auto";
+  int printJobId = 0;
+  std::string pageSize = "A4";
+  // 1-based page numbers. When |pages| is not empty the pagesStart..pageEnd
+  // range is ignored. 0 means "from the first"/"until the last" page.
+  int pagesStart = 0;
+  int pageEnd = 0;
+  std::vector<int> pages;
+  // > 0: rasterize each page at this resolution before sending it, the
+  // in-process equivalent of Ghostscript's pdfimage24.
+  int rasterDpi = 0;
+  // > 0: pipelined mode, maximum pages prepared ahead of the spooler.
+  int pipelineDepth = 0;
+  // Produce copies 2..N in software by replaying the first copy instead of
+  // relying on the driver's DM_COPIES/DM_COLLATE.
+  bool softwareCopies = false;
+  // Black-and-white jobs only: send pages as 1-bit bitmaps reduced with this
+  // mode, at |rasterDpi| (kDefaultMonoDpi when 0). Ignored when |color|.
+  DitherMode monoDither = DitherMode::kOff;
+  // Raster pages (mono, or |rasterDpi| > 0) are rendered and sent in bands of
+  // this many rows. 0 picks a height that keeps one band under
+  // kMaxRasterBandBytes, which only splits large pages (A3, 600 dpi).
+  int bandHeight = 0;
+};
+
+// Resolution of the mono raster path when the job sets no rasterDpi.
+constexpr int kDefaultMonoDpi = 300;
+
+// Turns the page selection in |settings| into valid 0-based page indices for
+// a document with |numPages| pages.
+std::vector<int> ResolvePageIndices(const PrintSettings& settings, int numPages);
+
+// Resolves "auto" orientation in |settings| by majority over the sizes of the
+// selected pages; a tie goes to the first of them. A document still
+// downloading only votes with the pages parsed so far (page 0 if none), so
+// this never waits for the rest of the file.
+std::string ResolveOrientation(DocumentLease* document, const PrintSettings& settings);
+
+// Draws a prepared page onto |cr| (device pixels of a page described by
+// |geometry|): borderless when the content stays clear of the hardware
+// margins, otherwise fit-to-page centred in the printable area. Uses
+// |prepared.image| when present, else renders |page| as vectors.
+void RenderPreparedPage(cairo_t* cr, const PrintPageGeometry& geometry,
+                        PopplerPage* page, const PreparedPage& prepared,
+                        int rasterDpi);
+
+struct SpoolResult {
+  bool ok = false;
+  int pagesSpooled = 0;
+  double elapsedMs = 0.0;
+  // Pipeline workers used (0 in serial mode) and their summed busy time.
+  int workerCount = 0;
+  double workerBusyMs = 0.0;
+  // Software copies: pages of the first copy that went to the spill file.
+  int spilledPages = 0;
+  // Mono raster path: the mode used (kOff if none) and the time spent
+  // reducing pages to 1 bit.
+  DitherMode monoDither = DitherMode::kOff;
+  double monoConvertMs = 0.0;
+  // Pages were rendered band by band instead of as whole-page images.
+  bool banded = false;
+  // Channel error code and message when !ok.
+  std::string errorCode;
+  std::string errorMessage;
+};
+
+using SpoolProgressCallback = std::function<void(int pagesSpooled, int totalPages)>;
+
+// Spools the selected pages of |document| (leased for |filePath|, a file or a
+// DocumentCache memory source) into a sink whose document has already been
+// started. Serial or pipelined depending on |settings.pipelineDepth|; with
+// |settings.softwareCopies| every copy is spooled, rendered once and
+// replayed. |onProgress| may be empty.
+SpoolResult SpoolPages(PrintSink* sink, DocumentLease* document,
+                       const std::string& filePath,
+                       const PrintSettings& settings,
+                       const SpoolProgressCallback& onProgress);
+
+#endif  // RUNNER_PRINT_JOB_H_
@@ -0,0 +1,124 @@
+#include "print_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "document_cache.h"
+#include "margin_cache.h"
+#include "page_rasterizer.h"
+
+void PreparePage(PopplerPage* page, int rasterDpi, const MarginBox& margins,
+                 uint64_t contentHash, PreparedPage* out) {
+  out->pageIndex = poppler_page_get_index(page);
+  poppler_page_get_size(page, &out->widthPts, &out->heightPts);
+
+  if (!margins.IsEmpty()) {
+    MarginCacheKey key = MakeMarginCacheKey(contentHash, out->pageIndex, margins);
+    if (contentHash == 0 ||
+        !MarginCache::Shared().Lookup(key, &out->contentInMargins)) {
+      out->contentInMargins =
+          HasContentInMargins(page, out->widthPts, out->heightPts, margins.left,
+                              margins.top, margins.right, margins.bottom);
+      if (contentHash != 0) {
+        MarginCache::Shared().Store(key, out->contentInMargins);
+      }
+    }
+  }
+  if (rasterDpi > 0) {
+    out->image = RenderPageToImage(page, rasterDpi);
+  }
+  out->ok = rasterDpi <= 0 || out->image != nullptr;
+}
+
+PagePipeline::PagePipeline(const PipelineOptions& options)
+    : options_(options), slots_(options.pageIndices.size()) {
+  if (options_.depth < 1) options_.depth = 1;
+}
+
+PagePipeline::~PagePipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+
+  for (auto& slot : slots_) {
+    if (slot.page.image) cairo_surface_destroy(slot.page.image);
+  }
+}
+
+void PagePipeline::Start() {
+  int workerCount = options_.workerCount;
+  if (workerCount <= 0) {
+    workerCount = std::min(options_.depth,
+                           (int)std::max(1u, std::thread::hardware_concurrency()));
+  }
+  workerCount = std::min(workerCount, (int)slots_.size());
+
+  for (int i = 0; i < workerCount; ++i) {
+    workers_.emplace_back(&PagePipeline::WorkerLoop, this);
+  }
+}
+
+bool PagePipeline::Next(PreparedPage* page) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (next_to_consume_ >= (int)slots_.size()) return false;
+
+  int index = next_to_consume_;
+  cv_.wait(lock, [this, index] { return slots_[index].done; });
+
+  *page = slots_[index].page;
+  slots_[index].page.image = nullptr;
+  next_to_consume_++;
+  cv_.notify_all();
+  return true;
+}
+
+double PagePipeline::worker_busy_ms() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return worker_busy_ms_;
+}
+
+void PagePipeline::WorkerLoop() {
+  std::string ignored;
+  DocumentLease document = DocumentCache::Shared().Acquire(options_.filePath, &ignored);
+
+  while (true) {
+    int slot;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] {
+        return stopping_ || next_to_prepare_ >= (int)slots_.size() ||
+               next_to_prepare_ < next_to_consume_ + options_.depth;
+      });
+      if (stopping_ || next_to_prepare_ >= (int)slots_.size()) break;
+      slot = next_to_prepare_++;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    PreparedPage prepared;
+    prepared.pageIndex = options_.pageIndices[slot];
+    PopplerPage* page = document.page(prepared.pageIndex);
+    if (page && options_.inkMask != DitherMode::kOff && options_.rasterDpi > 0) {
+      PreparePage(page, 0, options_.margins, options_.contentHash, &prepared);
+      prepared.image = RenderPageToInkMask(page, options_.rasterDpi, options_.inkMask,
+                                           options_.bandRows);
+      prepared.ok = prepared.image != nullptr;
+    }
+    else if (page) {
+      PreparePage(page, options_.rasterDpi, options_.margins,
+                  options_.contentHash, &prepared);
+    }
+    double busyMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slots_[slot].page = prepared;
+      slots_[slot].done = true;
+      worker_busy_ms_ += busyMs;
+    }
+    cv_.notify_all();
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef RUNNER_PRINT_PIPELINE_H_
+#define RUNNER_PRINT_PIPELINE_H_
+
+#include <cairo/cairo.h>
+#include <poppler/glib/poppler.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "margin_analyzer.h"
+#include "mono_raster.h"
+
+struct PipelineOptions {
+  std::string filePath;
+  // 0-based page indices, delivered to the consumer in this order.
+  std::vector<int> pageIndices;
+  // Maximum number of pages prepared ahead of the consumer.
+  int depth = 4;
+  // 0 means min(depth, hardware threads).
+  int workerCount = 0;
+  // > 0: pre-render every page into an RGB24 image at this resolution.
+  int rasterDpi = 0;
+  // Not kOff (with |rasterDpi|): pre-render an A1 ink mask instead, drawn in
+  // bands of |bandRows| rows (0: automatic) so no full-page RGB image exists.
+  DitherMode inkMask = DitherMode::kOff;
+  int bandRows = 0;
+  // HasContentInMargins runs on the workers when this is not empty.
+  MarginBox margins;
+  // HashFileContent of |filePath|; 0 skips the margin cache.
+  uint64_t contentHash = 0;
+};
+
+// A page that has been analysed (and optionally rasterized) ahead of time.
+struct PreparedPage {
+  int pageIndex = -1;
+  double widthPts = 0.0;
+  double heightPts = 0.0;
+  bool contentInMargins = false;
+  // RGB24 image, or A1 ink mask with PipelineOptions::inkMask. Owned by
+  // whoever received the page from PagePipeline::Next.
+  cairo_surface_t* image = nullptr;
+  bool ok = false;
+};
+
+// Analyses (and optionally rasterizes) |page| on the calling thread. The
+// serial print path and the pipeline workers share this. A non-zero
+// |contentHash| lets the margin decision come from MarginCache.
+void PreparePage(PopplerPage* page, int rasterDpi, const MarginBox& margins,
+                 uint64_t contentHash, PreparedPage* out);
+
+// Producer/consumer pipeline: worker threads, each with its own
+// PopplerDocument since Poppler documents are not thread-safe, prepare pages
+// N+1..N+depth while the consumer is still spooling page N.
+class PagePipeline {
+ public:
+  explicit PagePipeline(const PipelineOptions& options);
+  ~PagePipeline();
+
+  // Prevent copying.
+  PagePipeline(PagePipeline const&) = delete;
+  PagePipeline& operator=(PagePipeline const&) = delete;
+
+  void Start();
+
+  // Blocks until the next page (in |pageIndices| order) is ready. Returns
+  // false once every page has been handed out.
+  bool Next(PreparedPage* page);
+
+  int worker_count() const { return (int)workers_.size(); }
+
+  // Total time workers spent preparing pages, summed across workers. Only
+  // meaningful after the pipeline has been drained.
+  double worker_busy_ms();
+
+ private:
+  struct Slot {
+    PreparedPage page;
+    bool done = false;
+  };
+
+  void WorkerLoop();
+
+  PipelineOptions options_;
+  std::vector<std::thread> workers_;
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int next_to_prepare_ = 0;
+  int next_to_consume_ = 0;
+  bool stopping_ = false;
+  double worker_busy_ms_ = 0.0;
+};
+
+#endif  // RUNNER_PRINT_PIPELINE_H_
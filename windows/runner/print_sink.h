@@ -0,0 +1,99 @@
+#ifndef RUNNER_PRINT_SINK_H_
+#define RUNNER_PRINT_SINK_H_
+
+#include <cairo/cairo.h>
+
+#include <string>
+
+#include "margin_analyzer.h"
+#include "mono_raster.h"
+
+// Paper geometry of the output device, in device pixels. Mirrors the
+// GetDeviceCaps values (PHYSICALWIDTH, PHYSICALOFFSETX, HORZRES, ...).
+struct PrintPageGeometry {
+  int physicalWidth = 0;
+  int physicalHeight = 0;
+  int offsetX = 0;
+  int offsetY = 0;
+  int printableWidth = 0;
+  int printableHeight = 0;
+  int dpiX = 72;
+  int dpiY = 72;
+
+  int rightMargin() const { return physicalWidth - printableWidth - offsetX; }
+  int bottomMargin() const { return physicalHeight - printableHeight - offsetY; }
+
+  // Hardware margins converted to PDF points.
+  MarginBox MarginsInPoints() const {
+    MarginBox margins;
+    margins.left = (double)offsetX * 72.0 / dpiX;
+    margins.top = (double)offsetY * 72.0 / dpiY;
+    margins.right = (double)rightMargin() * 72.0 / dpiX;
+    margins.bottom = (double)bottomMargin() * 72.0 / dpiY;
+    return margins;
+  }
+};
+
+// Device settings that can change between pages of one spooled document.
+// |pageSize| is a paper name as sent by Flutter ("A4", "LETTER", "F4", ...).
+struct PageSetup {
+  std::string pageSize = "A4";
+  bool color = false;
+  bool duplex = false;
+  bool landscape = false;
+
+  bool operator==(const PageSetup& other) const {
+    return pageSize == other.pageSize && color == other.color &&
+           duplex == other.duplex && landscape == other.landscape;
+  }
+  bool operator!=(const PageSetup& other) const { return !(*this == other); }
+};
+
+// How a sink turns pages into device data. With |dpi| == 0 pages go out as
+// vectors (and pre-rendered images) through cairo; otherwise every page is
+// drawn on RGB24 bands at |dpi| (capped at the device resolution) and sent as
+// bitmaps, 1-bit when |mono| is set. |bandRows| is the band height in stored
+// rows, 0 lets RasterBands pick one that bounds the band size.
+struct RasterMode {
+  int dpi = 0;
+  DitherMode mono = DitherMode::kOff;
+  int bandRows = 0;
+};
+
+// Destination of a spooled document. The Win32 implementation wraps a
+// printer DC (see GdiPrintSink); other implementations can write to a file or
+// a fake spooler, which keeps the job logic free of Win32.
+class PrintSink {
+ public:
+  virtual ~PrintSink() = default;
+
+  // Starts a spooler document. |spoolJobId| receives the spooler's job id
+  // (0 if the backend has none).
+  virtual bool StartDocument(const std::string& name, int* spoolJobId) = 0;
+  virtual bool StartPage() = 0;
+  // Drawing surface for the current page, in device pixels. Owned by the
+  // sink and only valid between StartPage and EndPage.
+  virtual cairo_surface_t* PageSurface() = 0;
+  // Raster mode: sends the band drawn on PageSurface() and moves it to the
+  // next band of the page. Returns false once the page has no more bands
+  // (always, in vector mode). Callers draw the whole page once per band:
+  //   do { draw(PageSurface()); } while (NextBand());
+  virtual bool NextBand() = 0;
+  virtual bool EndPage() = 0;
+  virtual bool EndDocument() = 0;
+  // Cancels a started document after a failure.
+  virtual void AbortDocument() = 0;
+
+  // Applies |setup| to the pages that follow. Only valid between pages;
+  // Geometry() describes the new paper afterwards.
+  virtual bool ChangePageSetup(const PageSetup& setup) = 0;
+
+  // Applies to the pages started after this; only valid between pages.
+  virtual void SetRasterMode(const RasterMode& mode) = 0;
+  // Total time spent reducing pages to 1 bit, in milliseconds.
+  virtual double mono_convert_ms() const = 0;
+
+  virtual PrintPageGeometry Geometry() = 0;
+};
+
+#endif  // RUNNER_PRINT_SINK_H_
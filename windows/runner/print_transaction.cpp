@@ -0,0 +1,150 @@
+#include "print_transaction.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "separator_cache.h"
+
+namespace {
+
+// Forwards to another sink and counts the pages that reach it, blank ones
+// included, so duplex parity is known after each section.
+class CountingSink : public PrintSink {
+ public:
+  explicit CountingSink(PrintSink* sink) : sink_(sink) {}
+
+  int sides() const { return sides_; }
+  void ResetSides() { sides_ = 0; }
+
+  // PrintSink:
+  bool StartDocument(const std::string& name, int* spoolJobId) override {
+    return sink_->StartDocument(name, spoolJobId);
+  }
+  bool StartPage() override { return sink_->StartPage(); }
+  cairo_surface_t* PageSurface() override { return sink_->PageSurface(); }
+  bool NextBand() override { return sink_->NextBand(); }
+  bool EndPage() override {
+    if (!sink_->EndPage()) return false;
+    sides_++;
+    return true;
+  }
+  bool EndDocument() override { return sink_->EndDocument(); }
+  void AbortDocument() override { sink_->AbortDocument(); }
+  bool ChangePageSetup(const PageSetup& setup) override {
+    return sink_->ChangePageSetup(setup);
+  }
+  void SetRasterMode(const RasterMode& mode) override { sink_->SetRasterMode(mode); }
+  double mono_convert_ms() const override { return sink_->mono_convert_ms(); }
+  PrintPageGeometry Geometry() override { return sink_->Geometry(); }
+
+ private:
+  PrintSink* sink_;
+  int sides_ = 0;
+};
+
+}  // namespace
+
+bool PrepareTransaction(const std::vector<TransactionSection>& sections,
+                        std::vector<PreparedSection>* prepared,
+                        std::string* errorCode, std::string* errorMessage) {
+  prepared->clear();
+  for (const TransactionSection& section : sections) {
+    PreparedSection entry;
+    entry.section = section;
+    // Satu dokumen spooler: salinan dari driver akan mengulang seluruh transaksi
+    if (entry.section.settings.copies > 1) entry.section.settings.softwareCopies = true;
+
+    std::string orientation;
+    if (section.type == TransactionSection::Type::kSeparator) {
+      if (!SeparatorCache::Shared().loaded()) {
+        *errorCode = "SEPARATOR_NOT_LOADED";
+        *errorMessage = "Separator PDF is not loaded.";
+        return false;
+      }
+      orientation = SeparatorCache::Shared().orientation();
+      entry.estimatedPages = SeparatorCache::Shared().page_count();
+    } else {
+      std::string loadError;
+      entry.document = DocumentCache::Shared().Acquire(section.filePath, &loadError);
+      if (!entry.document) {
+        *errorCode = "POPPLER_LOAD_ERROR";
+        *errorMessage = loadError;
+        return false;
+      }
+      orientation = ResolveOrientation(&entry.document, section.settings);
+      entry.estimatedPages =
+          (int)ResolvePageIndices(entry.section.settings, entry.document.page_count()).size() *
+          std::max(1, entry.section.settings.copies);
+    }
+
+    entry.setup.pageSize = section.settings.pageSize;
+    entry.setup.color = section.settings.color;
+    entry.setup.duplex = section.settings.doubleSided;
+    entry.setup.landscape = orientation != "portrait";
+    prepared->push_back(std::move(entry));
+  }
+  return true;
+}
+
+SpoolResult SpoolTransaction(PrintSink* sink,
+                             std::vector<PreparedSection>* sections,
+                             const SpoolProgressCallback& onProgress) {
+  SpoolResult result;
+  auto startTime = std::chrono::steady_clock::now();
+  CountingSink counter(sink);
+
+  int totalPages = 0;
+  for (const PreparedSection& entry : *sections) totalPages += entry.estimatedPages;
+
+  for (size_t i = 0; i < sections->size(); ++i) {
+    PreparedSection& entry = (*sections)[i];
+    if (i > 0) {
+      const PreparedSection& previous = (*sections)[i - 1];
+      // Sisi belakang kosong supaya bagian berikutnya mulai di lembar baru
+      if (previous.setup.duplex && counter.sides() % 2 == 1) {
+        if (!counter.StartPage() || !counter.EndPage()) {
+          result.errorCode = "END_PAGE_FAILED";
+          result.errorMessage = "Failed to pad duplex section.";
+          return result;
+        }
+      }
+      if (entry.setup != previous.setup && !counter.ChangePageSetup(entry.setup)) {
+        result.errorCode = "PAGE_SETUP_FAILED";
+        result.errorMessage = "Failed to change page setup for section " + std::to_string(i + 1) + ".";
+        return result;
+      }
+    }
+    counter.ResetSides();
+
+    int pagesBefore = result.pagesSpooled;
+    SpoolProgressCallback sectionProgress;
+    if (onProgress) {
+      sectionProgress = [&](int pagesSpooled, int) {
+        int done = pagesBefore + pagesSpooled;
+        onProgress(done, std::max(totalPages, done));
+      };
+    }
+
+    SpoolResult part = entry.section.type == TransactionSection::Type::kSeparator
+        ? SeparatorCache::Shared().Spool(&counter, entry.section.settings.printerName, sectionProgress)
+        : SpoolPages(&counter, &entry.document, entry.section.filePath, entry.section.settings,
+                     sectionProgress);
+    result.pagesSpooled += part.pagesSpooled;
+    result.spilledPages += part.spilledPages;
+    result.workerCount = std::max(result.workerCount, part.workerCount);
+    result.workerBusyMs += part.workerBusyMs;
+    if (!part.ok) {
+      result.errorCode = part.errorCode;
+      result.errorMessage = part.errorMessage;
+      return result;
+    }
+
+    // Dokumen tidak dipakai lagi, kembalikan ke cache sekarang
+    entry.document.Reset();
+  }
+
+  result.elapsedMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - startTime).count();
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,47 @@
+#ifndef RUNNER_PRINT_TRANSACTION_H_
+#define RUNNER_PRINT_TRANSACTION_H_
+
+#include <string>
+#include <vector>
+
+#include "document_cache.h"
+#include "print_job.h"
+#include "print_sink.h"
+
+// One part of a customer transaction: a PDF file (invoice or print file) or
+// the bundled separator page, with its own paper, colour, duplex and copies.
+struct TransactionSection {
+  enum class Type { kDocument, kSeparator };
+
+  Type type = Type::kDocument;
+  // kDocument only.
+  std::string filePath;
+  PrintSettings settings;
+};
+
+// A section with its document leased and its page setup resolved.
+struct PreparedSection {
+  TransactionSection section;
+  DocumentLease document;
+  PageSetup setup;
+  // Pages the section will spool, blank padding not included.
+  int estimatedPages = 0;
+};
+
+// Leases every document of |sections| and resolves their page setups, so a
+// missing or broken file fails the transaction before anything is spooled.
+bool PrepareTransaction(const std::vector<TransactionSection>& sections,
+                        std::vector<PreparedSection>* prepared,
+                        std::string* errorCode, std::string* errorMessage);
+
+// Spools all |sections| (same printer) into the one document already started
+// on |sink|, which is set up for the first section. Between sections the
+// sink's page setup is changed when it differs, and a duplex section that
+// ends on a front side gets a blank back so the next section starts on a new
+// sheet. Copies are always produced in software, since driver copies would
+// repeat the whole document. Progress counts pages over all sections.
+SpoolResult SpoolTransaction(PrintSink* sink,
+                             std::vector<PreparedSection>* sections,
+                             const SpoolProgressCallback& onProgress);
+
+#endif  // RUNNER_PRINT_TRANSACTION_H_
@@ -0,0 +1,314 @@
+#include "printer_capability_db.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace {
+
+constexpr char kDbHeader[] = "hlaprint-printer-caps 1";
+
+// Tenths of a millimetre a driver's size may be off by (rounding of inch
+// sizes, drivers reporting printable instead of physical size).
+constexpr int kSizeTolerance = 20;
+
+struct StandardPaper {
+  const char* name;
+  int width;
+  int height;
+};
+
+constexpr StandardPaper kStandardPapers[] = {
+    {"A3", 2970, 4200},     {"A4", 2100, 2970},     {"A5", 1480, 2100},
+    {"A6", 1050, 1480},     {"B5", 1760, 2500},     {"F4", 2150, 3300},
+    {"FOLIO", 2159, 3302},  {"LETTER", 2159, 2794}, {"LEGAL", 2159, 3556},
+};
+
+std::string ToUpper(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](unsigned char c) { return (char)std::toupper(c); });
+  return text;
+}
+
+// Tabs and newlines separate fields in the file.
+std::string Sanitize(std::string text) {
+  std::replace_if(text.begin(), text.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; },
+                  ' ');
+  return text;
+}
+
+std::vector<std::string> SplitTabs(const std::string& line) {
+  std::vector<std::string> fields;
+  std::string field;
+  std::istringstream in(line);
+  while (std::getline(in, field, '\t')) fields.push_back(field);
+  return fields;
+}
+
+bool SameSize(const PaperInfo& paper, int width, int height) {
+  auto near = [](int a, int b) { return std::abs(a - b) <= kSizeTolerance; };
+  return (near(paper.width, width) && near(paper.height, height)) ||
+         (near(paper.width, height) && near(paper.height, width));
+}
+
+std::string Resolve(const PrinterCapabilities& caps, const std::string& target) {
+  // 1. Nama sama persis (tanpa beda huruf besar/kecil)
+  for (const PaperInfo& paper : caps.papers) {
+    if (ToUpper(paper.name) == target) return paper.name;
+  }
+  // 2. F4 sering disebut Folio atau Oficio oleh driver
+  if (target == "F4") {
+    for (const PaperInfo& paper : caps.papers) {
+      std::string upper = ToUpper(paper.name);
+      if (upper.find("FOLIO") != std::string::npos || upper.find("OFICIO") != std::string::npos ||
+          upper.find("F4") != std::string::npos) {
+        return paper.name;
+      }
+    }
+  }
+  // 3. Ukuran standarnya, nama terpendek menang ("A5" bukan "A5 Extra")
+  const PaperInfo* best = nullptr;
+  int width = 0, height = 0;
+  if (StandardPaperSize(target, &width, &height)) {
+    for (const PaperInfo& paper : caps.papers) {
+      if (SameSize(paper, width, height) && (!best || paper.name.size() < best->name.size())) {
+        best = &paper;
+      }
+    }
+    if (best) return best->name;
+  }
+  // 4. Nama yang mengandung target, terpendek menang
+  for (const PaperInfo& paper : caps.papers) {
+    if (ToUpper(paper.name).find(target) != std::string::npos &&
+        (!best || paper.name.size() < best->name.size())) {
+      best = &paper;
+    }
+  }
+  return best ? best->name : std::string();
+}
+
+}  // namespace
+
+bool StandardPaperSize(const std::string& name, int* width, int* height) {
+  std::string upper = ToUpper(name);
+  for (const StandardPaper& paper : kStandardPapers) {
+    if (upper == paper.name) {
+      *width = paper.width;
+      *height = paper.height;
+      return true;
+    }
+  }
+  return false;
+}
+
+PrinterCapabilityDb::PrinterCapabilityDb(std::unique_ptr<CapabilityProvider> provider)
+    : provider_(std::move(provider)) {
+  thread_ = std::thread(&PrinterCapabilityDb::Run, this);
+}
+
+PrinterCapabilityDb::~PrinterCapabilityDb() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void PrinterCapabilityDb::Open(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  path_ = path;
+
+  std::ifstream in(std::filesystem::u8path(path));
+  std::string line;
+  if (!in || !std::getline(in, line) || line != kDbHeader) return;
+
+  // "printer" memulai entri baru, baris "paper" sesudahnya milik printer itu
+  std::shared_ptr<PrinterCapabilities> current;
+  std::string currentName;
+  auto commit = [&]() {
+    if (current && !entries_.count(currentName)) entries_[currentName].caps = current;
+    current.reset();
+  };
+  while (std::getline(in, line)) {
+    std::vector<std::string> fields = SplitTabs(line);
+    // Daftar DPI kosong membuat kolom terakhir hilang
+    if ((fields.size() == 9 || fields.size() == 10) && fields[0] == "printer") {
+      commit();
+      current = std::make_shared<PrinterCapabilities>();
+      currentName = fields[1];
+      current->driverVersion = fields[2];
+      current->duplex = fields[3] == "1";
+      current->color = fields[4] == "1";
+      current->marginLeft = std::atof(fields[5].c_str());
+      current->marginTop = std::atof(fields[6].c_str());
+      current->marginRight = std::atof(fields[7].c_str());
+      current->marginBottom = std::atof(fields[8].c_str());
+      std::istringstream dpis(fields.size() == 10 ? fields[9] : "");
+      int dpi = 0;
+      while (dpis >> dpi) current->dpis.push_back(dpi);
+    } else if (fields.size() == 5 && fields[0] == "paper" && current) {
+      PaperInfo paper;
+      paper.id = std::atoi(fields[1].c_str());
+      paper.width = std::atoi(fields[2].c_str());
+      paper.height = std::atoi(fields[3].c_str());
+      paper.name = fields[4];
+      current->papers.push_back(paper);
+    }
+  }
+  commit();
+}
+
+void PrinterCapabilityDb::Preload() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    preload_pending_ = true;
+  }
+  cv_.notify_all();
+}
+
+void PrinterCapabilityDb::Run() {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stopping_ || preload_pending_; });
+      if (stopping_) return;
+      preload_pending_ = false;
+    }
+
+    std::vector<std::string> printers;
+    {
+      std::lock_guard<std::mutex> lock(provider_mutex_);
+      printers = provider_->ListPrinters();
+    }
+    for (const std::string& printer : printers) {
+      std::shared_ptr<const PrinterCapabilities> known;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        auto it = entries_.find(printer);
+        if (it != entries_.end()) known = it->second.caps;
+      }
+      if (known) {
+        std::string version;
+        bool found;
+        {
+          std::lock_guard<std::mutex> lock(provider_mutex_);
+          found = provider_->DriverVersion(printer, &version);
+        }
+        if (!found || version == known->driverVersion) continue;
+      }
+      Build(printer);
+    }
+    Save();
+  }
+}
+
+std::shared_ptr<const PrinterCapabilities> PrinterCapabilityDb::Build(const std::string& printer) {
+  auto caps = std::make_shared<PrinterCapabilities>();
+  bool queried;
+  {
+    std::lock_guard<std::mutex> lock(provider_mutex_);
+    queried = provider_->Query(printer, caps.get());
+  }
+  if (!queried) return nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[printer];
+  if (entry.caps) stats_.rebuilds++;
+  entry.caps = caps;
+  entry.resolved.clear();
+  dirty_ = true;
+  return caps;
+}
+
+std::shared_ptr<const PrinterCapabilities> PrinterCapabilityDb::Get(const std::string& printer) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(printer);
+    if (it != entries_.end() && it->second.caps) {
+      stats_.hits++;
+      return it->second.caps;
+    }
+    stats_.misses++;
+  }
+  std::shared_ptr<const PrinterCapabilities> caps = Build(printer);
+  if (caps) Save();
+  return caps;
+}
+
+bool PrinterCapabilityDb::ResolvePaperName(const std::string& printer, const std::string& target,
+                                           std::string* name) {
+  std::string key = ToUpper(target);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(printer);
+    if (it != entries_.end() && it->second.caps) {
+      auto resolved = it->second.resolved.find(key);
+      if (resolved != it->second.resolved.end()) {
+        stats_.hits++;
+        *name = resolved->second;
+        return !name->empty();
+      }
+    }
+  }
+
+  std::shared_ptr<const PrinterCapabilities> caps = Get(printer);
+  if (!caps) return false;
+  std::string result = Resolve(*caps, key);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(printer);
+    // Bisa saja entri dibangun ulang sementara itu; hasil lama tidak disimpan
+    if (it != entries_.end() && it->second.caps == caps) it->second.resolved[key] = result;
+  }
+  *name = result;
+  return !result.empty();
+}
+
+void PrinterCapabilityDb::Invalidate(const std::string& printer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.erase(printer)) dirty_ = true;
+}
+
+CapabilityDbStats PrinterCapabilityDb::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PrinterCapabilityDb::Save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!dirty_ || path_.empty()) return;
+
+  // Tulis ke file sementara lalu rename, supaya file tidak pernah setengah jadi
+  std::filesystem::path target = std::filesystem::u8path(path_);
+  std::filesystem::path temp = target;
+  temp += ".tmp";
+  std::error_code ec;
+  std::filesystem::create_directories(target.parent_path(), ec);
+  {
+    std::ofstream out(temp, std::ios::trunc);
+    if (!out) return;
+    out << kDbHeader << "\n";
+    for (const auto& entry : entries_) {
+      const PrinterCapabilities& caps = *entry.second.caps;
+      out << "printer\t" << Sanitize(entry.first) << "\t" << Sanitize(caps.driverVersion) << "\t"
+          << (caps.duplex ? 1 : 0) << "\t" << (caps.color ? 1 : 0) << "\t"
+          << caps.marginLeft << "\t" << caps.marginTop << "\t"
+          << caps.marginRight << "\t" << caps.marginBottom << "\t";
+      for (size_t i = 0; i < caps.dpis.size(); ++i) out << (i ? " " : "") << caps.dpis[i];
+      out << "\n";
+      for (const PaperInfo& paper : caps.papers) {
+        out << "paper\t" << paper.id << "\t" << paper.width << "\t" << paper.height << "\t"
+            << Sanitize(paper.name) << "\n";
+      }
+    }
+    if (!out) return;
+  }
+  std::filesystem::rename(temp, target, ec);
+  if (!ec) dirty_ = false;
+}
@@ -0,0 +1,124 @@
+#ifndef RUNNER_PRINTER_CAPABILITY_DB_H_
+#define RUNNER_PRINTER_CAPABILITY_DB_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct PaperInfo {
+  int id = 0;  // DMPAPER_* code on Windows, 0 where the system has none
+  std::string name;
+  // Portrait size in tenths of a millimetre, 0 if unknown.
+  int width = 0;
+  int height = 0;
+};
+
+// Everything the app asks a printer driver about, captured once.
+struct PrinterCapabilities {
+  // Changes whenever the driver is updated or replaced; entries built for an
+  // older version are rebuilt.
+  std::string driverVersion;
+  std::vector<PaperInfo> papers;
+  std::vector<int> dpis;
+  bool duplex = false;
+  bool color = false;
+  // Unprintable area of the default paper, in points.
+  double marginLeft = 0.0;
+  double marginTop = 0.0;
+  double marginRight = 0.0;
+  double marginBottom = 0.0;
+};
+
+// What the database needs from the print system. The Win32 implementation
+// (Win32CapabilityProvider) asks DeviceCapabilities, the Linux one CUPS
+// printer attributes; tests can substitute a fake.
+class CapabilityProvider {
+ public:
+  virtual ~CapabilityProvider() = default;
+
+  virtual std::vector<std::string> ListPrinters() = 0;
+  // Cheap compared to Query. Returns false if the printer is gone.
+  virtual bool DriverVersion(const std::string& printer, std::string* version) = 0;
+  // Fills everything including driverVersion.
+  virtual bool Query(const std::string& printer, PrinterCapabilities* caps) = 0;
+};
+
+struct CapabilityDbStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t rebuilds = 0;
+};
+
+// Capabilities of every installed printer, built in the background at
+// startup and persisted to a small text file, so paper lookups never reach
+// the driver on the caller's thread once a printer is known. Persisted
+// entries whose driver version no longer matches are rebuilt during Preload.
+// Thread-safe.
+class PrinterCapabilityDb {
+ public:
+  explicit PrinterCapabilityDb(std::unique_ptr<CapabilityProvider> provider);
+  ~PrinterCapabilityDb();
+
+  // Prevent copying.
+  PrinterCapabilityDb(PrinterCapabilityDb const&) = delete;
+  PrinterCapabilityDb& operator=(PrinterCapabilityDb const&) = delete;
+
+  // Loads previously saved entries from |path| and saves there from now on.
+  void Open(const std::string& path);
+
+  // Checks every installed printer on the background thread, rebuilding
+  // missing and outdated entries.
+  void Preload();
+
+  // Returns the capabilities of |printer|. A printer not known yet is
+  // queried on the calling thread once.
+  std::shared_ptr<const PrinterCapabilities> Get(const std::string& printer);
+
+  // Finds the driver's name for the paper the app calls |target| ("A4",
+  // "F4", "Letter", ...): an exact name, then a paper of the standard size,
+  // then the shortest name containing |target|. Results are memoised per
+  // printer. Returns false if nothing matches.
+  bool ResolvePaperName(const std::string& printer, const std::string& target, std::string* name);
+
+  // Drops |printer| so the next Get queries the driver again.
+  void Invalidate(const std::string& printer);
+
+  CapabilityDbStats stats();
+
+ private:
+  struct Entry {
+    std::shared_ptr<const PrinterCapabilities> caps;
+    // Upper-cased target -> resolved name ("" = no match).
+    std::unordered_map<std::string, std::string> resolved;
+  };
+
+  void Run();
+  std::shared_ptr<const PrinterCapabilities> Build(const std::string& printer);
+  void Save();
+
+  std::unique_ptr<CapabilityProvider> provider_;
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  std::string path_;
+  bool dirty_ = false;
+  CapabilityDbStats stats_;
+
+  // Calls into the provider are serialised; drivers are not all reentrant.
+  std::mutex provider_mutex_;
+  std::condition_variable cv_;
+  bool preload_pending_ = false;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+// Standard size of an app paper name in tenths of a millimetre; false for
+// names the table does not know.
+bool StandardPaperSize(const std::string& name, int* width, int* height);
+
+#endif  // RUNNER_PRINTER_CAPABILITY_DB_H_
@@ -0,0 +1,87 @@
+#include "printer_session_cache.h"
+
+PrinterSessionCache::PrinterSessionCache(std::unique_ptr<PrinterDriver> driver)
+    : driver_(std::move(driver)) {}
+
+PrinterSessionCache::~PrinterSessionCache() {
+  for (auto& entry : sessions_) {
+    if (entry.second->handle) driver_->Close(entry.second->handle);
+  }
+}
+
+std::shared_ptr<PrinterSessionCache::Session> PrinterSessionCache::GetSession(
+    const std::string& printerName) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<Session>& session = sessions_[printerName];
+  if (!session) session = std::make_shared<Session>();
+  return session;
+}
+
+bool PrinterSessionCache::AcquireDevMode(const std::string& printerName,
+                                         const DevModeRequest& request,
+                                         std::vector<unsigned char>* devMode,
+                                         bool* cacheHit,
+                                         std::string* errorCode) {
+  std::shared_ptr<Session> session = GetSession(printerName);
+  std::lock_guard<std::mutex> lock(session->mutex);
+
+  // Driver atau setelan default berubah sejak job terakhir, bangun ulang semuanya
+  if (session->handle && driver_->ConsumeChange(session->handle)) {
+    driver_->Close(session->handle);
+    session->handle = nullptr;
+    session->devModes.clear();
+    std::lock_guard<std::mutex> statsLock(mutex_);
+    stats_.invalidations++;
+  }
+
+  auto cached = session->devModes.find(request);
+  bool hit = session->handle && cached != session->devModes.end();
+  if (cacheHit) *cacheHit = hit;
+  {
+    std::lock_guard<std::mutex> statsLock(mutex_);
+    hit ? stats_.hits++ : stats_.misses++;
+  }
+  if (hit) {
+    *devMode = cached->second;
+    return true;
+  }
+
+  if (!session->handle) {
+    session->handle = driver_->Open(printerName);
+    if (!session->handle) {
+      if (errorCode) *errorCode = "PRINTER_NOT_FOUND";
+      return false;
+    }
+  }
+
+  std::vector<unsigned char> built;
+  if (!driver_->BuildDevMode(session->handle, printerName, request, &built, errorCode)) {
+    return false;
+  }
+  session->devModes[request] = built;
+  *devMode = std::move(built);
+  return true;
+}
+
+void PrinterSessionCache::Invalidate(const std::string& printerName) {
+  std::shared_ptr<Session> session;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(printerName);
+    if (it == sessions_.end()) return;
+    session = it->second;
+    stats_.invalidations++;
+  }
+
+  std::lock_guard<std::mutex> lock(session->mutex);
+  if (session->handle) {
+    driver_->Close(session->handle);
+    session->handle = nullptr;
+  }
+  session->devModes.clear();
+}
+
+PrinterSessionStats PrinterSessionCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
@@ -0,0 +1,97 @@
+#ifndef RUNNER_PRINTER_SESSION_CACHE_H_
+#define RUNNER_PRINTER_SESSION_CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// The DEVMODE settings that need a driver round trip to validate. Copies and
+// collation are patched onto the validated copy by the caller.
+struct DevModeRequest {
+  int paperSize = 0;  // DMPAPER_* code
+  bool color = false;
+  bool duplex = false;
+  bool landscape = false;
+
+  bool operator<(const DevModeRequest& other) const {
+    return std::tie(paperSize, color, duplex, landscape) <
+           std::tie(other.paperSize, other.color, other.duplex, other.landscape);
+  }
+};
+
+// What the cache needs from the print system. The Win32 implementation
+// (Win32PrinterDriver) talks to the spooler; tests can substitute a fake.
+class PrinterDriver {
+ public:
+  using Handle = void*;
+
+  virtual ~PrinterDriver() = default;
+
+  // Returns nullptr if the printer cannot be opened.
+  virtual Handle Open(const std::string& printerName) = 0;
+  virtual void Close(Handle handle) = 0;
+
+  // Fills |devMode| with the printer's default DEVMODE merged with |request|
+  // and validated by the driver.
+  virtual bool BuildDevMode(Handle handle, const std::string& printerName,
+                            const DevModeRequest& request,
+                            std::vector<unsigned char>* devMode,
+                            std::string* errorCode) = 0;
+
+  // Returns true if the printer's driver or default settings changed since the
+  // previous call (or the printer went away). Must not block.
+  virtual bool ConsumeChange(Handle handle) = 0;
+};
+
+struct PrinterSessionStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t invalidations = 0;
+};
+
+// Keeps one open printer handle per printer together with the validated
+// DEVMODEs built for it, so repeated jobs skip OpenPrinter and the
+// DocumentProperties round trips. A printer's entries are dropped when its
+// driver reports a change. Thread-safe; different printers do not block each
+// other.
+class PrinterSessionCache {
+ public:
+  explicit PrinterSessionCache(std::unique_ptr<PrinterDriver> driver);
+  ~PrinterSessionCache();
+
+  // Prevent copying.
+  PrinterSessionCache(PrinterSessionCache const&) = delete;
+  PrinterSessionCache& operator=(PrinterSessionCache const&) = delete;
+
+  // Copies the validated DEVMODE for |request| into |devMode|. |cacheHit|
+  // (optional) tells whether the driver had to be asked.
+  bool AcquireDevMode(const std::string& printerName,
+                      const DevModeRequest& request,
+                      std::vector<unsigned char>* devMode, bool* cacheHit,
+                      std::string* errorCode);
+
+  // Drops the session of |printerName|, e.g. after a job failed on it.
+  void Invalidate(const std::string& printerName);
+
+  PrinterSessionStats stats();
+
+ private:
+  struct Session {
+    std::mutex mutex;
+    PrinterDriver::Handle handle = nullptr;
+    std::map<DevModeRequest, std::vector<unsigned char>> devModes;
+  };
+
+  std::shared_ptr<Session> GetSession(const std::string& printerName);
+
+  std::unique_ptr<PrinterDriver> driver_;
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<Session>> sessions_;
+  PrinterSessionStats stats_;
+};
+
+#endif  // RUNNER_PRINTER_SESSION_CACHE_H_
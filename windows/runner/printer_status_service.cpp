@@ -0,0 +1,154 @@
+#include "printer_status_service.h"
+
+#include <algorithm>
+
+bool PrinterStatus::operator==(const PrinterStatus& other) const {
+  return online == other.online && status == other.status && rawStatus == other.rawStatus &&
+         queuedJobs == other.queuedJobs && pagesPerMinute == other.pagesPerMinute;
+}
+
+PrinterStatusService::PrinterStatusService(std::unique_ptr<SpoolBackend> backend,
+                                           ChangeCallback changed)
+    : backend_(std::move(backend)), changed_(std::move(changed)) {
+  thread_ = std::thread(&PrinterStatusService::Run, this);
+}
+
+PrinterStatusService::~PrinterStatusService() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  backend_->Wake();
+  thread_.join();
+  for (const auto& entry : printers_) {
+    if (entry.second.added) backend_->RemoveQueue(entry.first);
+  }
+}
+
+void PrinterStatusService::SetPrinters(const std::vector<std::string>& printers) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wanted_.clear();
+    for (const std::string& printer : printers) {
+      if (!printer.empty() && std::find(wanted_.begin(), wanted_.end(), printer) == wanted_.end()) {
+        wanted_.push_back(printer);
+      }
+    }
+    wanted_dirty_ = true;
+  }
+  backend_->Wake();
+}
+
+bool PrinterStatusService::Get(const std::string& printer, PrinterStatus* status) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = snapshots_.find(printer);
+  if (it == snapshots_.end()) return false;
+  *status = it->second;
+  return true;
+}
+
+std::vector<std::pair<std::string, PrinterStatus>> PrinterStatusService::Snapshot() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<std::pair<std::string, PrinterStatus>>(snapshots_.begin(), snapshots_.end());
+}
+
+void PrinterStatusService::Run() {
+  std::vector<std::string> changed;
+  auto lastRefresh = std::chrono::steady_clock::now();
+
+  for (;;) {
+    std::vector<std::string> wanted;
+    bool wantedChanged = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) return;
+      if (wanted_dirty_) {
+        wanted = wanted_;
+        wanted_dirty_ = false;
+        wantedChanged = true;
+      }
+    }
+    if (wantedChanged) {
+      for (auto it = printers_.begin(); it != printers_.end();) {
+        if (std::find(wanted.begin(), wanted.end(), it->first) != wanted.end()) {
+          ++it;
+          continue;
+        }
+        if (it->second.added) backend_->RemoveQueue(it->first);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          snapshots_.erase(it->first);
+        }
+        it = printers_.erase(it);
+      }
+      for (const std::string& name : wanted) {
+        // Printer baru langsung dicek, tidak menunggu refresh berikutnya
+        if (printers_.emplace(name, Printer()).second) changed.push_back(name);
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    bool refreshAll = now - lastRefresh >= kRefreshInterval;
+    if (refreshAll) lastRefresh = now;
+    for (auto& entry : printers_) {
+      if (refreshAll || std::find(changed.begin(), changed.end(), entry.first) != changed.end()) {
+        Refresh(entry.first, &entry.second);
+      }
+    }
+
+    int timeoutMs = -1;
+    if (!printers_.empty()) {
+      timeoutMs = (int)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                lastRefresh + kRefreshInterval - now).count());
+    }
+    changed.clear();
+    backend_->Wait(timeoutMs, &changed);
+  }
+}
+
+void PrinterStatusService::Refresh(const std::string& name, Printer* printer) {
+  if (!printer->added) printer->added = backend_->AddQueue(name);
+
+  SpoolQueueInfo info;
+  PrinterStatus status;
+  if (!printer->added || !backend_->QueryQueue(name, &info)) {
+    // Printer dihapus atau tidak terjangkau: anggap offline, buka ulang saat refresh
+    if (printer->added) backend_->RemoveQueue(name);
+    *printer = Printer();
+    status.status = kSpoolQueueOffline;
+    Publish(name, status);
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  std::map<int, int> jobPages;
+  for (const auto& job : info.jobPages) {
+    auto last = printer->jobPages.find(job.first);
+    int before = last == printer->jobPages.end() ? 0 : last->second;
+    if (job.second > before) printer->printed.emplace_back(now, job.second - before);
+    jobPages[job.first] = job.second;
+  }
+  printer->jobPages.swap(jobPages);
+  while (!printer->printed.empty() && now - printer->printed.front().first > kThroughputWindow) {
+    printer->printed.pop_front();
+  }
+
+  status.status = info.status;
+  status.rawStatus = info.rawStatus;
+  status.online = !(info.status & (kSpoolQueueOffline | kSpoolQueueError | kSpoolQueuePaused));
+  status.queuedJobs = (int)info.jobPages.size();
+  for (const auto& printed : printer->printed) status.pagesPerMinute += printed.second;
+  Publish(name, status);
+}
+
+void PrinterStatusService::Publish(const std::string& name, const PrinterStatus& status) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto inserted = snapshots_.emplace(name, status);
+    if (!inserted.second) {
+      if (inserted.first->second == status) return;
+      inserted.first->second = status;
+    }
+  }
+  if (changed_) changed_(name, status);
+}
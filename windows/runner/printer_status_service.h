@@ -0,0 +1,89 @@
+#ifndef RUNNER_PRINTER_STATUS_SERVICE_H_
+#define RUNNER_PRINTER_STATUS_SERVICE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "spool_watcher.h"
+
+// Latest known state of one printer.
+struct PrinterStatus {
+  bool online = false;
+  uint32_t status = 0;  // SpoolQueueStatus bits
+  uint32_t rawStatus = 0;
+  int queuedJobs = 0;
+  // Pages printed over the last kThroughputWindow.
+  int pagesPerMinute = 0;
+
+  bool operator==(const PrinterStatus& other) const;
+  bool operator!=(const PrinterStatus& other) const { return !(*this == other); }
+};
+
+// Keeps a status snapshot of every configured printer, refreshed on the
+// backend's change notifications from one background thread, so reading a
+// printer's status is a map lookup instead of an OpenPrinter/GetPrinter
+// round trip on the caller's thread. Printers are also resynced every
+// kRefreshInterval, which catches missed notifications and retries printers
+// that could not be opened. |changed| runs on that thread, only when a
+// printer's snapshot actually changes.
+class PrinterStatusService {
+ public:
+  using ChangeCallback = std::function<void(const std::string& printer, const PrinterStatus& status)>;
+
+  static constexpr std::chrono::milliseconds kRefreshInterval{5000};
+  static constexpr std::chrono::seconds kThroughputWindow{60};
+
+  PrinterStatusService(std::unique_ptr<SpoolBackend> backend, ChangeCallback changed);
+  ~PrinterStatusService();
+
+  // Prevent copying.
+  PrinterStatusService(PrinterStatusService const&) = delete;
+  PrinterStatusService& operator=(PrinterStatusService const&) = delete;
+
+  // Replaces the set of watched printers. Snapshots of printers no longer in
+  // the set are dropped; new ones are queried right away.
+  void SetPrinters(const std::vector<std::string>& printers);
+
+  // Returns false if |printer| is not watched or not queried yet.
+  bool Get(const std::string& printer, PrinterStatus* status);
+
+  // Snapshots of every watched printer queried so far.
+  std::vector<std::pair<std::string, PrinterStatus>> Snapshot();
+
+ private:
+  struct Printer {
+    // AddQueue succeeded; otherwise retried on every refresh.
+    bool added = false;
+    // Pages printed so far by each job still in the queue.
+    std::map<int, int> jobPages;
+    // Pages that came out recently, for pagesPerMinute.
+    std::deque<std::pair<std::chrono::steady_clock::time_point, int>> printed;
+  };
+
+  void Run();
+  void Refresh(const std::string& name, Printer* printer);
+  void Publish(const std::string& name, const PrinterStatus& status);
+
+  std::unique_ptr<SpoolBackend> backend_;
+  ChangeCallback changed_;
+  std::mutex mutex_;
+  std::vector<std::string> wanted_;
+  bool wanted_dirty_ = false;
+  bool stopping_ = false;
+  std::unordered_map<std::string, PrinterStatus> snapshots_;
+  // Owned by the service thread.
+  std::map<std::string, Printer> printers_;
+  std::thread thread_;
+};
+
+#endif  // RUNNER_PRINTER_STATUS_SERVICE_H_
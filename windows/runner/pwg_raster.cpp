@@ -0,0 +1,330 @@
+#include "pwg_raster.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PWG_RASTER_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+// Offset header PWG (PWG 5102.4 bagian 4.3), semuanya big-endian
+constexpr size_t kMediaClass = 0;
+constexpr size_t kDuplex = 272;
+constexpr size_t kHwResolution = 276;
+constexpr size_t kPageSize = 352;
+constexpr size_t kTumble = 368;
+constexpr size_t kWidth = 372;
+constexpr size_t kHeight = 376;
+constexpr size_t kBitsPerColor = 384;
+constexpr size_t kBitsPerPixel = 388;
+constexpr size_t kBytesPerLine = 392;
+constexpr size_t kColorSpace = 400;
+constexpr size_t kNumColors = 420;
+constexpr size_t kTotalPageCount = 452;
+constexpr size_t kCrossFeedTransform = 456;
+constexpr size_t kFeedTransform = 460;
+constexpr size_t kImageBox = 464;
+constexpr size_t kAlternatePrimary = 480;
+constexpr size_t kPageSizeName = 1732;
+constexpr size_t kStringSize = 64;
+
+// Nilai ColorSpace PWG
+constexpr uint32_t kPwgBlack = 3;
+constexpr uint32_t kPwgSGray = 18;
+constexpr uint32_t kPwgSRgb = 19;
+
+// Kode kompresi: 0..127 ulang piksel berikut n+1 kali, 129..255 salin
+// 257-n piksel apa adanya, 128 isi sisa baris dengan putih
+constexpr uint8_t kFillWhite = 128;
+constexpr size_t kMaxRun = 128;
+constexpr int kMaxLineRepeat = 256;
+
+void PutUint32(uint8_t* out, size_t offset, uint32_t value) {
+  out[offset] = (uint8_t)(value >> 24);
+  out[offset + 1] = (uint8_t)(value >> 16);
+  out[offset + 2] = (uint8_t)(value >> 8);
+  out[offset + 3] = (uint8_t)value;
+}
+
+uint32_t GetUint32(const uint8_t* data, size_t offset) {
+  return ((uint32_t)data[offset] << 24) | ((uint32_t)data[offset + 1] << 16) |
+         ((uint32_t)data[offset + 2] << 8) | (uint32_t)data[offset + 3];
+}
+
+void PutString(uint8_t* out, size_t offset, const std::string& value) {
+  // Selalu diakhiri nol, jadi maksimal 63 karakter
+  memcpy(out + offset, value.data(), std::min(value.size(), kStringSize - 1));
+}
+
+int BytesPerPixelUnit(RasterColorSpace space) {
+  // black_1 dikompresi per byte (8 piksel), bukan per piksel
+  return space == RasterColorSpace::kRgb8 ? 3 : 1;
+}
+
+uint8_t WhiteByte(RasterColorSpace space) {
+  return space == RasterColorSpace::kBlack1 ? 0x00 : 0xFF;
+}
+
+#ifdef PWG_RASTER_SSE2
+int CountTrailingZeros(unsigned mask) {
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Leading bytes of |a| and |b| that agree, at most |count|.
+size_t EqualPrefix(const uint8_t* a, const uint8_t* b, size_t count) {
+  size_t i = 0;
+#ifdef PWG_RASTER_SSE2
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    unsigned differ = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFu;
+    if (differ) return i + CountTrailingZeros(differ);
+  }
+#endif
+  while (i < count && a[i] == b[i]) ++i;
+  return i;
+}
+
+// |count| minus the run of |fill| bytes at the end of |data|.
+size_t TrimTrailing(const uint8_t* data, size_t count, uint8_t fill) {
+#ifdef PWG_RASTER_SSE2
+  const __m128i filled = _mm_set1_epi8((char)fill);
+  while (count >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + count - 16));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, filled)) != 0xFFFF) break;
+    count -= 16;
+  }
+#endif
+  while (count > 0 && data[count - 1] == fill) --count;
+  return count;
+}
+
+// First pixel of |line| (of |count|) equal to the one after it, or |count|
+// if there is none: where a literal stretch has to stop for a run.
+size_t FirstRepeat(const uint8_t* line, size_t count, int pixelBytes) {
+  size_t k = 0;
+  if (pixelBytes == 1) {
+#ifdef PWG_RASTER_SSE2
+    for (; k + 17 <= count; k += 16) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + k));
+      __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + k + 1));
+      unsigned equal = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+      if (equal) return k + CountTrailingZeros(equal);
+    }
+#endif
+    for (; k + 1 < count; ++k) {
+      if (line[k] == line[k + 1]) return k;
+    }
+    return count;
+  }
+  for (; k + 1 < count; ++k) {
+    if (memcmp(line + k * pixelBytes, line + (k + 1) * pixelBytes, pixelBytes) == 0) return k;
+  }
+  return count;
+}
+
+void EncodeLine(const uint8_t* line, int bytesPerLine, int pixelBytes, uint8_t white,
+                std::vector<uint8_t>* out) {
+  size_t pixels = (size_t)(bytesPerLine / pixelBytes);
+  // Ekor putih cukup satu kode, biasanya separuh kanan baris teks
+  size_t end = (TrimTrailing(line, bytesPerLine, white) + pixelBytes - 1) / pixelBytes;
+  size_t i = 0;
+  while (i < end) {
+    size_t limit = std::min(end, i + kMaxRun);
+    const uint8_t* pixel = line + i * pixelBytes;
+    size_t run = 1 + EqualPrefix(pixel + pixelBytes, pixel, (limit - i - 1) * pixelBytes) / pixelBytes;
+    size_t literal = run > 1 ? 0 : FirstRepeat(pixel, limit - i, pixelBytes);
+    if (literal <= 1) {
+      out->push_back((uint8_t)(run - 1));
+      out->insert(out->end(), pixel, pixel + pixelBytes);
+      i += run;
+      continue;
+    }
+    out->push_back((uint8_t)(257 - literal));
+    out->insert(out->end(), pixel, pixel + literal * pixelBytes);
+    i += literal;
+  }
+  if (end < pixels) out->push_back(kFillWhite);
+}
+
+}  // namespace
+
+const char* RasterColorSpaceName(RasterColorSpace space) {
+  switch (space) {
+    case RasterColorSpace::kBlack1: return "black_1";
+    case RasterColorSpace::kGray8: return "sgray_8";
+    case RasterColorSpace::kRgb8: return "srgb_8";
+  }
+  return "sgray_8";
+}
+
+int RasterBitsPerPixel(RasterColorSpace space) {
+  switch (space) {
+    case RasterColorSpace::kBlack1: return 1;
+    case RasterColorSpace::kGray8: return 8;
+    case RasterColorSpace::kRgb8: return 24;
+  }
+  return 8;
+}
+
+int RasterBytesPerLine(RasterColorSpace space, int width) {
+  return (width * RasterBitsPerPixel(space) + 7) / 8;
+}
+
+void EncodePwgHeader(const PwgPageHeader& header, uint8_t* out) {
+  memset(out, 0, kPwgHeaderSize);
+  uint32_t colorSpace = kPwgSGray;
+  if (header.space == RasterColorSpace::kBlack1) colorSpace = kPwgBlack;
+  if (header.space == RasterColorSpace::kRgb8) colorSpace = kPwgSRgb;
+  int bitsPerPixel = RasterBitsPerPixel(header.space);
+
+  PutString(out, kMediaClass, "PwgRaster");
+  PutUint32(out, kDuplex, header.duplex ? 1 : 0);
+  PutUint32(out, kHwResolution, (uint32_t)header.dpi);
+  PutUint32(out, kHwResolution + 4, (uint32_t)header.dpi);
+  PutUint32(out, kPageSize, (uint32_t)header.pageWidth);
+  PutUint32(out, kPageSize + 4, (uint32_t)header.pageHeight);
+  PutUint32(out, kTumble, header.tumble ? 1 : 0);
+  PutUint32(out, kWidth, (uint32_t)header.width);
+  PutUint32(out, kHeight, (uint32_t)header.height);
+  PutUint32(out, kBitsPerColor, header.space == RasterColorSpace::kBlack1 ? 1 : 8);
+  PutUint32(out, kBitsPerPixel, (uint32_t)bitsPerPixel);
+  PutUint32(out, kBytesPerLine, (uint32_t)RasterBytesPerLine(header.space, header.width));
+  PutUint32(out, kColorSpace, colorSpace);
+  PutUint32(out, kNumColors, header.space == RasterColorSpace::kRgb8 ? 3 : 1);
+  PutUint32(out, kTotalPageCount, (uint32_t)header.totalPages);
+  PutUint32(out, kCrossFeedTransform, 1);
+  PutUint32(out, kFeedTransform, 1);
+  PutUint32(out, kImageBox + 8, (uint32_t)header.width);
+  PutUint32(out, kImageBox + 12, (uint32_t)header.height);
+  PutUint32(out, kAlternatePrimary, 0xFFFFFF);
+  PutString(out, kPageSizeName, header.mediaName);
+}
+
+bool DecodePwgHeader(const uint8_t* data, PwgPageHeader* header) {
+  if (memcmp(data + kMediaClass, "PwgRaster", 10) != 0) return false;
+  switch (GetUint32(data, kColorSpace)) {
+    case kPwgBlack: header->space = RasterColorSpace::kBlack1; break;
+    case kPwgSGray: header->space = RasterColorSpace::kGray8; break;
+    case kPwgSRgb: header->space = RasterColorSpace::kRgb8; break;
+    default: return false;
+  }
+  header->width = (int)GetUint32(data, kWidth);
+  header->height = (int)GetUint32(data, kHeight);
+  header->dpi = (int)GetUint32(data, kHwResolution);
+  header->pageWidth = (int)GetUint32(data, kPageSize);
+  header->pageHeight = (int)GetUint32(data, kPageSize + 4);
+  header->duplex = GetUint32(data, kDuplex) != 0;
+  header->tumble = GetUint32(data, kTumble) != 0;
+  header->totalPages = (int)GetUint32(data, kTotalPageCount);
+  const char* name = reinterpret_cast<const char*>(data + kPageSizeName);
+  header->mediaName.assign(name, strnlen(name, kStringSize));
+  if (header->width <= 0 || header->height <= 0 || header->width > 0x10000 ||
+      header->height > 0x10000) {
+    return false;
+  }
+  return GetUint32(data, kBitsPerPixel) == (uint32_t)RasterBitsPerPixel(header->space) &&
+         GetUint32(data, kBytesPerLine) ==
+             (uint32_t)RasterBytesPerLine(header->space, header->width);
+}
+
+void EncodePwgLines(const uint8_t* rows, size_t stride, int rowCount,
+                    RasterColorSpace space, int width, std::vector<uint8_t>* out) {
+  int bytesPerLine = RasterBytesPerLine(space, width);
+  int pixelBytes = BytesPerPixelUnit(space);
+  uint8_t white = WhiteByte(space);
+  int y = 0;
+  while (y < rowCount) {
+    const uint8_t* line = rows + (size_t)y * stride;
+    // Baris kosong di antara baris teks biasanya identik satu sama lain
+    int repeat = 1;
+    while (y + repeat < rowCount && repeat < kMaxLineRepeat &&
+           memcmp(line, rows + (size_t)(y + repeat) * stride, bytesPerLine) == 0) {
+      ++repeat;
+    }
+    out->push_back((uint8_t)(repeat - 1));
+    EncodeLine(line, bytesPerLine, pixelBytes, white, out);
+    y += repeat;
+  }
+}
+
+bool DecodePwgRaster(const uint8_t* data, size_t size, const RasterPageCallback& onPage,
+                     std::string* error) {
+  if (size < sizeof(kPwgSyncWord) || memcmp(data, kPwgSyncWord, sizeof(kPwgSyncWord)) != 0) {
+    *error = "Missing RaS2 sync word.";
+    return false;
+  }
+  size_t pos = sizeof(kPwgSyncWord);
+  int index = 0;
+  for (; pos < size; ++index) {
+    auto fail = [&](const char* what) {
+      *error = "Page " + std::to_string(index + 1) + ": " + what + " at byte " + std::to_string(pos) + ".";
+      return false;
+    };
+    PwgPageHeader header;
+    if (size - pos < kPwgHeaderSize) return fail("truncated header");
+    if (!DecodePwgHeader(data + pos, &header)) return fail("invalid header");
+    pos += kPwgHeaderSize;
+
+    RasterPageImage page;
+    page.width = header.width;
+    page.height = header.height;
+    page.dpi = header.dpi;
+    page.space = header.space;
+    size_t bytesPerLine = (size_t)RasterBytesPerLine(header.space, header.width);
+    size_t pixelBytes = (size_t)BytesPerPixelUnit(header.space);
+    uint8_t white = WhiteByte(header.space);
+    page.pixels.resize(bytesPerLine * header.height);
+
+    int y = 0;
+    while (y < header.height) {
+      if (pos >= size) return fail("truncated line");
+      int repeat = data[pos++] + 1;
+      if (y + repeat > header.height) return fail("line repeat past the page end");
+      uint8_t* line = page.pixels.data() + (size_t)y * bytesPerLine;
+      size_t x = 0;
+      while (x < bytesPerLine) {
+        if (pos >= size) return fail("truncated line");
+        uint8_t code = data[pos++];
+        if (code == kFillWhite) {
+          memset(line + x, white, bytesPerLine - x);
+          x = bytesPerLine;
+          break;
+        }
+        size_t count = code < kFillWhite ? (size_t)code + 1 : (size_t)(257 - code);
+        if (x + count * pixelBytes > bytesPerLine) return fail("run past the line end");
+        if (code < kFillWhite) {
+          if (size - pos < pixelBytes) return fail("truncated run");
+          for (size_t i = 0; i < count; ++i) memcpy(line + x + i * pixelBytes, data + pos, pixelBytes);
+          pos += pixelBytes;
+        } else {
+          if (size - pos < count * pixelBytes) return fail("truncated literal");
+          memcpy(line + x, data + pos, count * pixelBytes);
+          pos += count * pixelBytes;
+        }
+        x += count * pixelBytes;
+      }
+      for (int i = 1; i < repeat; ++i) memcpy(line + i * bytesPerLine, line, bytesPerLine);
+      y += repeat;
+    }
+    if (onPage && !onPage(index, page)) return true;
+  }
+  if (index == 0) {
+    *error = "No pages.";
+    return false;
+  }
+  return true;
+}
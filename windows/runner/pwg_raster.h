@@ -0,0 +1,81 @@
+#ifndef RUNNER_PWG_RASTER_H_
+#define RUNNER_PWG_RASTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Pixel formats of IPP Everywhere raster, named as in
+// pwg-raster-document-type-supported.
+enum class RasterColorSpace {
+  // 1 bit per pixel, set = black, most significant bit leftmost.
+  kBlack1,
+  // 8 bits per pixel, 0 = black, 255 = white.
+  kGray8,
+  // 8 bits per channel, R G B.
+  kRgb8,
+};
+
+const char* RasterColorSpaceName(RasterColorSpace space);
+int RasterBitsPerPixel(RasterColorSpace space);
+// Bytes of one row of |width| pixels.
+int RasterBytesPerLine(RasterColorSpace space, int width);
+
+// Sync word at the start of a PWG raster stream, then one header and the
+// compressed lines per page.
+constexpr char kPwgSyncWord[4] = {'R', 'a', 'S', '2'};
+constexpr size_t kPwgHeaderSize = 1796;
+
+// The page header fields PWG 5102.4 gives a meaning to; the rest is zero.
+struct PwgPageHeader {
+  int width = 0;
+  int height = 0;
+  int dpi = 300;
+  RasterColorSpace space = RasterColorSpace::kGray8;
+  // Page size in points, as in the job's media.
+  int pageWidth = 0;
+  int pageHeight = 0;
+  bool duplex = false;
+  bool tumble = false;
+  // PWG self-describing media name ("iso_a4_210x297mm"), may be empty.
+  std::string mediaName;
+  // Pages in the document, 0 if not known up front.
+  int totalPages = 0;
+};
+
+// Writes |header| as the big-endian kPwgHeaderSize bytes at |out|.
+void EncodePwgHeader(const PwgPageHeader& header, uint8_t* out);
+// False if |data| is not a header of a supported colour space.
+bool DecodePwgHeader(const uint8_t* data, PwgPageHeader* header);
+
+// Appends |rowCount| rows, |stride| bytes apart, in the PWG line
+// compression: each line group starts with a repeat count for identical
+// lines, then PackBits-style runs of whole pixels (bytes for black_1), and
+// a white tail is closed with a single fill code. Runs are found 16 bytes at
+// a time where SSE2 is available. Lines of separate calls are never merged,
+// so parts of a page can be encoded concurrently and concatenated.
+void EncodePwgLines(const uint8_t* rows, size_t stride, int rowCount,
+                    RasterColorSpace space, int width, std::vector<uint8_t>* out);
+
+// One decoded page; |pixels| holds height rows of RasterBytesPerLine bytes.
+struct RasterPageImage {
+  int width = 0;
+  int height = 0;
+  int dpi = 0;
+  RasterColorSpace space = RasterColorSpace::kGray8;
+  std::vector<uint8_t> pixels;
+};
+
+// Called per decoded page with its 0-based index; returning false stops
+// decoding.
+using RasterPageCallback = std::function<bool(int index, const RasterPageImage& page)>;
+
+// Decodes a whole PWG raster stream, checking the sync word, every header
+// and that each page's lines fill it exactly. Returns false with |error|
+// set at the first malformed byte.
+bool DecodePwgRaster(const uint8_t* data, size_t size, const RasterPageCallback& onPage,
+                     std::string* error);
+
+#endif  // RUNNER_PWG_RASTER_H_
@@ -0,0 +1,50 @@
+#include "raster_band.h"
+
+#include <algorithm>
+#include <cmath>
+
+RasterBands::RasterBands(int deviceWidth, int deviceHeight, double scaleX, double scaleY,
+                         int bandRows)
+    : device_height_(std::max(1, deviceHeight)), scale_x_(scaleX), scale_y_(scaleY) {
+  width_ = std::max(1, (int)std::ceil(deviceWidth * scaleX));
+  height_ = std::max(1, (int)std::ceil(device_height_ * scaleY));
+
+  if (bandRows <= 0) {
+    // Otomatis: satu pita selama halaman muat di kMaxRasterBandBytes.
+    // Dibulatkan ke bawah ke kelipatan 8 agar pembulatan di bawah tidak melewati batas
+    size_t rowBytes = (size_t)width_ * 4;
+    bandRows = (int)std::min<size_t>(kMaxRasterBandBytes / rowBytes / 8 * 8, (size_t)height_);
+  }
+  band_rows_ = std::max(8, (bandRows + 7) / 8 * 8);
+  if (band_rows_ >= height_) band_rows_ = height_;
+  band_count_ = (height_ + band_rows_ - 1) / band_rows_;
+}
+
+int RasterBands::band_rows(int band) const {
+  return std::min(band_rows_, height_ - band_top(band));
+}
+
+int RasterBands::device_top(int band) const {
+  if (band <= 0) return 0;
+  if (band >= band_count_) return device_height_;
+  return std::min(device_height_, (int)std::lround(band_top(band) / scale_y_));
+}
+
+int RasterBands::device_bottom(int band) const {
+  return device_top(band + 1);
+}
+
+cairo_surface_t* RasterBands::CreateBandSurface(int band) const {
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width_, band_rows(band));
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(surface);
+    return nullptr;
+  }
+  cairo_t* cr = cairo_create(surface);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_set_device_scale(surface, scale_x_, scale_y_);
+  cairo_surface_set_device_offset(surface, 0, -band_top(band));
+  return surface;
+}
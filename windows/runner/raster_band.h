@@ -0,0 +1,50 @@
+#ifndef RUNNER_RASTER_BAND_H_
+#define RUNNER_RASTER_BAND_H_
+
+#include <cairo/cairo.h>
+
+#include <cstddef>
+
+// Largest RGB24 band allocated when the caller leaves the band height to
+// RasterBands. Pages that fit are drawn in one piece, larger ones (A3 or
+// 600 dpi) are cut so a page never needs more than this at once.
+constexpr size_t kMaxRasterBandBytes = 64 * 1024 * 1024;
+
+// A raster page of |deviceWidth| x |deviceHeight| device pixels stored at
+// |scaleX| x |scaleY| of the device resolution, cut into horizontal bands of
+// |bandRows| stored rows (0: automatic, see kMaxRasterBandBytes). Band
+// heights are rounded to multiples of 8 so ordered dithering lines up.
+class RasterBands {
+ public:
+  RasterBands(int deviceWidth, int deviceHeight, double scaleX, double scaleY, int bandRows);
+
+  // Size of the whole page in stored pixels.
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int band_count() const { return band_count_; }
+
+  // Stored rows of |band|.
+  int band_top(int band) const { return band * band_rows_; }
+  int band_rows(int band) const;
+
+  // Device rows covered by |band|: [device_top, device_bottom). Adjacent
+  // bands share their edge, so the page is tiled without gaps.
+  int device_top(int band) const;
+  int device_bottom(int band) const;
+
+  // A white RGB24 image for |band|. Device scale and offset are set so
+  // callers keep drawing in page device pixels; whatever falls outside the
+  // band is clipped. Caller owns. nullptr if it could not be allocated.
+  cairo_surface_t* CreateBandSurface(int band) const;
+
+ private:
+  int device_height_;
+  double scale_x_;
+  double scale_y_;
+  int width_;
+  int height_;
+  int band_rows_;
+  int band_count_;
+};
+
+#endif  // RUNNER_RASTER_BAND_H_
@@ -0,0 +1,636 @@
+#include "raster_file_sink.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+#include "pdf_file_sink.h"
+
+namespace {
+
+// Baris per bagian pita PWG yang dikompresi satu thread
+constexpr int kPwgPartRows = 64;
+// Level 1: strip teks tetap mengecil jauh, kompresi tidak jadi bottleneck
+constexpr int kPclmFlateLevel = 1;
+
+// Nama media PWG 5101.1 untuk kertas dari Flutter.
+std::string PwgMediaName(std::string name) {
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](unsigned char c) { return (char)std::toupper(c); });
+  if (name == "LETTER") return "na_letter_8.5x11in";
+  if (name == "LEGAL") return "na_legal_8.5x14in";
+  if (name == "A3") return "iso_a3_297x420mm";
+  if (name == "A5") return "iso_a5_148x210mm";
+  if (name == "F4") return "na_foolscap_8.5x13in";
+  return "iso_a4_210x297mm";
+}
+
+std::string FormatNumber(const char* format, double value) {
+  char text[32];
+  snprintf(text, sizeof(text), format, value);
+  return text;
+}
+
+// |count| rows of the band starting at |top| in |space|, packed at
+// RasterBytesPerLine. black_1 comes from the band's bilevel image (set bit =
+// white there, ink here), the others from the RGB24 pixels.
+void ConvertRows(const uint8_t* band, int stride, const BilevelImage& bilevel, int top, int count,
+                 int width, RasterColorSpace space, std::vector<uint8_t>* out) {
+  int bytesPerLine = RasterBytesPerLine(space, width);
+  out->resize((size_t)bytesPerLine * count);
+  for (int y = 0; y < count; ++y) {
+    uint8_t* row = out->data() + (size_t)y * bytesPerLine;
+    if (space == RasterColorSpace::kBlack1) {
+      const uint8_t* bits = bilevel.bits.data() + (size_t)(top + y) * bilevel.stride;
+      for (int x = 0; x < bytesPerLine; ++x) row[x] = (uint8_t)~bits[x];
+      // Bit sisa di byte terakhir harus putih agar baris identik terdeteksi
+      if (width % 8) row[bytesPerLine - 1] &= (uint8_t)(0xFF << (8 - width % 8));
+      continue;
+    }
+    const uint32_t* pixels = reinterpret_cast<const uint32_t*>(band + (size_t)(top + y) * stride);
+    if (space == RasterColorSpace::kGray8) {
+      for (int x = 0; x < width; ++x) {
+        uint32_t p = pixels[x];
+        row[x] = (uint8_t)((77 * ((p >> 16) & 0xFF) + 150 * ((p >> 8) & 0xFF) + 29 * (p & 0xFF)) >> 8);
+      }
+    } else {
+      for (int x = 0; x < width; ++x) {
+        uint32_t p = pixels[x];
+        row[3 * x] = (uint8_t)(p >> 16);
+        row[3 * x + 1] = (uint8_t)(p >> 8);
+        row[3 * x + 2] = (uint8_t)p;
+      }
+    }
+  }
+}
+
+// Turns a column strip of a landscape page (|columns| x |rows| RGB24) into
+// |columns| portrait rows of |rows| pixels: the strip's rightmost column
+// becomes the first row, its top the left end of every row. Copied in tiles
+// so both sides stay in cache.
+void RotateStrip(const uint8_t* strip, int stripStride, int columns, int rows, uint8_t* out,
+                 int outStride) {
+  constexpr int kTile = 32;
+  for (int y0 = 0; y0 < rows; y0 += kTile) {
+    int y1 = std::min(rows, y0 + kTile);
+    for (int x0 = 0; x0 < columns; x0 += kTile) {
+      int x1 = std::min(columns, x0 + kTile);
+      for (int y = y0; y < y1; ++y) {
+        const uint32_t* in = reinterpret_cast<const uint32_t*>(strip + (size_t)y * stripStride);
+        for (int x = x0; x < x1; ++x) {
+          uint8_t* row = out + (size_t)(columns - 1 - x) * outStride;
+          reinterpret_cast<uint32_t*>(row)[y] = in[x];
+        }
+      }
+    }
+  }
+}
+
+bool Deflate(const std::vector<uint8_t>& input, std::vector<uint8_t>* out) {
+  uLongf size = compressBound((uLong)input.size());
+  out->resize(size);
+  if (compress2(out->data(), &size, input.data(), (uLong)input.size(), kPclmFlateLevel) != Z_OK) {
+    return false;
+  }
+  out->resize(size);
+  return true;
+}
+
+bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>* out) {
+  uLongf length = (uLongf)out->size();
+  return uncompress(out->data(), &length, data, (uLong)size) == Z_OK && length == out->size();
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* data, std::string* error) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = "Cannot open " + path + ".";
+    return false;
+  }
+  uint8_t buffer[64 * 1024];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data->insert(data->end(), buffer, buffer + count);
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) *error = "Cannot read " + path + ".";
+  return ok;
+}
+
+// Integer after "/|key| " in |dict|, or -1.
+long long DictInteger(const std::string& dict, const std::string& key) {
+  size_t pos = dict.find("/" + key + " ");
+  if (pos == std::string::npos) return -1;
+  return atoll(dict.c_str() + pos + key.size() + 2);
+}
+
+// PCLm sesuai yang ditulis RasterFileSink: objek berurutan, strip halaman
+// ditulis sebelum objek halamannya, xref di akhir.
+bool DecodePclm(const std::vector<uint8_t>& file, const RasterPageCallback& onPage,
+                std::string* error) {
+  std::string text(file.begin(), file.end());
+  if (text.compare(0, 8, "%PDF-1.7") != 0 || text.find("%PCLm 1.0") == std::string::npos) {
+    *error = "Missing PDF/PCLm header.";
+    return false;
+  }
+  size_t startxref = text.rfind("startxref");
+  if (startxref == std::string::npos) {
+    *error = "Missing startxref.";
+    return false;
+  }
+  size_t xref = (size_t)atoll(text.c_str() + startxref + 9);
+  if (xref >= text.size() || text.compare(xref, 4, "xref") != 0) {
+    *error = "startxref does not point at the xref table.";
+    return false;
+  }
+  int objectCount = 0;
+  if (sscanf(text.c_str() + xref, "xref\n0 %d\n", &objectCount) != 1 || objectCount < 3) {
+    *error = "Invalid xref header.";
+    return false;
+  }
+  size_t entries = text.find('\n', text.find('\n', xref) + 1) + 1;
+  if (entries + (size_t)objectCount * 20 > text.size()) {
+    *error = "Truncated xref table.";
+    return false;
+  }
+  for (int id = 1; id < objectCount; ++id) {
+    size_t offset = (size_t)atoll(text.c_str() + entries + (size_t)id * 20);
+    std::string expected = std::to_string(id) + " 0 obj";
+    if (offset >= text.size() || text.compare(offset, expected.size(), expected) != 0) {
+      *error = "xref entry of object " + std::to_string(id) + " is wrong.";
+      return false;
+    }
+  }
+
+  RasterPageImage page;
+  int index = 0;
+  size_t pos = 0;
+  while ((pos = text.find(" 0 obj\n", pos)) != std::string::npos && pos < xref) {
+    size_t dictStart = pos + 7;
+    size_t dictEnd = text.find(">>\n", dictStart);
+    if (dictEnd == std::string::npos) break;
+    std::string dict = text.substr(dictStart, dictEnd + 2 - dictStart);
+    pos = dictEnd;
+
+    if (dict.find("/Subtype/Image") != std::string::npos) {
+      long long width = DictInteger(dict, "Width");
+      long long rows = DictInteger(dict, "Height");
+      long long length = DictInteger(dict, "Length");
+      RasterColorSpace space = dict.find("/DeviceRGB") != std::string::npos
+          ? RasterColorSpace::kRgb8 : RasterColorSpace::kGray8;
+      size_t data = dictEnd + 3 + 7;  // ">>\n" "stream\n"
+      if (width <= 0 || rows <= 0 || length < 0 || data + (size_t)length > xref ||
+          text.compare(dictEnd + 3, 7, "stream\n") != 0) {
+        *error = "Invalid image strip on page " + std::to_string(index + 1) + ".";
+        return false;
+      }
+      if (page.pixels.empty()) {
+        page.width = (int)width;
+        page.space = space;
+      } else if (page.width != width || page.space != space) {
+        *error = "Strips of page " + std::to_string(index + 1) + " differ in format.";
+        return false;
+      }
+      size_t bytes = (size_t)RasterBytesPerLine(space, (int)width) * (size_t)rows;
+      size_t start = page.pixels.size();
+      std::vector<uint8_t> strip(bytes);
+      if (!Inflate(file.data() + data, (size_t)length, &strip)) {
+        *error = "Strip on page " + std::to_string(index + 1) + " does not inflate to " +
+                 std::to_string(bytes) + " bytes.";
+        return false;
+      }
+      page.pixels.resize(start + bytes);
+      memcpy(page.pixels.data() + start, strip.data(), bytes);
+      page.height += (int)rows;
+      pos = data + (size_t)length;
+    } else if (dict.find("/Type/Page/") != std::string::npos) {
+      double mediaWidth = 0.0;
+      size_t box = dict.find("/MediaBox[0 0 ");
+      if (box != std::string::npos) mediaWidth = atof(dict.c_str() + box + 14);
+      if (page.pixels.empty() || mediaWidth <= 0.0) {
+        *error = "Page " + std::to_string(index + 1) + " has no image strips.";
+        return false;
+      }
+      page.dpi = (int)(page.width * 72.0 / mediaWidth + 0.5);
+      if (onPage && !onPage(index, page)) return true;
+      page = RasterPageImage();
+      ++index;
+    }
+  }
+  if (index == 0) {
+    *error = "No pages.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+const char* RasterFormatMimeType(RasterFormat format) {
+  return format == RasterFormat::kPclm ? "application/PCLm" : "image/pwg-raster";
+}
+
+RasterFileSink::RasterFileSink(const std::string& path, const PageSetup& setup,
+                               const RasterSinkOptions& options)
+    : path_(path), setup_(setup), options_(options) {
+  options_.dpi = std::max(72, options_.dpi);
+  options_.stripRows = std::max(8, (options_.stripRows + 7) / 8 * 8);
+  if (options_.format == RasterFormat::kPclm) {
+    options_.black1 = false;
+    if (!options_.gray8) options_.rgb8 = true;
+  }
+}
+
+RasterFileSink::~RasterFileSink() {
+  CloseFile();
+}
+
+bool RasterFileSink::StartDocument(const std::string& name, int* spoolJobId) {
+  if (spoolJobId) *spoolJobId = 0;
+  file_ = fopen(path_.c_str(), "wb");
+  if (!file_) return false;
+  offset_ = 0;
+  failed_ = false;
+  if (options_.format == RasterFormat::kPwgRaster) {
+    return Write(kPwgSyncWord, sizeof(kPwgSyncWord));
+  }
+  // Objek 1 (katalog) dan 2 (pohon halaman) ditulis paling akhir
+  object_offsets_.assign(3, 0);
+  page_objects_.clear();
+  std::string title;
+  for (char c : name) title += (c == '\n' || c == '\r') ? ' ' : c;
+  return WriteText("%PDF-1.7\n%PCLm 1.0\n% " + title + "\n");
+}
+
+bool RasterFileSink::StartPage() {
+  if (!file_ || failed_) return false;
+  PrintPageGeometry geometry = Geometry();
+  space_ = PageColorSpace();
+  dither_mode_ = DitherMode::kOff;
+  if (space_ == RasterColorSpace::kBlack1) {
+    dither_mode_ = raster_.mono != DitherMode::kOff ? raster_.mono : DitherMode::kThreshold;
+  }
+
+  // Printer menarik kertas potret: halaman lanskap diputar, jadi baris
+  // keluaran adalah kolom halaman yang digambar pemanggil
+  rotate_ = setup_.landscape;
+  int outputWidth = rotate_ ? geometry.physicalHeight : geometry.physicalWidth;
+  int outputHeight = rotate_ ? geometry.physicalWidth : geometry.physicalHeight;
+
+  // Tanpa mode raster dari pemanggil (halaman vektor, separator yang
+  // digambar sekali) halaman jadi satu pita utuh.
+  int bandRows = raster_.dpi > 0 ? raster_.bandRows : outputHeight;
+  if (options_.format == RasterFormat::kPclm) {
+    // Strip tidak boleh terpotong batas pita, kecuali di akhir halaman
+    int strip = options_.stripRows;
+    if (bandRows <= 0) {
+      bandRows = (int)(kMaxRasterBandBytes / ((size_t)outputWidth * 4)) / strip * strip;
+    }
+    bandRows = std::max(strip, (bandRows + strip - 1) / strip * strip);
+    strip_objects_.clear();
+    strip_rows_.clear();
+  }
+  bands_ = std::make_unique<RasterBands>(outputWidth, outputHeight, 1.0, 1.0, bandRows);
+  band_ = 0;
+  page_width_ = bands_->width();
+  dither_ = DitherState();
+
+  if (options_.format == RasterFormat::kPwgRaster) {
+    double width = 0.0, height = 0.0;
+    OutputPageSize(&width, &height);
+    PwgPageHeader header;
+    header.width = bands_->width();
+    header.height = bands_->height();
+    header.dpi = options_.dpi;
+    header.space = space_;
+    header.pageWidth = (int)(width + 0.5);
+    header.pageHeight = (int)(height + 0.5);
+    header.duplex = setup_.duplex;
+    header.mediaName = PwgMediaName(setup_.pageSize);
+    uint8_t encoded[kPwgHeaderSize];
+    EncodePwgHeader(header, encoded);
+    if (!Write(encoded, sizeof(encoded))) return false;
+  }
+  band_surface_ = CreateBandSurface();
+  return band_surface_ != nullptr;
+}
+
+cairo_surface_t* RasterFileSink::PageSurface() {
+  return band_surface_;
+}
+
+bool RasterFileSink::NextBand() {
+  if (!bands_ || !band_surface_) return false;
+  if (!WriteBand()) failed_ = true;
+  DestroyBand();
+  if (++band_ >= bands_->band_count()) return false;
+  band_surface_ = CreateBandSurface();
+  if (!band_surface_) failed_ = true;
+  return band_surface_ != nullptr;
+}
+
+bool RasterFileSink::EndPage() {
+  if (!bands_) return false;
+  // Pita yang tidak digambar pemanggil tetap dikirim (putih), karena tinggi
+  // halaman sudah tercatat di header
+  while (!failed_ && band_ < bands_->band_count()) {
+    if (!band_surface_) band_surface_ = CreateBandSurface();
+    if (!band_surface_ || !WriteBand()) failed_ = true;
+    DestroyBand();
+    ++band_;
+  }
+  DestroyBand();
+  bands_.reset();
+  if (!failed_ && options_.format == RasterFormat::kPclm && !FinishPclmPage()) failed_ = true;
+  if (failed_) return false;
+  stats_.pages++;
+  return true;
+}
+
+bool RasterFileSink::EndDocument() {
+  if (!file_) return false;
+  if (!failed_ && options_.format == RasterFormat::kPclm && !FinishPclm()) failed_ = true;
+  if (fclose(file_) != 0) failed_ = true;
+  file_ = nullptr;
+  return !failed_;
+}
+
+void RasterFileSink::AbortDocument() {
+  CloseFile();
+  std::error_code ec;
+  std::filesystem::remove(std::filesystem::u8path(path_), ec);
+}
+
+bool RasterFileSink::ChangePageSetup(const PageSetup& setup) {
+  setup_ = setup;
+  return true;
+}
+
+void RasterFileSink::SetRasterMode(const RasterMode& mode) {
+  raster_ = mode;
+}
+
+PrintPageGeometry RasterFileSink::Geometry() {
+  double width = 0.0, height = 0.0;
+  PageSizeInPoints(setup_, &width, &height);
+  PrintPageGeometry geometry;
+  geometry.physicalWidth = (int)(width * options_.dpi / 72.0 + 0.5);
+  geometry.physicalHeight = (int)(height * options_.dpi / 72.0 + 0.5);
+  geometry.printableWidth = geometry.physicalWidth;
+  geometry.printableHeight = geometry.physicalHeight;
+  geometry.dpiX = options_.dpi;
+  geometry.dpiY = options_.dpi;
+  return geometry;
+}
+
+void RasterFileSink::OutputPageSize(double* width, double* height) const {
+  PageSizeInPoints(setup_, width, height);
+  if (rotate_) std::swap(*width, *height);
+}
+
+cairo_surface_t* RasterFileSink::CreateBandSurface() const {
+  if (!rotate_) return bands_->CreateBandSurface(band_);
+  // Baris pertama keluaran adalah kolom paling kanan halaman lanskap, jadi
+  // pita berjalan dari kanan ke kiri
+  int columns = bands_->band_rows(band_);
+  int left = bands_->height() - bands_->band_top(band_) - columns;
+  cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, columns, bands_->width());
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(surface);
+    return nullptr;
+  }
+  cairo_t* cr = cairo_create(surface);
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_set_device_offset(surface, -left, 0);
+  return surface;
+}
+
+RasterColorSpace RasterFileSink::PageColorSpace() const {
+  if (setup_.color) {
+    if (options_.rgb8) return RasterColorSpace::kRgb8;
+    return options_.gray8 ? RasterColorSpace::kGray8 : RasterColorSpace::kBlack1;
+  }
+  // Mono 1 bit hanya kalau job meminta dithering; tanpa itu abu-abu 8 bit
+  if (raster_.mono != DitherMode::kOff && options_.black1) return RasterColorSpace::kBlack1;
+  if (options_.gray8) return RasterColorSpace::kGray8;
+  return options_.black1 ? RasterColorSpace::kBlack1 : RasterColorSpace::kRgb8;
+}
+
+bool RasterFileSink::EncodeBand(cairo_surface_t* source, std::vector<EncodedPart>* parts) {
+  cairo_surface_flush(source);
+  const uint8_t* pixels = cairo_image_surface_get_data(source);
+  int stride = cairo_image_surface_get_stride(source);
+  int width = bands_->width();
+  int rows = bands_->band_rows(band_);
+  if (!pixels) return false;
+
+  // Dithering (difusi error berurutan antar baris) dikerjakan di sini sekali
+  // untuk seluruh pita; konversi lain dan kompresi per bagian paralel.
+  BilevelImage bilevel;
+  if (space_ == RasterColorSpace::kBlack1) {
+    auto start = std::chrono::steady_clock::now();
+    bool converted = ConvertToBilevel(source, dither_mode_, &bilevel, &dither_);
+    mono_convert_ms_ += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!converted) return false;
+  }
+
+  bool pclm = options_.format == RasterFormat::kPclm;
+  int partRows = pclm ? options_.stripRows : kPwgPartRows;
+  int partCount = (rows + partRows - 1) / partRows;
+  parts->assign(partCount, EncodedPart());
+  int threadCount = options_.threads;
+  if (threadCount <= 0) threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+  threadCount = std::max(1, std::min(threadCount, partCount));
+
+  std::atomic<int> nextPart{0};
+  std::atomic<bool> failed{false};
+  auto work = [&]() {
+    std::vector<uint8_t> converted;
+    for (int index = nextPart++; index < partCount; index = nextPart++) {
+      EncodedPart& part = (*parts)[index];
+      int top = index * partRows;
+      part.rows = std::min(partRows, rows - top);
+      ConvertRows(pixels, stride, bilevel, top, part.rows, width, space_, &converted);
+      if (pclm) {
+        if (!Deflate(converted, &part.data)) failed = true;
+      } else {
+        EncodePwgLines(converted.data(), (size_t)RasterBytesPerLine(space_, width), part.rows,
+                       space_, width, &part.data);
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threadCount; ++i) workers.emplace_back(work);
+  work();
+  for (std::thread& worker : workers) worker.join();
+
+  stats_.rawBytes += (int64_t)RasterBytesPerLine(space_, width) * rows;
+  for (const EncodedPart& part : *parts) stats_.encodedBytes += (int64_t)part.data.size();
+  return !failed;
+}
+
+bool RasterFileSink::WriteBand() {
+  auto start = std::chrono::steady_clock::now();
+  cairo_surface_t* source = band_surface_;
+  if (rotate_) {
+    cairo_surface_flush(band_surface_);
+    int rows = bands_->band_rows(band_);
+    source = cairo_image_surface_create(CAIRO_FORMAT_RGB24, bands_->width(), rows);
+    const uint8_t* strip = cairo_image_surface_get_data(band_surface_);
+    uint8_t* out = cairo_image_surface_get_data(source);
+    if (!strip || !out) {
+      cairo_surface_destroy(source);
+      return false;
+    }
+    RotateStrip(strip, cairo_image_surface_get_stride(band_surface_), rows, bands_->width(), out,
+                cairo_image_surface_get_stride(source));
+    cairo_surface_mark_dirty(source);
+  }
+  std::vector<EncodedPart> parts;
+  bool encoded = EncodeBand(source, &parts);
+  if (source != band_surface_) cairo_surface_destroy(source);
+  stats_.encodeMs += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  if (!encoded) return false;
+  for (const EncodedPart& part : parts) {
+    bool written = options_.format == RasterFormat::kPclm ? WritePclmStrip(part)
+                                                          : Write(part.data.data(), part.data.size());
+    if (!written) return false;
+  }
+  return true;
+}
+
+bool RasterFileSink::Write(const void* data, size_t size) {
+  if (!file_ || failed_) return false;
+  if (size > 0 && fwrite(data, 1, size, file_) != size) {
+    failed_ = true;
+    return false;
+  }
+  offset_ += (int64_t)size;
+  return true;
+}
+
+bool RasterFileSink::WriteText(const std::string& text) {
+  return Write(text.data(), text.size());
+}
+
+int RasterFileSink::NewObject() {
+  object_offsets_.push_back(0);
+  return (int)object_offsets_.size() - 1;
+}
+
+bool RasterFileSink::BeginObject(int id) {
+  object_offsets_[id] = offset_;
+  return WriteText(std::to_string(id) + " 0 obj\n");
+}
+
+bool RasterFileSink::WritePclmStrip(const EncodedPart& part) {
+  int id = NewObject();
+  std::string dict = "<</Type/XObject/Subtype/Image/Width " + std::to_string(bands_->width()) +
+                     "/Height " + std::to_string(part.rows) + "/ColorSpace/" +
+                     (space_ == RasterColorSpace::kRgb8 ? "DeviceRGB" : "DeviceGray") +
+                     "/BitsPerComponent 8/Filter/FlateDecode/Length " +
+                     std::to_string(part.data.size()) + ">>\nstream\n";
+  if (!BeginObject(id) || !WriteText(dict) || !Write(part.data.data(), part.data.size()) ||
+      !WriteText("\nendstream\nendobj\n")) {
+    return false;
+  }
+  strip_objects_.push_back(id);
+  strip_rows_.push_back(part.rows);
+  return true;
+}
+
+bool RasterFileSink::FinishPclmPage() {
+  double width = 0.0, height = 0.0;
+  OutputPageSize(&width, &height);
+  int pageRows = 0;
+  for (int rows : strip_rows_) pageRows += rows;
+
+  // Satuan piksel; strip disusun dari atas, PDF menghitung y dari bawah
+  std::string scale = FormatNumber("%.6f", 72.0 / options_.dpi);
+  std::string content = scale + " 0 0 " + scale + " 0 0 cm\n";
+  std::string xobjects;
+  int top = 0;
+  for (size_t i = 0; i < strip_objects_.size(); ++i) {
+    std::string name = "/Image" + std::to_string(i);
+    content += "/P <</MCID 0>> BDC q\n" + std::to_string(page_width_) + " 0 0 " +
+               std::to_string(strip_rows_[i]) + " 0 " +
+               std::to_string(pageRows - top - strip_rows_[i]) + " cm\n" + name + " Do Q\nEMC\n";
+    xobjects += name + " " + std::to_string(strip_objects_[i]) + " 0 R";
+    top += strip_rows_[i];
+  }
+
+  int contentId = NewObject();
+  if (!BeginObject(contentId) ||
+      !WriteText("<</Length " + std::to_string(content.size()) + ">>\nstream\n" + content +
+                 "endstream\nendobj\n")) {
+    return false;
+  }
+  int pageId = NewObject();
+  if (!BeginObject(pageId) ||
+      !WriteText("<</Type/Page/Parent 2 0 R/MediaBox[0 0 " + FormatNumber("%.2f", width) + " " +
+                 FormatNumber("%.2f", height) + "]/Contents " + std::to_string(contentId) +
+                 " 0 R/Resources<</XObject<<" + xobjects + ">>>>>>\nendobj\n")) {
+    return false;
+  }
+  page_objects_.push_back(pageId);
+  return true;
+}
+
+bool RasterFileSink::FinishPclm() {
+  std::string kids;
+  for (int id : page_objects_) kids += (kids.empty() ? "" : " ") + std::to_string(id) + " 0 R";
+  if (!BeginObject(2) ||
+      !WriteText("<</Type/Pages/Kids[" + kids + "]/Count " + std::to_string(page_objects_.size()) +
+                 ">>\nendobj\n") ||
+      !BeginObject(1) || !WriteText("<</Type/Catalog/Pages 2 0 R>>\nendobj\n")) {
+    return false;
+  }
+
+  // Tiap entri xref tepat 20 byte
+  int64_t xref = offset_;
+  std::string table = "xref\n0 " + std::to_string(object_offsets_.size()) + "\n0000000000 65535 f \n";
+  for (size_t id = 1; id < object_offsets_.size(); ++id) {
+    char entry[21];
+    snprintf(entry, sizeof(entry), "%010lld 00000 n \n", (long long)object_offsets_[id]);
+    table += entry;
+  }
+  table += "trailer\n<</Size " + std::to_string(object_offsets_.size()) +
+           "/Root 1 0 R>>\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+  return WriteText(table);
+}
+
+void RasterFileSink::DestroyBand() {
+  if (band_surface_) {
+    cairo_surface_destroy(band_surface_);
+    band_surface_ = nullptr;
+  }
+}
+
+void RasterFileSink::CloseFile() {
+  DestroyBand();
+  bands_.reset();
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool DecodeRasterFile(const std::string& path, RasterFormat format,
+                      const RasterPageCallback& onPage, std::string* error) {
+  std::vector<uint8_t> data;
+  if (!ReadFile(path, &data, error)) return false;
+  if (format == RasterFormat::kPclm) return DecodePclm(data, onPage, error);
+  return DecodePwgRaster(data.data(), data.size(), onPage, error);
+}
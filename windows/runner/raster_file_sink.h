@@ -0,0 +1,150 @@
+#ifndef RUNNER_RASTER_FILE_SINK_H_
+#define RUNNER_RASTER_FILE_SINK_H_
+
+#include <cairo/cairo.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "print_sink.h"
+#include "pwg_raster.h"
+#include "raster_band.h"
+
+// Document formats of IPP Everywhere printers that take device raster
+// instead of PDF.
+enum class RasterFormat {
+  // image/pwg-raster: PWG 5102.4 headers and PackBits-style lines.
+  kPwgRaster,
+  // application/PCLm: a constrained PDF of Flate-compressed image strips.
+  kPclm,
+};
+
+const char* RasterFormatMimeType(RasterFormat format);
+
+// What the printer accepts, from its Get-Printer-Attributes answer
+// (pwg-raster-document-*, pclm-*).
+struct RasterSinkOptions {
+  RasterFormat format = RasterFormat::kPwgRaster;
+  int dpi = 300;
+  // Pixel formats the printer takes. PCLm has no black_1.
+  bool black1 = true;
+  bool gray8 = true;
+  bool rgb8 = false;
+  // PCLm strip height (pclm-strip-height-preferred), rounded up to 8.
+  int stripRows = 16;
+  // Compression threads per band, 0 for one per core.
+  int threads = 0;
+};
+
+struct RasterSinkStats {
+  int pages = 0;
+  // Uncompressed pixel bytes and what went into the file for them.
+  int64_t rawBytes = 0;
+  int64_t encodedBytes = 0;
+  // Time spent turning bands into pixel rows and compressing them.
+  double encodeMs = 0.0;
+};
+
+// PrintSink that renders every page on RGB24 bands at the printer
+// resolution and writes them as PWG raster or PCLm, so a driverless printer
+// gets data it only has to decompress instead of PDF it has to interpret.
+// Mono pages go out as black_1 (dithered with the job's mode, threshold
+// otherwise) when the printer takes it, else sgray_8; colour pages as
+// srgb_8 if supported. Each band is split into row groups (PCLm strips)
+// compressed on parallel threads and written in order. Landscape pages are
+// rotated into the portrait feed direction, top edge to the paper's left as
+// for orientation-requested landscape: callers still draw them landscape,
+// band by band on column strips. There are no hardware margins.
+class RasterFileSink : public PrintSink {
+ public:
+  RasterFileSink(const std::string& path, const PageSetup& setup,
+                 const RasterSinkOptions& options);
+  ~RasterFileSink() override;
+
+  // Prevent copying.
+  RasterFileSink(RasterFileSink const&) = delete;
+  RasterFileSink& operator=(RasterFileSink const&) = delete;
+
+  const RasterSinkStats& stats() const { return stats_; }
+
+  // PrintSink:
+  bool StartDocument(const std::string& name, int* spoolJobId) override;
+  bool StartPage() override;
+  cairo_surface_t* PageSurface() override;
+  bool NextBand() override;
+  bool EndPage() override;
+  bool EndDocument() override;
+  void AbortDocument() override;
+  bool ChangePageSetup(const PageSetup& setup) override;
+  void SetRasterMode(const RasterMode& mode) override;
+  double mono_convert_ms() const override { return mono_convert_ms_; }
+  PrintPageGeometry Geometry() override;
+
+ private:
+  // One compressed row group of a band: PWG lines or a PCLm strip.
+  struct EncodedPart {
+    int rows = 0;
+    std::vector<uint8_t> data;
+  };
+
+  RasterColorSpace PageColorSpace() const;
+  // Paper size in points as it goes into the file: portrait when rotated.
+  void OutputPageSize(double* width, double* height) const;
+  // The surface the caller draws band |band_| on; a column strip of the
+  // landscape page when rotated.
+  cairo_surface_t* CreateBandSurface() const;
+  bool WriteBand();
+  // |source| holds the band's rows of the output page.
+  bool EncodeBand(cairo_surface_t* source, std::vector<EncodedPart>* parts);
+  bool Write(const void* data, size_t size);
+  bool WriteText(const std::string& text);
+  // Starts PDF object |id| at the current offset.
+  bool BeginObject(int id);
+  int NewObject();
+  bool WritePclmStrip(const EncodedPart& part);
+  bool FinishPclmPage();
+  bool FinishPclm();
+  void DestroyBand();
+  void CloseFile();
+
+  std::string path_;
+  PageSetup setup_;
+  RasterSinkOptions options_;
+  RasterMode raster_;
+  FILE* file_ = nullptr;
+  int64_t offset_ = 0;
+  bool failed_ = false;
+
+  // Halaman yang sedang digambar; |bands_| membagi halaman keluaran (potret
+  // bila |rotate_|)
+  std::unique_ptr<RasterBands> bands_;
+  bool rotate_ = false;
+  cairo_surface_t* band_surface_ = nullptr;
+  int band_ = 0;
+  int page_width_ = 0;
+  RasterColorSpace space_ = RasterColorSpace::kGray8;
+  DitherMode dither_mode_ = DitherMode::kOff;
+  DitherState dither_;
+
+  // PCLm: offset tiap objek (indeks = nomor objek), objek halaman, dan strip
+  // halaman yang sedang ditulis beserta tinggi barisnya
+  std::vector<int64_t> object_offsets_;
+  std::vector<int> page_objects_;
+  std::vector<int> strip_objects_;
+  std::vector<int> strip_rows_;
+
+  RasterSinkStats stats_;
+  double mono_convert_ms_ = 0.0;
+};
+
+// Decodes |path| as written by RasterFileSink in |format| and calls
+// |onPage| per page. For PCLm this checks the cross-reference offsets and
+// that every strip inflates to its declared size. Used to verify output
+// before it is sent (HLAPRINT_VERIFY_RASTER).
+bool DecodeRasterFile(const std::string& path, RasterFormat format,
+                      const RasterPageCallback& onPage, std::string* error);
+
+#endif  // RUNNER_RASTER_FILE_SINK_H_
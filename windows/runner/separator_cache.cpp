@@ -0,0 +1,163 @@
+#include "separator_cache.h"
+
+#include <chrono>
+
+namespace {
+
+std::string DisplayListKey(const std::string& printerName,
+                           const PrintPageGeometry& geometry) {
+  return printerName + "|" + std::to_string(geometry.physicalWidth) + "x" +
+         std::to_string(geometry.physicalHeight) + "+" +
+         std::to_string(geometry.offsetX) + "+" + std::to_string(geometry.offsetY) +
+         "|" + std::to_string(geometry.printableWidth) + "x" +
+         std::to_string(geometry.printableHeight) + "@" +
+         std::to_string(geometry.dpiX) + "x" + std::to_string(geometry.dpiY);
+}
+
+// Holds a reference on every recording surface of a display list, so the
+// list can be replayed with the cache unlocked even if Load drops it.
+class DisplayListRefs {
+ public:
+  explicit DisplayListRefs(const std::vector<cairo_surface_t*>& pages) : pages_(pages) {
+    for (cairo_surface_t* recording : pages_) cairo_surface_reference(recording);
+  }
+  ~DisplayListRefs() {
+    for (cairo_surface_t* recording : pages_) cairo_surface_destroy(recording);
+  }
+
+  // Prevent copying.
+  DisplayListRefs(const DisplayListRefs&) = delete;
+  DisplayListRefs& operator=(const DisplayListRefs&) = delete;
+
+  const std::vector<cairo_surface_t*>& pages() const { return pages_; }
+
+ private:
+  std::vector<cairo_surface_t*> pages_;
+};
+
+}  // namespace
+
+SeparatorCache& SeparatorCache::Shared() {
+  static SeparatorCache* cache = new SeparatorCache();
+  return *cache;
+}
+
+bool SeparatorCache::Load(const std::string& path, std::string* error) {
+  GError* gerror = nullptr;
+  gchar* uri = g_filename_to_uri(path.c_str(), nullptr, &gerror);
+  PopplerDocument* doc = nullptr;
+  if (uri) {
+    doc = poppler_document_new_from_file(uri, nullptr, &gerror);
+    g_free(uri);
+  }
+  if (!doc) {
+    if (error) *error = gerror ? gerror->message : "Failed to load separator PDF.";
+    g_clear_error(&gerror);
+    return false;
+  }
+
+  std::string orientation = "portrait";
+  PopplerPage* first = poppler_document_get_page(doc, 0);
+  if (first) {
+    double width = 0.0, height = 0.0;
+    poppler_page_get_size(first, &width, &height);
+    if (width > height) orientation = "landscape";
+    g_object_unref(first);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ClearLocked();
+  doc_ = doc;
+  orientation_ = orientation;
+  return true;
+}
+
+bool SeparatorCache::loaded() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return doc_ != nullptr;
+}
+
+std::string SeparatorCache::orientation() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return orientation_;
+}
+
+void SeparatorCache::ClearLocked() {
+  for (auto& entry : display_lists_) {
+    for (cairo_surface_t* recording : entry.second) cairo_surface_destroy(recording);
+  }
+  display_lists_.clear();
+  if (doc_) {
+    g_object_unref(doc_);
+    doc_ = nullptr;
+  }
+}
+
+int SeparatorCache::page_count() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return doc_ ? poppler_document_get_n_pages(doc_) : 0;
+}
+
+SpoolResult SeparatorCache::Spool(PrintSink* sink, const std::string& printerName,
+                                  const SpoolProgressCallback& onProgress) {
+  SpoolResult result;
+  auto startTime = std::chrono::steady_clock::now();
+  PrintPageGeometry geometry = sink->Geometry();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!doc_) {
+    result.errorCode = "SEPARATOR_NOT_LOADED";
+    result.errorMessage = "Separator PDF is not loaded.";
+    return result;
+  }
+
+  // Render pertama untuk kombinasi printer/kertas ini, selanjutnya cukup diputar ulang
+  std::vector<cairo_surface_t*>& pages = display_lists_[DisplayListKey(printerName, geometry)];
+  if (pages.empty()) {
+    MarginBox margins = geometry.MarginsInPoints();
+    int pageCount = poppler_document_get_n_pages(doc_);
+    for (int i = 0; i < pageCount; ++i) {
+      PopplerPage* page = poppler_document_get_page(doc_, i);
+      if (!page) continue;
+      PreparedPage prepared;
+      PreparePage(page, 0, margins, 0, &prepared);
+
+      cairo_surface_t* recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, nullptr);
+      cairo_t* cr = cairo_create(recording);
+      RenderPreparedPage(cr, geometry, page, prepared, 0);
+      cairo_destroy(cr);
+      pages.push_back(recording);
+      g_object_unref(page);
+    }
+  }
+
+  // Pemutaran ulang ke spooler bisa lama; separator untuk printer lain tidak
+  // perlu menunggu, jadi kunci dilepas setelah daftar diambil
+  DisplayListRefs displayList(pages);
+  lock.unlock();
+
+  int totalPages = (int)displayList.pages().size();
+  for (cairo_surface_t* recording : displayList.pages()) {
+    if (!sink->StartPage()) {
+      result.errorCode = "START_PAGE_FAILED";
+      result.errorMessage = "Failed to start print page.";
+      return result;
+    }
+    cairo_t* cr = cairo_create(sink->PageSurface());
+    cairo_set_source_surface(cr, recording, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    if (!sink->EndPage()) {
+      result.errorCode = "END_PAGE_FAILED";
+      result.errorMessage = "Failed to end print page.";
+      return result;
+    }
+    result.pagesSpooled++;
+    if (onProgress) onProgress(result.pagesSpooled, totalPages);
+  }
+
+  result.elapsedMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - startTime).count();
+  result.ok = true;
+  return result;
+}
@@ -0,0 +1,49 @@
+#ifndef RUNNER_SEPARATOR_CACHE_H_
+#define RUNNER_SEPARATOR_CACHE_H_
+
+#include <cairo/cairo.h>
+#include <poppler/glib/poppler.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "print_job.h"
+#include "print_sink.h"
+
+// The bundled separator page (assets/pdf/separator.pdf), parsed once. For
+// every printer/paper geometry it is printed on, its pages are rendered once
+// into recording surfaces and replayed from then on, so a separator costs no
+// file I/O, parsing, margin analysis or Poppler rendering after the first.
+class SeparatorCache {
+ public:
+  static SeparatorCache& Shared();
+
+  // Parses the separator PDF at |path|, dropping any display lists built
+  // from a previous load.
+  bool Load(const std::string& path, std::string* error);
+  bool loaded();
+
+  // Orientation of the separator's first page ("portrait" or "landscape").
+  std::string orientation();
+  int page_count();
+
+  // Spools every separator page into |sink|, whose document has already
+  // been started. |printerName| and the sink geometry select the display
+  // list.
+  SpoolResult Spool(PrintSink* sink, const std::string& printerName,
+                    const SpoolProgressCallback& onProgress);
+
+ private:
+  SeparatorCache() = default;
+  void ClearLocked();
+
+  std::mutex mutex_;
+  PopplerDocument* doc_ = nullptr;
+  std::string orientation_ = "portrait";
+  // Printer name + geometry -> one recording surface per separator page.
+  std::map<std::string, std::vector<cairo_surface_t*>> display_lists_;
+};
+
+#endif  // RUNNER_SEPARATOR_CACHE_H_
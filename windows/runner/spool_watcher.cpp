@@ -0,0 +1,240 @@
+#include "spool_watcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "job_correlation.h"
+
+bool SpoolJobInfo::operator==(const SpoolJobInfo& other) const {
+  return status == other.status && rawStatus == other.rawStatus &&
+         pagesPrinted == other.pagesPrinted && totalPages == other.totalPages &&
+         finished == other.finished;
+}
+
+std::string FormatSpoolJobInfo(const SpoolJobInfo& info) {
+  std::string text = "Status Code: " + std::to_string(info.rawStatus) +
+                     " | Pages: " + std::to_string(info.pagesPrinted) + "/" +
+                     std::to_string(info.totalPages);
+  if (info.status & kSpoolJobPrinting) text += " [Printing]";
+  if (info.status & kSpoolJobSpooling) text += " [Spooling]";
+  if (info.status & kSpoolJobError) text += " [Error]";
+  if (info.status & kSpoolJobOffline) text += " [Offline]";
+  if (info.status & kSpoolJobPaperOut) text += " [Paper Out]";
+  if (info.status & kSpoolJobDeleting) text += " [DELETING]";
+  if (info.status & kSpoolJobBlocked) text += " [Blocked]";
+  return text;
+}
+
+SpoolWatcher::SpoolWatcher(std::unique_ptr<SpoolBackend> backend)
+    : backend_(std::move(backend)) {
+  thread_ = std::thread(&SpoolWatcher::Run, this);
+}
+
+SpoolWatcher::~SpoolWatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  backend_->Wake();
+  thread_.join();
+  for (const auto& entry : queue_refs_) backend_->RemoveQueue(entry.first);
+}
+
+void SpoolWatcher::Watch(const std::string& queue, int jobId, int totalPages,
+                         ProgressCallback progress, DoneCallback done) {
+  Job job;
+  job.queue = queue;
+  job.jobId = jobId;
+  job.totalPages = totalPages;
+  job.progress = std::move(progress);
+  job.done = std::move(done);
+  job.deadline = std::chrono::steady_clock::now() + kJobTimeout;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.push_back(std::move(job));
+    watched_++;
+  }
+  backend_->Wake();
+}
+
+void SpoolWatcher::WatchDocument(const std::string& queue, const std::string& tag, int totalPages,
+                                 ResolvedCallback resolved, ProgressCallback progress,
+                                 DoneCallback done) {
+  Job job;
+  job.queue = queue;
+  job.tag = tag;
+  job.totalPages = totalPages;
+  job.resolved = std::move(resolved);
+  job.progress = std::move(progress);
+  job.done = std::move(done);
+  job.deadline = std::chrono::steady_clock::now() + kDocumentTimeout;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.push_back(std::move(job));
+    watched_++;
+  }
+  backend_->Wake();
+}
+
+size_t SpoolWatcher::watched_count() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return watched_;
+}
+
+void SpoolWatcher::Run() {
+  std::vector<std::string> changed;
+  auto lastResync = std::chrono::steady_clock::now();
+  bool resyncAll = false;
+
+  for (;;) {
+    std::vector<Job> adopted;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) return;
+      adopted.swap(incoming_);
+    }
+    for (Job& job : adopted) {
+      if (queue_refs_[job.queue]++ == 0) backend_->AddQueue(job.queue);
+      // Job baru langsung dicek, bisa saja sudah selesai sebelum didaftarkan
+      changed.push_back(job.queue);
+      if (job.tag.empty()) {
+        jobs_.push_back(std::move(job));
+      } else {
+        std::string tag = job.tag;
+        documents_[tag] = std::move(job);
+      }
+    }
+
+    // Dokumen yang belum ketemu dicari di antrean yang berubah; job yang
+    // ketemu langsung ikut dicek di bawah
+    if (!documents_.empty()) {
+      std::vector<std::string> queues;
+      for (const auto& entry : documents_) {
+        const std::string& queue = entry.second.queue;
+        bool due = resyncAll || std::find(changed.begin(), changed.end(), queue) != changed.end();
+        if (due && std::find(queues.begin(), queues.end(), queue) == queues.end()) {
+          queues.push_back(queue);
+        }
+      }
+      for (const std::string& queue : queues) ResolveDocuments(queue);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (resyncAll) lastResync = now;
+    for (auto it = documents_.begin(); it != documents_.end();) {
+      if (now < it->second.deadline) {
+        ++it;
+        continue;
+      }
+      SpoolOutcome outcome;
+      outcome.reason = "Failed (Document never showed up in the spooler queue).";
+      if (it->second.done) it->second.done(outcome);
+      std::string queue = it->second.queue;
+      it = documents_.erase(it);
+      Release(queue);
+    }
+    for (size_t i = 0; i < jobs_.size();) {
+      Job& job = jobs_[i];
+      bool due = resyncAll || std::find(changed.begin(), changed.end(), job.queue) != changed.end();
+      if (!(due && Poll(&job)) && now < job.deadline) {
+        ++i;
+        continue;
+      }
+      Finish(&job);
+      std::string queue = job.queue;
+      jobs_.erase(jobs_.begin() + i);
+      Release(queue);
+    }
+
+    // Tanpa job cukup menunggu Wake; selain itu bangun untuk resync atau
+    // batas waktu job terdekat
+    int timeoutMs = -1;
+    if (!jobs_.empty() || !documents_.empty()) {
+      auto wakeAt = lastResync + kResyncInterval;
+      for (const Job& job : jobs_) wakeAt = std::min(wakeAt, job.deadline);
+      for (const auto& entry : documents_) wakeAt = std::min(wakeAt, entry.second.deadline);
+      timeoutMs = (int)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                wakeAt - now).count());
+    }
+    changed.clear();
+    backend_->Wait(timeoutMs, &changed);
+    resyncAll = changed.empty() &&
+                std::chrono::steady_clock::now() - lastResync >= kResyncInterval;
+  }
+}
+
+void SpoolWatcher::ResolveDocuments(const std::string& queue) {
+  std::vector<SpoolDocument> documents;
+  if (!backend_->ListDocuments(queue, &documents)) return;
+  std::string tag;
+  for (const SpoolDocument& document : documents) {
+    if (!ExtractDocumentTag(document.name, &tag)) continue;
+    auto it = documents_.find(tag);
+    if (it == documents_.end() || it->second.queue != queue) continue;
+    Job job = std::move(it->second);
+    documents_.erase(it);
+    job.jobId = document.jobId;
+    job.deadline = std::chrono::steady_clock::now() + kJobTimeout;
+    if (job.resolved) job.resolved(job.jobId);
+    jobs_.push_back(std::move(job));
+  }
+}
+
+void SpoolWatcher::Release(const std::string& queue) {
+  if (--queue_refs_[queue] == 0) {
+    queue_refs_.erase(queue);
+    backend_->RemoveQueue(queue);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  watched_--;
+}
+
+bool SpoolWatcher::Poll(Job* job) {
+  SpoolJobInfo info;
+  // Job yang hilang dari antrean sudah selesai (atau dihapus) di spooler
+  if (!backend_->QueryJob(job->queue, job->jobId, &info)) return true;
+
+  job->maxPagesPrinted = std::max(job->maxPagesPrinted, info.pagesPrinted);
+  job->spoolBytes = std::max(job->spoolBytes, info.spoolBytes);
+  if (info.status & kSpoolJobDeleting) job->deletingSeen = true;
+  if (info.status & kSpoolJobError) job->errorSeen = true;
+  if (info.status & kSpoolJobOffline) job->offlineSeen = true;
+
+  if (!job->seen || info != job->last) {
+    job->seen = true;
+    job->last = info;
+    if (job->progress) job->progress(info);
+  }
+  return info.finished;
+}
+
+void SpoolWatcher::Finish(Job* job) {
+  SpoolOutcome outcome;
+  outcome.maxPagesPrinted = job->maxPagesPrinted;
+  outcome.spoolBytes = job->spoolBytes;
+
+  if (job->errorSeen && job->maxPagesPrinted == 0) {
+    // Error muncul dan tidak ada halaman tercetak sebelum hilang
+    outcome.reason = "Failed (Error flag detected & 0 pages).";
+  } else if (job->maxPagesPrinted == 0 && job->totalPages > 0) {
+    if (!job->errorSeen && !job->offlineSeen && !job->deletingSeen) {
+      outcome.success = true;
+      outcome.reason = "Assumed Success (Job finished very fast before PagesPrinted could be polled).";
+    } else {
+      outcome.reason = "Failed (Job disappeared with 0 pages printed - likely Cancelled by Admin/User).";
+    }
+  } else if (job->deletingSeen && job->maxPagesPrinted == 0) {
+    // Banyak driver printer tidak melaporkan PagesPrinted
+    if (!job->errorSeen && !job->offlineSeen) {
+      outcome.success = true;
+      outcome.reason = "Assumed Success (Job deleted without errors, likely driver doesn't report PagesPrinted).";
+    } else {
+      outcome.reason = "Failed (Job was cancelled before printing started).";
+    }
+  } else {
+    outcome.success = true;
+    outcome.reason = "Success (Job finished/handed off to printer).";
+  }
+
+  if (job->done) job->done(outcome);
+}
@@ -0,0 +1,197 @@
+#ifndef RUNNER_SPOOL_WATCHER_H_
+#define RUNNER_SPOOL_WATCHER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Spooler-independent job status bits.
+enum SpoolJobStatus : uint32_t {
+  kSpoolJobPrinting = 1u << 0,
+  kSpoolJobSpooling = 1u << 1,
+  kSpoolJobError = 1u << 2,
+  kSpoolJobOffline = 1u << 3,
+  kSpoolJobPaperOut = 1u << 4,
+  kSpoolJobDeleting = 1u << 5,
+  kSpoolJobBlocked = 1u << 6,
+};
+
+// One job as the spooler currently reports it.
+struct SpoolJobInfo {
+  uint32_t status = 0;  // SpoolJobStatus bits
+  // The spooler's own status value, for logs only.
+  uint32_t rawStatus = 0;
+  int pagesPrinted = 0;
+  int totalPages = 0;
+  // Size of the spooled data, -1 if the spooler does not say. Grows while
+  // the job spools and is not compared by ==, so growth alone is not a
+  // progress update.
+  int64_t spoolBytes = -1;
+  // The spooler is done with the job but still lists it (CUPS job history).
+  bool finished = false;
+
+  bool operator==(const SpoolJobInfo& other) const;
+  bool operator!=(const SpoolJobInfo& other) const { return !(*this == other); }
+};
+
+// "Status Code: <raw> | Pages: x/y [Printing]..." as shown in progress events.
+std::string FormatSpoolJobInfo(const SpoolJobInfo& info);
+
+// Spooler-independent printer status bits.
+enum SpoolQueueStatus : uint32_t {
+  kSpoolQueueOffline = 1u << 0,
+  kSpoolQueueError = 1u << 1,
+  kSpoolQueuePaused = 1u << 2,
+  kSpoolQueuePaperOut = 1u << 3,
+  kSpoolQueuePrinting = 1u << 4,
+};
+
+// A printer and its queue as the spooler currently reports them.
+struct SpoolQueueInfo {
+  uint32_t status = 0;  // SpoolQueueStatus bits
+  // The spooler's own status value, for logs only.
+  uint32_t rawStatus = 0;
+  // Jobs in the queue and the pages each has printed so far.
+  std::vector<std::pair<int, int>> jobPages;
+};
+
+// A job in a queue and the document name it was submitted under.
+struct SpoolDocument {
+  int jobId = 0;
+  std::string name;
+};
+
+// What the watchers need from the print system: change notifications per
+// queue, job and queue lookups. The Win32 implementation (Win32SpoolBackend) uses
+// printer change notifications, the Linux one CUPS subscriptions; tests can
+// substitute a fake spooler.
+class SpoolBackend {
+ public:
+  virtual ~SpoolBackend() = default;
+
+  // Starts and stops change notifications for |queue|. Only called from the
+  // watcher thread, like Wait and QueryJob.
+  virtual bool AddQueue(const std::string& queue) = 0;
+  virtual void RemoveQueue(const std::string& queue) = 0;
+
+  // Blocks until a watched queue changes, Wake is called or |timeoutMs|
+  // passes (< 0: no timeout). Appends the queues that changed to |changed|.
+  virtual void Wait(int timeoutMs, std::vector<std::string>* changed) = 0;
+
+  // Makes a pending or the next Wait return early. Any thread.
+  virtual void Wake() = 0;
+
+  // Returns false if the spooler no longer knows the job.
+  virtual bool QueryJob(const std::string& queue, int jobId, SpoolJobInfo* info) = 0;
+
+  // Returns false if the printer is gone or unreachable. Only for queues
+  // added with AddQueue.
+  virtual bool QueryQueue(const std::string& queue, SpoolQueueInfo* info) = 0;
+
+  // Lists the jobs in |queue| with their document names. Returns false if
+  // the printer is gone or unreachable. Only for queues added with AddQueue.
+  virtual bool ListDocuments(const std::string& queue, std::vector<SpoolDocument>* documents) = 0;
+};
+
+// Final verdict on a watched job.
+struct SpoolOutcome {
+  bool success = false;
+  int maxPagesPrinted = 0;
+  // Largest spool size the spooler reported for the job, -1 if none.
+  int64_t spoolBytes = -1;
+  // Why, for the log ("Success (Job finished/handed off to printer).").
+  std::string reason;
+};
+
+// One thread watching every spooled job until the spooler is done with it,
+// woken by the backend's change notifications instead of polling each job
+// once a second on a thread of its own. Queues are resynced every
+// kResyncInterval in case a notification was missed, and a job is given up
+// on after kJobTimeout. Documents submitted by another program are watched by
+// the tag in their document name (see job_correlation.h) and resolved to a
+// job when one appears in their queue. Callbacks run on the watcher thread.
+class SpoolWatcher {
+ public:
+  using ProgressCallback = std::function<void(const SpoolJobInfo& info)>;
+  using DoneCallback = std::function<void(const SpoolOutcome& outcome)>;
+  using ResolvedCallback = std::function<void(int jobId)>;
+
+  static constexpr std::chrono::milliseconds kResyncInterval{5000};
+  static constexpr std::chrono::minutes kJobTimeout{10};
+  // How long a tagged document may take to show up in its queue.
+  static constexpr std::chrono::minutes kDocumentTimeout{2};
+
+  explicit SpoolWatcher(std::unique_ptr<SpoolBackend> backend);
+  // Stops watching; jobs still pending get no callbacks.
+  ~SpoolWatcher();
+
+  // Prevent copying.
+  SpoolWatcher(SpoolWatcher const&) = delete;
+  SpoolWatcher& operator=(SpoolWatcher const&) = delete;
+
+  // Watches |jobId| on |queue|. |progress| runs whenever the job's state
+  // changes, |done| once at the end. |totalPages| is what was spooled (0 if
+  // unknown) and only feeds the verdict.
+  void Watch(const std::string& queue, int jobId, int totalPages,
+             ProgressCallback progress, DoneCallback done);
+
+  // Watches the job whose document name carries |tag| once it shows up on
+  // |queue|, then like Watch. Call before handing the document to the
+  // submitter. |resolved| runs with the job id when it is found; if it never
+  // is within kDocumentTimeout, |done| reports a failure.
+  void WatchDocument(const std::string& queue, const std::string& tag, int totalPages,
+                     ResolvedCallback resolved, ProgressCallback progress, DoneCallback done);
+
+  // Jobs currently watched, including those not picked up yet.
+  size_t watched_count();
+
+ private:
+  struct Job {
+    std::string queue;
+    // 0 while waiting for the tagged document to show up.
+    int jobId = 0;
+    std::string tag;
+    int totalPages = 0;
+    ResolvedCallback resolved;
+    ProgressCallback progress;
+    DoneCallback done;
+    std::chrono::steady_clock::time_point deadline;
+    SpoolJobInfo last;
+    bool seen = false;
+    int maxPagesPrinted = 0;
+    int64_t spoolBytes = -1;
+    bool deletingSeen = false;
+    bool errorSeen = false;
+    bool offlineSeen = false;
+  };
+
+  void Run();
+  // Matches the queue's jobs against the documents still waiting on it.
+  void ResolveDocuments(const std::string& queue);
+  // Returns true when the job is over.
+  bool Poll(Job* job);
+  void Finish(Job* job);
+  void Release(const std::string& queue);
+
+  std::unique_ptr<SpoolBackend> backend_;
+  std::mutex mutex_;
+  std::vector<Job> incoming_;
+  size_t watched_ = 0;
+  bool stopping_ = false;
+  // Owned by the watcher thread.
+  std::vector<Job> jobs_;
+  // Tag -> document not found in its queue yet.
+  std::unordered_map<std::string, Job> documents_;
+  std::map<std::string, int> queue_refs_;
+  std::thread thread_;
+};
+
+#endif  // RUNNER_SPOOL_WATCHER_H_
@@ -0,0 +1,204 @@
+#include "streaming_buffer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Content-Length larger than this is not trusted for preallocation.
+constexpr int64_t kMaxReserveBytes = 512LL * 1024 * 1024;
+
+// Reads /L (file length) from a linearization dictionary in |head|.
+bool ParseLinearizedLength(const std::string& head, int64_t* length) {
+  size_t dict = head.find("/Linearized");
+  if (dict == std::string::npos) return false;
+  size_t end = head.find(">>", dict);
+  if (end == std::string::npos) return false;
+  for (size_t pos = head.find("/L", dict + 1); pos != std::string::npos && pos < end;
+       pos = head.find("/L", pos + 2)) {
+    // Lewati nama lain yang diawali /L
+    if (pos + 2 < head.size() && std::isalpha(static_cast<unsigned char>(head[pos + 2]))) continue;
+    *length = std::strtoll(head.c_str() + pos + 2, nullptr, 10);
+    return *length > 0;
+  }
+  return false;
+}
+
+// GInputStream + GSeekable over a StreamingBuffer, so Poppler can load the
+// document through its on-demand (cached file) loader.
+struct StreamingInputStream {
+  GInputStream parent_instance;
+  std::shared_ptr<StreamingBuffer>* buffer;
+  goffset position;
+};
+
+struct StreamingInputStreamClass {
+  GInputStreamClass parent_class;
+};
+
+void streaming_input_stream_seekable_init(GSeekableIface* iface);
+
+G_DEFINE_TYPE_WITH_CODE(StreamingInputStream, streaming_input_stream, G_TYPE_INPUT_STREAM,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_SEEKABLE, streaming_input_stream_seekable_init))
+
+StreamingInputStream* Self(gpointer object) {
+  return reinterpret_cast<StreamingInputStream*>(object);
+}
+
+gssize streaming_input_stream_read(GInputStream* stream, void* buffer, gsize count,
+                                   GCancellable*, GError** error) {
+  StreamingInputStream* self = Self(stream);
+  int64_t read = (*self->buffer)->Read(self->position, buffer, count);
+  if (read < 0) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE, "PDF download failed.");
+    return -1;
+  }
+  self->position += read;
+  return static_cast<gssize>(read);
+}
+
+goffset streaming_input_stream_tell(GSeekable* seekable) {
+  return Self(seekable)->position;
+}
+
+gboolean streaming_input_stream_can_seek(GSeekable*) {
+  return TRUE;
+}
+
+gboolean streaming_input_stream_seek(GSeekable* seekable, goffset offset, GSeekType type,
+                                     GCancellable*, GError** error) {
+  StreamingInputStream* self = Self(seekable);
+  goffset base = 0;
+  if (type == G_SEEK_CUR) {
+    base = self->position;
+  } else if (type == G_SEEK_END && (*self->buffer)->expected_length() >= 0) {
+    base = (*self->buffer)->expected_length();
+  } else if (type == G_SEEK_END) {
+    // Tanpa Content-Length akhir file baru diketahui setelah unduhan selesai
+    if (!(*self->buffer)->WaitForComplete()) {
+      g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE, "PDF download failed.");
+      return FALSE;
+    }
+    base = (*self->buffer)->received();
+  }
+  if (base + offset < 0) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid seek offset.");
+    return FALSE;
+  }
+  self->position = base + offset;
+  return TRUE;
+}
+
+gboolean streaming_input_stream_can_truncate(GSeekable*) {
+  return FALSE;
+}
+
+gboolean streaming_input_stream_truncate(GSeekable*, goffset, GCancellable*, GError** error) {
+  g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Cannot truncate a download.");
+  return FALSE;
+}
+
+void streaming_input_stream_seekable_init(GSeekableIface* iface) {
+  iface->tell = streaming_input_stream_tell;
+  iface->can_seek = streaming_input_stream_can_seek;
+  iface->seek = streaming_input_stream_seek;
+  iface->can_truncate = streaming_input_stream_can_truncate;
+  iface->truncate_fn = streaming_input_stream_truncate;
+}
+
+void streaming_input_stream_finalize(GObject* object) {
+  delete Self(object)->buffer;
+  G_OBJECT_CLASS(streaming_input_stream_parent_class)->finalize(object);
+}
+
+void streaming_input_stream_init(StreamingInputStream* self) {
+  self->buffer = nullptr;
+  self->position = 0;
+}
+
+void streaming_input_stream_class_init(StreamingInputStreamClass* klass) {
+  G_OBJECT_CLASS(klass)->finalize = streaming_input_stream_finalize;
+  G_INPUT_STREAM_CLASS(klass)->read_fn = streaming_input_stream_read;
+}
+
+}  // namespace
+
+StreamingBuffer::StreamingBuffer(int64_t expectedLength)
+    : expected_length_(expectedLength) {
+  if (expectedLength > 0) {
+    data_.reserve(static_cast<size_t>(std::min(expectedLength, kMaxReserveBytes)));
+  }
+}
+
+int64_t StreamingBuffer::received() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int64_t>(data_.size());
+}
+
+void StreamingBuffer::Append(const uint8_t* data, size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_ || failed_) return;
+    data_.insert(data_.end(), data, data + size);
+  }
+  arrived_.notify_all();
+}
+
+void StreamingBuffer::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+  }
+  arrived_.notify_all();
+}
+
+void StreamingBuffer::Fail() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = true;
+  }
+  arrived_.notify_all();
+}
+
+int64_t StreamingBuffer::Read(int64_t offset, void* buffer, size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  size_t begin = static_cast<size_t>(offset);
+  arrived_.wait(lock, [&] { return failed_ || finished_ || data_.size() >= begin + size; });
+  if (failed_) return -1;
+  if (begin >= data_.size()) return 0;
+  size_t count = std::min(size, data_.size() - begin);
+  std::memcpy(buffer, data_.data() + begin, count);
+  return static_cast<int64_t>(count);
+}
+
+bool StreamingBuffer::WaitForLinearized() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  arrived_.wait(lock, [&] { return failed_ || finished_ || data_.size() >= kLinearizationWindow; });
+  if (failed_ || expected_length_ <= 0) return false;
+  std::string head(reinterpret_cast<const char*>(data_.data()),
+                   std::min(data_.size(), kLinearizationWindow));
+  int64_t length = 0;
+  return ParseLinearizedLength(head, &length) && length == expected_length_;
+}
+
+bool StreamingBuffer::WaitForComplete() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  arrived_.wait(lock, [&] { return failed_ || finished_; });
+  return !failed_;
+}
+
+GBytes* StreamingBuffer::Bytes() {
+  auto* owner = new std::shared_ptr<StreamingBuffer>(shared_from_this());
+  return g_bytes_new_with_free_func(data_.data(), data_.size(),
+      [](gpointer data) { delete static_cast<std::shared_ptr<StreamingBuffer>*>(data); }, owner);
+}
+
+GInputStream* StreamingBuffer::NewInputStream() {
+  auto* stream = static_cast<StreamingInputStream*>(
+      g_object_new(streaming_input_stream_get_type(), nullptr));
+  stream->buffer = new std::shared_ptr<StreamingBuffer>(shared_from_this());
+  return G_INPUT_STREAM(stream);
+}
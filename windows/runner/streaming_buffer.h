@@ -0,0 +1,67 @@
+#ifndef RUNNER_STREAMING_BUFFER_H_
+#define RUNNER_STREAMING_BUFFER_H_
+
+#include <gio/gio.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A PDF that is still being downloaded, pushed in chunk by chunk from Dart.
+// Bytes are appended on the platform thread while print workers read them
+// through input streams that block until the range they need has arrived,
+// so Poppler can start on a linearized file before the transfer is done.
+class StreamingBuffer : public std::enable_shared_from_this<StreamingBuffer> {
+ public:
+  // |expectedLength| is the Content-Length of the download, or -1 if the
+  // server did not send one.
+  explicit StreamingBuffer(int64_t expectedLength);
+
+  StreamingBuffer(StreamingBuffer const&) = delete;
+  StreamingBuffer& operator=(StreamingBuffer const&) = delete;
+
+  int64_t expected_length() const { return expected_length_; }
+  int64_t received();
+
+  void Append(const uint8_t* data, size_t size);
+  // No more bytes will come. Reads past the end return what there is.
+  void Finish();
+  // The download broke off; blocked and later reads fail.
+  void Fail();
+
+  // Copies up to |size| bytes from |offset| into |buffer|, waiting until
+  // they have arrived or the download ends. Returns the number of bytes
+  // copied (0 at the end), or -1 if the download failed.
+  int64_t Read(int64_t offset, void* buffer, size_t size);
+
+  // Waits for the first kLinearizationWindow bytes and returns true if the
+  // file is linearized ("fast web view") with a length matching the
+  // Content-Length. Only such files can be parsed before they are complete.
+  bool WaitForLinearized();
+
+  // Waits for the whole download. False if it failed.
+  bool WaitForComplete();
+
+  // The complete content, sharing this buffer. Only valid after
+  // WaitForComplete() returned true.
+  GBytes* Bytes();
+
+  // A new seekable GInputStream over this buffer whose reads block until
+  // the bytes arrive. The stream keeps the buffer alive.
+  GInputStream* NewInputStream();
+
+ private:
+  // The linearization dictionary must start within the first 1024 bytes.
+  static constexpr size_t kLinearizationWindow = 1024;
+
+  std::mutex mutex_;
+  std::condition_variable arrived_;
+  std::vector<uint8_t> data_;
+  const int64_t expected_length_;
+  bool finished_ = false;
+  bool failed_ = false;
+};
+
+#endif  // RUNNER_STREAMING_BUFFER_H_
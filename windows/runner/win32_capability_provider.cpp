@@ -0,0 +1,123 @@
+#include "win32_capability_provider.h"
+
+#include <windows.h>
+#include <winspool.h>
+
+#include <cwchar>
+
+#include "utils.h"
+
+namespace {
+
+std::wstring ToWide(const std::string& printerName) {
+  std::wstring wprinter;
+  wprinter.assign(printerName.begin(), printerName.end());
+  return wprinter;
+}
+
+// DeviceCapabilities answers -1 on error and 0 for "none".
+int CapabilityCount(const std::wstring& printer, WORD capability) {
+  int count = DeviceCapabilitiesW(printer.c_str(), nullptr, capability, nullptr, nullptr);
+  return count > 0 ? count : 0;
+}
+
+}  // namespace
+
+std::vector<std::string> Win32CapabilityProvider::ListPrinters() {
+  std::vector<std::string> printers;
+  DWORD flags = PRINTER_ENUM_LOCAL | PRINTER_ENUM_CONNECTIONS;
+  DWORD bytesNeeded = 0, returned = 0;
+  EnumPrintersW(flags, nullptr, 4, nullptr, 0, &bytesNeeded, &returned);
+  if (bytesNeeded == 0) return printers;
+  std::vector<BYTE> buffer(bytesNeeded);
+  if (!EnumPrintersW(flags, nullptr, 4, buffer.data(), bytesNeeded, &bytesNeeded, &returned)) {
+    return printers;
+  }
+  const PRINTER_INFO_4W* info = reinterpret_cast<const PRINTER_INFO_4W*>(buffer.data());
+  for (DWORD i = 0; i < returned; ++i) {
+    if (info[i].pPrinterName) printers.push_back(Utf8FromUtf16(info[i].pPrinterName));
+  }
+  return printers;
+}
+
+bool Win32CapabilityProvider::DriverVersion(const std::string& printer, std::string* version) {
+  std::wstring wprinter = ToWide(printer);
+  HANDLE hPrinter = nullptr;
+  if (!OpenPrinterW(const_cast<LPWSTR>(wprinter.c_str()), &hPrinter, nullptr)) return false;
+
+  DWORD bytesNeeded = 0;
+  GetPrinterDriverW(hPrinter, nullptr, 6, nullptr, 0, &bytesNeeded);
+  std::vector<BYTE> buffer(bytesNeeded);
+  bool fetched = bytesNeeded > 0 &&
+                 GetPrinterDriverW(hPrinter, nullptr, 6, buffer.data(), bytesNeeded, &bytesNeeded);
+  ClosePrinter(hPrinter);
+  if (!fetched) return false;
+
+  // Nama driver + versi + tanggal: berubah setiap driver diperbarui atau diganti
+  const DRIVER_INFO_6W* driver = reinterpret_cast<const DRIVER_INFO_6W*>(buffer.data());
+  wchar_t stamp[64];
+  swprintf(stamp, 64, L" %llx %08lx%08lx", (unsigned long long)driver->dwlDriverVersion,
+           driver->ftDriverDate.dwHighDateTime, driver->ftDriverDate.dwLowDateTime);
+  *version = Utf8FromUtf16(driver->pName ? driver->pName : L"") + Utf8FromUtf16(stamp);
+  return true;
+}
+
+bool Win32CapabilityProvider::Query(const std::string& printer, PrinterCapabilities* caps) {
+  if (!DriverVersion(printer, &caps->driverVersion)) return false;
+  std::wstring wprinter = ToWide(printer);
+
+  // DC_PAPERS, DC_PAPERNAMES dan DC_PAPERSIZE memakai urutan yang sama
+  int count = CapabilityCount(wprinter, DC_PAPERS);
+  if (count > 0) {
+    std::vector<WORD> ids(count);
+    std::vector<wchar_t> names((size_t)count * 64);
+    std::vector<POINT> sizes(count);
+    DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_PAPERS, reinterpret_cast<LPWSTR>(ids.data()), nullptr);
+    bool hasNames = CapabilityCount(wprinter, DC_PAPERNAMES) == count &&
+                    DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_PAPERNAMES, names.data(), nullptr) > 0;
+    bool hasSizes = CapabilityCount(wprinter, DC_PAPERSIZE) == count &&
+                    DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_PAPERSIZE,
+                                        reinterpret_cast<LPWSTR>(sizes.data()), nullptr) > 0;
+    for (int i = 0; i < count; ++i) {
+      PaperInfo paper;
+      paper.id = ids[i];
+      if (hasNames) {
+        // Setiap nama maksimal 64 karakter dan tidak selalu diakhiri null
+        const wchar_t* name = names.data() + (size_t)i * 64;
+        paper.name = Utf8FromUtf16(std::wstring(name, wcsnlen(name, 64)).c_str());
+      }
+      if (hasSizes) {
+        paper.width = sizes[i].x;
+        paper.height = sizes[i].y;
+      }
+      caps->papers.push_back(paper);
+    }
+  }
+
+  int resolutions = CapabilityCount(wprinter, DC_ENUMRESOLUTIONS);
+  if (resolutions > 0) {
+    std::vector<LONG> pairs((size_t)resolutions * 2);
+    DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_ENUMRESOLUTIONS, reinterpret_cast<LPWSTR>(pairs.data()),
+                        nullptr);
+    for (int i = 0; i < resolutions; ++i) caps->dpis.push_back((int)pairs[(size_t)i * 2]);
+  }
+  caps->duplex = DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_DUPLEX, nullptr, nullptr) == 1;
+  caps->color = DeviceCapabilitiesW(wprinter.c_str(), nullptr, DC_COLORDEVICE, nullptr, nullptr) == 1;
+
+  // Margin hardware dari DC dengan DEVMODE default
+  HDC hdc = CreateDCW(L"WINSPOOL", wprinter.c_str(), nullptr, nullptr);
+  if (hdc) {
+    int dpiX = GetDeviceCaps(hdc, LOGPIXELSX);
+    int dpiY = GetDeviceCaps(hdc, LOGPIXELSY);
+    if (dpiX > 0 && dpiY > 0) {
+      int offsetX = GetDeviceCaps(hdc, PHYSICALOFFSETX);
+      int offsetY = GetDeviceCaps(hdc, PHYSICALOFFSETY);
+      caps->marginLeft = offsetX * 72.0 / dpiX;
+      caps->marginTop = offsetY * 72.0 / dpiY;
+      caps->marginRight = (GetDeviceCaps(hdc, PHYSICALWIDTH) - offsetX - GetDeviceCaps(hdc, HORZRES)) * 72.0 / dpiX;
+      caps->marginBottom = (GetDeviceCaps(hdc, PHYSICALHEIGHT) - offsetY - GetDeviceCaps(hdc, VERTRES)) * 72.0 / dpiY;
+    }
+    DeleteDC(hdc);
+  }
+  return true;
+}
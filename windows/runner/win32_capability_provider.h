@@ -0,0 +1,17 @@
+#ifndef RUNNER_WIN32_CAPABILITY_PROVIDER_H_
+#define RUNNER_WIN32_CAPABILITY_PROVIDER_H_
+
+#include "printer_capability_db.h"
+
+// CapabilityProvider on the Windows spooler: DeviceCapabilities for papers,
+// resolutions, duplex and colour, the default DEVMODE's device context for
+// hardware margins, and the driver's version and date from
+// GetPrinterDriver as the invalidation key.
+class Win32CapabilityProvider : public CapabilityProvider {
+ public:
+  std::vector<std::string> ListPrinters() override;
+  bool DriverVersion(const std::string& printer, std::string* version) override;
+  bool Query(const std::string& printer, PrinterCapabilities* caps) override;
+};
+
+#endif  // RUNNER_WIN32_CAPABILITY_PROVIDER_H_
@@ -0,0 +1,119 @@
+#include "win32_printer_driver.h"
+
+#include <windows.h>
+#include <winspool.h>
+
+namespace {
+
+struct OpenedPrinter {
+  HANDLE printer = nullptr;
+  HANDLE change = INVALID_HANDLE_VALUE;
+};
+
+std::wstring ToWide(const std::string& printerName) {
+  std::wstring wprinter;
+  wprinter.assign(printerName.begin(), printerName.end());
+  return wprinter;
+}
+
+}  // namespace
+
+PrinterDriver::Handle Win32PrinterDriver::Open(const std::string& printerName) {
+  std::wstring wprinter = ToWide(printerName);
+  HANDLE hPrinter = nullptr;
+  if (!OpenPrinterW(const_cast<LPWSTR>(wprinter.c_str()), &hPrinter, nullptr)) {
+    return nullptr;
+  }
+
+  // Hanya perubahan driver/DEVMODE/nama yang membatalkan cache, bukan status printer
+  WORD fields[] = {PRINTER_NOTIFY_FIELD_DEVMODE, PRINTER_NOTIFY_FIELD_DRIVER_NAME,
+                   PRINTER_NOTIFY_FIELD_PRINTER_NAME};
+  PRINTER_NOTIFY_OPTIONS_TYPE type = {};
+  type.Type = PRINTER_NOTIFY_TYPE;
+  type.Count = ARRAYSIZE(fields);
+  type.pFields = fields;
+  PRINTER_NOTIFY_OPTIONS options = {};
+  options.Version = 2;
+  options.Count = 1;
+  options.pTypes = &type;
+
+  OpenedPrinter* opened = new OpenedPrinter();
+  opened->printer = hPrinter;
+  opened->change = FindFirstPrinterChangeNotification(
+      hPrinter, PRINTER_CHANGE_DELETE_PRINTER | PRINTER_CHANGE_PRINTER_DRIVER, 0, &options);
+  return opened;
+}
+
+void Win32PrinterDriver::Close(Handle handle) {
+  OpenedPrinter* opened = static_cast<OpenedPrinter*>(handle);
+  if (opened->change != INVALID_HANDLE_VALUE) {
+    FindClosePrinterChangeNotification(opened->change);
+  }
+  ClosePrinter(opened->printer);
+  delete opened;
+}
+
+bool Win32PrinterDriver::BuildDevMode(Handle handle, const std::string& printerName,
+                                      const DevModeRequest& request,
+                                      std::vector<unsigned char>* devMode,
+                                      std::string* errorCode) {
+  OpenedPrinter* opened = static_cast<OpenedPrinter*>(handle);
+  std::wstring wprinter = ToWide(printerName);
+
+  // Mendapatkan ukuran DEVMODE default
+  LONG devModeSize = DocumentPropertiesW(nullptr, opened->printer, const_cast<LPWSTR>(wprinter.c_str()), nullptr, nullptr, 0);
+  if (devModeSize <= 0) {
+    if (errorCode) *errorCode = "GET_DEVMODE_SIZE_FAILED";
+    return false;
+  }
+
+  std::vector<unsigned char> buffer(devModeSize);
+  PDEVMODEW pDevMode = reinterpret_cast<PDEVMODEW>(buffer.data());
+
+  // Mendapatkan DEVMODE default
+  if (DocumentPropertiesW(nullptr, opened->printer, const_cast<LPWSTR>(wprinter.c_str()), pDevMode, nullptr, DM_OUT_BUFFER) != IDOK) {
+    if (errorCode) *errorCode = "GET_DEVMODE_FAILED";
+    return false;
+  }
+
+  // Mengatur metadata cetak
+  pDevMode->dmFields |= DM_COPIES | DM_DUPLEX | DM_COLOR | DM_ORIENTATION | DM_PRINTQUALITY | DM_YRESOLUTION | DM_PAPERSIZE;
+  pDevMode->dmPaperSize = static_cast<short>(request.paperSize);
+
+  // Set kualitas cetak
+  pDevMode->dmPrintQuality = DMRES_HIGH;
+  pDevMode->dmYResolution = pDevMode->dmPrintQuality;
+  pDevMode->dmCopies = 1;
+
+  // Set cetak bolak-balik (duplex)
+  if (request.duplex) {
+    pDevMode->dmDuplex = request.landscape ? DMDUP_HORIZONTAL : DMDUP_VERTICAL;
+  }
+  else {
+    pDevMode->dmDuplex = DMDUP_SIMPLEX;
+  }
+
+  pDevMode->dmOrientation = request.landscape ? DMORIENT_LANDSCAPE : DMORIENT_PORTRAIT;
+  pDevMode->dmColor = request.color ? DMCOLOR_COLOR : DMCOLOR_MONOCHROME;
+
+  // Pastikan perubahan pada DEVMODE berhasil diterapkan
+  if (DocumentPropertiesW(nullptr, opened->printer, const_cast<LPWSTR>(wprinter.c_str()), pDevMode, pDevMode, DM_IN_BUFFER | DM_OUT_BUFFER) != IDOK) {
+    OutputDebugStringA("Gagal mengatur kualitas cetak tinggi. Melanjutkan dengan pengaturan default.\n");
+  }
+
+  *devMode = std::move(buffer);
+  return true;
+}
+
+bool Win32PrinterDriver::ConsumeChange(Handle handle) {
+  OpenedPrinter* opened = static_cast<OpenedPrinter*>(handle);
+  if (opened->change == INVALID_HANDLE_VALUE) return false;
+  if (WaitForSingleObject(opened->change, 0) != WAIT_OBJECT_0) return false;
+
+  // Reset notifikasi agar event berikutnya bisa ditangkap
+  DWORD change = 0;
+  PPRINTER_NOTIFY_INFO info = nullptr;
+  FindNextPrinterChangeNotification(opened->change, &change, nullptr, reinterpret_cast<LPVOID*>(&info));
+  if (info) FreePrinterNotifyInfo(info);
+  return true;
+}
@@ -0,0 +1,20 @@
+#ifndef RUNNER_WIN32_PRINTER_DRIVER_H_
+#define RUNNER_WIN32_PRINTER_DRIVER_H_
+
+#include "printer_session_cache.h"
+
+// PrinterDriver backed by the Windows spooler. Each opened printer also gets
+// a change notification limited to driver, DEVMODE and name changes, so
+// status updates while printing do not throw the cached DEVMODEs away.
+class Win32PrinterDriver : public PrinterDriver {
+ public:
+  Handle Open(const std::string& printerName) override;
+  void Close(Handle handle) override;
+  bool BuildDevMode(Handle handle, const std::string& printerName,
+                    const DevModeRequest& request,
+                    std::vector<unsigned char>* devMode,
+                    std::string* errorCode) override;
+  bool ConsumeChange(Handle handle) override;
+};
+
+#endif  // RUNNER_WIN32_PRINTER_DRIVER_H_
@@ -0,0 +1,195 @@
+#include "win32_spool_backend.h"
+
+#include <winspool.h>
+
+namespace {
+
+std::wstring ToWide(const std::string& printerName) {
+  std::wstring wprinter;
+  wprinter.assign(printerName.begin(), printerName.end());
+  return wprinter;
+}
+
+std::string ToUtf8(const wchar_t* text) {
+  if (!text || !*text) return std::string();
+  int size = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+  if (size <= 1) return std::string();
+  std::string result(size - 1, '\0');
+  WideCharToMultiByte(CP_UTF8, 0, text, -1, &result[0], size, nullptr, nullptr);
+  return result;
+}
+
+uint32_t ToSpoolJobStatus(DWORD status) {
+  uint32_t result = 0;
+  if (status & JOB_STATUS_PRINTING) result |= kSpoolJobPrinting;
+  if (status & JOB_STATUS_SPOOLING) result |= kSpoolJobSpooling;
+  if (status & JOB_STATUS_ERROR) result |= kSpoolJobError;
+  if (status & JOB_STATUS_OFFLINE) result |= kSpoolJobOffline;
+  if (status & JOB_STATUS_PAPEROUT) result |= kSpoolJobPaperOut;
+  if (status & (JOB_STATUS_DELETING | JOB_STATUS_DELETED)) result |= kSpoolJobDeleting;
+  if (status & JOB_STATUS_BLOCKED_DEVQ) result |= kSpoolJobBlocked;
+  return result;
+}
+
+uint32_t ToSpoolQueueStatus(DWORD status, DWORD attributes) {
+  uint32_t result = 0;
+  if ((status & (PRINTER_STATUS_OFFLINE | PRINTER_STATUS_NOT_AVAILABLE)) ||
+      (attributes & PRINTER_ATTRIBUTE_WORK_OFFLINE)) {
+    result |= kSpoolQueueOffline;
+  }
+  if (status & (PRINTER_STATUS_ERROR | PRINTER_STATUS_PAPER_JAM | PRINTER_STATUS_USER_INTERVENTION)) {
+    result |= kSpoolQueueError;
+  }
+  if (status & PRINTER_STATUS_PAUSED) result |= kSpoolQueuePaused;
+  if (status & PRINTER_STATUS_PAPER_OUT) result |= kSpoolQueuePaperOut;
+  if (status & PRINTER_STATUS_PRINTING) result |= kSpoolQueuePrinting;
+  return result;
+}
+
+// Fills |buffer| through a Win32 "size query, then fetch" call.
+template <typename Fetch>
+bool FetchInto(std::vector<BYTE>* buffer, Fetch fetch) {
+  DWORD bytesNeeded = 0;
+  if (fetch(buffer->data(), (DWORD)buffer->size(), &bytesNeeded)) return true;
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || bytesNeeded == 0) return false;
+  buffer->resize(bytesNeeded);
+  return fetch(buffer->data(), (DWORD)buffer->size(), &bytesNeeded) != FALSE;
+}
+
+}  // namespace
+
+Win32SpoolBackend::Win32SpoolBackend() {
+  wake_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+}
+
+Win32SpoolBackend::~Win32SpoolBackend() {
+  for (auto& entry : queues_) {
+    if (entry.second.change != INVALID_HANDLE_VALUE) {
+      FindClosePrinterChangeNotification(entry.second.change);
+    }
+    ClosePrinter(entry.second.printer);
+  }
+  if (wake_) CloseHandle(wake_);
+}
+
+bool Win32SpoolBackend::AddQueue(const std::string& queue) {
+  std::wstring wprinter = ToWide(queue);
+  Queue opened;
+  if (!OpenPrinterW(const_cast<LPWSTR>(wprinter.c_str()), &opened.printer, nullptr)) {
+    return false;
+  }
+  // Tambah, ubah status dan hapus job semuanya memicu notifikasi ini;
+  // SET_PRINTER untuk perubahan status printer (offline, kertas habis)
+  opened.change = FindFirstPrinterChangeNotification(
+      opened.printer, PRINTER_CHANGE_JOB | PRINTER_CHANGE_SET_PRINTER, 0, nullptr);
+  queues_[queue] = opened;
+  return true;
+}
+
+void Win32SpoolBackend::RemoveQueue(const std::string& queue) {
+  auto it = queues_.find(queue);
+  if (it == queues_.end()) return;
+  if (it->second.change != INVALID_HANDLE_VALUE) {
+    FindClosePrinterChangeNotification(it->second.change);
+  }
+  ClosePrinter(it->second.printer);
+  queues_.erase(it);
+}
+
+void Win32SpoolBackend::Wait(int timeoutMs, std::vector<std::string>* changed) {
+  std::vector<HANDLE> handles = {wake_};
+  std::vector<const std::string*> names = {nullptr};
+  for (const auto& entry : queues_) {
+    if (entry.second.change == INVALID_HANDLE_VALUE) continue;
+    if (handles.size() == MAXIMUM_WAIT_OBJECTS) break;
+    handles.push_back(entry.second.change);
+    names.push_back(&entry.first);
+  }
+
+  DWORD waited = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE,
+                                        timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+  if (waited == WAIT_TIMEOUT || waited == WAIT_FAILED) return;
+
+  // Bisa lebih dari satu printer yang berubah; semua notifikasi yang
+  // tersinyal di-reset supaya event berikutnya tertangkap
+  for (size_t i = 1; i < handles.size(); ++i) {
+    if (WaitForSingleObject(handles[i], 0) != WAIT_OBJECT_0) continue;
+    DWORD change = 0;
+    FindNextPrinterChangeNotification(handles[i], &change, nullptr, nullptr);
+    changed->push_back(*names[i]);
+  }
+}
+
+void Win32SpoolBackend::Wake() {
+  if (wake_) SetEvent(wake_);
+}
+
+bool Win32SpoolBackend::QueryJob(const std::string& queue, int jobId, SpoolJobInfo* info) {
+  auto it = queues_.find(queue);
+  if (it == queues_.end()) return false;
+
+  HANDLE printer = it->second.printer;
+  bool fetched = FetchInto(&job_buffer_, [printer, jobId](BYTE* data, DWORD size, DWORD* needed) {
+    return GetJobW(printer, (DWORD)jobId, 2, data, size, needed);
+  });
+  // Job sudah selesai dan dihapus dari spooler oleh Windows
+  if (!fetched) return false;
+
+  const JOB_INFO_2W* job = reinterpret_cast<const JOB_INFO_2W*>(job_buffer_.data());
+  info->rawStatus = job->Status;
+  info->status = ToSpoolJobStatus(job->Status);
+  info->pagesPrinted = (int)job->PagesPrinted;
+  info->totalPages = (int)job->TotalPages;
+  info->spoolBytes = (int64_t)job->Size;
+  return true;
+}
+
+bool Win32SpoolBackend::QueryQueue(const std::string& queue, SpoolQueueInfo* info) {
+  auto it = queues_.find(queue);
+  if (it == queues_.end()) return false;
+  HANDLE printer = it->second.printer;
+
+  bool fetched = FetchInto(&printer_buffer_, [printer](BYTE* data, DWORD size, DWORD* needed) {
+    return GetPrinterW(printer, 2, data, size, needed);
+  });
+  if (!fetched) return false;
+  const PRINTER_INFO_2W* printerInfo = reinterpret_cast<const PRINTER_INFO_2W*>(printer_buffer_.data());
+  info->rawStatus = printerInfo->Status;
+  info->status = ToSpoolQueueStatus(printerInfo->Status, printerInfo->Attributes);
+  DWORD jobCount = printerInfo->cJobs;
+
+  info->jobPages.clear();
+  if (jobCount == 0) return true;
+  DWORD returned = 0;
+  fetched = FetchInto(&job_buffer_, [printer, jobCount, &returned](BYTE* data, DWORD size, DWORD* needed) {
+    return EnumJobsW(printer, 0, jobCount, 1, data, size, needed, &returned);
+  });
+  if (!fetched) return true;
+  const JOB_INFO_1W* jobs = reinterpret_cast<const JOB_INFO_1W*>(job_buffer_.data());
+  for (DWORD i = 0; i < returned; ++i) {
+    info->jobPages.emplace_back((int)jobs[i].JobId, (int)jobs[i].PagesPrinted);
+  }
+  return true;
+}
+
+bool Win32SpoolBackend::ListDocuments(const std::string& queue,
+                                      std::vector<SpoolDocument>* documents) {
+  auto it = queues_.find(queue);
+  if (it == queues_.end()) return false;
+  HANDLE printer = it->second.printer;
+
+  documents->clear();
+  DWORD returned = 0;
+  bool fetched = FetchInto(&job_buffer_, [printer, &returned](BYTE* data, DWORD size, DWORD* needed) {
+    return EnumJobsW(printer, 0, MAXDWORD, 1, data, size, needed, &returned);
+  });
+  if (!fetched) return false;
+  const JOB_INFO_1W* jobs = reinterpret_cast<const JOB_INFO_1W*>(job_buffer_.data());
+  for (DWORD i = 0; i < returned; ++i) {
+    SpoolDocument document;
+    document.jobId = (int)jobs[i].JobId;
+    document.name = ToUtf8(jobs[i].pDocument);
+    documents->push_back(std::move(document));
+  }
+  return true;
+}
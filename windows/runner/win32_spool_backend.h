@@ -0,0 +1,46 @@
+#ifndef RUNNER_WIN32_SPOOL_BACKEND_H_
+#define RUNNER_WIN32_SPOOL_BACKEND_H_
+
+#include <windows.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "spool_watcher.h"
+
+// SpoolBackend on the Windows spooler. Every watched printer gets its own
+// handle with a job and printer change notification, and Wait blocks on all of
+// them plus a wake event. WaitForMultipleObjects caps that at 63 printers;
+// any beyond are only seen on the watcher's periodic resync.
+class Win32SpoolBackend : public SpoolBackend {
+ public:
+  Win32SpoolBackend();
+  ~Win32SpoolBackend() override;
+
+  // Prevent copying.
+  Win32SpoolBackend(Win32SpoolBackend const&) = delete;
+  Win32SpoolBackend& operator=(Win32SpoolBackend const&) = delete;
+
+  bool AddQueue(const std::string& queue) override;
+  void RemoveQueue(const std::string& queue) override;
+  void Wait(int timeoutMs, std::vector<std::string>* changed) override;
+  void Wake() override;
+  bool QueryJob(const std::string& queue, int jobId, SpoolJobInfo* info) override;
+  bool QueryQueue(const std::string& queue, SpoolQueueInfo* info) override;
+  bool ListDocuments(const std::string& queue, std::vector<SpoolDocument>* documents) override;
+
+ private:
+  struct Queue {
+    HANDLE printer = nullptr;
+    HANDLE change = INVALID_HANDLE_VALUE;
+  };
+
+  HANDLE wake_ = nullptr;
+  std::map<std::string, Queue> queues_;
+  // Reused by the queries, grown as needed.
+  std::vector<BYTE> job_buffer_;
+  std::vector<BYTE> printer_buffer_;
+};
+
+#endif  // RUNNER_WIN32_SPOOL_BACKEND_H_